@@ -12,10 +12,90 @@
 
 
 //#if BOARD == DEVELOPMENT_BOARD_V1_1_0 || BOARD == WRIGHT_V1_0_0 || BOARD == EARHART_V1_0_0
+/** Construct the DataManager and the STM24256 driver it uses by default.
+ *  The DataManager also drives the same pins itself, through an I2C 
+ *  object and a DigitalOut on the write control pin, for current address
+ *  reads, the adaptive clock, pipelined writes and asynchronous calls.
+ *  The two never transfer at once: mbed re-applies each I2C object's 
+ *  frequency when the bus passes between them, both leave the write 
+ *  control pin high when idle and blocking transfers return ASYNC_BUSY
+ *  whilst an asynchronous call is in progress. Nothing else may use 
+ *  these pins whilst the DataManager exists
+ *
+ * @param write_control Write control pin of the EEPROM
+ * @param sda I2C data pin
+ * @param scl I2C clock pin
+ * @param frequency_hz Bus clock whilst the adaptive clock is disabled
+ */
 DataManager::DataManager(PinName write_control, PinName sda, PinName scl, int frequency_hz) : 
-                         _storage(write_control, sda, scl, frequency_hz)
+                         _storage(write_control, sda, scl, frequency_hz),
+                         _transaction_open(false),
+                         _rle_next_evict(0),
+                         _i2c(sda, scl),
+                         _write_control(write_control, 1),
+                         _address_known(false),
+                         _frequency_hz(frequency_hz),
+                         _adaptive_clock(false),
+                         _polling_write_cycle(false),
+                         _pipelined_writes(false),
+                         _write_cycle_pending(false),
+                         #if DEVICE_I2C_ASYNCH
+                         _async_state(ASYNC_IDLE),
+                         #endif /* #if DEVICE_I2C_ASYNCH */
+                         _scratch_used(0),
+                         _scratch_peak(0),
+                         _api_depth(0),
+                         _api_op(0),
+                         #if DM_TRACE == true
+                         _trace_next(0),
+                         _trace_count(0),
+                         #endif /* #if DM_TRACE == true */
+                         _image_checksum(DataManager_FileSystem::IMAGE_CHECKSUM_SEED),
+                         _image_page(0),
+                         _image_restore_active(false)
 {
-    
+    for(int slot = 0; slot < RLE_MAX_OPEN_FILES; slot++)
+    {
+        _rle_files[slot].open = false;
+    }
+
+    _archive.open = false;
+    _truncate_step.active = false;
+    _truncate_step.persistent = false;
+    _operation.loaded = false;
+    _operation.active = false;
+    _operation.sequence = 0;
+    _layout_checked = false;
+    reset_compression_stats();
+    reset_io_stats();
+    set_adaptive_clock(false);
+
+    /** Timing starts from the datasheet and follows the measured transfers
+     */
+    DataManager_LatencyClock::start();
+    _timing.bus_byte_ns = ((uint64_t)BUS_CLOCKS_PER_BYTE * 1000000000) / _frequency_hz;
+    _timing.write_cycle_us = ENERGY_WRITE_CYCLE_US;
+
+    RetryPolicy_t policy = { NUM_OF_WRITE_RETRIES, RETRY_BACKOFF_US, RETRY_BACKOFF_MAX_US };
+    set_retry_policy(policy);
+    reset_retry_stats();
+
+    #if DM_LATENCY_HISTOGRAMS == true
+    reset_latency_histograms();
+    #endif /* #if DM_LATENCY_HISTOGRAMS == true */
+
+    #if DM_ENERGY_MODEL == true
+    EnergyModel_t model = { ENERGY_SUPPLY_MV, ENERGY_MCU_ACTIVE_UA, ENERGY_EEPROM_ACTIVE_UA, 
+                            ENERGY_EEPROM_WRITE_UA, ENERGY_WRITE_CYCLE_US };
+    set_energy_model(model);
+    reset_energy_stats();
+    #endif /* #if DM_ENERGY_MODEL == true */
+
+    #if DM_SPANS == true
+    _span_depth = 0;
+    _span_mark_ticks = 0;
+    reset_spans();
+    #endif /* #if DM_SPANS == true */
 }
 //#endif /* #if BOARD == ... */
 
@@ -33,25 +113,116 @@ DataManager::~DataManager()
  */
 int DataManager::init_filesystem()
 {
-    char blank[PAGE_SIZE_BYTES] = { 0 };
+    ApiScope api(*this, DataManager_FileSystem::TRACE_INIT_FILESYSTEM, 0, 0, 0);
 
-    int status = -1;
-    for(int ft_page = 0; ft_page < FILE_TABLE_PAGES; ft_page++)
+    /** A truncation in progress refers to a file table that is about to go,
+     *  as does a resumable operation, which mustn't be resumed after a reset
+     */
+    _truncate_step.active = false;
+
+    int status = load_operation();
+
+    /** The operation page of an older layout may hold file data, which is
+     *  overwritten rather than interpreted
+     */
+    bool incompatible = (status == DataManager_FileSystem::LAYOUT_INCOMPATIBLE);
+
+    if(incompatible)
+    {
+        _operation.loaded = true;
+        _operation.active = false;
+        status = DataManager::DATA_MANAGER_OK;
+    }
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return api.done(status);
+    }
+
+    if(_operation.active || incompatible)
     {
-        status = _storage.write_to_address(FILE_TABLE_START_ADDRESS + (ft_page * PAGE_SIZE_BYTES), blank, PAGE_SIZE_BYTES);
+        _operation.active = false;
+
+        status = write_operation();
 
         if(status != DataManager::DATA_MANAGER_OK)
         {
-            return status;
+            return api.done(status);
         }
-        wait_us(5000);
     }
 
-    return DataManager::DATA_MANAGER_OK;
+    for(int page = 0; page <= FILE_TABLE_PAGES; page++)
+    {
+        status = clear_filesystem_page(page);
+
+        if(status != DataManager::DATA_MANAGER_OK)
+        {
+            return api.done(status);
+        }
+    }
+
+    return api.done(DataManager::DATA_MANAGER_OK);
+}
+
+/** Resumable form of init_filesystem(), which clears one page per step
+ *  and persists its progress so that a reset part way through continues
+ *  from the last checkpoint rather than restarting. Call again, or call
+ *  resume_operation(), until it returns something other than
+ *  OPERATION_IN_PROGRESS. Supersedes any other resumable operation
+ *
+ * @param &budget Work that this call may do
+ * @return OPERATION_IN_PROGRESS or the outcome of the operation
+ */
+int DataManager::init_filesystem(const OperationBudget_t &budget)
+{
+    ApiScope api(*this, DataManager_FileSystem::TRACE_INIT_FILESYSTEM, 0, 0, 0);
+
+    int status = load_operation();
+
+    /** The operation page of an older layout may hold file data, which the
+     *  first checkpoint overwrites rather than it being interpreted
+     */
+    if(status == DataManager_FileSystem::LAYOUT_INCOMPATIBLE)
+    {
+        _operation.loaded = true;
+        _operation.active = false;
+        status = DataManager::DATA_MANAGER_OK;
+    }
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return api.done(status);
+    }
+
+    if(!_operation.active || _operation.op != DataManager_FileSystem::TRACE_INIT_FILESYSTEM)
+    {
+        _truncate_step.active = false;
+
+        _operation.active = true;
+        _operation.op = DataManager_FileSystem::TRACE_INIT_FILESYSTEM;
+        _operation.filename = 0;
+        _operation.archive_filename = 0;
+        _operation.progress = 0;
+        _operation.total = FILE_TABLE_PAGES + 1;
+        _operation.archive_address = 0;
+        memset(_operation.file.data, 0, sizeof(_operation.file));
+
+        status = write_operation();
+
+        if(status != DataManager::DATA_MANAGER_OK)
+        {
+            _operation.active = false;
+            return api.done(status);
+        }
+    }
+
+    return api.done(run_operation(budget));
 }
 
 int DataManager::init_gstats()
 {
+    ApiScope api(*this, DataManager_FileSystem::TRACE_INIT_GSTATS, 0, 0, 0);
+
     int status = -1;
     DataManager_FileSystem::GlobalStats_t g_stats;
     g_stats.parameters.next_available_address = STORAGE_START_ADDRESS;
@@ -64,10 +235,12 @@ int DataManager::init_gstats()
 
     if(status != DataManager::DATA_MANAGER_OK)
     {
-        return status;
+        return api.done(status);
     }
+
+    _layout_checked = true;
     
-    return DataManager::DATA_MANAGER_OK;
+    return api.done(DataManager::DATA_MANAGER_OK);
 }
 
 /** Determine whether or not the filesystem has been initialised
@@ -79,13 +252,22 @@ int DataManager::init_gstats()
  */
 int DataManager::is_initialised(bool &initialised)
 {
+    ApiScope api(*this, DataManager_FileSystem::TRACE_IS_INITIALISED, 0, 0, 0);
+
+    int status = check_layout();
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return api.done(status);
+    }
+
     DataManager_FileSystem::GlobalStats_t g_stats;
     
-    int status = get_global_stats(g_stats.data);
+    status = get_global_stats(g_stats.data);
 
     if(status != DataManager::DATA_MANAGER_OK)
     {
-        return status;
+        return api.done(status);
     }
 
     if(g_stats.parameters.initialised != DataManager_FileSystem::INITIALISED)
@@ -95,7 +277,7 @@ int DataManager::is_initialised(bool &initialised)
 
     initialised = true;
 
-    return DataManager::DATA_MANAGER_OK;
+    return api.done(DataManager::DATA_MANAGER_OK);
 }
 
 /** Get global next address and space remaining counters
@@ -105,14 +287,16 @@ int DataManager::is_initialised(bool &initialised)
  */
 int DataManager::get_global_stats(char *data)
 {
-    int status = _storage.read_from_address(GLOBAL_STATS_START_ADDRESS, data, GLOBAL_STATS_LENGTH);
+    ApiScope api(*this, DataManager_FileSystem::TRACE_GET_GLOBAL_STATS, 0, 0, 0);
+
+    int status = read_storage(GLOBAL_STATS_START_ADDRESS, data, GLOBAL_STATS_LENGTH);
 
     if(status != DataManager::DATA_MANAGER_OK)
     {
-        return status;
+        return api.done(status);
     }
 
-    return DataManager::DATA_MANAGER_OK;
+    return api.done(DataManager::DATA_MANAGER_OK);
 }
 
 /** Return maximum number of files that can be stored
@@ -143,20 +327,31 @@ int DataManager::get_storage_size_bytes()
  */
 int DataManager::add_file(DataManager_FileSystem::File_t file, uint16_t entries_to_store)
 {
+    ApiScope api(*this, DataManager_FileSystem::TRACE_ADD_FILE, file.parameters.filename, entries_to_store, file.parameters.length_bytes);
+
     int requested_space = entries_to_store * file.parameters.length_bytes;
 
+    /** The space remaining of an older layout counts pages since reserved
+     */
+    int g_stats_status = check_layout();
+
+    if(g_stats_status != DataManager::DATA_MANAGER_OK)
+    {
+        return api.done(g_stats_status);
+    }
+
     DataManager_FileSystem::GlobalStats_t g_stats;
 
-    int g_stats_status = get_global_stats(g_stats.data);
+    g_stats_status = get_global_stats(g_stats.data);
 
     if(g_stats_status != DataManager::DATA_MANAGER_OK)
     {
-        return g_stats_status;
+        return api.done(g_stats_status);
     }
 
     if(requested_space > g_stats.parameters.space_remaining)
     {
-        return DataManager_FileSystem::FILE_TABLE_FULL;
+        return api.done(DataManager_FileSystem::FILE_TABLE_FULL);
     }
 
     file.parameters.file_start_address = g_stats.parameters.next_available_address;
@@ -164,40 +359,35 @@ int DataManager::add_file(DataManager_FileSystem::File_t file, uint16_t entries_
     file.parameters.file_end_address = (g_stats.parameters.next_available_address + requested_space) - 1;
 
     g_stats.parameters.next_available_address = file.parameters.file_end_address + 1;
-    g_stats.parameters.space_remaining = EEPROM_SIZE_BYTES - g_stats.parameters.next_available_address; 
+    g_stats.parameters.space_remaining = (STORAGE_START_ADDRESS + STORAGE_LENGTH) - g_stats.parameters.next_available_address; 
 
     g_stats_status = set_global_stats(g_stats.data);
 
     if(g_stats_status != DataManager::DATA_MANAGER_OK)
     {
-        return g_stats_status;
+        return api.done(g_stats_status);
     }
 
-    file.parameters.valid = (file.parameters.filename + file.parameters.length_bytes + file.parameters.file_start_address +
-                            file.parameters.file_end_address + file.parameters.next_available_address) | 1;
+    file.parameters.valid = DataManager_FileSystem::file_checksum(file);
 
     int address = -1;
     int next_address_status = get_next_available_file_table_address(address);
 
     if(next_address_status != DataManager::DATA_MANAGER_OK) 
     {
-        return next_address_status;
+        return api.done(next_address_status);
     }
 
     if(address == -1)
     {
-        return DataManager_FileSystem::FILE_TABLE_FULL;
-    }
-    int write_status = -1;
-    for(int i=0; i<NUM_OF_WRITE_RETRIES && write_status!= DataManager::DATA_MANAGER_OK; i++)
-    {
-        write_status = _storage.write_to_address(address, file.data, sizeof(file));
+        return api.done(DataManager_FileSystem::FILE_TABLE_FULL);
     }
+    int write_status = write_with_retry(address, file.data, sizeof(file));
     if(write_status != DataManager::DATA_MANAGER_OK)
     {
-        return write_status;
+        return api.done(write_status);
     }
-    return DataManager::DATA_MANAGER_OK;
+    return api.done(DataManager::DATA_MANAGER_OK);
 }
 
 /** Get all File_t parameters for a given filename
@@ -209,38 +399,11 @@ int DataManager::add_file(DataManager_FileSystem::File_t file, uint16_t entries_
  */
 int DataManager::get_file_by_name(uint8_t filename, DataManager_FileSystem::File_t &file)
 {
-    int file_size = sizeof(DataManager_FileSystem::File_t);
-
-    uint16_t max_files = get_max_files();
-    bool match = false;
-
-    for(uint16_t file_index = 0; file_index < max_files; file_index++)
-    {
-        int status = _storage.read_from_address(FILE_TABLE_START_ADDRESS + (file_index * file_size), file.data, file_size);
-
-        if(status != DataManager::DATA_MANAGER_OK)
-        {
-            return status;
-        }
-
-        if(!is_valid_file(file))
-        {
-            continue;
-        }
+    ApiScope api(*this, DataManager_FileSystem::TRACE_GET_FILE_BY_NAME, filename, 0, 0);
 
-        if(filename == file.parameters.filename)
-        {
-            match = true;
-            break;
-        }
-    }
+    int address = -1;
 
-    if(!match)
-    {
-        return DataManager_FileSystem::FILE_INVALID_NAME;
-    }
-    
-    return DataManager::DATA_MANAGER_OK;
+    return api.done(get_file_table_entry(filename, file, address));
 }
 
 /** Calculate the number of valid files current stored in memory
@@ -250,6 +413,9 @@ int DataManager::get_file_by_name(uint8_t filename, DataManager_FileSystem::File
  */
 int DataManager::total_stored_files(int &valid_files)
 {
+    ApiScope api(*this, DataManager_FileSystem::TRACE_TOTAL_STORED_FILES, 0, 0, 0);
+    Span span(*this, DataManager_FileSystem::SPAN_TABLE_SCAN);
+
     DataManager_FileSystem::File_t file;
     int file_size = sizeof(file);
     
@@ -257,11 +423,11 @@ int DataManager::total_stored_files(int &valid_files)
 
     for(uint16_t file_index = 0; file_index < max_files; file_index++)
     {
-        int status = _storage.read_from_address(FILE_TABLE_START_ADDRESS + (file_index * file_size), file.data, file_size);
+        int status = read_storage(FILE_TABLE_START_ADDRESS + (file_index * file_size), file.data, file_size);
 
         if(status != DataManager::DATA_MANAGER_OK)
         {
-            return status;
+            return api.done(status);
         }
 
         if(is_valid_file(file))
@@ -270,7 +436,7 @@ int DataManager::total_stored_files(int &valid_files)
         }
     }
 
-    return DataManager::DATA_MANAGER_OK;
+    return api.done(DataManager::DATA_MANAGER_OK);
 }
 
 /** Calculate total number of spaces available in the file table
@@ -283,19 +449,21 @@ int DataManager::total_stored_files(int &valid_files)
  */
 int DataManager::total_remaining_file_table_entries(int &remaining_files)
 {
+    ApiScope api(*this, DataManager_FileSystem::TRACE_TOTAL_REMAINING_FILE_TABLE, 0, 0, 0);
+
     int valid_files = 0;
     int status = total_stored_files(valid_files);
 
     if(status != DataManager::DATA_MANAGER_OK)
     {
-        return status; 
+        return api.done(status); 
     }
 
     uint16_t max_files = get_max_files();
 
     remaining_files = max_files - valid_files;
 
-    return DataManager::DATA_MANAGER_OK;
+    return api.done(DataManager::DATA_MANAGER_OK);
 }
 
 /** Read an entry, i.e. actual data such as a measurement, from a 
@@ -309,13 +477,15 @@ int DataManager::total_remaining_file_table_entries(int &remaining_files)
  */
 int DataManager::read_file_entry(uint8_t filename, int entry_index, char *data, int data_length)
 {
+    ApiScope api(*this, DataManager_FileSystem::TRACE_READ_FILE_ENTRY, filename, entry_index, data_length);
+
     DataManager_FileSystem::File_t file;
 
     int status = get_file_by_name(filename, file);
 
     if(status != DataManager::DATA_MANAGER_OK)
     {
-        return status;
+        return api.done(status);
     }
 
     int total_written_entries = 0;
@@ -323,28 +493,31 @@ int DataManager::read_file_entry(uint8_t filename, int entry_index, char *data,
 
     if(status != DataManager::DATA_MANAGER_OK)
     {
-        return status;
+        return api.done(status);
     }
 
     if(entry_index + 1 > total_written_entries)
     {
-        return DataManager_FileSystem::FILE_ENTRY_INVALID_INDEX;
+        return api.done(DataManager_FileSystem::FILE_ENTRY_INVALID_INDEX);
     }
 
     if(data_length != file.parameters.length_bytes)
     {
-        return DataManager_FileSystem::FILE_ENTRY_LENGTH_MISMATCH;
+        return api.done(DataManager_FileSystem::FILE_ENTRY_LENGTH_MISMATCH);
     }
 
     uint16_t address = file.parameters.file_start_address + (entry_index * data_length);
-    status = _storage.read_from_address(address, data, data_length);
+    {
+        Span span(*this, DataManager_FileSystem::SPAN_DATA_READ);
+        status = read_storage(address, data, data_length);
+    }
 
     if(status != DataManager::DATA_MANAGER_OK)
     {
-        return status;
+        return api.done(status);
     }
 
-    return DataManager::DATA_MANAGER_OK;
+    return api.done(DataManager::DATA_MANAGER_OK);
 }
 
 /** Write an entry, i.e. actual data such as a measurement, to next 
@@ -357,42 +530,77 @@ int DataManager::read_file_entry(uint8_t filename, int entry_index, char *data,
  */
 int DataManager::append_file_entry(uint8_t filename, char *data, int data_length)
 {
+    ApiScope api(*this, DataManager_FileSystem::TRACE_APPEND_FILE_ENTRY, filename, 0, data_length);
+
     DataManager_FileSystem::File_t file;
+    int address = -1;
+    int staged = -1;
+    int status = -1;
 
-    int status = get_file_by_name(filename, file);
+    /** Files already staged by the open transaction have newer metadata in RAM 
+     *  than in the file table
+     */
+    if(_transaction_open)
+    {
+        staged = get_staged_file(filename);
+    }
 
-    if(status != DataManager::DATA_MANAGER_OK)
+    if(staged != -1)
     {
-        return status;
+        file = _journal.parameters.records[staged].file;
+    }
+    else
+    {
+        status = get_file_table_entry(filename, file, address);
+
+        if(status != DataManager::DATA_MANAGER_OK)
+        {
+            return api.done(status);
+        }
+
+        if(_transaction_open && _journal.parameters.entries >= DataManager_FileSystem::TRANSACTION_MAX_FILES)
+        {
+            return api.done(DataManager_FileSystem::TRANSACTION_FULL);
+        }
     }
 
     if(data_length != file.parameters.length_bytes)
     {
-        return DataManager_FileSystem::FILE_ENTRY_LENGTH_MISMATCH;
+        return api.done(DataManager_FileSystem::FILE_ENTRY_LENGTH_MISMATCH);
     }
 
     if((data_length - 1) + file.parameters.next_available_address 
        > file.parameters.file_end_address)
     {
-        return DataManager_FileSystem::FILE_ENTRY_FULL;
+        return api.done(DataManager_FileSystem::FILE_ENTRY_FULL);
     }
 
     /** Write actual data, i.e. a measurement, to the next available address 
      */
-    status = -1;
-    for(int i=0; i<NUM_OF_WRITE_RETRIES && status!= DataManager::DATA_MANAGER_OK; i++)
     {
-        status = _storage.write_to_address(file.parameters.next_available_address, 
-                                    data, data_length);
+        Span span(*this, DataManager_FileSystem::SPAN_DATA_WRITE);
+        status = write_with_retry(file.parameters.next_available_address, data, data_length);
     }
     if(status != DataManager::DATA_MANAGER_OK)
     {
-        return status;
+        return api.done(status);
     }
 
     file.parameters.next_available_address += data_length;
-    file.parameters.valid = (file.parameters.filename + file.parameters.length_bytes + file.parameters.file_start_address +
-                            file.parameters.file_end_address + file.parameters.next_available_address) | 1;
+    file.parameters.valid = DataManager_FileSystem::file_checksum(file);
+
+    if(_transaction_open)
+    {
+        if(staged == -1)
+        {
+            staged = _journal.parameters.entries++;
+            _journal.parameters.records[staged].address = address;
+        }
+
+        _journal.parameters.records[staged].file = file;
+
+        return api.done(DataManager::DATA_MANAGER_OK);
+    }
     
     /** Update the next available address and validity byte
      */
@@ -400,10 +608,10 @@ int DataManager::append_file_entry(uint8_t filename, char *data, int data_length
 
     if(status != DataManager::DATA_MANAGER_OK)
     {
-        return status;
+        return api.done(status);
     }
 
-    return DataManager::DATA_MANAGER_OK;
+    return api.done(DataManager::DATA_MANAGER_OK);
 }
 
 /** By resetting the next available address to the file start address
@@ -415,27 +623,37 @@ int DataManager::append_file_entry(uint8_t filename, char *data, int data_length
  */  
 int DataManager::delete_file_entries(uint8_t filename)
 {
+    ApiScope api(*this, DataManager_FileSystem::TRACE_DELETE_FILE_ENTRIES, filename, 0, 0);
+
+    /** The open transaction would overwrite this change when it commits
+     */
+    if(_transaction_open && get_staged_file(filename) != -1)
+    {
+        return api.done(DataManager_FileSystem::TRANSACTION_CONFLICT);
+    }
+
+    close_file_state(filename);
+
     DataManager_FileSystem::File_t file;
 
     int status = get_file_by_name(filename, file);
 
     if(status != DataManager::DATA_MANAGER_OK)
     {
-        return status;
+        return api.done(status);
     }
 
     file.parameters.next_available_address = file.parameters.file_start_address;
-    file.parameters.valid = (file.parameters.filename + file.parameters.length_bytes + file.parameters.file_start_address +
-                            file.parameters.file_end_address + file.parameters.next_available_address) | 1;
+    file.parameters.valid = DataManager_FileSystem::file_checksum(file);
 
     status = modify_file(filename, file);
 
     if(status != DataManager::DATA_MANAGER_OK)
     {
-        return status;
+        return api.done(status);
     }
 
-    return DataManager::DATA_MANAGER_OK;
+    return api.done(DataManager::DATA_MANAGER_OK);
 }
 
 /** Write an entry, i.e. actual data such as a measurement, to the 
@@ -448,36 +666,44 @@ int DataManager::delete_file_entries(uint8_t filename)
  */
 int DataManager::overwrite_file_entries(uint8_t filename, char *data, int data_length)
 {
+    ApiScope api(*this, DataManager_FileSystem::TRACE_OVERWRITE_FILE_ENTRIES, filename, 0, data_length);
+
+    /** The open transaction would overwrite this change when it commits
+     */
+    if(_transaction_open && get_staged_file(filename) != -1)
+    {
+        return api.done(DataManager_FileSystem::TRANSACTION_CONFLICT);
+    }
+
+    close_file_state(filename);
+
     DataManager_FileSystem::File_t file;
 
     int status = get_file_by_name(filename, file);
 
     if(status != DataManager::DATA_MANAGER_OK)
     {
-        return status;
+        return api.done(status);
     }
 
     if(data_length != file.parameters.length_bytes)
     {
-        return DataManager_FileSystem::FILE_ENTRY_LENGTH_MISMATCH;
+        return api.done(DataManager_FileSystem::FILE_ENTRY_LENGTH_MISMATCH);
     }
 
     /** Write actual data, i.e. a measurement, to the start address 
      */
-    status = -1;
-    for(int i=0; i<NUM_OF_WRITE_RETRIES && status!= DataManager::DATA_MANAGER_OK; i++)
     {
-        status = _storage.write_to_address(file.parameters.file_start_address, 
-                                    data, data_length);
+        Span span(*this, DataManager_FileSystem::SPAN_DATA_WRITE);
+        status = write_with_retry(file.parameters.file_start_address, data, data_length);
     }
     if(status != DataManager::DATA_MANAGER_OK)
     {
-        return status;
+        return api.done(status);
     }
     
     file.parameters.next_available_address = file.parameters.file_start_address + data_length;
-    file.parameters.valid = (file.parameters.filename + file.parameters.length_bytes + file.parameters.file_start_address +
-                            file.parameters.file_end_address + file.parameters.next_available_address) | 1;
+    file.parameters.valid = DataManager_FileSystem::file_checksum(file);
     
     /** Update the next available address and validity byte
      */
@@ -485,10 +711,10 @@ int DataManager::overwrite_file_entries(uint8_t filename, char *data, int data_l
 
     if(status != DataManager::DATA_MANAGER_OK)
     {
-        return status;
+        return api.done(status);
     }
 
-    return DataManager::DATA_MANAGER_OK;
+    return api.done(DataManager::DATA_MANAGER_OK);
 }
 
 /** Remove entries_to_remove entries starting from index 0, shift
@@ -504,295 +730,4692 @@ int DataManager::overwrite_file_entries(uint8_t filename, char *data, int data_l
  */
 int DataManager::truncate_file(uint8_t filename, int entries_to_remove)
 {
-    DataManager_FileSystem::File_t file;
+    ApiScope api(*this, DataManager_FileSystem::TRACE_TRUNCATE_FILE, filename, entries_to_remove, 0);
 
-    int status = get_file_by_name(filename, file);
+    int status = DataManager_FileSystem::OPERATION_IN_PROGRESS;
 
-    if(status != DataManager::DATA_MANAGER_OK)
+    while(status == DataManager_FileSystem::OPERATION_IN_PROGRESS)
     {
-        return status;
+        status = truncate_file_step(filename, entries_to_remove);
     }
 
-    int written_entries = 0;
-    status = get_total_written_file_entries(filename, written_entries);
+    return api.done(status);
+}
 
-    if(status != DataManager::DATA_MANAGER_OK)
+/** Make one step of truncate_file(), so that other work can be done
+ *  between the write cycles of a long truncation. The first step looks
+ *  the file up, each following step moves at most one page of entries,
+ *  i.e. makes one write cycle, and the last updates the file's metadata.
+ *  Call with the same arguments until it returns something other than
+ *  OPERATION_IN_PROGRESS. A step that fails ends the truncation, leaving
+ *  the entries already moved where they are and the file's metadata as it
+ *  was. Other files may be used between steps but the file being 
+ *  truncated must not be
+ *
+ * @param filename ID of the file on which this operation is to be performed
+ * @param entries_to_remove Number of entries to be truncated from the 
+ *                          start of the file entry table
+ * @return OPERATION_IN_PROGRESS, OPERATION_BUSY if another truncation is
+ *         in progress or the outcome of the truncation
+ */
+int DataManager::truncate_file_step(uint8_t filename, int entries_to_remove)
+{
+    ApiScope api(*this, DataManager_FileSystem::TRACE_TRUNCATE_FILE_STEP, filename, entries_to_remove, 0);
+
+    /** A resumable operation owns the truncation in progress
+     */
+    if(_operation.active)
     {
-        return status;
+        return api.done(DataManager_FileSystem::OPERATION_BUSY);
     }
 
-    if(entries_to_remove >= written_entries)
+    int status = truncate_step(filename, entries_to_remove);
+
+    /** A failed step mustn't leave the truncation open, else every later
+     *  truncation is refused and a retry would finish the move with the
+     *  length the file had when it started, dropping entries appended since
+     */
+    if(status != DataManager::DATA_MANAGER_OK && status != DataManager_FileSystem::OPERATION_IN_PROGRESS &&
+       status != DataManager_FileSystem::OPERATION_BUSY)
     {
-        status = delete_file_entries(filename);
+        _truncate_step.active = false;
+    }
 
-        if(status != DataManager::DATA_MANAGER_OK)
-        {
-            return status;
-        }
+    return api.done(status);
+}
 
-        return DataManager::DATA_MANAGER_OK;
-    }
+/** Resumable form of truncate_file(), which persists its progress so
+ *  that a reset part way through can be continued by resume_operation()
+ *  rather than leaving the file half moved. A move never overwrites
+ *  entries that the last checkpoint would move again, so a truncation
+ *  of fewer than a page of bytes moves less than a page per step and
+ *  adds a checkpoint to each step. Call with the same arguments, or
+ *  call resume_operation(), until it returns something other than
+ *  OPERATION_IN_PROGRESS; the file must not be used in the meantime
+ *
+ * @param filename ID of the file on which this operation is to be performed
+ * @param entries_to_remove Number of entries to be truncated from the 
+ *                          start of the file entry table
+ * @param &budget Work that this call may do
+ * @return OPERATION_IN_PROGRESS, OPERATION_BUSY if another operation is
+ *         in progress or the outcome of the truncation
+ */
+int DataManager::truncate_file(uint8_t filename, int entries_to_remove, const OperationBudget_t &budget)
+{
+    ApiScope api(*this, DataManager_FileSystem::TRACE_TRUNCATE_FILE, filename, entries_to_remove, 0);
 
-    char buffer[file.parameters.length_bytes];
-    int new_index = 0;
+    int status = load_operation();
 
-    for(int current_index = entries_to_remove; current_index < written_entries; current_index++)
+    if(status != DataManager::DATA_MANAGER_OK)
     {
-        status = read_file_entry(filename, current_index, buffer, file.parameters.length_bytes);
+        return api.done(status);
+    }
 
-        if(status != DataManager::DATA_MANAGER_OK)
+    if(_operation.active)
+    {
+        if(_operation.op != DataManager_FileSystem::TRACE_TRUNCATE_FILE || _truncate_step.filename != filename ||
+           _truncate_step.entries_to_remove != entries_to_remove)
         {
-            return status;
+            return api.done(DataManager_FileSystem::OPERATION_BUSY);
         }
 
-        uint16_t new_address = file.parameters.file_start_address + (new_index * file.parameters.length_bytes);
-        status = -1;
-        for(int i=0; i<NUM_OF_WRITE_RETRIES && status!= DataManager::DATA_MANAGER_OK; i++)
-        {
-            status = _storage.write_to_address(new_address, buffer, file.parameters.length_bytes);
-        }
-        if(status != DataManager::DATA_MANAGER_OK)
-        {
-            return status;
-        }
-        new_index++;
+        return api.done(run_operation(budget));
     }
 
-    file.parameters.next_available_address = file.parameters.file_start_address + (new_index * file.parameters.length_bytes); 
-    file.parameters.valid = (file.parameters.filename + file.parameters.length_bytes + file.parameters.file_start_address +
-                            file.parameters.file_end_address + file.parameters.next_available_address) | 1;
-    
-    /** Update the next available address and validity byte
+    if(_truncate_step.active)
+    {
+        return api.done(DataManager_FileSystem::OPERATION_BUSY);
+    }
+
+    /** The first step looks the file up, or deletes every entry at once
      */
-    status = modify_file(filename, file);
+    status = truncate_step(filename, entries_to_remove);
+
+    if(status != DataManager_FileSystem::OPERATION_IN_PROGRESS)
+    {
+        return api.done(status);
+    }
+
+    _truncate_step.persistent = true;
+    _truncate_step.checkpoint_address = _truncate_step.source_address;
+
+    _operation.active = true;
+    _operation.op = DataManager_FileSystem::TRACE_TRUNCATE_FILE;
+    _operation.filename = filename;
+    _operation.archive_filename = 0;
+    _operation.progress = 0;
+    _operation.total = 0;
+    _operation.archive_address = 0;
+    _operation.file = _truncate_step.file;
+
+    /** Nothing has moved yet, so a failed checkpoint abandons the truncation
+     */
+    status = write_operation();
 
     if(status != DataManager::DATA_MANAGER_OK)
     {
-        return status;
+        _operation.active = false;
+        _truncate_step.active = false;
+        _truncate_step.persistent = false;
+        return api.done(status);
     }
 
-    return DataManager::DATA_MANAGER_OK;
+    return api.done(run_operation(budget));
 }
 
-/** Calculate number of entries within a file
+/** Make one step of a truncation
  *
- * @param filename ID of the file to be queried
- * @param &written_entries Address of integer value to which the number
- *                         of written entries should be stored
- * @return Indicates success or failure reason
+ * @param filename ID of the file on which this operation is to be performed
+ * @param entries_to_remove Number of entries to be truncated from the 
+ *                          start of the file entry table
+ * @return OPERATION_IN_PROGRESS or the outcome of the truncation
  */
-int DataManager::get_total_written_file_entries(uint8_t filename, int &written_entries)
+int DataManager::truncate_step(uint8_t filename, int entries_to_remove)
 {
-    DataManager_FileSystem::File_t file;
-
-    int status = get_file_by_name(filename, file);
+    TruncateStep_t &step = _truncate_step;
 
-    if(status != DataManager::DATA_MANAGER_OK)
+    if(step.active && (step.filename != filename || step.entries_to_remove != entries_to_remove))
     {
-        return status;
+        return DataManager_FileSystem::OPERATION_BUSY;
     }
 
-    int remaining_length = (file.parameters.file_end_address + 1) 
-                          - file.parameters.next_available_address;
+    if(!step.active)
+    {
+        /** The open transaction would overwrite this change when it commits
+         */
+        if(_transaction_open && get_staged_file(filename) != -1)
+        {
+            return DataManager_FileSystem::TRANSACTION_CONFLICT;
+        }
 
-    int remaining_entries = remaining_length / file.parameters.length_bytes;
+        close_file_state(filename);
 
-    int total_entries = ((file.parameters.file_end_address - file.parameters.file_start_address) + 1 ) 
-                        / file.parameters.length_bytes;
+        int status = get_file_table_entry(filename, step.file, step.address);
 
-    written_entries = total_entries - remaining_entries;
+        if(status != DataManager::DATA_MANAGER_OK)
+        {
+            return status;
+        }
 
-    return DataManager::DATA_MANAGER_OK;
-}
+        int written_entries = 0;
+        status = get_total_written_file_entries(filename, written_entries);
 
-/** Calculate number of measurements that can be stored
- *
- * @param filename ID of the file to be queried
+        if(status != DataManager::DATA_MANAGER_OK)
+        {
+            return status;
+        }
+
+        if(entries_to_remove >= written_entries)
+        {
+            return delete_file_entries(filename);
+        }
+
+        /** Move the remaining entries as a byte range rather than entry by 
+         *  entry. The destination is always below the source, so copying 
+         *  forwards never overwrites bytes that are yet to be read
+         */
+        int length_bytes = step.file.parameters.length_bytes;
+        step.filename = filename;
+        step.entries_to_remove = entries_to_remove;
+        step.remaining_bytes = (written_entries - entries_to_remove) * length_bytes;
+        step.source_address = step.file.parameters.file_start_address + (entries_to_remove * length_bytes);
+        step.new_address = step.file.parameters.file_start_address;
+        step.persistent = false;
+        step.active = true;
+
+        return DataManager_FileSystem::OPERATION_IN_PROGRESS;
+    }
+
+    if(step.remaining_bytes > 0)
+    {
+        ScratchBuffer buffer(*this, PAGE_SIZE_BYTES);
+
+        if(buffer.data == NULL)
+        {
+            return DataManager_FileSystem::SCRATCH_ARENA_EXHAUSTED;
+        }
+
+        int chunk = truncate_chunk(step);
+        int status;
+
+        /** Checkpoint before a move would overwrite entries that resuming
+         *  from the last checkpoint would read again
+         */
+        if(step.persistent && step.new_address + chunk > step.checkpoint_address)
+        {
+            status = write_operation();
+
+            if(status != DataManager::DATA_MANAGER_OK)
+            {
+                return status;
+            }
+        }
+
+        Span move_span(*this, DataManager_FileSystem::SPAN_DATA_MOVE);
+
+        status = read_storage(step.source_address, buffer.data, chunk);
+
+        if(status != DataManager::DATA_MANAGER_OK)
+        {
+            return status;
+        }
+
+        status = write_with_retry(step.new_address, buffer.data, chunk);
+
+        if(status != DataManager::DATA_MANAGER_OK)
+        {
+            return status;
+        }
+
+        step.source_address += chunk;
+        step.new_address += chunk;
+        step.remaining_bytes -= chunk;
+
+        return DataManager_FileSystem::OPERATION_IN_PROGRESS;
+    }
+
+    step.file.parameters.next_available_address = step.new_address; 
+    step.file.parameters.valid = DataManager_FileSystem::file_checksum(step.file);
+    
+    /** Update the next available address and validity byte. A persistent
+     *  truncation writes the entry at its known address, which also repairs
+     *  an entry torn by a reset whilst the truncation was finishing
+     */
+    int status;
+
+    if(step.persistent)
+    {
+        Span span(*this, DataManager_FileSystem::SPAN_METADATA_WRITE);
+        status = write_with_retry(step.address, step.file.data, sizeof(step.file));
+    }
+    else
+    {
+        status = modify_file(filename, step.file);
+    }
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return status;
+    }
+
+    step.active = false;
+    step.persistent = false;
+
+    return DataManager::DATA_MANAGER_OK;
+}
+
+/** Calculate number of entries within a file
+ *
+ * @param filename ID of the file to be queried
+ * @param &written_entries Address of integer value to which the number
+ *                         of written entries should be stored
+ * @return Indicates success or failure reason
+ */
+int DataManager::get_total_written_file_entries(uint8_t filename, int &written_entries)
+{
+    ApiScope api(*this, DataManager_FileSystem::TRACE_GET_TOTAL_WRITTEN_ENTRIES, filename, 0, 0);
+
+    DataManager_FileSystem::File_t file;
+
+    int status = get_file_by_name(filename, file);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return api.done(status);
+    }
+
+    int remaining_length = (file.parameters.file_end_address + 1) 
+                          - file.parameters.next_available_address;
+
+    int remaining_entries = remaining_length / file.parameters.length_bytes;
+
+    int total_entries = ((file.parameters.file_end_address - file.parameters.file_start_address) + 1 ) 
+                        / file.parameters.length_bytes;
+
+    written_entries = total_entries - remaining_entries;
+
+    return api.done(DataManager::DATA_MANAGER_OK);
+}
+
+/** Calculate number of measurements that can be stored
+ *
+ * @param filename ID of the file to be queried
  * @param &remaining_entries Address of integer value to which the number
  *                           of remaining measurements should be stored
  * @return Indicates success or failure reason
  */
-int DataManager::get_remaining_file_entries(uint8_t filename, int &remaining_entries)
+int DataManager::get_remaining_file_entries(uint8_t filename, int &remaining_entries)
+{
+    ApiScope api(*this, DataManager_FileSystem::TRACE_GET_REMAINING_ENTRIES, filename, 0, 0);
+
+    DataManager_FileSystem::File_t file;
+
+    int status = get_file_by_name(filename, file);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return api.done(status);
+    }
+
+    int remaining_length = (file.parameters.file_end_address + 1) 
+                          - file.parameters.next_available_address;
+
+    remaining_entries = remaining_length / file.parameters.length_bytes;
+
+    return api.done(DataManager::DATA_MANAGER_OK);
+}
+
+/** Calculate remaining space for entries in bytes
+ *
+ * @param filename ID of the file to be queried
+ * @param &remaining_entries Address of integer value to which the amount
+ *                           of remaining space should be stored
+ * @return Indicates success or failure reason
+ */
+int DataManager::get_remaining_file_entries_bytes(uint8_t filename, int &remaining_bytes)
+{
+    ApiScope api(*this, DataManager_FileSystem::TRACE_GET_REMAINING_ENTRIES_BYTES, filename, 0, 0);
+
+    DataManager_FileSystem::File_t file;
+
+    int status = get_file_by_name(filename, file);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return api.done(status);
+    }
+
+    remaining_bytes = (file.parameters.file_end_address + 1) 
+                     - file.parameters.next_available_address;
+
+    return api.done(DataManager::DATA_MANAGER_OK);
+}
+
+/** Add a record group, i.e. a file whose entries are rows holding one
+ *  sample of each channel in a fixed schema, so that a tick costs a single
+ *  data write and metadata update. Rows are appended with append_file_entry(),
+ *  each channel being stored at record_channel_offset() within the row
+ *
+ * @param filename ID of the record group
+ * @param schema Number of channels and length of each channel in bytes
+ * @param rows_to_store Number of rows to be stored
+ * @return Indicates success or failure reason
+ */
+int DataManager::add_record_group(uint8_t filename, DataManager_FileSystem::RecordSchema_t schema, uint16_t rows_to_store)
+{
+    ApiScope api(*this, DataManager_FileSystem::TRACE_ADD_RECORD_GROUP, filename, rows_to_store, 0);
+
+    int status = check_record_schema(schema, NULL);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return api.done(status);
+    }
+
+    DataManager_FileSystem::File_t file;
+    file.parameters.filename = filename;
+    file.parameters.length_bytes = DataManager_FileSystem::record_channel_offset(schema, schema.parameters.channels);
+
+    return api.done(add_file(file, rows_to_store));
+}
+
+/** Read a single channel from a specific row of a record group
+ *
+ * @param filename ID of the record group from which we should read
+ * @param schema Schema with which the record group was added
+ * @param row_index 0-indexed row to be read
+ * @param channel 0-indexed channel to be read
+ * @param *data Pointer to an array in which the read data will be stored
+ * @param data_length Length of *data in bytes, must equal the channel length
+ * @return Indicates success or failure reason
+ */
+int DataManager::read_record_channel(uint8_t filename, DataManager_FileSystem::RecordSchema_t schema, 
+                                     int row_index, uint8_t channel, char *data, int data_length)
+{
+    ApiScope api(*this, DataManager_FileSystem::TRACE_READ_RECORD_CHANNEL, filename, row_index, data_length);
+
+    return api.done(read_record_projection(filename, schema, channel, row_index, 1, data, data_length));
+}
+
+/** Read a single channel from consecutive rows of a record group, i.e. 
+ *  a column. Whole rows are read in page-sized chunks when the skipped
+ *  channels are narrower than the overhead of a random read
+ *
+ * @param filename ID of the record group from which we should read
+ * @param schema Schema with which the record group was added
+ * @param channel 0-indexed channel to be read
+ * @param first_row 0-indexed row from which to start reading
+ * @param rows Number of rows to be read
+ * @param *data Pointer to an array in which the channel samples will be stored
+ * @param data_length Length of *data in bytes, must equal rows multiplied by
+ *                    the channel length
+ * @return Indicates success or failure reason
+ */
+int DataManager::read_record_projection(uint8_t filename, DataManager_FileSystem::RecordSchema_t schema, uint8_t channel,
+                                        int first_row, int rows, char *data, int data_length)
+{
+    ApiScope api(*this, DataManager_FileSystem::TRACE_READ_RECORD_PROJECTION, filename, first_row, data_length);
+
+    DataManager_FileSystem::File_t file;
+
+    int status = get_file_by_name(filename, file);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return api.done(status);
+    }
+
+    status = check_record_schema(schema, &file);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return api.done(status);
+    }
+
+    if(channel >= schema.parameters.channels)
+    {
+        return api.done(DataManager_FileSystem::RECORD_INVALID_CHANNEL);
+    }
+
+    int row_length = file.parameters.length_bytes;
+    int channel_offset = DataManager_FileSystem::record_channel_offset(schema, channel);
+    int channel_length = schema.parameters.channel_length_bytes[channel];
+
+    if(data_length != rows * channel_length)
+    {
+        return api.done(DataManager_FileSystem::FILE_ENTRY_LENGTH_MISMATCH);
+    }
+
+    int written_rows = (file.parameters.next_available_address - file.parameters.file_start_address) / row_length;
+
+    if(first_row < 0 || rows < 0 || first_row + rows > written_rows)
+    {
+        return api.done(DataManager_FileSystem::FILE_ENTRY_INVALID_INDEX);
+    }
+
+    uint16_t address = file.parameters.file_start_address + (first_row * row_length);
+    int rows_per_chunk = PAGE_SIZE_BYTES / row_length;
+
+    /** Read only the channel from each row when the other channels are too 
+     *  wide to be worth transferring
+     */
+    if(rows_per_chunk == 0 || row_length - channel_length > RANDOM_READ_OVERHEAD_BYTES)
+    {
+        for(int row = 0; row < rows; row++)
+        {
+            status = read_storage(address + channel_offset, &data[row * channel_length], channel_length);
+
+            if(status != DataManager::DATA_MANAGER_OK)
+            {
+                return api.done(status);
+            }
+
+            address += row_length;
+        }
+
+        return api.done(DataManager::DATA_MANAGER_OK);
+    }
+
+    ScratchBuffer buffer(*this, PAGE_SIZE_BYTES);
+
+    if(buffer.data == NULL)
+    {
+        return api.done(DataManager_FileSystem::SCRATCH_ARENA_EXHAUSTED);
+    }
+
+    for(int row = 0; row < rows; row += rows_per_chunk)
+    {
+        int chunk_rows = (rows - row < rows_per_chunk) ? rows - row : rows_per_chunk;
+
+        status = read_storage(address, buffer.data, chunk_rows * row_length);
+
+        if(status != DataManager::DATA_MANAGER_OK)
+        {
+            return api.done(status);
+        }
+
+        for(int chunk_row = 0; chunk_row < chunk_rows; chunk_row++)
+        {
+            memcpy(&data[(row + chunk_row) * channel_length], &buffer.data[(chunk_row * row_length) + channel_offset], channel_length);
+        }
+
+        address += chunk_rows * row_length;
+    }
+
+    return api.done(DataManager::DATA_MANAGER_OK);
+}
+
+/** Add a packed file, i.e. a file whose entries are made up of fields of
+ *  arbitrary bit width packed back to back into a contiguous bitstream.
+ *  Each entry must contain at least PACKED_MIN_ENTRY_BITS bits
+ *
+ * @param filename ID of the packed file
+ * @param schema Number of fields and the width of each field in bits
+ * @param entries_to_store Number of entries to be stored
+ * @return Indicates success or failure reason
+ */
+int DataManager::add_packed_file(uint8_t filename, DataManager_FileSystem::PackedSchema_t schema, uint16_t entries_to_store)
+{
+    ApiScope api(*this, DataManager_FileSystem::TRACE_ADD_PACKED_FILE, filename, entries_to_store, 0);
+
+    int entry_bits = DataManager_FileSystem::packed_entry_bits(schema);
+
+    if(entry_bits < DataManager_FileSystem::PACKED_MIN_ENTRY_BITS)
+    {
+        return api.done(DataManager_FileSystem::PACKED_INVALID_SCHEMA);
+    }
+
+    /** The bitstream is stored as a file of single byte entries so that the 
+     *  existing file table and space accounting apply unchanged
+     */
+    DataManager_FileSystem::File_t file;
+    file.parameters.filename = filename;
+    file.parameters.length_bytes = 1;
+
+    uint32_t stream_bytes = (((uint32_t)entries_to_store * entry_bits) + 7) / 8;
+
+    if(stream_bytes > 0xFFFF)
+    {
+        return api.done(DataManager_FileSystem::FILE_TABLE_FULL);
+    }
+
+    return api.done(add_file(file, stream_bytes));
+}
+
+/** Pack an entry and write it to the end of a packed file's bitstream. Only
+ *  the bytes spanned by the entry are written
+ *
+ * @param filename ID of the packed file to which we should append data
+ * @param schema Schema with which the packed file was added
+ * @param *fields Array of schema.parameters.fields values to be packed
+ * @return Indicates success or failure reason
+ */
+int DataManager::append_packed_entry(uint8_t filename, DataManager_FileSystem::PackedSchema_t schema, const uint32_t *fields)
+{
+    ApiScope api(*this, DataManager_FileSystem::TRACE_APPEND_PACKED_ENTRY, filename, 0, 0);
+
+    /** Packed entries update the file table directly, which the open 
+     *  transaction would overwrite when it commits
+     */
+    if(_transaction_open && get_staged_file(filename) != -1)
+    {
+        return api.done(DataManager_FileSystem::TRANSACTION_CONFLICT);
+    }
+
+    int entry_bits = DataManager_FileSystem::packed_entry_bits(schema);
+
+    if(entry_bits < DataManager_FileSystem::PACKED_MIN_ENTRY_BITS)
+    {
+        return api.done(DataManager_FileSystem::PACKED_INVALID_SCHEMA);
+    }
+
+    DataManager_FileSystem::File_t file;
+
+    int status = get_file_by_name(filename, file);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return api.done(status);
+    }
+
+    if(file.parameters.length_bytes != 1)
+    {
+        return api.done(DataManager_FileSystem::FILE_ENTRY_LENGTH_MISMATCH);
+    }
+
+    uint32_t written_entries = ((uint32_t)(file.parameters.next_available_address - file.parameters.file_start_address) * 8) / entry_bits;
+    uint32_t bit_offset = written_entries * entry_bits;
+
+    uint16_t address = file.parameters.file_start_address + (bit_offset / 8);
+    int shift = bit_offset % 8;
+    int length = (shift + entry_bits + 7) / 8;
+
+    if((length - 1) + address > file.parameters.file_end_address)
+    {
+        return api.done(DataManager_FileSystem::FILE_ENTRY_FULL);
+    }
+
+    ScratchBuffer buffer(*this, DataManager_FileSystem::PACKED_MAX_ENTRY_BYTES);
+
+    if(buffer.data == NULL)
+    {
+        return api.done(DataManager_FileSystem::SCRATCH_ARENA_EXHAUSTED);
+    }
+
+    /** The first byte is shared with the end of the previous entry
+     */
+    if(shift != 0)
+    {
+        status = read_storage(address, buffer.data, 1);
+
+        if(status != DataManager::DATA_MANAGER_OK)
+        {
+            return api.done(status);
+        }
+    }
+
+    DataManager_FileSystem::pack_entry(schema, fields, buffer.data, shift);
+
+    status = write_with_retry(address, buffer.data, length);
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return api.done(status);
+    }
+
+    file.parameters.next_available_address = address + length;
+    file.parameters.valid = DataManager_FileSystem::file_checksum(file);
+
+    /** Update the next available address and validity byte
+     */
+    status = modify_file(filename, file);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return api.done(status);
+    }
+
+    return api.done(DataManager::DATA_MANAGER_OK);
+}
+
+/** Read and unpack consecutive entries from a packed file. A single entry 
+ *  is a random access read of only the bytes it spans; longer runs are 
+ *  read in page-sized chunks and unpacked in bulk
+ *
+ * @param filename ID of the packed file from which we should read
+ * @param schema Schema with which the packed file was added
+ * @param first_entry 0-indexed position of the first entry to be read
+ * @param entries Number of entries to be read
+ * @param *fields Array to which the unpacked field values will be written
+ * @param fields_length Length of *fields, must equal entries multiplied by
+ *                      the number of fields in the schema
+ * @return Indicates success or failure reason
+ */
+int DataManager::read_packed_entries(uint8_t filename, DataManager_FileSystem::PackedSchema_t schema, int first_entry, 
+                                     int entries, uint32_t *fields, int fields_length)
+{
+    ApiScope api(*this, DataManager_FileSystem::TRACE_READ_PACKED_ENTRIES, filename, first_entry, entries);
+
+    int entry_bits = DataManager_FileSystem::packed_entry_bits(schema);
+
+    if(entry_bits < DataManager_FileSystem::PACKED_MIN_ENTRY_BITS)
+    {
+        return api.done(DataManager_FileSystem::PACKED_INVALID_SCHEMA);
+    }
+
+    if(fields_length != entries * schema.parameters.fields)
+    {
+        return api.done(DataManager_FileSystem::FILE_ENTRY_LENGTH_MISMATCH);
+    }
+
+    DataManager_FileSystem::File_t file;
+
+    int status = get_file_by_name(filename, file);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return api.done(status);
+    }
+
+    int written_entries = ((file.parameters.next_available_address - file.parameters.file_start_address) * 8) / entry_bits;
+
+    if(first_entry < 0 || entries < 0 || first_entry + entries > written_entries)
+    {
+        return api.done(DataManager_FileSystem::FILE_ENTRY_INVALID_INDEX);
+    }
+
+    /** Leave room for an entry that starts part way through the first byte
+     */
+    int entries_per_chunk = ((PAGE_SIZE_BYTES * 8) - 7) / entry_bits;
+
+    ScratchBuffer buffer(*this, PAGE_SIZE_BYTES);
+
+    if(buffer.data == NULL)
+    {
+        return api.done(DataManager_FileSystem::SCRATCH_ARENA_EXHAUSTED);
+    }
+
+    for(int entry = 0; entry < entries; entry += entries_per_chunk)
+    {
+        int chunk_entries = (entries - entry < entries_per_chunk) ? entries - entry : entries_per_chunk;
+
+        uint32_t first_bit = (uint32_t)(first_entry + entry) * entry_bits;
+        uint32_t end_bit = first_bit + (chunk_entries * entry_bits);
+        int length = ((end_bit + 7) / 8) - (first_bit / 8);
+
+        status = read_storage(file.parameters.file_start_address + (first_bit / 8), buffer.data, length);
+
+        if(status != DataManager::DATA_MANAGER_OK)
+        {
+            return api.done(status);
+        }
+
+        DataManager_FileSystem::unpack_entries(schema, buffer.data, first_bit % 8, chunk_entries, 
+                                               &fields[entry * schema.parameters.fields]);
+    }
+
+    return api.done(DataManager::DATA_MANAGER_OK);
+}
+
+/** Calculate number of entries within a packed file
+ *
+ * @param filename ID of the packed file to be queried
+ * @param schema Schema with which the packed file was added
+ * @param &written_entries Address of integer value to which the number
+ *                         of written entries should be stored
+ * @return Indicates success or failure reason
+ */
+int DataManager::get_total_packed_entries(uint8_t filename, DataManager_FileSystem::PackedSchema_t schema, int &written_entries)
+{
+    ApiScope api(*this, DataManager_FileSystem::TRACE_GET_TOTAL_PACKED_ENTRIES, filename, 0, 0);
+
+    int entry_bits = DataManager_FileSystem::packed_entry_bits(schema);
+
+    if(entry_bits < DataManager_FileSystem::PACKED_MIN_ENTRY_BITS)
+    {
+        return api.done(DataManager_FileSystem::PACKED_INVALID_SCHEMA);
+    }
+
+    DataManager_FileSystem::File_t file;
+
+    int status = get_file_by_name(filename, file);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return api.done(status);
+    }
+
+    written_entries = ((file.parameters.next_available_address - file.parameters.file_start_address) * 8) / entry_bits;
+
+    return api.done(DataManager::DATA_MANAGER_OK);
+}
+
+/** Add a run-length encoded file for low-cardinality values such as status
+ *  codes. Each entry in the file table region is a run of identical values,
+ *  stored as a 16-bit run length followed by the value
+ *
+ * @param filename ID of the RLE file
+ * @param value_length_bytes Length of each value, at most RLE_MAX_VALUE_BYTES
+ * @param runs_to_store Number of runs to be stored
+ * @return Indicates success or failure reason
+ */
+int DataManager::add_rle_file(uint8_t filename, uint8_t value_length_bytes, uint16_t runs_to_store)
+{
+    ApiScope api(*this, DataManager_FileSystem::TRACE_ADD_RLE_FILE, filename, runs_to_store, value_length_bytes);
+
+    if(value_length_bytes == 0 || value_length_bytes > RLE_MAX_VALUE_BYTES)
+    {
+        return api.done(DataManager_FileSystem::RLE_INVALID_VALUE_LENGTH);
+    }
+
+    close_file_state(filename);
+
+    DataManager_FileSystem::File_t file;
+    file.parameters.filename = filename;
+    file.parameters.length_bytes = sizeof(uint16_t) + value_length_bytes;
+
+    return api.done(add_file(file, runs_to_store));
+}
+
+/** Append a value to an RLE file. A value that differs from the previous
+ *  one starts a new run, which is written at once, so the latest value 
+ *  always survives a reset. A value equal to the previous one increments
+ *  the current run in RAM and its length is rewritten every 
+ *  RLE_SYNC_INTERVAL values, when the run ends or when the file is flushed.
+ *  A reset therefore loses at most RLE_SYNC_INTERVAL - 1 repeats of the
+ *  latest value; call flush_rle_file() before a planned reset to lose none
+ *
+ * @param filename ID of the RLE file to which we should append data
+ * @param *data Value to be appended
+ * @param data_length Length of *data in bytes
+ * @return Indicates success or failure reason
+ */
+int DataManager::append_rle_entry(uint8_t filename, char *data, int data_length)
+{
+    ApiScope api(*this, DataManager_FileSystem::TRACE_APPEND_RLE_ENTRY, filename, 0, data_length);
+
+    RleState_t *state = NULL;
+
+    int status = get_rle_state(filename, state);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return api.done(status);
+    }
+
+    if(data_length != state->value_length)
+    {
+        return api.done(DataManager_FileSystem::FILE_ENTRY_LENGTH_MISMATCH);
+    }
+
+    if(state->pending == 0 || state->pending == 0xFFFF || memcmp(state->value, data, data_length) != 0)
+    {
+        return api.done(start_rle_run(*state, data));
+    }
+
+    state->pending++;
+
+    if(state->pending - state->stored < RLE_SYNC_INTERVAL)
+    {
+        return api.done(DataManager::DATA_MANAGER_OK);
+    }
+
+    status = persist_rle_run(*state);
+
+    /** The value isn't counted unless its run length could be written
+     */
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        state->pending--;
+    }
+
+    return api.done(status);
+}
+
+/** Write the length of the current run of an RLE file so that all of its
+ *  values survive a reset
+ *
+ * @param filename ID of the RLE file to be flushed
+ * @return Indicates success or failure reason
+ */
+int DataManager::flush_rle_file(uint8_t filename)
+{
+    ApiScope api(*this, DataManager_FileSystem::TRACE_FLUSH_RLE_FILE, filename, 0, 0);
+
+    RleState_t *state = NULL;
+
+    int status = get_rle_state(filename, state);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return api.done(status);
+    }
+
+    return api.done(persist_rle_run(*state));
+}
+
+/** Read the value at a specific index of an RLE file, locating its run
+ *  through the file's run index
+ *
+ * @param filename ID of the RLE file from which we should read
+ * @param entry_index 0-indexed position of the value to be read
+ * @param *data Pointer to an array in which the read value will be stored
+ * @param data_length Length of *data in bytes
+ * @return Indicates success or failure reason
+ */
+int DataManager::read_rle_entry(uint8_t filename, int entry_index, char *data, int data_length)
+{
+    ApiScope api(*this, DataManager_FileSystem::TRACE_READ_RLE_ENTRY, filename, entry_index, data_length);
+
+    RleState_t *state = NULL;
+
+    int status = get_rle_state(filename, state);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return api.done(status);
+    }
+
+    if(data_length != state->value_length)
+    {
+        return api.done(DataManager_FileSystem::FILE_ENTRY_LENGTH_MISMATCH);
+    }
+
+    if(entry_index < 0 || (uint32_t)entry_index >= state->persisted_entries + state->pending)
+    {
+        return api.done(DataManager_FileSystem::FILE_ENTRY_INVALID_INDEX);
+    }
+
+    /** Values in the current run haven't been written yet
+     */
+    if((uint32_t)entry_index >= state->persisted_entries)
+    {
+        memcpy(data, state->value, data_length);
+        return api.done(DataManager::DATA_MANAGER_OK);
+    }
+
+    /** Start from the last checkpoint at or before the requested value
+     */
+    int checkpoint = 0;
+
+    while(checkpoint + 1 < state->index_count && state->index[checkpoint + 1] <= (uint32_t)entry_index)
+    {
+        checkpoint++;
+    }
+
+    DataManager_FileSystem::File_t file;
+
+    status = get_file_by_name(filename, file);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return api.done(status);
+    }
+
+    int record_length = file.parameters.length_bytes;
+    int records_per_chunk = PAGE_SIZE_BYTES / record_length;
+    uint16_t run = checkpoint * state->index_stride;
+    uint32_t entries_before = state->index[checkpoint];
+
+    ScratchBuffer buffer(*this, PAGE_SIZE_BYTES);
+
+    if(buffer.data == NULL)
+    {
+        return api.done(DataManager_FileSystem::SCRATCH_ARENA_EXHAUSTED);
+    }
+
+    while(run < state->persisted_runs)
+    {
+        int chunk_records = (state->persisted_runs - run < records_per_chunk) ? state->persisted_runs - run : records_per_chunk;
+
+        status = read_storage(file.parameters.file_start_address + (run * record_length), 
+                                            buffer.data, chunk_records * record_length);
+
+        if(status != DataManager::DATA_MANAGER_OK)
+        {
+            return api.done(status);
+        }
+
+        for(int record = 0; record < chunk_records; record++)
+        {
+            uint16_t run_length;
+            memcpy(&run_length, &buffer.data[record * record_length], sizeof(run_length));
+
+            if((uint32_t)entry_index < entries_before + run_length)
+            {
+                memcpy(data, &buffer.data[(record * record_length) + sizeof(run_length)], data_length);
+                return api.done(DataManager::DATA_MANAGER_OK);
+            }
+
+            entries_before += run_length;
+        }
+
+        run += chunk_records;
+    }
+
+    return api.done(DataManager_FileSystem::FILE_ENTRY_INVALID_INDEX);
+}
+
+/** Calculate number of values within an RLE file, including those of the
+ *  current run that are yet to be flushed
+ *
+ * @param filename ID of the RLE file to be queried
+ * @param &written_entries Address of integer value to which the number
+ *                         of written values should be stored
+ * @return Indicates success or failure reason
+ */
+int DataManager::get_total_rle_entries(uint8_t filename, int &written_entries)
+{
+    ApiScope api(*this, DataManager_FileSystem::TRACE_GET_TOTAL_RLE_ENTRIES, filename, 0, 0);
+
+    RleState_t *state = NULL;
+
+    int status = get_rle_state(filename, state);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return api.done(status);
+    }
+
+    written_entries = state->persisted_entries + state->pending;
+
+    return api.done(DataManager::DATA_MANAGER_OK);
+}
+
+/** Add an archive file, i.e. a compressed region into which the sealed 
+ *  pages of another file are moved by compress_sealed_pages()
+ *
+ * @param filename ID of the archive file
+ * @param bytes_to_store Size of the compressed region in bytes
+ * @return Indicates success or failure reason
+ */
+int DataManager::add_archive_file(uint8_t filename, uint16_t bytes_to_store)
+{
+    ApiScope api(*this, DataManager_FileSystem::TRACE_ADD_ARCHIVE_FILE, filename, 0, bytes_to_store);
+
+    close_file_state(filename);
+
+    DataManager_FileSystem::File_t file;
+    file.parameters.filename = filename;
+    file.parameters.length_bytes = 1;
+
+    return api.done(add_file(file, bytes_to_store));
+}
+
+/** Compress every sealed page of a file, i.e. every page-sized block of
+ *  whole entries that has been completely written, append the compressed
+ *  blocks to an archive file and truncate them from the source file. 
+ *  Intended to be run in the background once a file is read-mostly.
+ *  Archiving stops at the first block that doesn't shrink, which is left
+ *  in the source file with those after it, as storing it would spend write
+ *  cycles to lose space
+ *
+ * @param filename ID of the file whose sealed pages are to be compressed
+ * @param archive_filename ID of the archive file to which they are moved
+ * @return ARCHIVE_INCOMPRESSIBLE if the first block doesn't shrink, else
+ *         success or failure reason
+ */
+int DataManager::compress_sealed_pages(uint8_t filename, uint8_t archive_filename)
+{
+    ApiScope api(*this, DataManager_FileSystem::TRACE_COMPRESS_SEALED_PAGES, filename, archive_filename, 0);
+
+    /** The open transaction would overwrite the truncation of the source or
+     *  the archive's metadata when it commits, duplicating entries or losing
+     *  compressed blocks
+     */
+    if(_transaction_open && (get_staged_file(filename) != -1 || get_staged_file(archive_filename) != -1))
+    {
+        return api.done(DataManager_FileSystem::TRANSACTION_CONFLICT);
+    }
+
+    DataManager_FileSystem::File_t file;
+
+    int status = get_file_by_name(filename, file);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return api.done(status);
+    }
+
+    int entry_length = file.parameters.length_bytes;
+
+    if(entry_length > PAGE_SIZE_BYTES || filename == archive_filename)
+    {
+        return api.done(DataManager_FileSystem::FILE_ENTRY_LENGTH_MISMATCH);
+    }
+
+    /** Blocks hold whole entries so that the archived region can be truncated
+     *  from the source file entry by entry
+     */
+    int entries_per_block = PAGE_SIZE_BYTES / entry_length;
+    int block_length = entries_per_block * entry_length;
+    int written_entries = (file.parameters.next_available_address - file.parameters.file_start_address) / entry_length;
+    int sealed_blocks = written_entries / entries_per_block;
+
+    if(sealed_blocks == 0)
+    {
+        return api.done(DataManager::DATA_MANAGER_OK);
+    }
+
+    status = open_archive(archive_filename);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return api.done(status);
+    }
+
+    DataManager_FileSystem::File_t archive;
+
+    status = get_file_by_name(archive_filename, archive);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return api.done(status);
+    }
+
+    if(archive.parameters.length_bytes != 1)
+    {
+        return api.done(DataManager_FileSystem::FILE_ENTRY_LENGTH_MISMATCH);
+    }
+
+    ScratchBuffer raw(*this, PAGE_SIZE_BYTES);
+    ScratchBuffer stored(*this, ARCHIVE_BLOCK_HEADER_BYTES + PAGE_SIZE_BYTES);
+
+    if(raw.data == NULL || stored.data == NULL)
+    {
+        return api.done(DataManager_FileSystem::SCRATCH_ARENA_EXHAUSTED);
+    }
+
+    status = read_sealed_block(file, 0, raw.data);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return api.done(status);
+    }
+
+    bool shrunk = compress_block(raw.data, block_length, stored.data);
+
+    uint16_t address = archive.parameters.next_available_address;
+    int archived_blocks = 0;
+
+    /** Every write cycle from here on is spent on the compression, whether 
+     *  by a block, the metadata or the truncation
+     */
+    uint32_t start_write_cycles = _io_stats.write_cycles;
+
+    /** The next block is read before this one is written and compressed 
+     *  whilst it is, so that with pipelined writes compressing a block 
+     *  overlaps the write cycle of the one before rather than following it.
+     *  The first block that doesn't shrink is left in place with the rest
+     */
+    for(; archived_blocks < sealed_blocks && shrunk; archived_blocks++)
+    {
+        bool next = archived_blocks + 1 < sealed_blocks;
+
+        if(next)
+        {
+            status = read_sealed_block(file, archived_blocks + 1, raw.data);
+
+            if(status != DataManager::DATA_MANAGER_OK)
+            {
+                break;
+            }
+        }
+
+        status = write_archive_block(stored.data, archive, address);
+
+        if(status != DataManager::DATA_MANAGER_OK)
+        {
+            break;
+        }
+
+        if(next)
+        {
+            shrunk = compress_block(raw.data, block_length, stored.data);
+        }
+    }
+
+    if(status == DataManager::DATA_MANAGER_OK && archived_blocks == 0)
+    {
+        status = DataManager_FileSystem::ARCHIVE_INCOMPRESSIBLE;
+    }
+
+    /** Archive what fits and shrinks and truncate that much
+     */
+    if((status == DataManager_FileSystem::ARCHIVE_FULL || status == DataManager_FileSystem::ARCHIVE_INCOMPRESSIBLE) && 
+       archived_blocks > 0)
+    {
+        status = DataManager::DATA_MANAGER_OK;
+    }
+
+    bool metadata_written = false;
+
+    if(status == DataManager::DATA_MANAGER_OK)
+    {
+        /** The archive's metadata is written once for all blocks. Should a reset occur
+         *  before the source is truncated, entries are duplicated rather than lost
+         */
+        archive.parameters.next_available_address = address;
+        archive.parameters.valid = DataManager_FileSystem::file_checksum(archive);
+
+        status = modify_file(archive_filename, archive);
+
+        if(status == DataManager::DATA_MANAGER_OK)
+        {
+            metadata_written = true;
+            status = truncate_file(filename, archived_blocks * entries_per_block);
+        }
+    }
+
+    /** The block index already counts the blocks written, which the archive
+     *  doesn't hold until its metadata does, so rebuild it on next use
+     */
+    if(!metadata_written && archived_blocks > 0)
+    {
+        close_file_state(archive_filename);
+    }
+
+    _compression_stats.write_cycles += _io_stats.write_cycles - start_write_cycles;
+
+    return api.done(status);
+}
+
+/** Resumable form of compress_sealed_pages(), which archives one block
+ *  per step, updates the archive's metadata at each checkpoint and then
+ *  truncates the source file as truncate_file() with a budget does. A
+ *  reset whilst archiving continues from the last checkpoint. Call with
+ *  the same arguments, or call resume_operation(), until it returns 
+ *  something other than OPERATION_IN_PROGRESS; neither file may be used
+ *  in the meantime
+ *
+ * @param filename ID of the file whose sealed pages are to be compressed
+ * @param archive_filename ID of the archive file to which they are moved
+ * @param &budget Work that this call may do
+ * @return OPERATION_IN_PROGRESS, OPERATION_BUSY if another operation is
+ *         in progress or the outcome of the compression
+ */
+int DataManager::compress_sealed_pages(uint8_t filename, uint8_t archive_filename, const OperationBudget_t &budget)
+{
+    ApiScope api(*this, DataManager_FileSystem::TRACE_COMPRESS_SEALED_PAGES, filename, archive_filename, 0);
+
+    /** The open transaction would overwrite the truncation of the source or
+     *  the archive's metadata when it commits, duplicating entries or losing
+     *  compressed blocks
+     */
+    if(_transaction_open && (get_staged_file(filename) != -1 || get_staged_file(archive_filename) != -1))
+    {
+        return api.done(DataManager_FileSystem::TRANSACTION_CONFLICT);
+    }
+
+    int status = load_operation();
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return api.done(status);
+    }
+
+    if(_operation.active)
+    {
+        if(_operation.op != DataManager_FileSystem::TRACE_COMPRESS_SEALED_PAGES || _operation.filename != filename ||
+           _operation.archive_filename != archive_filename)
+        {
+            return api.done(DataManager_FileSystem::OPERATION_BUSY);
+        }
+
+        return api.done(run_operation(budget));
+    }
+
+    if(_truncate_step.active)
+    {
+        return api.done(DataManager_FileSystem::OPERATION_BUSY);
+    }
+
+    DataManager_FileSystem::File_t file;
+
+    status = get_file_by_name(filename, file);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return api.done(status);
+    }
+
+    int entry_length = file.parameters.length_bytes;
+
+    if(entry_length > PAGE_SIZE_BYTES || filename == archive_filename)
+    {
+        return api.done(DataManager_FileSystem::FILE_ENTRY_LENGTH_MISMATCH);
+    }
+
+    int entries_per_block = PAGE_SIZE_BYTES / entry_length;
+    int written_entries = (file.parameters.next_available_address - file.parameters.file_start_address) / entry_length;
+    int sealed_blocks = written_entries / entries_per_block;
+
+    if(sealed_blocks == 0)
+    {
+        return api.done(DataManager::DATA_MANAGER_OK);
+    }
+
+    status = open_archive(archive_filename);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return api.done(status);
+    }
+
+    DataManager_FileSystem::File_t archive;
+
+    status = get_file_by_name(archive_filename, archive);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return api.done(status);
+    }
+
+    if(archive.parameters.length_bytes != 1)
+    {
+        return api.done(DataManager_FileSystem::FILE_ENTRY_LENGTH_MISMATCH);
+    }
+
+    /** The first block is tried before the operation is persisted, so that
+     *  a file that doesn't compress costs no write cycles
+     */
+    {
+        ScratchBuffer raw(*this, PAGE_SIZE_BYTES);
+        ScratchBuffer stored(*this, ARCHIVE_BLOCK_HEADER_BYTES + PAGE_SIZE_BYTES);
+
+        if(raw.data == NULL || stored.data == NULL)
+        {
+            return api.done(DataManager_FileSystem::SCRATCH_ARENA_EXHAUSTED);
+        }
+
+        status = read_sealed_block(file, 0, raw.data);
+
+        if(status != DataManager::DATA_MANAGER_OK)
+        {
+            return api.done(status);
+        }
+
+        if(!compress_block(raw.data, (PAGE_SIZE_BYTES / entry_length) * entry_length, stored.data))
+        {
+            return api.done(DataManager_FileSystem::ARCHIVE_INCOMPRESSIBLE);
+        }
+    }
+
+    _operation.active = true;
+    _operation.op = DataManager_FileSystem::TRACE_COMPRESS_SEALED_PAGES;
+    _operation.filename = filename;
+    _operation.archive_filename = archive_filename;
+    _operation.progress = 0;
+    _operation.total = sealed_blocks;
+    _operation.archive_address = archive.parameters.next_available_address;
+    _operation.file = file;
+    _operation.archive = archive;
+
+    uint32_t start_write_cycles = _io_stats.write_cycles;
+
+    status = write_operation();
+
+    _compression_stats.write_cycles += _io_stats.write_cycles - start_write_cycles;
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        _operation.active = false;
+        return api.done(status);
+    }
+
+    return api.done(run_operation(budget));
+}
+
+/** Read an entry from an archive file, decompressing only the blocks 
+ *  that it spans
+ *
+ * @param archive_filename ID of the archive file from which we should read
+ * @param entry_index 0-indexed position of the entry within the archive
+ * @param *data Pointer to an array in which the read data will be stored
+ * @param data_length Length of *data in bytes, i.e. the entry length of
+ *                    the file from which the entries were archived
+ * @return Indicates success or failure reason
+ */
+int DataManager::read_archived_entry(uint8_t archive_filename, int entry_index, char *data, int data_length)
+{
+    ApiScope api(*this, DataManager_FileSystem::TRACE_READ_ARCHIVED_ENTRY, archive_filename, entry_index, data_length);
+
+    int status = open_archive(archive_filename);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return api.done(status);
+    }
+
+    if(entry_index < 0 || data_length <= 0 || (uint32_t)(entry_index + 1) * data_length > _archive.length)
+    {
+        return api.done(DataManager_FileSystem::FILE_ENTRY_INVALID_INDEX);
+    }
+
+    uint32_t offset = (uint32_t)entry_index * data_length;
+
+    /** Start from the last checkpoint at or before the requested entry
+     */
+    int checkpoint = 0;
+
+    while(checkpoint + 1 < _archive.index_count && _archive.index_offset[checkpoint + 1] <= offset)
+    {
+        checkpoint++;
+    }
+
+    uint16_t address = _archive.index_address[checkpoint];
+    uint32_t block_offset = _archive.index_offset[checkpoint];
+
+    ScratchBuffer block(*this, ARCHIVE_BLOCK_HEADER_BYTES + PAGE_SIZE_BYTES);
+    ScratchBuffer raw(*this, PAGE_SIZE_BYTES);
+
+    if(raw.data == NULL || block.data == NULL)
+    {
+        return api.done(DataManager_FileSystem::SCRATCH_ARENA_EXHAUSTED);
+    }
+    int copied = 0;
+
+    while(copied < data_length)
+    {
+        status = read_storage(address, block.data, ARCHIVE_BLOCK_HEADER_BYTES);
+
+        if(status != DataManager::DATA_MANAGER_OK)
+        {
+            return api.done(status);
+        }
+
+        int raw_length = (uint8_t)block.data[0];
+        int stored_length = (uint8_t)block.data[1];
+
+        if(raw_length == 0 || raw_length > PAGE_SIZE_BYTES || stored_length > raw_length)
+        {
+            return api.done(DataManager_FileSystem::ARCHIVE_CORRUPT);
+        }
+
+        if(offset + copied < block_offset + raw_length)
+        {
+            status = read_storage(address + ARCHIVE_BLOCK_HEADER_BYTES, 
+                                                &block.data[ARCHIVE_BLOCK_HEADER_BYTES], stored_length);
+
+            if(status != DataManager::DATA_MANAGER_OK)
+            {
+                return api.done(status);
+            }
+
+            const char *decoded = &block.data[ARCHIVE_BLOCK_HEADER_BYTES];
+
+            if(stored_length < raw_length)
+            {
+                uint32_t start_us = us_ticker_read();
+                int decoded_length = DataManager_FileSystem::lz_decompress(&block.data[ARCHIVE_BLOCK_HEADER_BYTES], stored_length, 
+                                                                           raw.data, PAGE_SIZE_BYTES);
+                _compression_stats.decode_us += us_ticker_read() - start_us;
+
+                if(decoded_length != raw_length)
+                {
+                    return api.done(DataManager_FileSystem::ARCHIVE_CORRUPT);
+                }
+
+                decoded = raw.data;
+            }
+
+            int block_position = (offset + copied) - block_offset;
+            int length = raw_length - block_position;
+
+            if(length > data_length - copied)
+            {
+                length = data_length - copied;
+            }
+
+            memcpy(&data[copied], &decoded[block_position], length);
+            copied += length;
+        }
+
+        block_offset += raw_length;
+        address += ARCHIVE_BLOCK_HEADER_BYTES + stored_length;
+    }
+
+    return api.done(DataManager::DATA_MANAGER_OK);
+}
+
+/** Calculate number of entries within an archive file
+ *
+ * @param archive_filename ID of the archive file to be queried
+ * @param entry_length Entry length of the file from which the entries were archived
+ * @param &archived_entries Address of integer value to which the number of 
+ *                          archived entries should be stored
+ * @return Indicates success or failure reason
+ */
+int DataManager::get_total_archived_entries(uint8_t archive_filename, int entry_length, int &archived_entries)
+{
+    ApiScope api(*this, DataManager_FileSystem::TRACE_GET_TOTAL_ARCHIVED_ENTRIES, archive_filename, 0, entry_length);
+
+    if(entry_length <= 0)
+    {
+        return api.done(DataManager_FileSystem::FILE_ENTRY_LENGTH_MISMATCH);
+    }
+
+    int status = open_archive(archive_filename);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return api.done(status);
+    }
+
+    archived_entries = _archive.length / entry_length;
+
+    return api.done(DataManager::DATA_MANAGER_OK);
+}
+
+/** Get the compression ratio, timing and write cycle counters accumulated 
+ *  by compress_sealed_pages() and read_archived_entry()
+ *
+ * @param &stats Address of CompressionStats_t to which counters will be written
+ */
+void DataManager::get_compression_stats(CompressionStats_t &stats)
+{
+    stats = _compression_stats;
+}
+
+/** Reset all compression counters to zero
+ */
+void DataManager::reset_compression_stats()
+{
+    memset(&_compression_stats, 0, sizeof(_compression_stats));
+}
+
+/** Begin a transaction. Until commit() is called, appends write their 
+ *  data immediately but their metadata changes are only staged in RAM,
+ *  so a power cut leaves every file in the transaction unchanged.
+ *  Only append_file_entry() stages changes; every other call that changes
+ *  a file's metadata, e.g. append_packed_entry(), append_rle_entry() or
+ *  compress_sealed_pages(), writes it at once and returns 
+ *  TRANSACTION_CONFLICT for a file that the transaction has staged
+ *
+ * @return Indicates success or failure reason
+ */
+int DataManager::begin()
+{
+    ApiScope api(*this, DataManager_FileSystem::TRACE_BEGIN, 0, 0, 0);
+
+    if(_transaction_open)
+    {
+        return api.done(DataManager_FileSystem::TRANSACTION_ALREADY_OPEN);
+    }
+
+    _journal.parameters.entries = 0;
+    _transaction_open = true;
+
+    return api.done(DataManager::DATA_MANAGER_OK);
+}
+
+/** Commit the open transaction. All staged metadata changes are written
+ *  to the journal as a single page-aligned record, which is then applied
+ *  to the file table and cleared
+ *
+ * @return Indicates success or failure reason
+ */
+int DataManager::commit()
+{
+    ApiScope api(*this, DataManager_FileSystem::TRACE_COMMIT, 0, 0, 0);
+
+    if(!_transaction_open)
+    {
+        return api.done(DataManager_FileSystem::TRANSACTION_NOT_OPEN);
+    }
+
+    _transaction_open = false;
+
+    if(_journal.parameters.entries == 0)
+    {
+        return api.done(DataManager::DATA_MANAGER_OK);
+    }
+
+    _journal.parameters.committed = DataManager_FileSystem::TRANSACTION_COMMITTED;
+    _journal.parameters.checksum = DataManager_FileSystem::journal_checksum(_journal);
+
+    /** The journal write is the commit point; a power cut before it completes
+     *  leaves a journal that fails its checksum and is ignored on recovery
+     */
+    int journal_length = sizeof(_journal) - ((DataManager_FileSystem::TRANSACTION_MAX_FILES - _journal.parameters.entries) 
+                                             * sizeof(_journal.parameters.records[0]));
+
+    int status;
+    {
+        Span span(*this, DataManager_FileSystem::SPAN_JOURNAL_WRITE);
+        status = write_with_retry(JOURNAL_START_ADDRESS, _journal.data, journal_length);
+    }
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return api.done(status);
+    }
+
+    return api.done(apply_journal());
+}
+
+/** Discard the metadata changes staged by the open transaction. Data that
+ *  has already been written lies beyond each file's next available address
+ *  and will be overwritten by subsequent appends
+ *
+ * @return Indicates success or failure reason
+ */
+int DataManager::rollback()
+{
+    ApiScope api(*this, DataManager_FileSystem::TRACE_ROLLBACK, 0, 0, 0);
+
+    if(!_transaction_open)
+    {
+        return api.done(DataManager_FileSystem::TRANSACTION_NOT_OPEN);
+    }
+
+    _journal.parameters.entries = 0;
+    _transaction_open = false;
+
+    return api.done(DataManager::DATA_MANAGER_OK);
+}
+
+/** Apply a transaction that was committed to the journal but not applied
+ *  to the file table before a reset. Should be called once at start-up, 
+ *  before any other file operation
+ *
+ * @return Indicates success or failure reason
+ */
+int DataManager::recover_transaction()
+{
+    ApiScope api(*this, DataManager_FileSystem::TRACE_RECOVER_TRANSACTION, 0, 0, 0);
+
+    /** The journal page of an older layout may hold file data
+     */
+    int status = check_layout();
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return api.done(status);
+    }
+
+    status = read_storage(JOURNAL_START_ADDRESS, _journal.data, sizeof(_journal));
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return api.done(status);
+    }
+
+    _transaction_open = false;
+
+    if(_journal.parameters.committed != DataManager_FileSystem::TRANSACTION_COMMITTED)
+    {
+        _journal.parameters.entries = 0;
+        return api.done(DataManager::DATA_MANAGER_OK);
+    }
+
+    /** A torn journal means the transaction never committed, so it is cleared 
+     *  without being applied
+     */
+    if(_journal.parameters.entries > DataManager_FileSystem::TRANSACTION_MAX_FILES ||
+       _journal.parameters.checksum != DataManager_FileSystem::journal_checksum(_journal))
+    {
+        _journal.parameters.entries = 0;
+    }
+
+    status = apply_journal();
+    _journal.parameters.entries = 0;
+
+    return api.done(status);
+}
+
+/** Continue the resumable operation in progress, including one that was
+ *  persisted before a reset. Should be called at start-up, after
+ *  recover_transaction() and before any other file operation, until it
+ *  returns something other than OPERATION_IN_PROGRESS
+ *
+ * @param &budget Work that this call may do
+ * @return OPERATION_IN_PROGRESS or the outcome of the operation, which
+ *         is DATA_MANAGER_OK if none was in progress
+ */
+int DataManager::resume_operation(const OperationBudget_t &budget)
+{
+    ApiScope api(*this, DataManager_FileSystem::TRACE_RESUME_OPERATION, 0, 0, 0);
+
+    int status = load_operation();
+
+    if(status != DataManager::DATA_MANAGER_OK || !_operation.active)
+    {
+        return api.done(status);
+    }
+
+    return api.done(run_operation(budget));
+}
+
+/** Calculate the number of pages, starting from page 0, that must be 
+ *  exported in order to capture global stats, the file table and all
+ *  storage that has been allocated to files
+ *
+ * @param &pages Address of integer value to which the number of pages
+ *               in use should be stored
+ * @return Indicates success or failure reason
+ */
+int DataManager::get_image_pages(int &pages)
+{
+    ApiScope api(*this, DataManager_FileSystem::TRACE_GET_IMAGE_PAGES, 0, 0, 0);
+
+    DataManager_FileSystem::GlobalStats_t g_stats;
+
+    int status = get_global_stats(g_stats.data);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return api.done(status);
+    }
+
+    /** An uninitialised filesystem has no meaningful allocation boundary, 
+     *  so fall back to the full device
+     */
+    if(g_stats.parameters.initialised != DataManager_FileSystem::INITIALISED ||
+       g_stats.parameters.next_available_address > PAGES * PAGE_SIZE_BYTES)
+    {
+        pages = PAGES;
+        return api.done(DataManager::DATA_MANAGER_OK);
+    }
+
+    pages = (g_stats.parameters.next_available_address + PAGE_SIZE_BYTES - 1) / PAGE_SIZE_BYTES;
+
+    return api.done(DataManager::DATA_MANAGER_OK);
+}
+
+/** Read a single page of the EEPROM image and add it to a running
+ *  checksum. Pages should be exported in ascending order, starting 
+ *  from page 0, at which point the checksum is reset
+ *
+ * @param page 0-indexed page to be exported
+ * @param *data Array to which the page will be written
+ * @param data_length Length of *data in bytes, must be PAGE_SIZE_BYTES
+ * @param &checksum Address of running checksum of the exported image
+ * @return Indicates success or failure reason
+ */
+int DataManager::export_image_page(int page, char *data, int data_length, uint32_t &checksum)
+{
+    ApiScope api(*this, DataManager_FileSystem::TRACE_EXPORT_IMAGE_PAGE, 0, page, data_length);
+
+    if(page < 0 || page >= PAGES)
+    {
+        return api.done(DataManager_FileSystem::IMAGE_INVALID_PAGE);
+    }
+
+    if(data_length != PAGE_SIZE_BYTES)
+    {
+        return api.done(DataManager_FileSystem::IMAGE_LENGTH_MISMATCH);
+    }
+
+    if(page == 0)
+    {
+        checksum = DataManager_FileSystem::IMAGE_CHECKSUM_SEED;
+    }
+
+    int status = read_storage(page * PAGE_SIZE_BYTES, data, PAGE_SIZE_BYTES);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return api.done(status);
+    }
+
+    checksum = DataManager_FileSystem::image_checksum(checksum, data, PAGE_SIZE_BYTES);
+
+    return api.done(DataManager::DATA_MANAGER_OK);
+}
+
+/** Prepare to restore an exported image. Global stats are invalidated
+ *  so that an interrupted restore is detected as an uninitialised 
+ *  filesystem rather than a corrupt one. The journal and operation page
+ *  lie beyond the pages of an image, so they are cleared so that neither
+ *  a transaction nor a resumable operation of the filesystem being 
+ *  replaced is applied to the restored one
+ *
+ * @return Indicates success or failure reason
+ */
+int DataManager::begin_image_restore()
+{
+    ApiScope api(*this, DataManager_FileSystem::TRACE_BEGIN_IMAGE_RESTORE, 0, 0, 0);
+
+    DataManager_FileSystem::GlobalStats_t g_stats;
+    memset(g_stats.data, 0, sizeof(g_stats));
+
+    int status = set_global_stats(g_stats.data);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return api.done(status);
+    }
+
+    status = wait_for_write_cycle();
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return api.done(status);
+    }
+
+    _truncate_step.active = false;
+
+    status = load_operation();
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return api.done(status);
+    }
+
+    if(_operation.active)
+    {
+        _operation.active = false;
+
+        status = write_operation();
+
+        if(status != DataManager::DATA_MANAGER_OK)
+        {
+            return api.done(status);
+        }
+    }
+
+    status = clear_filesystem_page(FILE_TABLE_PAGES);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return api.done(status);
+    }
+
+    _image_checksum = DataManager_FileSystem::IMAGE_CHECKSUM_SEED;
+    _image_page = 0;
+    _image_restore_active = true;
+
+    return api.done(DataManager::DATA_MANAGER_OK);
+}
+
+/** Write the next page of an exported image using a full page write
+ *  followed by ACK polling rather than a fixed write cycle delay. 
+ *  Page 0, which holds global stats, is held back until the image 
+ *  checksum has been verified by finish_image_restore()
+ *
+ * @param *data Page of the image to be restored
+ * @param data_length Length of *data in bytes, must be PAGE_SIZE_BYTES
+ * @return IMAGE_RESTORE_NOT_STARTED unless begin_image_restore() has been
+ *         called since the last restore finished, else success or failure reason
+ */
+int DataManager::restore_image_page(char *data, int data_length)
+{
+    ApiScope api(*this, DataManager_FileSystem::TRACE_RESTORE_IMAGE_PAGE, 0, 0, data_length);
+
+    if(!_image_restore_active)
+    {
+        return api.done(DataManager_FileSystem::IMAGE_RESTORE_NOT_STARTED);
+    }
+
+    if(_image_page >= PAGES)
+    {
+        return api.done(DataManager_FileSystem::IMAGE_INVALID_PAGE);
+    }
+
+    if(data_length != PAGE_SIZE_BYTES)
+    {
+        return api.done(DataManager_FileSystem::IMAGE_LENGTH_MISMATCH);
+    }
+
+    _image_checksum = DataManager_FileSystem::image_checksum(_image_checksum, data, PAGE_SIZE_BYTES);
+
+    if(_image_page == 0)
+    {
+        memcpy(_image_first_page, data, PAGE_SIZE_BYTES);
+        _image_page++;
+
+        return api.done(DataManager::DATA_MANAGER_OK);
+    }
+
+    int status = write_with_retry(_image_page * PAGE_SIZE_BYTES, data, PAGE_SIZE_BYTES);
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return api.done(status);
+    }
+
+    status = wait_for_write_cycle();
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return api.done(status);
+    }
+
+    _image_page++;
+
+    return api.done(DataManager::DATA_MANAGER_OK);
+}
+
+/** Verify the checksum of the restored image and, if it matches, write
+ *  page 0 to mark the filesystem as initialised. A mismatch ends the 
+ *  restore, which must then be started again with begin_image_restore()
+ *
+ * @param checksum Checksum returned by export_image_page() for the final 
+ *                 exported page
+ * @return IMAGE_RESTORE_NOT_STARTED unless begin_image_restore() has been
+ *         called since the last restore finished, else success or failure reason
+ */
+int DataManager::finish_image_restore(uint32_t checksum)
+{
+    ApiScope api(*this, DataManager_FileSystem::TRACE_FINISH_IMAGE_RESTORE, 0, 0, 0);
+
+    if(!_image_restore_active)
+    {
+        return api.done(DataManager_FileSystem::IMAGE_RESTORE_NOT_STARTED);
+    }
+
+    if(_image_page == 0)
+    {
+        return api.done(DataManager_FileSystem::IMAGE_INVALID_PAGE);
+    }
+
+    if(checksum != _image_checksum)
+    {
+        _image_restore_active = false;
+        return api.done(DataManager_FileSystem::IMAGE_CHECKSUM_MISMATCH);
+    }
+
+    int status = write_with_retry(0, _image_first_page, PAGE_SIZE_BYTES);
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return api.done(status);
+    }
+
+    status = wait_for_write_cycle();
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return api.done(status);
+    }
+
+    _image_page = 0;
+    _image_restore_active = false;
+
+    return api.done(DataManager::DATA_MANAGER_OK);
+}
+
+/** Predict the bus transfers, bus bytes, write cycles and time of a call
+ *  from the current metadata of its file and the measured device timing,
+ *  e.g. to decide whether it fits before a deadline. Supports appending,
+ *  overwriting, deleting and truncating entries, the next step of
+ *  truncate_file_step(), reading a range of entries with read_file_entry()
+ *  and get_file_by_name(). The estimate itself costs one file table
+ *  lookup, none for a truncation already in progress, and assumes no
+ *  transaction is open. With the adaptive clock or pipelined writes the
+ *  DataManager polls write cycles itself, and how many polls a write 
+ *  cycle takes depends on its timing, so transfers and bus bytes exclude
+ *  them. IoStats_t counts them apart, and time_us covers them as they
+ *  fall within the write cycles. With pipelined writes time_us leaves
+ *  out the last write cycle, which the call doesn't wait for
+ *
+ * @param op The call
+ * @param filename ID of the file on which the call would operate
+ * @param &params Arguments of the call
+ * @param &estimate Address of CostEstimate_t to which the prediction will be written
+ * @return Indicates success or the failure reason that the call would return
+ */
+int DataManager::estimate_cost(DataManager_FileSystem::TraceOp op, uint8_t filename, const CostParams_t &params,
+                               CostEstimate_t &estimate)
+{
+    ApiScope api(*this, DataManager_FileSystem::TRACE_ESTIMATE_COST, filename, params.index, params.length);
+
+    memset(&estimate, 0, sizeof(estimate));
+
+    /** A resumable operation owns the truncation in progress
+     */
+    if(op == DataManager_FileSystem::TRACE_TRUNCATE_FILE_STEP && _operation.active)
+    {
+        return api.done(DataManager_FileSystem::OPERATION_BUSY);
+    }
+
+    /** A truncation in progress is estimated from its own state
+     */
+    if(op == DataManager_FileSystem::TRACE_TRUNCATE_FILE_STEP && _truncate_step.active)
+    {
+        return api.done(estimate_truncate_step(filename, params.index, estimate));
+    }
+
+    DataManager_FileSystem::File_t file;
+    int address = -1;
+
+    int status = get_file_table_entry(filename, file, address);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return api.done(status);
+    }
+
+    /** Follow the device's address counter through the call, starting from
+     *  where the lookup above left it
+     */
+    _estimate_pointer = _address_known ? _address_pointer : -1;
+
+    int slot = (address - FILE_TABLE_START_ADDRESS) / sizeof(DataManager_FileSystem::File_t);
+    int length_bytes = file.parameters.length_bytes;
+    int total_entries = ((file.parameters.file_end_address - file.parameters.file_start_address) + 1) / length_bytes;
+    int written_entries = total_entries - (((file.parameters.file_end_address + 1) - file.parameters.next_available_address) 
+                                           / length_bytes);
+
+    status = DataManager::DATA_MANAGER_OK;
+
+    switch(op)
+    {
+        case DataManager_FileSystem::TRACE_GET_FILE_BY_NAME:
+            estimate_table_scan(slot, estimate);
+            break;
+
+        case DataManager_FileSystem::TRACE_READ_FILE_ENTRY:
+            if(params.index < 0 || params.count < 1 || params.index + params.count > written_entries)
+            {
+                status = DataManager_FileSystem::FILE_ENTRY_INVALID_INDEX;
+                break;
+            }
+
+            /** Each read looks the file up twice, once for its metadata and 
+             *  once for the number of written entries
+             */
+            for(int entry = params.index; entry < params.index + params.count; entry++)
+            {
+                estimate_table_scan(slot, estimate);
+                estimate_table_scan(slot, estimate);
+                estimate_read(file.parameters.file_start_address + (entry * length_bytes), length_bytes, estimate);
+            }
+            break;
+
+        case DataManager_FileSystem::TRACE_APPEND_FILE_ENTRY:
+        case DataManager_FileSystem::TRACE_OVERWRITE_FILE_ENTRIES:
+        {
+            estimate_table_scan(slot, estimate);
+
+            uint16_t data_address = (op == DataManager_FileSystem::TRACE_APPEND_FILE_ENTRY) ? 
+                                    file.parameters.next_available_address : file.parameters.file_start_address;
+
+            if(params.length != length_bytes)
+            {
+                status = DataManager_FileSystem::FILE_ENTRY_LENGTH_MISMATCH;
+                break;
+            }
+
+            if((params.length - 1) + data_address > file.parameters.file_end_address)
+            {
+                status = DataManager_FileSystem::FILE_ENTRY_FULL;
+                break;
+            }
+
+            estimate_write(data_address, params.length, estimate);
+            estimate_table_scan(slot, estimate);
+            estimate_write(address, sizeof(file), estimate);
+            break;
+        }
+
+        case DataManager_FileSystem::TRACE_TRUNCATE_FILE:
+            estimate_table_scan(slot, estimate);
+            estimate_table_scan(slot, estimate);
+
+            if(params.index < written_entries)
+            {
+                int remaining_bytes = (written_entries - params.index) * length_bytes;
+                uint16_t source_address = file.parameters.file_start_address + (params.index * length_bytes);
+                uint16_t new_address = file.parameters.file_start_address;
+
+                while(remaining_bytes > 0)
+                {
+                    int chunk = PAGE_SIZE_BYTES - (new_address % PAGE_SIZE_BYTES);
+
+                    if(chunk > remaining_bytes)
+                    {
+                        chunk = remaining_bytes;
+                    }
+
+                    estimate_read(source_address, chunk, estimate);
+                    estimate_write(new_address, chunk, estimate);
+
+                    source_address += chunk;
+                    new_address += chunk;
+                    remaining_bytes -= chunk;
+                }
+
+                estimate_table_scan(slot, estimate);
+                estimate_write(address, sizeof(file), estimate);
+                break;
+            }
+
+            /** Removing every entry falls through to delete_file_entries()
+             */
+            estimate_table_scan(slot, estimate);
+            estimate_table_scan(slot, estimate);
+            estimate_write(address, sizeof(file), estimate);
+            break;
+
+        case DataManager_FileSystem::TRACE_DELETE_FILE_ENTRIES:
+            estimate_table_scan(slot, estimate);
+            estimate_table_scan(slot, estimate);
+            estimate_write(address, sizeof(file), estimate);
+            break;
+
+        /** The first step of a truncation only looks the file up, unless it
+         *  removes every entry
+         */
+        case DataManager_FileSystem::TRACE_TRUNCATE_FILE_STEP:
+            estimate_table_scan(slot, estimate);
+            estimate_table_scan(slot, estimate);
+
+            if(params.index < written_entries)
+            {
+                status = DataManager_FileSystem::OPERATION_IN_PROGRESS;
+                break;
+            }
+
+            estimate_table_scan(slot, estimate);
+            estimate_table_scan(slot, estimate);
+            estimate_write(address, sizeof(file), estimate);
+            break;
+
+        default:
+            status = DataManager_FileSystem::ESTIMATE_UNSUPPORTED_OP;
+            break;
+    }
+
+    estimate_time(estimate);
+
+    return api.done(status);
+}
+
+DataManager::ScratchBuffer::ScratchBuffer(DataManager &manager, int length) : 
+                                          data(NULL),
+                                          _manager(manager),
+                                          _previous_used(manager._scratch_used)
+{
+    if(_manager._scratch_used + length > DM_SCRATCH_ARENA_BYTES)
+    {
+        return;
+    }
+
+    data = &_manager._scratch[_manager._scratch_used];
+    _manager._scratch_used += length;
+
+    if(_manager._scratch_used > _manager._scratch_peak)
+    {
+        _manager._scratch_peak = _manager._scratch_used;
+    }
+}
+
+DataManager::ScratchBuffer::~ScratchBuffer()
+{
+    _manager._scratch_used = _previous_used;
+}
+
+DataManager::ApiScope::ApiScope(DataManager &manager, DataManager_FileSystem::TraceOp op, int filename, int index, int length) : 
+                                _manager(manager),
+                                _outermost(manager._api_depth == 0)
+                                #if DM_SPANS == true
+                                , _span(manager, op)
+                                #endif /* #if DM_SPANS == true */
+                                #if DM_TRACE == true || DM_LATENCY_HISTOGRAMS == true || DM_ENERGY_MODEL == true
+                                , _op(op)
+                                , _start_ticks(0)
+                                #endif /* #if DM_TRACE == true || DM_LATENCY_HISTOGRAMS == true || DM_ENERGY_MODEL == true */
+{
+    _manager._api_depth++;
+
+    if(!_outermost)
+    {
+        return;
+    }
+
+    _manager._api_op = op;
+
+    #if DM_TRACE == true
+    _record.parameters.op = op;
+    _record.parameters.filename = filename;
+    _record.parameters.index = index < 0 ? 0 : (index > 0xFFFF ? 0xFFFF : index);
+    _record.parameters.length = length < 0 ? 0 : (length > 0xFFFF ? 0xFFFF : length);
+    #else
+    (void)filename;
+    (void)index;
+    (void)length;
+    #endif /* #if DM_TRACE == true */
+
+    #if DM_TRACE == true || DM_LATENCY_HISTOGRAMS == true || DM_ENERGY_MODEL == true
+    _start_ticks = DataManager_LatencyClock::now();
+    #endif /* #if DM_TRACE == true || DM_LATENCY_HISTOGRAMS == true || DM_ENERGY_MODEL == true */
+
+    #if DM_ENERGY_MODEL == true
+    _start_bus_bytes = _manager._io_stats.bus_bytes;
+    _start_write_cycles = _manager._io_stats.write_cycles;
+    #endif /* #if DM_ENERGY_MODEL == true */
+}
+
+DataManager::ApiScope::~ApiScope()
+{
+    _manager._api_depth--;
+
+    if(_outermost)
+    {
+        _manager._api_op = 0;
+    }
+}
+
+/** Record the outcome of the call if it is outermost
+ *
+ * @param status Status returned by the call
+ * @return status, unchanged
+ */
+int DataManager::ApiScope::done(int status)
+{
+    #if DM_TRACE == true || DM_LATENCY_HISTOGRAMS == true || DM_ENERGY_MODEL == true
+    if(!_outermost)
+    {
+        return status;
+    }
+
+    uint32_t elapsed_us = DataManager_LatencyClock::to_us(DataManager_LatencyClock::now() - _start_ticks);
+
+    #if DM_LATENCY_HISTOGRAMS == true
+    _manager.record_latency(_op, elapsed_us);
+    #endif /* #if DM_LATENCY_HISTOGRAMS == true */
+
+    #if DM_ENERGY_MODEL == true
+    _manager.record_energy(_op, elapsed_us, _manager._io_stats.bus_bytes - _start_bus_bytes,
+                           _manager._io_stats.write_cycles - _start_write_cycles);
+    #endif /* #if DM_ENERGY_MODEL == true */
+
+    #if DM_TRACE == true
+    uint8_t elapsed_log2_us = 0;
+
+    while(elapsed_us > 0)
+    {
+        elapsed_log2_us++;
+        elapsed_us >>= 1;
+    }
+
+    _record.parameters.result = status < -128 ? -128 : (status > 127 ? 127 : status);
+    _record.parameters.elapsed_log2_us = elapsed_log2_us;
+    _manager.record_trace(_record);
+    #endif /* #if DM_TRACE == true */
+    #endif /* #if DM_TRACE == true || DM_LATENCY_HISTOGRAMS == true || DM_ENERGY_MODEL == true */
+
+    return status;
+}
+
+#if DM_ENERGY_MODEL == true
+/** Add the estimated energy of a completed call to the counters of its type
+ *
+ * @param op The call type
+ * @param elapsed_us Duration of the call
+ * @param bus_bytes Bytes the call clocked over the bus
+ * @param write_cycles Write cycles the call started
+ */
+void DataManager::record_energy(uint8_t op, uint32_t elapsed_us, uint32_t bus_bytes, uint32_t write_cycles)
+{
+    /** mV x uA x us is femtojoules, so dividing by 10^6 gives nanojoules
+     */
+    uint64_t bus_us = ((uint64_t)bus_bytes * BUS_CLOCKS_PER_BYTE * 1000000) / _clock_stats.frequency_hz;
+    uint64_t mcu_nj = ((uint64_t)_energy_model.supply_mv * _energy_model.mcu_active_ua * elapsed_us) / 1000000;
+    uint64_t bus_nj = ((uint64_t)_energy_model.supply_mv * _energy_model.eeprom_active_ua * bus_us) / 1000000;
+    uint64_t write_nj = ((uint64_t)_energy_model.supply_mv * _energy_model.eeprom_write_ua * 
+                         _energy_model.write_cycle_us * write_cycles) / 1000000;
+
+    EnergyCounts_t *counts[] = { &_energy_stats.total, &_energy_stats.api[op] };
+
+    for(int count = 0; count < 2; count++)
+    {
+        counts[count]->calls++;
+        counts[count]->mcu_nj += mcu_nj;
+        counts[count]->bus_nj += bus_nj;
+        counts[count]->write_nj += write_nj;
+    }
+}
+#endif /* #if DM_ENERGY_MODEL == true */
+
+#if DM_SPANS == true
+DataManager::Span::Span(DataManager &manager, uint8_t frame) : 
+                        _manager(manager),
+                        _pushed(false)
+{
+    if(_manager._span_depth >= DM_SPAN_DEPTH)
+    {
+        return;
+    }
+
+    int parent = (_manager._span_depth > 0) ? _manager._span_stack[_manager._span_depth - 1] : -1;
+    int node = 0;
+
+    while(node < _manager._span_count && 
+          (_manager._spans[node].parent != parent || _manager._spans[node].frame != frame))
+    {
+        node++;
+    }
+
+    if(node == DM_SPAN_NODES)
+    {
+        return;
+    }
+
+    _manager.charge_span_time();
+
+    if(node == _manager._span_count)
+    {
+        memset(&_manager._spans[node], 0, sizeof(SpanNode_t));
+        _manager._spans[node].parent = parent;
+        _manager._spans[node].frame = frame;
+        _manager._span_count++;
+    }
+
+    _manager._spans[node].calls++;
+    _manager._span_stack[_manager._span_depth++] = node;
+    _pushed = true;
+}
+
+DataManager::Span::~Span()
+{
+    if(_pushed)
+    {
+        _manager.charge_span_time();
+        _manager._span_depth--;
+    }
+}
+
+/** Charge the time since the last charge to the innermost span
+ */
+void DataManager::charge_span_time()
+{
+    uint32_t now_ticks = DataManager_LatencyClock::now();
+
+    if(_span_depth > 0)
+    {
+        _spans[_span_stack[_span_depth - 1]].time_us += DataManager_LatencyClock::to_us(now_ticks - _span_mark_ticks);
+    }
+
+    _span_mark_ticks = now_ticks;
+}
+
+/** Charge a bus transfer to the innermost span
+ *
+ * @param bus_bytes Bytes on the bus, including address and overhead
+ * @param write_cycles Number of write cycles the transfer started
+ */
+void DataManager::charge_span_transfer(uint32_t bus_bytes, uint32_t write_cycles)
+{
+    if(_span_depth == 0)
+    {
+        return;
+    }
+
+    SpanNode_t &node = _spans[_span_stack[_span_depth - 1]];
+    node.bus_bytes += bus_bytes;
+    node.transfers++;
+    node.write_cycles += write_cycles;
+}
+#endif /* #if DM_SPANS == true */
+
+#if DM_LATENCY_HISTOGRAMS == true
+/** Add the latency of a completed call to the histogram of its type
+ *
+ * @param op The call type
+ * @param elapsed_us Duration of the call
+ */
+void DataManager::record_latency(uint8_t op, uint32_t elapsed_us)
+{
+    LatencyHistogram_t &histogram = _latency[op];
+    int bucket = 0;
+
+    while(bucket < DM_LATENCY_BUCKETS - 1 && (elapsed_us >> (bucket + 1)) > 0)
+    {
+        bucket++;
+    }
+
+    histogram.calls++;
+    histogram.total_us += elapsed_us;
+    histogram.buckets[bucket]++;
+
+    if(elapsed_us > histogram.max_us)
+    {
+        histogram.max_us = elapsed_us;
+    }
+}
+#endif /* #if DM_LATENCY_HISTOGRAMS == true */
+
+/** Set global next address and space remaining counters
+ *
+ * @param data Byte array containing data to write to global stats counters
+ * @return Indicates success or failure reason
+ */
+int DataManager::set_global_stats(char *data)
+{
+    Span span(*this, DataManager_FileSystem::SPAN_GLOBAL_STATS_WRITE);
+
+    int status = write_with_retry(GLOBAL_STATS_START_ADDRESS, data, GLOBAL_STATS_LENGTH);
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return status;
+    }
+    return DataManager::DATA_MANAGER_OK;
+}
+
+/** Perform checksum on given File_t using the 'valid' parameter
+ *
+ * @param type File to be checked for validity
+ * @return True if file is valid, else false
+ */
+bool DataManager::is_valid_file(DataManager_FileSystem::File_t file)
+{
+    /** During init_filesystem() we set every bit in the file table to 0
+     *  so, if the valid byte == 0, this can't be a valid entry
+     */
+    if(file.parameters.valid == 0x00)
+    {
+        return false;
+    }
+    
+    /** Use our 8-bit valid flag as a rudimentary checksum of the length and type id
+     */
+    if(file.parameters.valid != DataManager_FileSystem::file_checksum(file))
+    {
+        return false;
+    }
+
+    return true;
+}
+
+/** Determine the next available address to which to write file
+ *
+ * @param &next_available_address Address of integer value in which the address
+ *                                of the next available location in memory to which
+ *                                you can write a file is stored. -1 if 
+ *                                there are no available spaces
+ * @return Indicates success or failure reason
+ */
+int DataManager::get_next_available_file_table_address(int &next_available_address)
+{
+    Span span(*this, DataManager_FileSystem::SPAN_TABLE_SCAN);
+
+    DataManager_FileSystem::File_t file;
+    int file_size = sizeof(file);
+    
+    uint16_t max_files = get_max_files();
+
+    for(uint16_t file_index = 0; file_index < max_files; file_index++)
+    {
+        int address = FILE_TABLE_START_ADDRESS + (file_index * file_size);
+        int status = read_storage(address, file.data, file_size);
+
+        if(status != DataManager::DATA_MANAGER_OK)
+        {
+            return status;
+        }
+
+        if(!is_valid_file(file))
+        {
+            next_available_address = address;
+            break;
+        }
+    }
+
+    return DataManager::DATA_MANAGER_OK;
+}
+
+/** Modify a file's metadata
+ *
+ * @param filename ID of file to be modified
+ * @param file Updated version of file
+ * @return Indicates success or failure reason
+ */
+int DataManager::modify_file(uint8_t filename, DataManager_FileSystem::File_t file)
+{
+    Span span(*this, DataManager_FileSystem::SPAN_METADATA_WRITE);
+
+    DataManager_FileSystem::File_t read_file;
+    int address = -1;
+
+    int status = get_file_table_entry(filename, read_file, address);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return status;
+    }
+
+    status = write_with_retry(address, file.data, sizeof(file));
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return status;
+    }
+    
+    return DataManager::DATA_MANAGER_OK;
+}
+
+/** Check a record group's schema and that the file was added with it
+ *
+ * @param &schema Schema to be checked
+ * @param &file File_t of the record group, or NULL to check the schema alone
+ * @return Indicates success or failure reason
+ */
+int DataManager::check_record_schema(const DataManager_FileSystem::RecordSchema_t &schema, 
+                                     const DataManager_FileSystem::File_t *file)
+{
+    if(schema.parameters.channels == 0 || schema.parameters.channels > DataManager_FileSystem::RECORD_GROUP_MAX_CHANNELS)
+    {
+        return DataManager_FileSystem::RECORD_INVALID_SCHEMA;
+    }
+
+    for(uint8_t channel = 0; channel < schema.parameters.channels; channel++)
+    {
+        if(schema.parameters.channel_length_bytes[channel] == 0)
+        {
+            return DataManager_FileSystem::RECORD_INVALID_SCHEMA;
+        }
+    }
+
+    if(file != NULL && file->parameters.length_bytes != 
+       DataManager_FileSystem::record_channel_offset(schema, schema.parameters.channels))
+    {
+        return DataManager_FileSystem::RECORD_INVALID_SCHEMA;
+    }
+
+    return DataManager::DATA_MANAGER_OK;
+}
+
+/** Find the RAM state of an RLE file, loading it from storage if it
+ *  isn't already open
+ *
+ * @param filename ID of the RLE file
+ * @param *&state Address of pointer to which the state will be assigned
+ * @return Indicates success or failure reason
+ */
+int DataManager::get_rle_state(uint8_t filename, RleState_t *&state)
+{
+    for(int slot = 0; slot < RLE_MAX_OPEN_FILES; slot++)
+    {
+        if(_rle_files[slot].open && _rle_files[slot].filename == filename)
+        {
+            state = &_rle_files[slot];
+            return DataManager::DATA_MANAGER_OK;
+        }
+    }
+
+    DataManager_FileSystem::File_t file;
+
+    int status = get_file_by_name(filename, file);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return status;
+    }
+
+    int record_length = file.parameters.length_bytes;
+
+    if(record_length <= (int)sizeof(uint16_t) || record_length > (int)sizeof(uint16_t) + RLE_MAX_VALUE_BYTES)
+    {
+        return DataManager_FileSystem::RLE_INVALID_VALUE_LENGTH;
+    }
+
+    /** Use a free slot if there is one, otherwise flush and reuse slots in turn
+     */
+    state = NULL;
+
+    for(int slot = 0; slot < RLE_MAX_OPEN_FILES && state == NULL; slot++)
+    {
+        if(!_rle_files[slot].open)
+        {
+            state = &_rle_files[slot];
+        }
+    }
+
+    if(state == NULL)
+    {
+        state = &_rle_files[_rle_next_evict];
+        _rle_next_evict = (_rle_next_evict + 1) % RLE_MAX_OPEN_FILES;
+
+        status = persist_rle_run(*state);
+
+        if(status != DataManager::DATA_MANAGER_OK)
+        {
+            return status;
+        }
+
+        state->open = false;
+    }
+
+    state->filename = filename;
+    state->value_length = record_length - sizeof(uint16_t);
+    state->pending = 0;
+    state->stored = 0;
+    state->persisted_runs = 0;
+    state->persisted_entries = 0;
+    state->index_stride = 1;
+    state->index_count = 0;
+
+    /** Rebuild the run index and run totals with one pass over the runs. 
+     *  The last run is the current one, which may be continued
+     */
+    int runs = (file.parameters.next_available_address - file.parameters.file_start_address) / record_length;
+    int records_per_chunk = PAGE_SIZE_BYTES / record_length;
+
+    ScratchBuffer buffer(*this, PAGE_SIZE_BYTES);
+
+    if(buffer.data == NULL)
+    {
+        return DataManager_FileSystem::SCRATCH_ARENA_EXHAUSTED;
+    }
+
+    for(int run = 0; run < runs; run += records_per_chunk)
+    {
+        int chunk_records = (runs - run < records_per_chunk) ? runs - run : records_per_chunk;
+
+        status = read_storage(file.parameters.file_start_address + (run * record_length), 
+                                            buffer.data, chunk_records * record_length);
+
+        if(status != DataManager::DATA_MANAGER_OK)
+        {
+            return status;
+        }
+
+        for(int record = 0; record < chunk_records; record++)
+        {
+            uint16_t run_length;
+            memcpy(&run_length, &buffer.data[record * record_length], sizeof(run_length));
+
+            if(run + record == runs - 1)
+            {
+                memcpy(state->value, &buffer.data[(record * record_length) + sizeof(run_length)], state->value_length);
+                state->pending = run_length;
+                state->stored = run_length;
+                break;
+            }
+
+            add_rle_index(*state, state->persisted_runs, state->persisted_entries);
+
+            state->persisted_runs++;
+            state->persisted_entries += run_length;
+        }
+    }
+
+    state->run_address = file.parameters.file_start_address + (state->persisted_runs * record_length);
+    state->open = true;
+
+    return DataManager::DATA_MANAGER_OK;
+}
+
+/** Rewrite the length of the current run of an RLE file if values have
+ *  been added to it since it was last written
+ *
+ * @param &state State of the RLE file
+ * @return Indicates success or failure reason
+ */
+int DataManager::persist_rle_run(RleState_t &state)
+{
+    if(!state.open || state.pending == state.stored)
+    {
+        return DataManager::DATA_MANAGER_OK;
+    }
+
+    /** Runs are written outside of transactions, so one that has staged the
+     *  file holds metadata that doesn't know about them
+     */
+    if(_transaction_open && get_staged_file(state.filename) != -1)
+    {
+        return DataManager_FileSystem::TRANSACTION_CONFLICT;
+    }
+
+    Span span(*this, DataManager_FileSystem::SPAN_DATA_WRITE);
+
+    char run_length[sizeof(state.pending)];
+    memcpy(run_length, &state.pending, sizeof(state.pending));
+
+    int status = write_with_retry(state.run_address, run_length, sizeof(run_length));
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return status;
+    }
+
+    state.stored = state.pending;
+
+    return DataManager::DATA_MANAGER_OK;
+}
+
+/** End the current run of an RLE file, adding it to the run index, and
+ *  write a new run of one value
+ *
+ * @param &state State of the RLE file
+ * @param *data Value of the new run
+ * @return Indicates success or failure reason
+ */
+int DataManager::start_rle_run(RleState_t &state, const char *data)
+{
+    if(_transaction_open && get_staged_file(state.filename) != -1)
+    {
+        return DataManager_FileSystem::TRANSACTION_CONFLICT;
+    }
+
+    int status = persist_rle_run(state);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return status;
+    }
+
+    if(state.pending > 0)
+    {
+        add_rle_index(state, state.persisted_runs, state.persisted_entries);
+
+        state.persisted_runs++;
+        state.persisted_entries += state.pending;
+        state.run_address += sizeof(state.pending) + state.value_length;
+        state.pending = 0;
+        state.stored = 0;
+    }
+
+    DataManager_FileSystem::File_t file;
+
+    status = get_file_by_name(state.filename, file);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return status;
+    }
+
+    int record_length = sizeof(uint16_t) + state.value_length;
+
+    if((record_length - 1) + state.run_address > file.parameters.file_end_address)
+    {
+        return DataManager_FileSystem::FILE_ENTRY_FULL;
+    }
+
+    char record[sizeof(uint16_t) + RLE_MAX_VALUE_BYTES];
+    uint16_t run_length = 1;
+    memcpy(record, &run_length, sizeof(run_length));
+    memcpy(&record[sizeof(run_length)], data, state.value_length);
+
+    /** The run is appended directly rather than through append_file_entry(),
+     *  which would stage it in an open transaction that the run's later
+     *  length writes would then bypass
+     */
+    {
+        Span span(*this, DataManager_FileSystem::SPAN_DATA_WRITE);
+        status = write_with_retry(state.run_address, record, record_length);
+    }
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return status;
+    }
+
+    file.parameters.next_available_address = state.run_address + record_length;
+    file.parameters.valid = DataManager_FileSystem::file_checksum(file);
+
+    status = modify_file(state.filename, file);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return status;
+    }
+
+    memcpy(state.value, data, state.value_length);
+    state.pending = run_length;
+    state.stored = run_length;
+
+    return DataManager::DATA_MANAGER_OK;
+}
+
+/** Record the number of values preceding a run in the run index if the run
+ *  falls on the index stride, doubling the stride when the index is full
+ *
+ * @param &state State of the RLE file
+ * @param run 0-indexed run
+ * @param entries_before Number of values preceding the run
+ */
+void DataManager::add_rle_index(RleState_t &state, uint16_t run, uint32_t entries_before)
+{
+    if(run % state.index_stride != 0)
+    {
+        return;
+    }
+
+    if(state.index_count == RLE_INDEX_ENTRIES)
+    {
+        for(int checkpoint = 0; checkpoint < RLE_INDEX_ENTRIES / 2; checkpoint++)
+        {
+            state.index[checkpoint] = state.index[checkpoint * 2];
+        }
+
+        state.index_count = RLE_INDEX_ENTRIES / 2;
+        state.index_stride *= 2;
+
+        if(run % state.index_stride != 0)
+        {
+            return;
+        }
+    }
+
+    state.index[state.index_count++] = entries_before;
+}
+
+/** Find the block index of an archive file, rebuilding it from the block
+ *  headers if the archive isn't already open
+ *
+ * @param filename ID of the archive file
+ * @return Indicates success or failure reason
+ */
+int DataManager::open_archive(uint8_t filename)
+{
+    if(_archive.open && _archive.filename == filename)
+    {
+        return DataManager::DATA_MANAGER_OK;
+    }
+
+    _archive.open = false;
+
+    DataManager_FileSystem::File_t file;
+
+    int status = get_file_by_name(filename, file);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return status;
+    }
+
+    _archive.filename = filename;
+    _archive.length = 0;
+    _archive.blocks = 0;
+    _archive.index_stride = 1;
+    _archive.index_count = 0;
+
+    /** Hop from header to header, reading only the two length bytes of each block
+     */
+    uint16_t address = file.parameters.file_start_address;
+
+    while(address < file.parameters.next_available_address)
+    {
+        char header[ARCHIVE_BLOCK_HEADER_BYTES];
+
+        status = read_storage(address, header, ARCHIVE_BLOCK_HEADER_BYTES);
+
+        if(status != DataManager::DATA_MANAGER_OK)
+        {
+            return status;
+        }
+
+        int raw_length = (uint8_t)header[0];
+        int stored_length = (uint8_t)header[1];
+
+        if(raw_length == 0 || raw_length > PAGE_SIZE_BYTES || stored_length > raw_length)
+        {
+            return DataManager_FileSystem::ARCHIVE_CORRUPT;
+        }
+
+        add_archive_index(address, _archive.length);
+        _archive.length += raw_length;
+        _archive.blocks++;
+
+        address += ARCHIVE_BLOCK_HEADER_BYTES + stored_length;
+    }
+
+    /** An empty archive still needs a checkpoint from which to start writing
+     */
+    if(_archive.index_count == 0)
+    {
+        _archive.index_address[0] = file.parameters.file_start_address;
+        _archive.index_offset[0] = 0;
+    }
+
+    _archive.open = true;
+
+    return DataManager::DATA_MANAGER_OK;
+}
+
+/** Record the address and uncompressed offset of a block in the archive's
+ *  block index, doubling the stride when the index is full
+ *
+ * @param address Address of the block's header
+ * @param offset Uncompressed offset of the block within the archive
+ */
+void DataManager::add_archive_index(uint16_t address, uint32_t offset)
+{
+    if(_archive.blocks % _archive.index_stride != 0)
+    {
+        return;
+    }
+
+    if(_archive.index_count == ARCHIVE_INDEX_ENTRIES)
+    {
+        for(int checkpoint = 0; checkpoint < ARCHIVE_INDEX_ENTRIES / 2; checkpoint++)
+        {
+            _archive.index_address[checkpoint] = _archive.index_address[checkpoint * 2];
+            _archive.index_offset[checkpoint] = _archive.index_offset[checkpoint * 2];
+        }
+
+        _archive.index_count = ARCHIVE_INDEX_ENTRIES / 2;
+        _archive.index_stride *= 2;
+
+        if(_archive.blocks % _archive.index_stride != 0)
+        {
+            return;
+        }
+    }
+
+    _archive.index_address[_archive.index_count] = address;
+    _archive.index_offset[_archive.index_count] = offset;
+    _archive.index_count++;
+}
+
+/** Compress a sealed block of a file and append it to the open archive
+ *
+ * @param &file The source file
+ * @param block 0-indexed block of the source file
+ * @param &archive The archive file
+ * @param &address Address of the next block of the archive, advanced past the block written
+ * @return ARCHIVE_INCOMPRESSIBLE if the block doesn't shrink, ARCHIVE_FULL if 
+ *         it doesn't fit, else success or failure reason
+ */
+int DataManager::archive_block(const DataManager_FileSystem::File_t &file, int block, const DataManager_FileSystem::File_t &archive,
+                               uint16_t &address)
+{
+    int entry_length = file.parameters.length_bytes;
+    int block_length = (PAGE_SIZE_BYTES / entry_length) * entry_length;
+
+    ScratchBuffer raw(*this, PAGE_SIZE_BYTES);
+    ScratchBuffer stored(*this, ARCHIVE_BLOCK_HEADER_BYTES + PAGE_SIZE_BYTES);
+
+    if(raw.data == NULL || stored.data == NULL)
+    {
+        return DataManager_FileSystem::SCRATCH_ARENA_EXHAUSTED;
+    }
+
+    int status = read_sealed_block(file, block, raw.data);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return status;
+    }
+
+    if(!compress_block(raw.data, block_length, stored.data))
+    {
+        return DataManager_FileSystem::ARCHIVE_INCOMPRESSIBLE;
+    }
+
+    return write_archive_block(stored.data, archive, address);
+}
+
+/** Read a sealed block of a file
+ *
+ * @param &file The source file
+ * @param block 0-indexed block of the source file
+ * @param *raw Buffer of PAGE_SIZE_BYTES to which the block will be read
+ * @return Indicates success or failure reason
+ */
+int DataManager::read_sealed_block(const DataManager_FileSystem::File_t &file, int block, char *raw)
+{
+    int entry_length = file.parameters.length_bytes;
+    int block_length = (PAGE_SIZE_BYTES / entry_length) * entry_length;
+
+    return read_storage(file.parameters.file_start_address + (block * block_length), raw, block_length);
+}
+
+/** Encode a block as an archive block: its header followed by the 
+ *  compressed block
+ *
+ * @param *raw The block
+ * @param block_length Length of the block in bytes
+ * @param *stored Buffer of ARCHIVE_BLOCK_HEADER_BYTES + PAGE_SIZE_BYTES to which the archive block will be written
+ * @return False if the archive block wouldn't be shorter than the block, else true
+ */
+bool DataManager::compress_block(char *raw, int block_length, char *stored)
+{
+    /** The header is part of the cost, so a block must shrink by more than
+     *  it. Archives written by earlier versions may hold raw blocks, which 
+     *  are signalled by equal raw and stored lengths and still read back
+     */
+    uint32_t start_us = us_ticker_read();
+    int stored_length = DataManager_FileSystem::lz_compress(raw, block_length, &stored[ARCHIVE_BLOCK_HEADER_BYTES], 
+                                                            block_length - ARCHIVE_BLOCK_HEADER_BYTES - 1);
+    _compression_stats.encode_us += us_ticker_read() - start_us;
+
+    if(stored_length == 0)
+    {
+        return false;
+    }
+
+    stored[0] = (char)block_length;
+    stored[1] = (char)stored_length;
+
+    return true;
+}
+
+/** Append an archive block to the open archive
+ *
+ * @param *stored The archive block
+ * @param &archive The archive file
+ * @param &address Address of the next block of the archive, advanced past the block written
+ * @return ARCHIVE_FULL if the block doesn't fit, else success or failure reason
+ */
+int DataManager::write_archive_block(char *stored, const DataManager_FileSystem::File_t &archive, uint16_t &address)
+{
+    int block_length = (uint8_t)stored[0];
+    int stored_length = (uint8_t)stored[1];
+
+    if((ARCHIVE_BLOCK_HEADER_BYTES + stored_length - 1) + address > archive.parameters.file_end_address)
+    {
+        return DataManager_FileSystem::ARCHIVE_FULL;
+    }
+
+    int status = write_with_retry(address, stored, ARCHIVE_BLOCK_HEADER_BYTES + stored_length);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return status;
+    }
+
+    add_archive_index(address, _archive.length);
+    _archive.length += block_length;
+    _archive.blocks++;
+
+    _compression_stats.raw_bytes += block_length;
+    _compression_stats.stored_bytes += ARCHIVE_BLOCK_HEADER_BYTES + stored_length;
+    _compression_stats.bytes_reclaimed += block_length - (ARCHIVE_BLOCK_HEADER_BYTES + stored_length);
+
+    address += ARCHIVE_BLOCK_HEADER_BYTES + stored_length;
+
+    return DataManager::DATA_MANAGER_OK;
+}
+
+/** Drop the RAM state of an RLE or archive file whose entries have been 
+ *  modified directly
+ *
+ * @param filename ID of the file
+ */
+void DataManager::close_file_state(uint8_t filename)
+{
+    for(int slot = 0; slot < RLE_MAX_OPEN_FILES; slot++)
+    {
+        if(_rle_files[slot].open && _rle_files[slot].filename == filename)
+        {
+            _rle_files[slot].open = false;
+        }
+    }
+
+    if(_archive.open && _archive.filename == filename)
+    {
+        _archive.open = false;
+    }
+}
+
+/** Get all File_t parameters and the file table address for a given filename
+ *
+ * @param filename ID of file to be retrieved
+ * @param &file Address of File_t object in which retrieved information
+ *              will be stored
+ * @param &address Address of integer value to which the file table address
+ *                 of the file will be stored
+ * @return Indicates success or failure reason
+ */
+int DataManager::get_file_table_entry(uint8_t filename, DataManager_FileSystem::File_t &file, int &address)
+{
+    Span span(*this, DataManager_FileSystem::SPAN_TABLE_SCAN);
+
+    int file_size = sizeof(DataManager_FileSystem::File_t);
+
+    uint16_t max_files = get_max_files();
+
+    for(uint16_t file_index = 0; file_index < max_files; file_index++)
+    {
+        int file_address = FILE_TABLE_START_ADDRESS + (file_index * file_size);
+        int status = read_storage(file_address, file.data, file_size);
+
+        if(status != DataManager::DATA_MANAGER_OK)
+        {
+            return status;
+        }
+
+        if(!is_valid_file(file))
+        {
+            continue;
+        }
+
+        if(filename == file.parameters.filename)
+        {
+            address = file_address;
+            return DataManager::DATA_MANAGER_OK;
+        }
+    }
+
+    return DataManager_FileSystem::FILE_INVALID_NAME;
+}
+
+/** Find the journal record in which a file's metadata is staged
+ *
+ * @param filename ID of file to be found
+ * @return Index of the record within the journal, -1 if the file is not staged
+ */
+int DataManager::get_staged_file(uint8_t filename)
+{
+    for(int record = 0; record < _journal.parameters.entries; record++)
+    {
+        if(_journal.parameters.records[record].file.parameters.filename == filename)
+        {
+            return record;
+        }
+    }
+
+    return -1;
+}
+
+/** Write every journal record to the file table and then clear the journal
+ *
+ * @return Indicates success or failure reason
+ */
+int DataManager::apply_journal()
+{
+    Span span(*this, DataManager_FileSystem::SPAN_JOURNAL_APPLY);
+
+    int status = -1;
+
+    for(int record = 0; record < _journal.parameters.entries; record++)
+    {
+        status = write_with_retry(_journal.parameters.records[record].address, 
+                                  _journal.parameters.records[record].file.data, 
+                                  sizeof(DataManager_FileSystem::File_t));
+        if(status != DataManager::DATA_MANAGER_OK)
+        {
+            return status;
+        }
+    }
+
+    /** Only the committed marker needs clearing for the journal to be ignored
+     */
+    char cleared[sizeof(_journal.parameters.committed)] = { 0 };
+
+    status = write_with_retry(JOURNAL_START_ADDRESS, cleared, sizeof(cleared));
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return status;
+    }
+
+    return DataManager::DATA_MANAGER_OK;
+}
+
+/** Calculate the number of bytes moved by the next step of a truncation
+ *
+ * @param &step The truncation
+ * @return Number of bytes to move
+ */
+int DataManager::truncate_chunk(const TruncateStep_t &step)
+{
+    /** Chunks end on destination page boundaries so that each write is a
+     *  single write cycle
+     */
+    int chunk = PAGE_SIZE_BYTES - (step.new_address % PAGE_SIZE_BYTES);
+
+    if(chunk > step.remaining_bytes)
+    {
+        chunk = step.remaining_bytes;
+    }
+
+    /** A persistent move mustn't overwrite its own source, which a move
+     *  torn by a power cut would then leave to be moved again
+     */
+    if(step.persistent && chunk > step.source_address - step.new_address)
+    {
+        chunk = step.source_address - step.new_address;
+    }
+
+    return chunk;
+}
+
+/** Clear one page of the file table or, after the last, the journal
+ *
+ * @param page 0-indexed page, FILE_TABLE_PAGES for the journal
+ * @return Indicates success or failure reason
+ */
+int DataManager::clear_filesystem_page(int page)
+{
+    ScratchBuffer blank(*this, PAGE_SIZE_BYTES);
+
+    if(blank.data == NULL)
+    {
+        return DataManager_FileSystem::SCRATCH_ARENA_EXHAUSTED;
+    }
+
+    memset(blank.data, 0, PAGE_SIZE_BYTES);
+
+    /** Clear the journal so that recover_transaction() doesn't apply a stale 
+     *  transaction to the new file table
+     */
+    uint16_t address = (page < FILE_TABLE_PAGES) ? FILE_TABLE_START_ADDRESS + (page * PAGE_SIZE_BYTES) : JOURNAL_START_ADDRESS;
+
+    int status = write_with_retry(address, blank.data, PAGE_SIZE_BYTES);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return status;
+    }
+    wait_us(5000);
+
+    return DataManager::DATA_MANAGER_OK;
+}
+
+/** Make steps of the resumable operation in progress until it finishes
+ *  or the next step could overrun the budget, then write a checkpoint
+ *
+ * @param &budget Work that this call may do
+ * @return OPERATION_IN_PROGRESS or the outcome of the operation
+ */
+int DataManager::run_operation(const OperationBudget_t &budget)
+{
+    /** Cost of the checkpoint that ends a call which runs out of budget
+     */
+    CostEstimate_t checkpoint;
+    memset(&checkpoint, 0, sizeof(checkpoint));
+    _estimate_pointer = -1;
+    estimate_write(OPERATION_START_ADDRESS, sizeof(DataManager_FileSystem::Operation_t), checkpoint);
+    checkpoint.time_us = (((uint64_t)checkpoint.bus_bytes * _timing.bus_byte_ns) / 1000) + 
+                         (checkpoint.write_cycles * _timing.write_cycle_us);
+
+    uint32_t start_us = us_ticker_read();
+    uint32_t start_write_cycles = _io_stats.write_cycles;
+    uint32_t step_us = 0;
+    uint32_t step_write_cycles = 0;
+
+    while(true)
+    {
+        uint32_t step_start_us = us_ticker_read();
+        uint32_t step_start_write_cycles = _io_stats.write_cycles;
+
+        /** Every write cycle of a compression's steps, including its
+         *  checkpoints, is spent on the compression
+         */
+        bool compressing = (_operation.op == DataManager_FileSystem::TRACE_COMPRESS_SEALED_PAGES);
+
+        int status = operation_step();
+
+        if(compressing)
+        {
+            _compression_stats.write_cycles += _io_stats.write_cycles - step_start_write_cycles;
+        }
+
+        if(status != DataManager_FileSystem::OPERATION_IN_PROGRESS)
+        {
+            return status;
+        }
+
+        /** The largest step so far stands in for the next one
+         */
+        uint32_t now_us = us_ticker_read();
+
+        if(now_us - step_start_us > step_us)
+        {
+            step_us = now_us - step_start_us;
+        }
+
+        if(_io_stats.write_cycles - step_start_write_cycles > step_write_cycles)
+        {
+            step_write_cycles = _io_stats.write_cycles - step_start_write_cycles;
+        }
+
+        uint32_t spent_us = now_us - start_us;
+        uint32_t spent_write_cycles = _io_stats.write_cycles - start_write_cycles;
+
+        if((budget.time_us != 0 && spent_us + step_us + checkpoint.time_us > budget.time_us) ||
+           (budget.write_cycles != 0 && spent_write_cycles + step_write_cycles + checkpoint.write_cycles > budget.write_cycles))
+        {
+            uint32_t checkpoint_start_write_cycles = _io_stats.write_cycles;
+
+            status = write_operation();
+
+            if(compressing)
+            {
+                _compression_stats.write_cycles += _io_stats.write_cycles - checkpoint_start_write_cycles;
+            }
+
+            if(status != DataManager::DATA_MANAGER_OK)
+            {
+                return status;
+            }
+
+            return DataManager_FileSystem::OPERATION_IN_PROGRESS;
+        }
+    }
+}
+
+/** Make one step of the resumable operation in progress
+ *
+ * @return OPERATION_IN_PROGRESS or the outcome of the operation
+ */
+int DataManager::operation_step()
+{
+    int status;
+
+    if(_operation.op == DataManager_FileSystem::TRACE_INIT_FILESYSTEM)
+    {
+        status = clear_filesystem_page(_operation.progress);
+
+        if(status != DataManager::DATA_MANAGER_OK)
+        {
+            return status;
+        }
+
+        if(++_operation.progress < _operation.total)
+        {
+            return DataManager_FileSystem::OPERATION_IN_PROGRESS;
+        }
+
+        return finish_operation(DataManager::DATA_MANAGER_OK);
+    }
+
+    if(_operation.op == DataManager_FileSystem::TRACE_COMPRESS_SEALED_PAGES && !_truncate_step.active)
+    {
+        if(_operation.progress < _operation.total)
+        {
+            status = archive_block(_operation.file, _operation.progress, _operation.archive, _operation.archive_address);
+
+            /** Archive what fits and shrinks and truncate that much
+             */
+            bool stop = (status == DataManager_FileSystem::ARCHIVE_FULL || status == DataManager_FileSystem::ARCHIVE_INCOMPRESSIBLE);
+
+            if(stop && _operation.progress > 0)
+            {
+                _operation.total = _operation.progress;
+                return DataManager_FileSystem::OPERATION_IN_PROGRESS;
+            }
+
+            if(stop)
+            {
+                return finish_operation(status);
+            }
+
+            if(status != DataManager::DATA_MANAGER_OK)
+            {
+                return status;
+            }
+
+            _operation.progress++;
+
+            return DataManager_FileSystem::OPERATION_IN_PROGRESS;
+        }
+
+        /** The checkpoint puts every block in the archive's metadata before
+         *  any entry is truncated from the source
+         */
+        status = write_operation();
+
+        if(status != DataManager::DATA_MANAGER_OK)
+        {
+            return status;
+        }
+
+        int entry_length = _operation.file.parameters.length_bytes;
+        int archived_entries = _operation.total * (PAGE_SIZE_BYTES / entry_length);
+
+        status = truncate_step(_operation.filename, archived_entries);
+
+        if(status != DataManager_FileSystem::OPERATION_IN_PROGRESS)
+        {
+            return finish_operation(status);
+        }
+
+        _truncate_step.persistent = true;
+        _truncate_step.checkpoint_address = _truncate_step.source_address;
+
+        status = write_operation();
+
+        if(status != DataManager::DATA_MANAGER_OK)
+        {
+            return status;
+        }
+
+        return DataManager_FileSystem::OPERATION_IN_PROGRESS;
+    }
+
+    status = truncate_step(_truncate_step.filename, _truncate_step.entries_to_remove);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return status;
+    }
+
+    return finish_operation(DataManager::DATA_MANAGER_OK);
+}
+
+/** Read the operation page once and restore the operation that was in
+ *  progress, if any, from the newer of its valid copies
+ *
+ * @return Indicates success or failure reason
+ */
+int DataManager::load_operation()
+{
+    if(_operation.loaded)
+    {
+        return DataManager::DATA_MANAGER_OK;
+    }
+
+    /** The operation page of an older layout may hold file data
+     */
+    int status = check_layout();
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return status;
+    }
+
+    DataManager_FileSystem::Operation_t copies[2];
+
+    status = read_storage(OPERATION_START_ADDRESS, copies[0].data, sizeof(copies));
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return status;
+    }
+
+    int newest = -1;
+
+    for(int copy = 0; copy < 2; copy++)
+    {
+        if(copies[copy].parameters.checksum != DataManager_FileSystem::operation_checksum(copies[copy]))
+        {
+            continue;
+        }
+
+        if(newest < 0 || (int16_t)(copies[copy].parameters.sequence - copies[newest].parameters.sequence) > 0)
+        {
+            newest = copy;
+        }
+    }
+
+    _operation.loaded = true;
+    _operation.active = false;
+
+    if(newest < 0)
+    {
+        return DataManager::DATA_MANAGER_OK;
+    }
+
+    const DataManager_FileSystem::Operation_t &operation = copies[newest];
+    _operation.sequence = operation.parameters.sequence;
+
+    if(operation.parameters.op == 0)
+    {
+        return DataManager::DATA_MANAGER_OK;
+    }
+
+    _operation.op = operation.parameters.op;
+    _operation.filename = operation.parameters.filename;
+    _operation.archive_filename = operation.parameters.archive_filename;
+    _operation.progress = operation.parameters.progress;
+    _operation.total = operation.parameters.total;
+    _operation.archive_address = operation.parameters.archive_address;
+    _operation.file = operation.parameters.file;
+
+    if(_operation.op == DataManager_FileSystem::TRACE_COMPRESS_SEALED_PAGES)
+    {
+        status = get_file_by_name(_operation.archive_filename, _operation.archive);
+
+        if(status != DataManager::DATA_MANAGER_OK)
+        {
+            return status;
+        }
+
+        /** A reset between updating the archive's metadata and the checkpoint
+         *  leaves blocks in the archive that are about to be archived again
+         */
+        if(_operation.archive.parameters.next_available_address != _operation.archive_address)
+        {
+            _operation.archive.parameters.next_available_address = _operation.archive_address;
+            _operation.archive.parameters.valid = DataManager_FileSystem::file_checksum(_operation.archive);
+
+            status = modify_file(_operation.archive_filename, _operation.archive);
+
+            if(status != DataManager::DATA_MANAGER_OK)
+            {
+                return status;
+            }
+        }
+
+        close_file_state(_operation.archive_filename);
+
+        status = open_archive(_operation.archive_filename);
+
+        if(status != DataManager::DATA_MANAGER_OK)
+        {
+            return status;
+        }
+    }
+
+    if(operation.parameters.truncating)
+    {
+        TruncateStep_t &step = _truncate_step;
+        step.active = true;
+        step.persistent = true;
+        step.filename = _operation.filename;
+        step.address = operation.parameters.address;
+        step.file = operation.parameters.file;
+        step.source_address = operation.parameters.source_address;
+        step.new_address = operation.parameters.new_address;
+        step.remaining_bytes = operation.parameters.remaining_bytes;
+        step.checkpoint_address = step.source_address;
+        step.entries_to_remove = (step.source_address - step.new_address) / step.file.parameters.length_bytes;
+    }
+
+    _operation.active = true;
+
+    return DataManager::DATA_MANAGER_OK;
+}
+
+/** Bring a filesystem initialised by v0.5.0 or earlier up to the current
+ *  layout, once per boot. Those versions allocated storage up to the end
+ *  of the EEPROM, so their space remaining counts the operation page and
+ *  journal and either page may hold their files' data
+ *
+ * @return LAYOUT_INCOMPATIBLE if allocated storage reaches into the 
+ *         operation page or journal, else success or failure reason
+ */
+int DataManager::check_layout()
+{
+    if(_layout_checked)
+    {
+        return DataManager::DATA_MANAGER_OK;
+    }
+
+    DataManager_FileSystem::GlobalStats_t g_stats;
+
+    int status = read_storage(GLOBAL_STATS_START_ADDRESS, g_stats.data, GLOBAL_STATS_LENGTH);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return status;
+    }
+
+    if(g_stats.parameters.initialised != DataManager_FileSystem::INITIALISED_V0_5)
+    {
+        _layout_checked = true;
+        return DataManager::DATA_MANAGER_OK;
+    }
+
+    if(g_stats.parameters.next_available_address > OPERATION_START_ADDRESS)
+    {
+        return DataManager_FileSystem::LAYOUT_INCOMPATIBLE;
+    }
+
+    ScratchBuffer blank(*this, PAGE_SIZE_BYTES);
+
+    if(blank.data == NULL)
+    {
+        return DataManager_FileSystem::SCRATCH_ARENA_EXHAUSTED;
+    }
+
+    memset(blank.data, 0, PAGE_SIZE_BYTES);
+
+    /** Neither page has been written by this layout, so clear them before 
+     *  they are read as an operation or journal. The global stats are written
+     *  last, so a reset part way through repeats the migration
+     */
+    for(uint16_t address = OPERATION_START_ADDRESS; address < PAGES * PAGE_SIZE_BYTES; address += PAGE_SIZE_BYTES)
+    {
+        status = write_with_retry(address, blank.data, PAGE_SIZE_BYTES);
+
+        if(status == DataManager::DATA_MANAGER_OK)
+        {
+            status = wait_for_write_cycle();
+        }
+
+        if(status != DataManager::DATA_MANAGER_OK)
+        {
+            return status;
+        }
+    }
+
+    g_stats.parameters.space_remaining = (STORAGE_START_ADDRESS + STORAGE_LENGTH) - g_stats.parameters.next_available_address;
+    g_stats.parameters.initialised = DataManager_FileSystem::INITIALISED;
+
+    status = set_global_stats(g_stats.data);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return status;
+    }
+
+    _layout_checked = true;
+
+    return DataManager::DATA_MANAGER_OK;
+}
+
+/** Persist the progress of the resumable operation in progress, or that
+ *  none is, to the older copy in the operation page
+ *
+ * @return Indicates success or failure reason
+ */
+int DataManager::write_operation()
+{
+    DataManager_FileSystem::Operation_t operation;
+    memset(operation.data, 0, sizeof(operation));
+
+    int status;
+
+    if(_operation.active)
+    {
+        /** Blocks archived since the last checkpoint count once the archive's
+         *  metadata covers them
+         */
+        if(_operation.op == DataManager_FileSystem::TRACE_COMPRESS_SEALED_PAGES &&
+           _operation.archive.parameters.next_available_address != _operation.archive_address)
+        {
+            _operation.archive.parameters.next_available_address = _operation.archive_address;
+            _operation.archive.parameters.valid = DataManager_FileSystem::file_checksum(_operation.archive);
+
+            status = modify_file(_operation.archive_filename, _operation.archive);
+
+            if(status != DataManager::DATA_MANAGER_OK)
+            {
+                _archive.open = false;
+                return status;
+            }
+        }
+
+        operation.parameters.op = _operation.op;
+        operation.parameters.filename = _operation.filename;
+        operation.parameters.archive_filename = _operation.archive_filename;
+        operation.parameters.progress = _operation.progress;
+        operation.parameters.total = _operation.total;
+        operation.parameters.archive_address = _operation.archive_address;
+        operation.parameters.file = _operation.file;
+
+        if(_truncate_step.active && _truncate_step.persistent)
+        {
+            operation.parameters.truncating = 1;
+            operation.parameters.address = _truncate_step.address;
+            operation.parameters.source_address = _truncate_step.source_address;
+            operation.parameters.new_address = _truncate_step.new_address;
+            operation.parameters.remaining_bytes = _truncate_step.remaining_bytes;
+        }
+    }
+
+    operation.parameters.sequence = _operation.sequence + 1;
+    operation.parameters.checksum = DataManager_FileSystem::operation_checksum(operation);
+
+    {
+        Span span(*this, DataManager_FileSystem::SPAN_CHECKPOINT_WRITE);
+        status = write_with_retry(OPERATION_START_ADDRESS + ((operation.parameters.sequence % 2) * sizeof(operation)),
+                                  operation.data, sizeof(operation));
+    }
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return status;
+    }
+
+    _operation.sequence = operation.parameters.sequence;
+    _truncate_step.checkpoint_address = _truncate_step.source_address;
+
+    return DataManager::DATA_MANAGER_OK;
+}
+
+/** Finish the resumable operation in progress, persisting that none is
+ *
+ * @param status Outcome of the operation
+ * @return status, or the failure reason if it couldn't be persisted
+ */
+int DataManager::finish_operation(int status)
+{
+    _operation.active = false;
+    _truncate_step.active = false;
+    _truncate_step.persistent = false;
+
+    int written = write_operation();
+
+    if(written != DataManager::DATA_MANAGER_OK)
+    {
+        return written;
+    }
+
+    return status;
+}
+
+/** Add the cost of a file table lookup that finds the file in the given
+ *  slot, reading every slot up to it
+ *
+ * @param slot Index of the file in the file table
+ * @param &estimate Estimate to which the cost is added
+ */
+void DataManager::estimate_table_scan(int slot, CostEstimate_t &estimate)
+{
+    int file_size = sizeof(DataManager_FileSystem::File_t);
+
+    for(int file_index = 0; file_index <= slot; file_index++)
+    {
+        estimate_read(FILE_TABLE_START_ADDRESS + (file_index * file_size), file_size, estimate);
+    }
+}
+
+/** Estimate the next step of the truncation in progress
+ *
+ * @param filename ID of the file given to truncate_file_step()
+ * @param entries_to_remove Number of entries given to truncate_file_step()
+ * @param &estimate Estimate to which the cost is written
+ * @return Indicates success or the failure reason that the step would return
+ */
+int DataManager::estimate_truncate_step(uint8_t filename, int entries_to_remove, CostEstimate_t &estimate)
+{
+    TruncateStep_t &step = _truncate_step;
+
+    if(step.filename != filename || step.entries_to_remove != entries_to_remove)
+    {
+        return DataManager_FileSystem::OPERATION_BUSY;
+    }
+
+    _estimate_pointer = _address_known ? _address_pointer : -1;
+
+    if(step.remaining_bytes > 0)
+    {
+        int chunk = truncate_chunk(step);
+
+        estimate_read(step.source_address, chunk, estimate);
+        estimate_write(step.new_address, chunk, estimate);
+    }
+    else
+    {
+        estimate_table_scan((step.address - FILE_TABLE_START_ADDRESS) / sizeof(DataManager_FileSystem::File_t), estimate);
+        estimate_write(step.address, sizeof(step.file), estimate);
+    }
+
+    estimate_time(estimate);
+
+    if(step.remaining_bytes > 0)
+    {
+        return DataManager_FileSystem::OPERATION_IN_PROGRESS;
+    }
+
+    return DataManager::DATA_MANAGER_OK;
+}
+
+/** Add the cost of a read made through read_storage()
+ *
+ * @param address Address from which to read
+ * @param length Number of bytes to be read
+ * @param &estimate Estimate to which the cost is added
+ */
+void DataManager::estimate_read(uint16_t address, int length, CostEstimate_t &estimate)
+{
+    estimate.transfers++;
+    estimate.bus_bytes += ((_estimate_pointer == address) ? CURRENT_READ_OVERHEAD_BYTES : RANDOM_READ_OVERHEAD_BYTES) + length;
+
+    _estimate_pointer = (address + length) & EEPROM_ADDRESS_MASK;
+}
+
+/** Add the cost of a write made through write_storage()
+ *
+ * @param address Address to which to write
+ * @param length Number of bytes to be written
+ * @param &estimate Estimate to which the cost is added
+ */
+void DataManager::estimate_write(uint16_t address, int length, CostEstimate_t &estimate)
+{
+    uint16_t last = address + length - 1;
+
+    estimate.transfers++;
+    estimate.bus_bytes += WRITE_OVERHEAD_BYTES + length;
+    estimate.write_cycles += (last / PAGE_SIZE_BYTES) - (address / PAGE_SIZE_BYTES) + 1;
+
+    /** The counter is unknown after a write made by the driver, and the
+     *  polls of the write cycle of any other write, made by the write or
+     *  by the next transfer, leave it in the global stats
+     */
+    _estimate_pointer = -1;
+}
+
+/** Set the time of an estimate from its bus bytes and the write cycles
+ *  that the call waits for
+ *
+ * @param &estimate Estimate whose time is set
+ */
+void DataManager::estimate_time(CostEstimate_t &estimate)
+{
+    /** A pipelined write returns without waiting for its last write cycle
+     */
+    uint32_t waited_cycles = (_pipelined_writes && estimate.write_cycles > 0) ? estimate.write_cycles - 1 : estimate.write_cycles;
+
+    estimate.time_us = (((uint64_t)estimate.bus_bytes * _timing.bus_byte_ns) / 1000) + (waited_cycles * _timing.write_cycle_us);
+}
+
+/** Update the measured device timing from a successful transfer
+ *
+ * @param start_ticks Latency clock reading when the transfer started
+ * @param bus_bytes Bytes on the bus, including address and overhead
+ * @param write_cycles Number of write cycles the transfer made
+ */
+void DataManager::measure_transfer(uint32_t start_ticks, uint32_t bus_bytes, uint32_t write_cycles)
+{
+    int32_t elapsed_us = DataManager_LatencyClock::to_us(DataManager_LatencyClock::now() - start_ticks);
+
+    if(write_cycles == 0)
+    {
+        int32_t sample_ns = (elapsed_us * 1000) / (int32_t)bus_bytes;
+        _timing.bus_byte_ns += (sample_ns - (int32_t)_timing.bus_byte_ns) / TIMING_SMOOTHING;
+        return;
+    }
+
+    /** The rest of a write is spent waiting for its write cycles
+     */
+    int32_t bus_us = (bus_bytes * _timing.bus_byte_ns) / 1000;
+    int32_t sample_us = (elapsed_us > bus_us) ? (elapsed_us - bus_us) / (int32_t)write_cycles : 0;
+    _timing.write_cycle_us += (sample_us - (int32_t)_timing.write_cycle_us) / TIMING_SMOOTHING;
+}
+
+/** Poll the device until it acknowledges its address, i.e. until its
+ *  internal write cycle has completed
+ *
+ * @return Indicates success or failure reason
+ */
+int DataManager::wait_for_write_cycle()
+{
+    Span span(*this, DataManager_FileSystem::SPAN_WRITE_CYCLE_POLL);
+
+    char poll;
+
+    /** NACKs are expected whilst polling, so keep them out of the adaptive clock's error count
+     */
+    _polling_write_cycle = true;
+
+    uint32_t start_reads = _io_stats.reads;
+    uint32_t start_bus_bytes = _io_stats.bus_bytes;
+    int status = DataManager_FileSystem::IMAGE_WRITE_CYCLE_TIMEOUT;
+
+    for(int attempt = 0; attempt < WRITE_CYCLE_POLL_ATTEMPTS; attempt++)
+    {
+        /** The device NACKs its address for the duration of the write cycle,
+         *  so a single byte read only succeeds once the cycle has completed.
+         *  Reading at the address counter keeps the poll a current address read
+         */
+        uint16_t address = _address_known ? _address_pointer : GLOBAL_STATS_START_ADDRESS;
+
+        if(read_storage(address, &poll, 1) == DataManager::DATA_MANAGER_OK)
+        {
+            status = DataManager::DATA_MANAGER_OK;
+            break;
+        }
+
+        wait_us(WRITE_CYCLE_POLL_INTERVAL_US);
+    }
+
+    _polling_write_cycle = false;
+
+    _io_stats.write_cycle_polls += _io_stats.reads - start_reads;
+    _io_stats.write_cycle_poll_bytes += _io_stats.bus_bytes - start_bus_bytes;
+
+    return status;
+}
+
+/** Wait for the write cycle left in progress by a pipelined write, if any
+ *
+ * @return Indicates success or failure reason
+ */
+int DataManager::complete_write_cycle()
+{
+    if(!_write_cycle_pending)
+    {
+        return DataManager::DATA_MANAGER_OK;
+    }
+
+    /** Cleared first, as the poll is itself a transfer
+     */
+    _write_cycle_pending = false;
+
+    return wait_for_write_cycle();
+}
+
+/** Read from the EEPROM. When the read continues from the device's internal
+ *  address counter, e.g. whilst iterating entries or scanning the file table,
+ *  the address bytes are skipped by issuing a current address read
+ *
+ * @param address Address from which to read
+ * @param *data Pointer to an array in which the read data will be stored
+ * @param length Number of bytes to be read
+ * @return Indicates success or failure reason
+ */
+int DataManager::read_storage(uint16_t address, char *data, int length)
+{
+    #if DEVICE_I2C_ASYNCH
+    /** The bus belongs to the asynchronous call until it completes
+     */
+    if(_async_state != ASYNC_IDLE)
+    {
+        return DataManager_FileSystem::ASYNC_BUSY;
+    }
+    #endif /* #if DEVICE_I2C_ASYNCH */
+
+    /** The device NACKs until the write cycle of a pipelined write completes
+     */
+    if(_write_cycle_pending)
+    {
+        int status = complete_write_cycle();
+
+        if(status != DataManager::DATA_MANAGER_OK)
+        {
+            return status;
+        }
+    }
+
+    /** Not from the polls of a write cycle, which the probe would fail
+     */
+    if(_clock_probe_pending && !_polling_write_cycle)
+    {
+        probe_clock_step();
+    }
+
+    uint32_t start_ticks = DataManager_LatencyClock::now();
+
+    _io_stats.reads++;
+    _io_stats.bytes_read += length;
+
+    if(_address_known && _address_pointer == address)
+    {
+        int status = _i2c.read(EEPROM_I2C_ADDRESS, data, length);
+        record_bus_result(status);
+
+        if(status == DataManager::DATA_MANAGER_OK)
+        {
+            _address_pointer = (address + length) & EEPROM_ADDRESS_MASK;
+
+            _io_stats.sequential_reads++;
+            _io_stats.bus_bytes += CURRENT_READ_OVERHEAD_BYTES + length;
+            _io_stats.bus_bytes_saved += RANDOM_READ_OVERHEAD_BYTES - CURRENT_READ_OVERHEAD_BYTES;
+
+            #if DM_SPANS == true
+            charge_span_transfer(CURRENT_READ_OVERHEAD_BYTES + length, 0);
+            #endif /* #if DM_SPANS == true */
+
+            measure_transfer(start_ticks, CURRENT_READ_OVERHEAD_BYTES + length, 0);
+
+            return DataManager::DATA_MANAGER_OK;
+        }
+
+        /** Counter state is uncertain after a NACK, fall back to a random read
+         */
+        _address_known = false;
+        start_ticks = DataManager_LatencyClock::now();
+    }
+
+    _io_stats.bus_bytes += RANDOM_READ_OVERHEAD_BYTES + length;
+
+    #if DM_SPANS == true
+    charge_span_transfer(RANDOM_READ_OVERHEAD_BYTES + length, 0);
+    #endif /* #if DM_SPANS == true */
+
+    int status;
+
+    if(_adaptive_clock || _pipelined_writes)
+    {
+        status = bus_read(address, data, length);
+
+        /** Under the adaptive clock a failed read is retried at once up to
+         *  the attempts of the retry policy, so that the errors which step
+         *  the clock down aren't returned to the caller, and once more after
+         *  each step down. A poll of a write cycle isn't, as it is expected
+         *  to fail and its loop tries again after the poll interval
+         */
+        int attempts = 1;
+        bool stepped_down = record_bus_result(status);
+
+        while(_adaptive_clock && !_polling_write_cycle && status != DataManager::DATA_MANAGER_OK &&
+              (stepped_down || attempts < _retry_policy.attempts))
+        {
+            _io_stats.bus_bytes += RANDOM_READ_OVERHEAD_BYTES + length;
+            start_ticks = DataManager_LatencyClock::now();
+
+            status = bus_read(address, data, length);
+            attempts++;
+            stepped_down = record_bus_result(status);
+        }
+    }
+    else
+    {
+        status = _storage.read_from_address(address, data, length);
+        record_bus_result(status);
+    }
+
+    _address_known = (status == DataManager::DATA_MANAGER_OK);
+    _address_pointer = (address + length) & EEPROM_ADDRESS_MASK;
+
+    if(status == DataManager::DATA_MANAGER_OK)
+    {
+        measure_transfer(start_ticks, RANDOM_READ_OVERHEAD_BYTES + length, 0);
+    }
+
+    return status;
+}
+
+/** Write to the EEPROM under the retry policy, counting every retry and
+ *  its cost against the public call in progress
+ *
+ * @param address Address to which to write
+ * @param *data Data to be written
+ * @param length Number of bytes to be written
+ * @return Indicates success or failure reason
+ */
+int DataManager::write_with_retry(uint16_t address, char *data, int length)
+{
+    uint32_t start_us = us_ticker_read();
+    uint32_t attempt_start_us = start_us;
+    uint32_t backoff_us = _retry_policy.backoff_us;
+    int retries = 0;
+
+    int status = write_storage(address, data, length);
+
+    while(status != DataManager::DATA_MANAGER_OK && retries + 1 < _retry_policy.attempts)
+    {
+        count_bus_fault(status);
+
+        /** Arbitration is lost to another master, after which the bus is free 
+         *  again. A NACK or timeout usually means the device is still busy, 
+         *  e.g. with a write cycle, so give it time before trying again
+         */
+        if(status != DataManager::BUS_ARBITRATION_LOST && backoff_us > 0)
+        {
+            Span span(*this, DataManager_FileSystem::SPAN_RETRY_BACKOFF);
+
+            wait_us(backoff_us);
+            backoff_us = (2 * backoff_us > _retry_policy.backoff_max_us) ? _retry_policy.backoff_max_us : 2 * backoff_us;
+        }
+
+        retries++;
+        attempt_start_us = us_ticker_read();
+        status = write_storage(address, data, length);
+    }
+
+    if(retries > 0)
+    {
+        _retry_stats.total.retries += retries;
+        _retry_stats.total.retry_us += attempt_start_us - start_us;
+
+        #if DM_RETRY_STATS == true
+        _retry_stats.api[_api_op].retries += retries;
+        _retry_stats.api[_api_op].retry_us += attempt_start_us - start_us;
+        #endif /* #if DM_RETRY_STATS == true */
+    }
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        count_bus_fault(status);
+        _retry_stats.total.failures++;
+
+        #if DM_RETRY_STATS == true
+        _retry_stats.api[_api_op].failures++;
+        #endif /* #if DM_RETRY_STATS == true */
+    }
+
+    return status;
+}
+
+/** Count a failed write attempt by its cause
+ *
+ * @param status Status of the failed attempt
+ */
+void DataManager::count_bus_fault(int status)
+{
+    if(status == DataManager::BUS_ARBITRATION_LOST)
+    {
+        _retry_stats.arbitration_losses++;
+    }
+    else if(status == DataManager::BUS_TIMEOUT || status == DataManager_FileSystem::IMAGE_WRITE_CYCLE_TIMEOUT)
+    {
+        _retry_stats.timeouts++;
+    }
+    else
+    {
+        _retry_stats.nacks++;
+    }
+}
+
+/** Write to the EEPROM and track the device's internal address counter
+ *
+ * @param address Address to which to write
+ * @param *data Data to be written
+ * @param length Number of bytes to be written
+ * @return Indicates success or failure reason
+ */
+int DataManager::write_storage(uint16_t address, char *data, int length)
+{
+    #if DEVICE_I2C_ASYNCH
+    /** The bus belongs to the asynchronous call until it completes
+     */
+    if(_async_state != ASYNC_IDLE)
+    {
+        return DataManager_FileSystem::ASYNC_BUSY;
+    }
+    #endif /* #if DEVICE_I2C_ASYNCH */
+
+    if(_write_cycle_pending)
+    {
+        int status = complete_write_cycle();
+
+        if(status != DataManager::DATA_MANAGER_OK)
+        {
+            return status;
+        }
+    }
+
+    /** Not from the polls of a write cycle, which the probe would fail
+     */
+    if(_clock_probe_pending && !_polling_write_cycle)
+    {
+        probe_clock_step();
+    }
+
+    uint32_t start_ticks = DataManager_LatencyClock::now();
+
+    _io_stats.writes++;
+    _io_stats.bytes_written += length;
+    _io_stats.bus_bytes += WRITE_OVERHEAD_BYTES + length;
+
+    /** One write cycle per page the write touches
+     */
+    uint32_t write_cycles = (length > 0) ? ((address + length - 1) / PAGE_SIZE_BYTES) - (address / PAGE_SIZE_BYTES) + 1 : 0;
+    _io_stats.write_cycles += write_cycles;
+
+    #if DM_SPANS == true
+    charge_span_transfer(WRITE_OVERHEAD_BYTES + length, write_cycles);
+    #endif /* #if DM_SPANS == true */
+
+    /** The counter is tracked by bus_write() and the write cycle polls it makes
+     */
+    if(_adaptive_clock || _pipelined_writes)
+    {
+        int status = bus_write(address, data, length);
+
+        /** Writing the pages again is harmless, so a write that failed at a
+         *  rate the board can't sustain is retried at once at the slower one
+         */
+        if(record_bus_result(status))
+        {
+            _io_stats.bus_bytes += WRITE_OVERHEAD_BYTES + length;
+            start_ticks = DataManager_LatencyClock::now();
+
+            status = bus_write(address, data, length);
+            record_bus_result(status);
+        }
+
+        /** A pipelined write doesn't wait for its last write cycle
+         */
+        if(status == DataManager::DATA_MANAGER_OK)
+        {
+            uint32_t waited_cycles = (_pipelined_writes && write_cycles > 0) ? write_cycles - 1 : write_cycles;
+            measure_transfer(start_ticks, WRITE_OVERHEAD_BYTES + length, waited_cycles);
+        }
+
+        return status;
+    }
+
+    int status = _storage.write_to_address(address, data, length);
+    record_bus_result(status);
+
+    if(status == DataManager::DATA_MANAGER_OK)
+    {
+        measure_transfer(start_ticks, WRITE_OVERHEAD_BYTES + length, write_cycles);
+    }
+
+    /** The driver waits for the write cycles itself, and how it polls them 
+     *  decides where the counter ends up, so the next read is a random read
+     */
+    _address_known = false;
+
+    return status;
+}
+
+/** Random read made directly on the bus, used by the adaptive clock
+ *
+ * @param address Address from which to read
+ * @param *data Pointer to an array in which the read data will be stored
+ * @param length Number of bytes to be read
+ * @return Indicates success or failure reason
+ */
+int DataManager::bus_read(uint16_t address, char *data, int length)
+{
+    _bus_tx[0] = (char)(address >> 8);
+    _bus_tx[1] = (char)(address & 0xFF);
+
+    int status = _i2c.write(EEPROM_I2C_ADDRESS, _bus_tx, 2, true);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        _i2c.stop();
+        return status;
+    }
+
+    return _i2c.read(EEPROM_I2C_ADDRESS, data, length);
+}
+
+/** Page write made directly on the bus, used by the adaptive clock and
+ *  pipelined writes. Writes are split at page boundaries and each write 
+ *  cycle is waited for, except that of the last page of a pipelined write
+ *
+ * @param address Address to which to write
+ * @param *data Data to be written
+ * @param length Number of bytes to be written
+ * @return Indicates success or failure reason
+ */
+int DataManager::bus_write(uint16_t address, char *data, int length)
+{
+    _address_known = false;
+
+    for(int written = 0; written < length; )
+    {
+        uint16_t chunk_address = address + written;
+        int chunk = PAGE_SIZE_BYTES - (chunk_address % PAGE_SIZE_BYTES);
+
+        if(chunk > length - written)
+        {
+            chunk = length - written;
+        }
+
+        _bus_tx[0] = (char)(chunk_address >> 8);
+        _bus_tx[1] = (char)(chunk_address & 0xFF);
+        memcpy(&_bus_tx[2], &data[written], chunk);
+
+        _write_control = 0;
+        int status = _i2c.write(EEPROM_I2C_ADDRESS, _bus_tx, 2 + chunk);
+        _write_control = 1;
+
+        if(status != DataManager::DATA_MANAGER_OK)
+        {
+            return status;
+        }
+
+        written += chunk;
+
+        uint16_t last = chunk_address + chunk - 1;
+
+        _address_known = true;
+        _address_pointer = (last & ~(PAGE_SIZE_BYTES - 1)) | ((last + 1) & (PAGE_SIZE_BYTES - 1));
+
+        if(_pipelined_writes && written == length)
+        {
+            _write_cycle_pending = true;
+            break;
+        }
+
+        status = wait_for_write_cycle();
+
+        if(status != DataManager::DATA_MANAGER_OK)
+        {
+            return status;
+        }
+    }
+
+    return DataManager::DATA_MANAGER_OK;
+}
+
+/** Count the outcome of a transfer towards the adaptive clock's current 
+ *  window and step the clock down or up at the end of the window
+ *
+ * @param status Status of the transfer
+ * @return True if the transfer failed and stepped the clock down, so
+ *         it is worth retrying once at the slower rate
+ */
+bool DataManager::record_bus_result(int status)
+{
+    if(!_adaptive_clock || _polling_write_cycle)
+    {
+        return false;
+    }
+
+    _clock_stats.transfers++;
+    _window.transfers++;
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        _clock_stats.errors++;
+        _window.errors++;
+    }
+
+    bool step_down = _window.errors > ADAPTIVE_CLOCK_MAX_ERRORS;
+
+    if(!step_down && _window.transfers < ADAPTIVE_CLOCK_WINDOW)
+    {
+        return false;
+    }
+
+    _clock_stats.history[_history_next] = _window;
+    _history_next = (_history_next + 1) % ADAPTIVE_CLOCK_HISTORY;
+
+    if(_clock_stats.windows < ADAPTIVE_CLOCK_HISTORY)
+    {
+        _clock_stats.windows++;
+    }
+
+    _clean_windows = (_window.errors == 0) ? _clean_windows + 1 : 0;
+
+    if(step_down && _clock_step < ADAPTIVE_CLOCK_RATE_STEPS - 1)
+    {
+        _clock_stats.step_downs++;
+        set_clock_step(_clock_step + 1);
+
+        return true;
+    }
+
+    if(_clean_windows >= ADAPTIVE_CLOCK_PROBE_WINDOWS && _clock_step > 0)
+    {
+        /** The faster rate is probed before the next transfer, when the 
+         *  device is known to be out of any write cycle
+         */
+        _clock_stats.step_ups++;
+        set_clock_step(_clock_step - 1);
+        _clock_probe_pending = true;
+    }
+    else
+    {
+        _window.transfers = 0;
+        _window.errors = 0;
+    }
+
+    return false;
+}
+
+/** Check that the adaptive clock's rate works before it is used by 
+ *  making ADAPTIVE_CLOCK_PROBE_READS reads, stepping down until they
+ *  all succeed or the slowest rate is reached. The device must not
+ *  be in a write cycle
+ */
+void DataManager::probe_clock_step()
 {
-    DataManager_FileSystem::File_t file;
+    _clock_probe_pending = false;
 
-    int status = get_file_by_name(filename, file);
+    char probe;
 
-    if(status != DataManager::DATA_MANAGER_OK)
+    for(int read = 0; read < ADAPTIVE_CLOCK_PROBE_READS; read++)
     {
-        return status;
+        _io_stats.bus_bytes += RANDOM_READ_OVERHEAD_BYTES + sizeof(probe);
+
+        if(bus_read(GLOBAL_STATS_START_ADDRESS, &probe, sizeof(probe)) == DataManager::DATA_MANAGER_OK)
+        {
+            continue;
+        }
+
+        _clock_stats.failed_probes++;
+
+        if(_clock_step == ADAPTIVE_CLOCK_RATE_STEPS - 1)
+        {
+            break;
+        }
+
+        _clock_stats.step_downs++;
+        set_clock_step(_clock_step + 1);
+        read = -1;
     }
 
-    int remaining_length = (file.parameters.file_end_address + 1) 
-                          - file.parameters.next_available_address;
+    _address_known = false;
+}
 
-    remaining_entries = remaining_length / file.parameters.length_bytes;
+/** Apply a rate from the adaptive clock's ladder
+ *
+ * @param step Index into ADAPTIVE_CLOCK_RATES_HZ
+ */
+void DataManager::set_clock_step(int step)
+{
+    static const int rates_hz[ADAPTIVE_CLOCK_RATE_STEPS] = ADAPTIVE_CLOCK_RATES_HZ;
 
-    return DataManager::DATA_MANAGER_OK;
+    _clock_step = step;
+    _clean_windows = 0;
+
+    _window.frequency_hz = rates_hz[step];
+    _window.transfers = 0;
+    _window.errors = 0;
+
+    _clock_stats.frequency_hz = rates_hz[step];
+    _i2c.frequency(rates_hz[step]);
 }
 
-/** Calculate remaining space for entries in bytes
+/** Return the largest number of scratch arena bytes borrowed at once since
+ *  construction or the last reset, so that DM_SCRATCH_ARENA_BYTES can be sized
  *
- * @param filename ID of the file to be queried
- * @param &remaining_entries Address of integer value to which the amount
- *                           of remaining space should be stored
- * @return Indicates success or failure reason
+ *  @return Peak scratch arena usage in bytes
  */
-int DataManager::get_remaining_file_entries_bytes(uint8_t filename, int &remaining_bytes)
+int DataManager::get_scratch_peak_bytes()
 {
-    DataManager_FileSystem::File_t file;
+    return _scratch_peak;
+}
 
-    int status = get_file_by_name(filename, file);
+/** Reset the peak scratch arena usage to the current usage
+ */
+void DataManager::reset_scratch_peak()
+{
+    _scratch_peak = _scratch_used;
+}
 
-    if(status != DataManager::DATA_MANAGER_OK)
-    {
-        return status;
-    }
+/** Get the bus traffic counters accumulated since construction or the
+ *  last reset, including the bytes saved by current address reads
+ *
+ * @param &stats Address of IoStats_t to which counters will be written
+ */
+void DataManager::get_io_stats(IoStats_t &stats)
+{
+    stats = _io_stats;
+}
 
-    remaining_bytes = (file.parameters.file_end_address + 1) 
-                     - file.parameters.next_available_address;
+/** Reset all bus traffic counters to zero
+ */
+void DataManager::reset_io_stats()
+{
+    memset(&_io_stats, 0, sizeof(_io_stats));
+}
 
-    return DataManager::DATA_MANAGER_OK;
+/** Get the device timing measured so far, used by estimate_cost()
+ *
+ * @param &timing Address of DeviceTiming_t to which the timing will be written
+ */
+void DataManager::get_device_timing(DeviceTiming_t &timing)
+{
+    timing = _timing;
 }
 
-/** Set global next address and space remaining counters
+/** Enable or disable the adaptive bus clock. When enabled, all transfers are
+ *  made by the DataManager on its own I2C object, starting at the fastest
+ *  rate. The clock steps down when a window of transfers sees more than
+ *  ADAPTIVE_CLOCK_MAX_ERRORS errors, and the transfer that stepped it 
+ *  down is retried once at the slower rate. After ADAPTIVE_CLOCK_PROBE_WINDOWS
+ *  clean windows it tries one step back up. The fastest rate and each
+ *  step back up are first probed with ADAPTIVE_CLOCK_PROBE_READS reads,
+ *  so a rate the board can't sustain fails reads of its own rather than
+ *  the caller's. When disabled, transfers return to the EEPROM driver at
+ *  the frequency given to the constructor
  *
- * @param data Byte array containing data to write to global stats counters
- * @return Indicates success or failure reason
+ * @param enabled True to enable the adaptive clock, false to disable it
  */
-int DataManager::set_global_stats(char *data)
+void DataManager::set_adaptive_clock(bool enabled)
 {
-    int status = -1;
-    for(int i=0; i<NUM_OF_WRITE_RETRIES && status!= DataManager::DATA_MANAGER_OK; i++)
+    _adaptive_clock = enabled;
+    _history_next = 0;
+
+    memset(&_clock_stats, 0, sizeof(_clock_stats));
+
+    _clock_probe_pending = enabled;
+
+    if(enabled)
     {
-        status = _storage.write_to_address(GLOBAL_STATS_START_ADDRESS, data, GLOBAL_STATS_LENGTH);
+        set_clock_step(0);
+        return;
     }
-    if(status != DataManager::DATA_MANAGER_OK)
+
+    _clock_step = 0;
+    _clean_windows = 0;
+    _clock_stats.frequency_hz = _frequency_hz;
+    _i2c.frequency(_frequency_hz);
+}
+
+/** Enable or disable pipelined writes. When enabled, all transfers are
+ *  made by the DataManager on its own I2C object and a write returns as 
+ *  soon as its last page has been sent. The write cycle of that page is
+ *  waited for by the next transfer, so that work done in the meantime, 
+ *  e.g. encoding, checksumming or compressing the next page, overlaps it
+ *  rather than following it. Whilst enabled, the write cycle time used by
+ *  estimate_cost() is only measured between the pages of a write that
+ *  spans pages. Disabling waits for any write cycle still in progress
+ *
+ * @param enabled True to enable pipelined writes, false to disable them
+ */
+void DataManager::set_pipelined_writes(bool enabled)
+{
+    if(!enabled)
     {
-        return status;
+        complete_write_cycle();
     }
-    return DataManager::DATA_MANAGER_OK;
+
+    _pipelined_writes = enabled;
 }
 
-/** Perform checksum on given File_t using the 'valid' parameter
+/** Get the current bus clock and the error history of the adaptive clock
  *
- * @param type File to be checked for validity
- * @return True if file is valid, else false
+ * @param &stats Address of ClockStats_t to which the state will be written
  */
-bool DataManager::is_valid_file(DataManager_FileSystem::File_t file)
+void DataManager::get_clock_stats(ClockStats_t &stats)
 {
-    /** During init_filesystem() we set every bit in the file table to 0
-     *  so, if the valid byte == 0, this can't be a valid entry
-     */
-    if(file.parameters.valid == 0x00)
+    stats = _clock_stats;
+
+    for(int window = 0; window < _clock_stats.windows; window++)
     {
-        return false;
+        int index = (_history_next - 1 - window + ADAPTIVE_CLOCK_HISTORY) % ADAPTIVE_CLOCK_HISTORY;
+        stats.history[window] = _clock_stats.history[index];
     }
-    
-    /** Mask the first 24 bits so that we can use our 8-bit valid flag as a rudimentary checksum 
-     *  of the length and type id. The checksum is OR'd with 1 so that our value can never = 0
-     */
-    uint32_t checksum = ((file.parameters.filename + file.parameters.length_bytes + file.parameters.file_start_address +
-                         file.parameters.file_end_address + file.parameters.next_available_address) | 1) & 0x000000FF;
+}
+
+/** Set the retry policy used by every write
+ *
+ * @param &policy The new policy; attempts below one are treated as one
+ */
+void DataManager::set_retry_policy(const RetryPolicy_t &policy)
+{
+    _retry_policy = policy;
 
-    if(file.parameters.valid != checksum)
+    if(_retry_policy.attempts < 1)
     {
-        return false;
+        _retry_policy.attempts = 1;
     }
+}
 
-    return true;
+/** Get the failed write attempts and retries counted since construction
+ *  or the last reset
+ *
+ * @param &stats Address of RetryStats_t to which counters will be written
+ */
+void DataManager::get_retry_stats(RetryStats_t &stats)
+{
+    stats = _retry_stats;
 }
 
-/** Determine the next available address to which to write file
+/** Reset all retry counters to zero
+ */
+void DataManager::reset_retry_stats()
+{
+    memset(&_retry_stats, 0, sizeof(_retry_stats));
+}
+
+#if DM_LATENCY_HISTOGRAMS == true
+/** Get the latency histogram of a public call type since construction or
+ *  the last reset
  *
- * @param &next_available_address Address of integer value in which the address
- *                                of the next available location in memory to which
- *                                you can write a file is stored. -1 if 
- *                                there are no available spaces
- * @return Indicates success or failure reason
+ * @param op The call type
+ * @param &histogram Address of LatencyHistogram_t to which the histogram will be written
  */
-int DataManager::get_next_available_file_table_address(int &next_available_address)
+void DataManager::get_latency_histogram(DataManager_FileSystem::TraceOp op, LatencyHistogram_t &histogram)
 {
-    DataManager_FileSystem::File_t file;
-    int file_size = sizeof(file);
-    
-    uint16_t max_files = get_max_files();
+    histogram = _latency[op];
+}
 
-    for(uint16_t file_index = 0; file_index < max_files; file_index++)
-    {
-        int address = FILE_TABLE_START_ADDRESS + (file_index * file_size);
-        int status = _storage.read_from_address(address, file.data, file_size);
+/** Reset the latency histograms of all call types
+ */
+void DataManager::reset_latency_histograms()
+{
+    memset(_latency, 0, sizeof(_latency));
+}
+#endif /* #if DM_LATENCY_HISTOGRAMS == true */
 
-        if(status != DataManager::DATA_MANAGER_OK)
-        {
-            return status;
-        }
+#if DM_ENERGY_MODEL == true
+/** Set the figures from which the energy of each call is estimated
+ *
+ * @param &model The new model
+ */
+void DataManager::set_energy_model(const EnergyModel_t &model)
+{
+    _energy_model = model;
+}
 
-        if(!is_valid_file(file))
-        {
-            next_available_address = address;
-            break;
-        }
-    }
+/** Get the energy estimated since construction or the last reset
+ *
+ * @param &stats Address of EnergyStats_t to which counters will be written
+ */
+void DataManager::get_energy_stats(EnergyStats_t &stats)
+{
+    stats = _energy_stats;
+}
 
-    return DataManager::DATA_MANAGER_OK;
+/** Reset all energy counters to zero
+ */
+void DataManager::reset_energy_stats()
+{
+    memset(&_energy_stats, 0, sizeof(_energy_stats));
 }
+#endif /* #if DM_ENERGY_MODEL == true */
 
-/** Modify a file's metadata
+#if DM_SPANS == true
+/** Copy the nodes of the span tree, in the order they were first reached.
+ *  Once all DM_SPAN_NODES nodes are in use, or DM_SPAN_DEPTH levels deep,
+ *  new frames are charged to their parent
  *
- * @param filename ID of file to be modified
- * @param file Updated version of file
- * @return Indicates success or failure reason
+ * @param *nodes Array to which the nodes will be written
+ * @param max_nodes Length of the nodes array
+ * @param &count Address of integer value to which the number of nodes written will be stored
  */
-int DataManager::modify_file(uint8_t filename, DataManager_FileSystem::File_t file)
+void DataManager::get_spans(SpanNode_t *nodes, int max_nodes, int &count)
 {
-    uint16_t max_files = get_max_files();
-    int file_size = sizeof(file);
-    
-    bool match = false;
-    uint16_t address;
+    for(count = 0; count < _span_count && count < max_nodes; count++)
+    {
+        nodes[count] = _spans[count];
+    }
+}
 
-    DataManager_FileSystem::File_t read_file;
+/** Discard the span tree
+ */
+void DataManager::reset_spans()
+{
+    /** Nodes in progress are kept, but their costs restart from zero
+     */
+    for(int node = 0; node < _span_depth; node++)
+    {
+        SpanNode_t &span = _spans[_span_stack[node]];
+
+        _spans[node] = span;
+        _spans[node].parent = node - 1;
+        _spans[node].calls = 1;
+        _spans[node].time_us = 0;
+        _spans[node].bus_bytes = 0;
+        _spans[node].transfers = 0;
+        _spans[node].write_cycles = 0;
+        _span_stack[node] = node;
+    }
 
-    for(uint16_t file_index = 0; file_index < max_files; file_index++)
+    _span_count = _span_depth;
+
+    if(_span_depth > 0)
+    {
+        _span_mark_ticks = DataManager_LatencyClock::now();
+    }
+}
+
+/** Print one cost of the span tree over UART as collapsed stacks, i.e. one
+ *  line of semicolon separated frames and the cost of the innermost frame
+ *  for each node with a non-zero cost, as read by flamegraph.pl
+ *
+ * @param metric The cost to print
+ */
+void DataManager::dump_spans(DataManager_FileSystem::SpanMetric metric)
+{
+    charge_span_time();
+
+    for(int node = 0; node < _span_count; node++)
     {
-        address = FILE_TABLE_START_ADDRESS + (file_index * file_size);
-        int status = _storage.read_from_address(address, read_file.data, file_size);
+        const SpanNode_t &span = _spans[node];
+        uint32_t cost = span.time_us;
 
-        if(status != DataManager::DATA_MANAGER_OK)
+        if(metric == DataManager_FileSystem::SPAN_BUS_BYTES)
         {
-            return status;
+            cost = span.bus_bytes;
+        }
+        else if(metric == DataManager_FileSystem::SPAN_TRANSFERS)
+        {
+            cost = span.transfers;
+        }
+        else if(metric == DataManager_FileSystem::SPAN_WRITE_CYCLES)
+        {
+            cost = span.write_cycles;
         }
 
-        if(!is_valid_file(read_file))
+        if(cost == 0)
         {
             continue;
         }
 
-        if(filename == read_file.parameters.filename)
+        /** Parents are always reached before their children, so walk up to 
+         *  the root and print the frames back down
+         */
+        int16_t path[DM_SPAN_DEPTH];
+        int depth = 0;
+
+        for(int16_t frame = node; frame >= 0 && depth < DM_SPAN_DEPTH; frame = _spans[frame].parent)
         {
-            match = true;
-            break;
+            path[depth++] = frame;
+        }
+
+        while(depth > 0)
+        {
+            depth--;
+            debug("%s%c", DataManager_FileSystem::span_frame_name(_spans[path[depth]].frame), depth > 0 ? ';' : ' ');
         }
+
+        debug("%lu\r\n", (unsigned long)cost);
     }
+}
+#endif /* #if DM_SPANS == true */
+
+#if DM_TRACE == true
+/** Copy the recorded calls, oldest first, out of the trace ring. The ring
+ *  keeps the most recent DM_TRACE_ENTRIES calls
+ *
+ * @param *records Array to which the records will be written
+ * @param max_records Length of the records array
+ * @param &count Address of integer value to which the number of records written will be stored
+ */
+void DataManager::get_trace(DataManager_FileSystem::TraceRecord_t *records, int max_records, int &count)
+{
+    int oldest = (_trace_next + DM_TRACE_ENTRIES - _trace_count) % DM_TRACE_ENTRIES;
 
-    if(!match)
+    for(count = 0; count < _trace_count && count < max_records; count++)
     {
-        return DataManager_FileSystem::FILE_INVALID_NAME;
+        records[count] = _trace[(oldest + count) % DM_TRACE_ENTRIES];
     }
-    int status = -1;
-    for(int i=0; i<NUM_OF_WRITE_RETRIES && status!= DataManager::DATA_MANAGER_OK; i++)
+}
+
+/** Discard all recorded calls
+ */
+void DataManager::clear_trace()
+{
+    _trace_next = 0;
+    _trace_count = 0;
+}
+
+/** Print the recorded calls, oldest first, over UART as one TRACE_LINE_PREFIX
+ *  line of hex encoded record bytes each, for the host replay tool
+ */
+void DataManager::dump_trace()
+{
+    int oldest = (_trace_next + DM_TRACE_ENTRIES - _trace_count) % DM_TRACE_ENTRIES;
+
+    for(int record = 0; record < _trace_count; record++)
     {
-        status = _storage.write_to_address(address, file.data, file_size);
+        const char *data = _trace[(oldest + record) % DM_TRACE_ENTRIES].data;
+
+        debug("%s ", DataManager_FileSystem::TRACE_LINE_PREFIX);
+
+        for(size_t byte = 0; byte < sizeof(DataManager_FileSystem::TraceRecord_t); byte++)
+        {
+            debug("%02X", (uint8_t)data[byte]);
+        }
+
+        debug("\r\n");
     }
-    if(status != DataManager::DATA_MANAGER_OK)
+}
+
+/** Add a completed call to the trace ring, overwriting the oldest record
+ *  once the ring is full
+ *
+ * @param record The call to add
+ */
+void DataManager::record_trace(const DataManager_FileSystem::TraceRecord_t &record)
+{
+    _trace[_trace_next] = record;
+    _trace_next = (_trace_next + 1) % DM_TRACE_ENTRIES;
+
+    if(_trace_count < DM_TRACE_ENTRIES)
     {
-        return status;
+        _trace_count++;
     }
-    
-    
-    return DataManager::DATA_MANAGER_OK;
 }
+#endif /* #if DM_TRACE == true */
 
 #if DM_DBG == true
 /** Utility function to print a File_t over UART
@@ -834,4 +5457,69 @@ void DataManager::print_global_stats(DataManager_FileSystem::GlobalStats_t g_sta
     debug("Next_available_address: %u\r\n", g_stats.parameters.next_available_address);
     debug("---END PRINT GLOBAL STATS\r\n");
 }
+
+#if DM_LATENCY_HISTOGRAMS == true
+/** Utility function to print the latency histogram of every call type
+ *  that has been made over UART
+ */
+void DataManager::print_latency_histograms()
+{
+    debug("---PRINT LATENCY HISTOGRAMS---\r\n");
+
+    for(int op = 1; op < DataManager_FileSystem::TRACE_OPS; op++)
+    {
+        const LatencyHistogram_t &histogram = _latency[op];
+
+        if(histogram.calls == 0)
+        {
+            continue;
+        }
+
+        debug("%s: calls %lu, mean %lu us, max %lu us\r\n", DataManager_FileSystem::TRACE_OP_NAMES[op], 
+              (unsigned long)histogram.calls, (unsigned long)(histogram.total_us / histogram.calls), 
+              (unsigned long)histogram.max_us);
+
+        for(int bucket = 0; bucket < DM_LATENCY_BUCKETS; bucket++)
+        {
+            if(histogram.buckets[bucket] > 0)
+            {
+                debug("  >= %lu us: %lu\r\n", bucket == 0 ? 0UL : (1UL << bucket), 
+                      (unsigned long)histogram.buckets[bucket]);
+            }
+        }
+    }
+
+    debug("---END PRINT LATENCY HISTOGRAMS---\r\n");
+}
+#endif /* #if DM_LATENCY_HISTOGRAMS == true */
+
+#if DM_ENERGY_MODEL == true
+/** Utility function to print the estimated energy of every call type 
+ *  that has been made over UART
+ */
+void DataManager::print_energy_stats()
+{
+    debug("---PRINT ENERGY STATS---\r\n");
+
+    for(int op = 0; op < DataManager_FileSystem::TRACE_OPS; op++)
+    {
+        const EnergyCounts_t &counts = (op == 0) ? _energy_stats.total : _energy_stats.api[op];
+
+        if(counts.calls == 0)
+        {
+            continue;
+        }
+
+        uint64_t total_nj = counts.mcu_nj + counts.bus_nj + counts.write_nj;
+
+        debug("%s: calls %lu, total %lu uJ (MCU %lu, bus %lu, write cycles %lu), mean %lu nJ\r\n", 
+              (op == 0) ? "all calls" : DataManager_FileSystem::TRACE_OP_NAMES[op], (unsigned long)counts.calls,
+              (unsigned long)(total_nj / 1000), (unsigned long)(counts.mcu_nj / 1000), 
+              (unsigned long)(counts.bus_nj / 1000), (unsigned long)(counts.write_nj / 1000), 
+              (unsigned long)(total_nj / counts.calls));
+    }
+
+    debug("---END PRINT ENERGY STATS---\r\n");
+}
+#endif /* #if DM_ENERGY_MODEL == true */
 #endif // #if DM_DBG == true
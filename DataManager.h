@@ -15,28 +15,157 @@
  */
 #define DM_DBG true
 
+/** Set to true to record every public call in a RAM ring of DM_TRACE_ENTRIES
+ *  records that can be dumped over UART and replayed on the host
+ */
+#ifndef DM_TRACE
+    #define DM_TRACE false
+#endif /* #ifndef DM_TRACE */
+
+#ifndef DM_TRACE_ENTRIES
+    #define DM_TRACE_ENTRIES 128
+#endif /* #ifndef DM_TRACE_ENTRIES */
+
+/** Set to true to keep a latency histogram of each public call with 
+ *  DM_LATENCY_BUCKETS log2 buckets of microseconds. Costs two clock reads 
+ *  per call and (16 + 4 * DM_LATENCY_BUCKETS) bytes of RAM per call type
+ */
+#ifndef DM_LATENCY_HISTOGRAMS
+    #define DM_LATENCY_HISTOGRAMS false
+#endif /* #ifndef DM_LATENCY_HISTOGRAMS */
+
+#ifndef DM_LATENCY_BUCKETS
+    #define DM_LATENCY_BUCKETS 20
+#endif /* #ifndef DM_LATENCY_BUCKETS */
+
+/** Set to true to charge the bus bytes, transfers, write cycles and time of
+ *  each call to a tree of its nested public calls and internal phases, kept
+ *  in DM_SPAN_NODES nodes of 24 bytes and DM_SPAN_DEPTH levels, and printed
+ *  as collapsed stacks for a flame graph by dump_spans()
+ */
+#ifndef DM_SPANS
+    #define DM_SPANS false
+#endif /* #ifndef DM_SPANS */
+
+/** Set to true to estimate the energy of each public call from its duration,
+ *  bus traffic and write cycles under an EnergyModel_t, accumulated per call
+ *  type in 32 bytes of RAM each
+ */
+#ifndef DM_ENERGY_MODEL
+    #define DM_ENERGY_MODEL false
+#endif /* #ifndef DM_ENERGY_MODEL */
+
+/** Set to true to count retries and failed writes per public call type as
+ *  well as in total, at a cost of 12 bytes of RAM per call type
+ */
+#ifndef DM_RETRY_STATS
+    #define DM_RETRY_STATS false
+#endif /* #ifndef DM_RETRY_STATS */
+
+#ifndef DM_SPAN_NODES
+    #define DM_SPAN_NODES 64
+#endif /* #ifndef DM_SPAN_NODES */
+
+#ifndef DM_SPAN_DEPTH
+    #define DM_SPAN_DEPTH 8
+#endif /* #ifndef DM_SPAN_DEPTH */
+
 /** Includes 
  */
 #include <mbed.h>
 #include "DataManager_FileSystem.h"
 
+#include "DataManager_Layout.h"
+#include "DataManager_BitPacking.h"
+#include "DataManager_Compression.h"
+#include "DataManager_Trace.h"
+#include "DataManager_Span.h"
+#include "DataManager_LatencyClock.h"
+
 /** Include specific drivers dependent on target */
 #if BOARD == DEVELOPMENT_BOARD_V1_1_0 || BOARD == WRIGHT_V1_0_0 || BOARD == EARHART_V1_0_0
     #include "STM24256.h"
     #define NUM_OF_WRITE_RETRIES       3
+    #define EEPROM_I2C_ADDRESS         0xA0
+
+    #define WRITE_CYCLE_POLL_ATTEMPTS    50
+    #define WRITE_CYCLE_POLL_INTERVAL_US 200
 
-    #define PAGES                      500
-    #define PAGE_SIZE_BYTES            64
-    #define EEPROM_SIZE_BYTES          32000
-    #define GLOBAL_STATS_START_ADDRESS 0
-    #define GLOBAL_STATS_LENGTH        8
-    #define FILE_TABLE_PAGES           7
-    #define FILE_TABLE_START_ADDRESS   GLOBAL_STATS_LENGTH
-    #define FILE_TABLE_LENGTH          ((PAGE_SIZE_BYTES * FILE_TABLE_PAGES) - GLOBAL_STATS_LENGTH)
-    #define STORAGE_START_ADDRESS      FILE_TABLE_LENGTH + GLOBAL_STATS_LENGTH
-    #define STORAGE_LENGTH             ((PAGES * PAGE_SIZE_BYTES) - (STORAGE_START_ADDRESS))
+    /** Default retry policy of writes: the delay before the first retry after
+     *  a NACK or timeout, doubled for each further retry up to the length of
+     *  a write cycle. NUM_OF_WRITE_RETRIES is the number of attempts
+     */
+    #define RETRY_BACKOFF_US             200
+    #define RETRY_BACKOFF_MAX_US         5000
+
+    /** Bytes of overhead, i.e. device address and two address bytes, paid by
+     *  every random read. Channel projections read whole rows when the bytes
+     *  of other channels skipped between samples cost no more than this
+     */
+    #define RANDOM_READ_OVERHEAD_BYTES   4
+
+    /** Bytes of overhead paid by a current address read, i.e. the device address
+     *  only, and by a write, i.e. device address and two address bytes. The 
+     *  internal address counter wraps at EEPROM_ADDRESS_MASK
+     */
+    #define CURRENT_READ_OVERHEAD_BYTES  1
+    #define WRITE_OVERHEAD_BYTES         3
+    #define EEPROM_ADDRESS_MASK          0x7FFF
+
+    /** Default energy model: supply voltage, MCU run current, EEPROM supply 
+     *  current whilst clocking the bus and during an internal write cycle, the
+     *  write cycle time tW and bus clocks per byte, i.e. 8 bits and an ACK
+     */
+    #define ENERGY_SUPPLY_MV             3300
+    #define ENERGY_MCU_ACTIVE_UA         5000
+    #define ENERGY_EEPROM_ACTIVE_UA      2000
+    #define ENERGY_EEPROM_WRITE_UA       1000
+    #define ENERGY_WRITE_CYCLE_US        5000
+    #define BUS_CLOCKS_PER_BYTE          9
+
+    /** Weight of the newest transfer in the measured device timing, as the
+     *  reciprocal, i.e. each transfer moves the timing 1/8 of the way
+     */
+    #define TIMING_SMOOTHING             8
+
+    /** Adaptive clock: rates tried from fastest to slowest, number of transfers
+     *  per evaluation window, errors in a window above which the clock steps 
+     *  down, clean windows after which it probes one step back up, number 
+     *  of windows kept in the error history and number of reads that must
+     *  all succeed before a rate is used
+     */
+    #define ADAPTIVE_CLOCK_RATES_HZ      { 1000000, 400000, 100000 }
+    #define ADAPTIVE_CLOCK_RATE_STEPS    3
+    #define ADAPTIVE_CLOCK_WINDOW        64
+    #define ADAPTIVE_CLOCK_MAX_ERRORS    2
+    #define ADAPTIVE_CLOCK_PROBE_WINDOWS 16
+    #define ADAPTIVE_CLOCK_HISTORY       8
+    #define ADAPTIVE_CLOCK_PROBE_READS   4
+
+    /** Number of RLE files whose current run is held in RAM at once, the longest
+     *  value they may store, the number of checkpoints in each run index and the
+     *  number of values added to the current run between writes of its length
+     */
+    #define RLE_MAX_OPEN_FILES           4
+    #define RLE_MAX_VALUE_BYTES          8
+    #define RLE_INDEX_ENTRIES            8
+    #define RLE_SYNC_INTERVAL            16
+
+    /** Length of the header in front of each compressed block in an archive and
+     *  the number of checkpoints in the block index of the open archive
+     */
+    #define ARCHIVE_BLOCK_HEADER_BYTES   2
+    #define ARCHIVE_INDEX_ENTRIES        8
 #endif /* #if BOARD == ... */
 
+/** Size of the static scratch arena from which internal operations borrow their
+ *  transfer buffers. The default covers compress_sealed_pages(), the deepest 
+ *  user; get_scratch_peak_bytes() reports what an application actually needs
+ */
+#ifndef DM_SCRATCH_ARENA_BYTES
+    #define DM_SCRATCH_ARENA_BYTES     ((3 * PAGE_SIZE_BYTES) + ARCHIVE_BLOCK_HEADER_BYTES)
+#endif /* #ifndef DM_SCRATCH_ARENA_BYTES */
+
 /** Base class for the Data Manager
  */ 
 class DataManager
@@ -49,7 +178,222 @@ class DataManager
             DATA_MANAGER_OK = 0
         };
 
+        /** Statuses of a failed transfer that the retry policy tells apart. Drivers
+         *  that can't tell the causes apart report any other non-zero status, 
+         *  which is treated as a NACK
+         */
+        enum
+        {
+            BUS_NACK             = 1,
+            BUS_ARBITRATION_LOST = 2,
+            BUS_TIMEOUT          = 3
+        };
+
+        /** Counters describing the effectiveness and cost of page compression
+         */
+        struct CompressionStats_t
+        {
+            uint32_t raw_bytes;
+            uint32_t stored_bytes;
+            uint32_t encode_us;
+            uint32_t decode_us;
+            uint32_t write_cycles;
+            int32_t bytes_reclaimed;
+        };
+
+        /** Counters describing the traffic on the EEPROM bus. The reads and
+         *  bus bytes of the write cycle polls made by the DataManager, rather
+         *  than by the driver, are also counted on their own
+         */
+        struct IoStats_t
+        {
+            uint32_t reads;
+            uint32_t sequential_reads;
+            uint32_t writes;
+            uint32_t bytes_read;
+            uint32_t bytes_written;
+            uint32_t bus_bytes;
+            uint32_t bus_bytes_saved;
+            uint32_t write_cycles;
+            uint32_t write_cycle_polls;
+            uint32_t write_cycle_poll_bytes;
+        };
+
+        /** Bus clock and outcome of one evaluation window of the adaptive clock
+         */
+        struct ClockWindow_t
+        {
+            uint32_t frequency_hz;
+            uint16_t transfers;
+            uint16_t errors;
+        };
+
+        /** Current bus clock, error counters and the most recent evaluation 
+         *  windows of the adaptive clock, most recent first
+         */
+        struct ClockStats_t
+        {
+            uint32_t frequency_hz;
+            uint32_t transfers;
+            uint32_t errors;
+            uint32_t step_downs;
+            uint32_t step_ups;
+            uint32_t failed_probes;
+            int windows;
+            ClockWindow_t history[ADAPTIVE_CLOCK_HISTORY];
+        };
+
+        /** Number of attempts made at each write and the backoff between them.
+         *  Arbitration losses are retried at once, NACKs and timeouts after a 
+         *  delay that starts at backoff_us and doubles up to backoff_max_us
+         */
+        struct RetryPolicy_t
+        {
+            int attempts;
+            uint32_t backoff_us;
+            uint32_t backoff_max_us;
+        };
+
+        /** Retries made, time spent on failed attempts and backoff before the 
+         *  final attempt and writes that failed after all attempts
+         */
+        struct RetryCounts_t
+        {
+            uint32_t retries;
+            uint32_t retry_us;
+            uint32_t failures;
+        };
+
+        /** Failed write attempts by cause and retry counts in total and, with
+         *  DM_RETRY_STATS, per public call, indexed by TraceOp. Index 0 counts
+         *  writes made outside of any call
+         */
+        struct RetryStats_t
+        {
+            uint32_t nacks;
+            uint32_t arbitration_losses;
+            uint32_t timeouts;
+            RetryCounts_t total;
+            #if DM_RETRY_STATS == true
+            RetryCounts_t api[DataManager_FileSystem::TRACE_OPS];
+            #endif /* #if DM_RETRY_STATS == true */
+        };
+
+        /** Latency of one public call type. Bucket 0 counts calls shorter than 
+         *  2 us, bucket b calls of 2^b to 2^(b+1) us and the last bucket all 
+         *  longer calls
+         */
+        struct LatencyHistogram_t
+        {
+            uint32_t calls;
+            uint32_t max_us;
+            uint64_t total_us;
+            uint32_t buckets[DM_LATENCY_BUCKETS];
+        };
+
+        /** Work that one call of a resumable operation may do: time spent and
+         *  write cycles made. A limit of 0 is no limit, and every call makes
+         *  at least one step
+         */
+        struct OperationBudget_t
+        {
+            uint32_t time_us;
+            uint32_t write_cycles;
+        };
+
+        /** Arguments of a call whose cost is estimated. index is the first entry
+         *  of a read or the entries to remove of a truncation, count the number
+         *  of entries read and length the data length of a write
+         */
+        struct CostParams_t
+        {
+            int index;
+            int count;
+            int length;
+        };
+
+        /** Predicted cost of a call
+         */
+        struct CostEstimate_t
+        {
+            uint32_t transfers;
+            uint32_t bus_bytes;
+            uint32_t write_cycles;
+            uint32_t time_us;
+        };
+
+        /** Device timing measured from completed transfers: bus time per byte,
+         *  including the ACK, and the time of a write cycle
+         */
+        struct DeviceTiming_t
+        {
+            uint32_t bus_byte_ns;
+            uint32_t write_cycle_us;
+        };
+
+        /** Datasheet figures from which the energy of a call is estimated. The
+         *  MCU draws mcu_active_ua for the whole call, the EEPROM draws 
+         *  eeprom_active_ua whilst the bus is clocked and eeprom_write_ua for
+         *  write_cycle_us per write cycle
+         */
+        struct EnergyModel_t
+        {
+            uint32_t supply_mv;
+            uint32_t mcu_active_ua;
+            uint32_t eeprom_active_ua;
+            uint32_t eeprom_write_ua;
+            uint32_t write_cycle_us;
+        };
+
+        /** Estimated energy in nanojoules of calls, split by where it is spent
+         */
+        struct EnergyCounts_t
+        {
+            uint32_t calls;
+            uint64_t mcu_nj;
+            uint64_t bus_nj;
+            uint64_t write_nj;
+        };
+
+        /** Estimated energy of all calls and of each call type, indexed by TraceOp
+         */
+        struct EnergyStats_t
+        {
+            EnergyCounts_t total;
+            EnergyCounts_t api[DataManager_FileSystem::TRACE_OPS];
+        };
+
+        /** One node of the span tree: a frame, i.e. a TraceOp or SpanPhase, 
+         *  reached through its parent node, or -1 for a root. Costs are those
+         *  charged whilst the node was innermost, i.e. excluding its children
+         */
+        struct SpanNode_t
+        {
+            int16_t parent;
+            uint8_t frame;
+            uint32_t calls;
+            uint32_t time_us;
+            uint32_t bus_bytes;
+            uint32_t transfers;
+            uint32_t write_cycles;
+        };
+
         #if BOARD == DEVELOPMENT_BOARD_V1_1_0 || BOARD == WRIGHT_V1_0_0 || BOARD == EARHART_V1_0_0
+        /** Construct the DataManager and the STM24256 driver it uses by default.
+         *  The DataManager also drives the same pins itself, through an I2C 
+         *  object and a DigitalOut on the write control pin, for current address
+         *  reads, the adaptive clock, pipelined writes and asynchronous calls.
+         *  The two never transfer at once: mbed re-applies each I2C object's 
+         *  frequency when the bus passes between them, both leave the write 
+         *  control pin high when idle and blocking transfers return ASYNC_BUSY
+         *  whilst an asynchronous call is in progress. Nothing else may use 
+         *  these pins whilst the DataManager exists
+         *
+         * @param write_control Write control pin of the EEPROM
+         * @param sda I2C data pin
+         * @param scl I2C clock pin
+         * @param frequency_hz Bus clock whilst the adaptive clock is disabled
+         */
         DataManager(PinName write_control, PinName sda, PinName scl, int frequency_hz);
         #endif /* #if BOARD == ... */
 
@@ -62,14 +406,29 @@ class DataManager
          */
         int init_filesystem();
 
+        /** Resumable form of init_filesystem(), which clears one page per step
+         *  and persists its progress so that a reset part way through continues
+         *  from the last checkpoint rather than restarting. Call again, or call
+         *  resume_operation(), until it returns something other than
+         *  OPERATION_IN_PROGRESS. Supersedes any other resumable operation
+         *
+         * @param &budget Work that this call may do
+         * @return OPERATION_IN_PROGRESS or the outcome of the operation
+         */
+        int init_filesystem(const OperationBudget_t &budget);
+
         int init_gstats();
 
-        /** Determine whether or not the filesystem has been initialised
+        /** Determine whether or not the filesystem has been initialised. A
+         *  filesystem initialised by v0.5.0 or earlier is first brought up to
+         *  the current layout
          *
          * @param &initialised Address of boolean value to which result of 
          *                     an initialisation check is stored. True on 
          *                     initialised, else false
-         * @return Indicates success or failure reason
+         * @return LAYOUT_INCOMPATIBLE if the filesystem's files reach into the
+         *         operation page or journal, which then needs init_filesystem(),
+         *         else success or failure reason
          */
         int is_initialised(bool &initialised);
 
@@ -181,6 +540,42 @@ class DataManager
          */
         int truncate_file(uint8_t filename, int entries_to_remove);
 
+        /** Make one step of truncate_file(), so that other work can be done
+         *  between the write cycles of a long truncation. The first step looks
+         *  the file up, each following step moves at most one page of entries,
+         *  i.e. makes one write cycle, and the last updates the file's metadata.
+         *  Call with the same arguments until it returns something other than
+         *  OPERATION_IN_PROGRESS. A step that fails ends the truncation, leaving
+         *  the entries already moved where they are and the file's metadata as it
+         *  was. Other files may be used between steps but the file being 
+         *  truncated must not be
+         *
+         * @param filename ID of the file on which this operation is to be performed
+         * @param entries_to_remove Number of entries to be truncated from the 
+         *                          start of the file entry table
+         * @return OPERATION_IN_PROGRESS, OPERATION_BUSY if another truncation is
+         *         in progress or the outcome of the truncation
+         */
+        int truncate_file_step(uint8_t filename, int entries_to_remove);
+
+        /** Resumable form of truncate_file(), which persists its progress so
+         *  that a reset part way through can be continued by resume_operation()
+         *  rather than leaving the file half moved. A move never overwrites
+         *  entries that the last checkpoint would move again, so a truncation
+         *  of fewer than a page of bytes moves less than a page per step and
+         *  adds a checkpoint to each step. Call with the same arguments, or
+         *  call resume_operation(), until it returns something other than
+         *  OPERATION_IN_PROGRESS; the file must not be used in the meantime
+         *
+         * @param filename ID of the file on which this operation is to be performed
+         * @param entries_to_remove Number of entries to be truncated from the 
+         *                          start of the file entry table
+         * @param &budget Work that this call may do
+         * @return OPERATION_IN_PROGRESS, OPERATION_BUSY if another operation is
+         *         in progress or the outcome of the truncation
+         */
+        int truncate_file(uint8_t filename, int entries_to_remove, const OperationBudget_t &budget);
+
         /** Calculate number of entries within a file
          *
          * @param filename ID of the file to be queried
@@ -208,56 +603,1338 @@ class DataManager
          */
         int get_remaining_file_entries_bytes(uint8_t filename, int &remaining_bytes);
 
-        #if DM_DBG == true
-        /** Utility function to print a File_t over UART
+        /** Add a record group, i.e. a file whose entries are rows holding one
+         *  sample of each channel in a fixed schema, so that a tick costs a single
+         *  data write and metadata update. Rows are appended with append_file_entry(),
+         *  each channel being stored at record_channel_offset() within the row
          *
-         * file The File_t object whose parameters we wish to print
+         * @param filename ID of the record group
+         * @param schema Number of channels and length of each channel in bytes
+         * @param rows_to_store Number of rows to be stored
+         * @return Indicates success or failure reason
          */
-        void print_file(DataManager_FileSystem::File_t file);
+        int add_record_group(uint8_t filename, DataManager_FileSystem::RecordSchema_t schema, uint16_t rows_to_store);
 
-        /** Utility function to print GlobalStats_t over UART
+        /** Read a single channel from a specific row of a record group
          *
-         * g_stats The GlobalStats_t object whose parameters we wish to print
+         * @param filename ID of the record group from which we should read
+         * @param schema Schema with which the record group was added
+         * @param row_index 0-indexed row to be read
+         * @param channel 0-indexed channel to be read
+         * @param *data Pointer to an array in which the read data will be stored
+         * @param data_length Length of *data in bytes, must equal the channel length
+         * @return Indicates success or failure reason
          */
-        void print_global_stats(DataManager_FileSystem::GlobalStats_t g_stats);
-        #endif // #if DM_DBG == true
+        int read_record_channel(uint8_t filename, DataManager_FileSystem::RecordSchema_t schema, 
+                                int row_index, uint8_t channel, char *data, int data_length);
 
-    private:
+        /** Read a single channel from consecutive rows of a record group, i.e. 
+         *  a column. Whole rows are read in page-sized chunks when the skipped
+         *  channels are narrower than the overhead of a random read
+         *
+         * @param filename ID of the record group from which we should read
+         * @param schema Schema with which the record group was added
+         * @param channel 0-indexed channel to be read
+         * @param first_row 0-indexed row from which to start reading
+         * @param rows Number of rows to be read
+         * @param *data Pointer to an array in which the channel samples will be stored
+         * @param data_length Length of *data in bytes, must equal rows multiplied by
+         *                    the channel length
+         * @return Indicates success or failure reason
+         */
+        int read_record_projection(uint8_t filename, DataManager_FileSystem::RecordSchema_t schema, uint8_t channel,
+                                   int first_row, int rows, char *data, int data_length);
 
-        /** Set global next address and space remaining counters
+        /** Add a packed file, i.e. a file whose entries are made up of fields of
+         *  arbitrary bit width packed back to back into a contiguous bitstream.
+         *  Each entry must contain at least PACKED_MIN_ENTRY_BITS bits
          *
-         * @param data Byte array containing data to write to global stats counters
+         * @param filename ID of the packed file
+         * @param schema Number of fields and the width of each field in bits
+         * @param entries_to_store Number of entries to be stored
          * @return Indicates success or failure reason
          */
-        int set_global_stats(char *data);  
+        int add_packed_file(uint8_t filename, DataManager_FileSystem::PackedSchema_t schema, uint16_t entries_to_store);
 
-        /** Perform checksum on given File_t using the 'valid' parameter
+        /** Pack an entry and write it to the end of a packed file's bitstream. Only
+         *  the bytes spanned by the entry are written
          *
-         * @param type File to be checked for validity
-         * @return True if file is valid, else false
+         * @param filename ID of the packed file to which we should append data
+         * @param schema Schema with which the packed file was added
+         * @param *fields Array of schema.parameters.fields values to be packed
+         * @return Indicates success or failure reason
          */
-        bool is_valid_file(DataManager_FileSystem::File_t file); 
+        int append_packed_entry(uint8_t filename, DataManager_FileSystem::PackedSchema_t schema, const uint32_t *fields);
 
-        /** Determine the next available address to which to write file
+        /** Read and unpack consecutive entries from a packed file. A single entry 
+         *  is a random access read of only the bytes it spans; longer runs are 
+         *  read in page-sized chunks and unpacked in bulk
          *
-         * @param &next_available_address Address of integer value in which the address
-         *                                of the next available location in memory to which
-         *                                you can write a file is stored. -1 if 
-         *                                there are no available spaces
+         * @param filename ID of the packed file from which we should read
+         * @param schema Schema with which the packed file was added
+         * @param first_entry 0-indexed position of the first entry to be read
+         * @param entries Number of entries to be read
+         * @param *fields Array to which the unpacked field values will be written
+         * @param fields_length Length of *fields, must equal entries multiplied by
+         *                      the number of fields in the schema
          * @return Indicates success or failure reason
          */
-        int get_next_available_file_table_address(int &next_available_address);
+        int read_packed_entries(uint8_t filename, DataManager_FileSystem::PackedSchema_t schema, int first_entry, 
+                                int entries, uint32_t *fields, int fields_length);
 
-        /** Modify a file's metadata
+        /** Calculate number of entries within a packed file
          *
-         * @param filename ID of file to be modified
-         * @param file Updated version of file
+         * @param filename ID of the packed file to be queried
+         * @param schema Schema with which the packed file was added
+         * @param &written_entries Address of integer value to which the number
+         *                         of written entries should be stored
          * @return Indicates success or failure reason
          */
-        int modify_file(uint8_t filename, DataManager_FileSystem::File_t file);  
+        int get_total_packed_entries(uint8_t filename, DataManager_FileSystem::PackedSchema_t schema, int &written_entries);
 
-        #if BOARD == DEVELOPMENT_BOARD_V1_1_0 || BOARD == WRIGHT_V1_0_0 || BOARD == EARHART_V1_0_0
-        STM24256 _storage;
-        #endif /* #if BOARD == ... */
+        /** Add a run-length encoded file for low-cardinality values such as status
+         *  codes. Each entry in the file table region is a run of identical values,
+         *  stored as a 16-bit run length followed by the value
+         *
+         * @param filename ID of the RLE file
+         * @param value_length_bytes Length of each value, at most RLE_MAX_VALUE_BYTES
+         * @param runs_to_store Number of runs to be stored
+         * @return Indicates success or failure reason
+         */
+        int add_rle_file(uint8_t filename, uint8_t value_length_bytes, uint16_t runs_to_store);
+
+        /** Append a value to an RLE file. A value that differs from the previous
+         *  one starts a new run, which is written at once, so the latest value 
+         *  always survives a reset. A value equal to the previous one increments
+         *  the current run in RAM and its length is rewritten every 
+         *  RLE_SYNC_INTERVAL values, when the run ends or when the file is flushed.
+         *  A reset therefore loses at most RLE_SYNC_INTERVAL - 1 repeats of the
+         *  latest value; call flush_rle_file() before a planned reset to lose none
+         *
+         * @param filename ID of the RLE file to which we should append data
+         * @param *data Value to be appended
+         * @param data_length Length of *data in bytes
+         * @return Indicates success or failure reason
+         */
+        int append_rle_entry(uint8_t filename, char *data, int data_length);
+
+        /** Write the length of the current run of an RLE file so that all of its
+         *  values survive a reset
+         *
+         * @param filename ID of the RLE file to be flushed
+         * @return Indicates success or failure reason
+         */
+        int flush_rle_file(uint8_t filename);
+
+        /** Read the value at a specific index of an RLE file, locating its run
+         *  through the file's run index
+         *
+         * @param filename ID of the RLE file from which we should read
+         * @param entry_index 0-indexed position of the value to be read
+         * @param *data Pointer to an array in which the read value will be stored
+         * @param data_length Length of *data in bytes
+         * @return Indicates success or failure reason
+         */
+        int read_rle_entry(uint8_t filename, int entry_index, char *data, int data_length);
+
+        /** Calculate number of values within an RLE file, including those of the
+         *  current run that are yet to be flushed
+         *
+         * @param filename ID of the RLE file to be queried
+         * @param &written_entries Address of integer value to which the number
+         *                         of written values should be stored
+         * @return Indicates success or failure reason
+         */
+        int get_total_rle_entries(uint8_t filename, int &written_entries);
+
+        /** Add an archive file, i.e. a compressed region into which the sealed 
+         *  pages of another file are moved by compress_sealed_pages()
+         *
+         * @param filename ID of the archive file
+         * @param bytes_to_store Size of the compressed region in bytes
+         * @return Indicates success or failure reason
+         */
+        int add_archive_file(uint8_t filename, uint16_t bytes_to_store);
+
+        /** Compress every sealed page of a file, i.e. every page-sized block of
+         *  whole entries that has been completely written, append the compressed
+         *  blocks to an archive file and truncate them from the source file. 
+         *  Intended to be run in the background once a file is read-mostly.
+         *  Archiving stops at the first block that doesn't shrink, which is left
+         *  in the source file with those after it, as storing it would spend write
+         *  cycles to lose space
+         *
+         * @param filename ID of the file whose sealed pages are to be compressed
+         * @param archive_filename ID of the archive file to which they are moved
+         * @return ARCHIVE_INCOMPRESSIBLE if the first block doesn't shrink, else
+         *         success or failure reason
+         */
+        int compress_sealed_pages(uint8_t filename, uint8_t archive_filename);
+
+        /** Resumable form of compress_sealed_pages(), which archives one block
+         *  per step, updates the archive's metadata at each checkpoint and then
+         *  truncates the source file as truncate_file() with a budget does. A
+         *  reset whilst archiving continues from the last checkpoint. Call with
+         *  the same arguments, or call resume_operation(), until it returns 
+         *  something other than OPERATION_IN_PROGRESS; neither file may be used
+         *  in the meantime
+         *
+         * @param filename ID of the file whose sealed pages are to be compressed
+         * @param archive_filename ID of the archive file to which they are moved
+         * @param &budget Work that this call may do
+         * @return OPERATION_IN_PROGRESS, OPERATION_BUSY if another operation is
+         *         in progress or the outcome of the compression
+         */
+        int compress_sealed_pages(uint8_t filename, uint8_t archive_filename, const OperationBudget_t &budget);
+
+        /** Read an entry from an archive file, decompressing only the blocks 
+         *  that it spans
+         *
+         * @param archive_filename ID of the archive file from which we should read
+         * @param entry_index 0-indexed position of the entry within the archive
+         * @param *data Pointer to an array in which the read data will be stored
+         * @param data_length Length of *data in bytes, i.e. the entry length of
+         *                    the file from which the entries were archived
+         * @return Indicates success or failure reason
+         */
+        int read_archived_entry(uint8_t archive_filename, int entry_index, char *data, int data_length);
+
+        /** Calculate number of entries within an archive file
+         *
+         * @param archive_filename ID of the archive file to be queried
+         * @param entry_length Entry length of the file from which the entries were archived
+         * @param &archived_entries Address of integer value to which the number of 
+         *                          archived entries should be stored
+         * @return Indicates success or failure reason
+         */
+        int get_total_archived_entries(uint8_t archive_filename, int entry_length, int &archived_entries);
+
+        /** Get the compression ratio, timing and write cycle counters accumulated 
+         *  by compress_sealed_pages() and read_archived_entry()
+         *
+         * @param &stats Address of CompressionStats_t to which counters will be written
+         */
+        void get_compression_stats(CompressionStats_t &stats);
+
+        /** Reset all compression counters to zero
+         */
+        void reset_compression_stats();
+
+        /** Begin a transaction. Until commit() is called, appends write their 
+         *  data immediately but their metadata changes are only staged in RAM,
+         *  so a power cut leaves every file in the transaction unchanged.
+         *  Only append_file_entry() stages changes; every other call that changes
+         *  a file's metadata, e.g. append_packed_entry(), append_rle_entry() or
+         *  compress_sealed_pages(), writes it at once and returns 
+         *  TRANSACTION_CONFLICT for a file that the transaction has staged
+         *
+         * @return Indicates success or failure reason
+         */
+        int begin();
+
+        /** Commit the open transaction. All staged metadata changes are written
+         *  to the journal as a single page-aligned record, which is then applied
+         *  to the file table and cleared
+         *
+         * @return Indicates success or failure reason
+         */
+        int commit();
+
+        /** Discard the metadata changes staged by the open transaction. Data that
+         *  has already been written lies beyond each file's next available address
+         *  and will be overwritten by subsequent appends
+         *
+         * @return Indicates success or failure reason
+         */
+        int rollback();
+
+        /** Apply a transaction that was committed to the journal but not applied
+         *  to the file table before a reset. Should be called once at start-up, 
+         *  before any other file operation. A filesystem initialised by v0.5.0
+         *  or earlier is first brought up to the current layout
+         *
+         * @return LAYOUT_INCOMPATIBLE if the filesystem's files reach into the
+         *         operation page or journal, which then needs init_filesystem(),
+         *         else success or failure reason
+         */
+        int recover_transaction();
+
+        /** Continue the resumable operation in progress, including one that was
+         *  persisted before a reset. Should be called at start-up, after
+         *  recover_transaction() and before any other file operation, until it
+         *  returns something other than OPERATION_IN_PROGRESS
+         *
+         * @param &budget Work that this call may do
+         * @return OPERATION_IN_PROGRESS or the outcome of the operation, which
+         *         is DATA_MANAGER_OK if none was in progress
+         */
+        int resume_operation(const OperationBudget_t &budget);
+
+        /** Calculate the number of pages, starting from page 0, that must be 
+         *  exported in order to capture global stats, the file table and all
+         *  storage that has been allocated to files
+         *
+         * @param &pages Address of integer value to which the number of pages
+         *               in use should be stored
+         * @return Indicates success or failure reason
+         */
+        int get_image_pages(int &pages);
+
+        /** Read a single page of the EEPROM image and add it to a running
+         *  checksum. Pages should be exported in ascending order, starting 
+         *  from page 0, at which point the checksum is reset
+         *
+         * @param page 0-indexed page to be exported
+         * @param *data Array to which the page will be written
+         * @param data_length Length of *data in bytes, must be PAGE_SIZE_BYTES
+         * @param &checksum Address of running checksum of the exported image
+         * @return Indicates success or failure reason
+         */
+        int export_image_page(int page, char *data, int data_length, uint32_t &checksum);
+
+        /** Prepare to restore an exported image. Global stats are invalidated
+         *  so that an interrupted restore is detected as an uninitialised 
+         *  filesystem rather than a corrupt one. The journal and operation page
+         *  lie beyond the pages of an image, so they are cleared so that neither
+         *  a transaction nor a resumable operation of the filesystem being 
+         *  replaced is applied to the restored one
+         *
+         * @return Indicates success or failure reason
+         */
+        int begin_image_restore();
+
+        /** Write the next page of an exported image using a full page write
+         *  followed by ACK polling rather than a fixed write cycle delay. 
+         *  Page 0, which holds global stats, is held back until the image 
+         *  checksum has been verified by finish_image_restore()
+         *
+         * @param *data Page of the image to be restored
+         * @param data_length Length of *data in bytes, must be PAGE_SIZE_BYTES
+         * @return IMAGE_RESTORE_NOT_STARTED unless begin_image_restore() has been
+         *         called since the last restore finished, else success or failure reason
+         */
+        int restore_image_page(char *data, int data_length);
+
+        /** Verify the checksum of the restored image and, if it matches, write
+         *  page 0 to mark the filesystem as initialised. A mismatch ends the 
+         *  restore, which must then be started again with begin_image_restore()
+         *
+         * @param checksum Checksum returned by export_image_page() for the final 
+         *                 exported page
+         * @return IMAGE_RESTORE_NOT_STARTED unless begin_image_restore() has been
+         *         called since the last restore finished, else success or failure reason
+         */
+        int finish_image_restore(uint32_t checksum);
+
+        /** Predict the bus transfers, bus bytes, write cycles and time of a call
+         *  from the current metadata of its file and the measured device timing,
+         *  e.g. to decide whether it fits before a deadline. Supports appending,
+         *  overwriting, deleting and truncating entries, the next step of
+         *  truncate_file_step(), reading a range of entries with read_file_entry()
+         *  and get_file_by_name(). The estimate itself costs one file table
+         *  lookup, none for a truncation already in progress, and assumes no
+         *  transaction is open. With the adaptive clock or pipelined writes the
+         *  DataManager polls write cycles itself, and how many polls a write 
+         *  cycle takes depends on its timing, so transfers and bus bytes exclude
+         *  them. IoStats_t counts them apart, and time_us covers them as they
+         *  fall within the write cycles. With pipelined writes time_us leaves
+         *  out the last write cycle, which the call doesn't wait for
+         *
+         * @param op The call
+         * @param filename ID of the file on which the call would operate
+         * @param &params Arguments of the call
+         * @param &estimate Address of CostEstimate_t to which the prediction will be written
+         * @return Indicates success or the failure reason that the call would return
+         */
+        int estimate_cost(DataManager_FileSystem::TraceOp op, uint8_t filename, const CostParams_t &params,
+                          CostEstimate_t &estimate);
+
+        #if DEVICE_I2C_ASYNCH
+        /** Append an entry using interrupt/DMA driven I2C transfers. The call returns
+         *  as soon as the first transfer has started; the file table lookup, data 
+         *  write, metadata write and the ACK polling after each write are then driven
+         *  by I2C events. No other DataManager call may be made, and *data must remain
+         *  valid, until done is called
+         *
+         * @param filename ID of the file to which we should append data
+         * @param *data Actual data to be written to file
+         * @param data_length Length of *data in bytes
+         * @param done Called from interrupt context with the final status
+         * @return Indicates success or failure reason of starting the operation
+         */
+        int append_file_entry_async(uint8_t filename, const char *data, int data_length, Callback<void(int)> done);
+
+        /** Read consecutive entries using interrupt/DMA driven I2C transfers. The call 
+         *  returns as soon as the file table lookup has started. No other DataManager 
+         *  call may be made, and *data must remain valid, until done is called
+         *
+         * @param filename ID of the file from which we should read
+         * @param entry_index 0-indexed position of the first entry to be read
+         * @param entries Number of entries to be read
+         * @param *data Pointer to an array in which the read data will be stored
+         * @param data_length Length of *data in bytes, i.e. entries * entry length
+         * @param done Called from interrupt context with the final status
+         * @return Indicates success or failure reason of starting the operation
+         */
+        int read_file_entries_async(uint8_t filename, int entry_index, int entries, char *data, 
+                                    int data_length, Callback<void(int)> done);
+
+        /** Determine whether or not an asynchronous operation is in progress
+         *
+         * @return True if an asynchronous operation is in progress, else false
+         */
+        bool is_async_busy();
+        #endif /* #if DEVICE_I2C_ASYNCH */
+
+        /** Return the largest number of scratch arena bytes borrowed at once since
+         *  construction or the last reset, so that DM_SCRATCH_ARENA_BYTES can be sized
+         *
+         *  @return Peak scratch arena usage in bytes
+         */
+        int get_scratch_peak_bytes();
+
+        /** Reset the peak scratch arena usage to the current usage
+         */
+        void reset_scratch_peak();
+
+        /** Get the bus traffic counters accumulated since construction or the
+         *  last reset, including the bytes saved by current address reads
+         *
+         * @param &stats Address of IoStats_t to which counters will be written
+         */
+        void get_io_stats(IoStats_t &stats);
+
+        /** Reset all bus traffic counters to zero
+         */
+        void reset_io_stats();
+
+        /** Get the device timing measured so far, used by estimate_cost()
+         *
+         * @param &timing Address of DeviceTiming_t to which the timing will be written
+         */
+        void get_device_timing(DeviceTiming_t &timing);
+
+        /** Enable or disable the adaptive bus clock. When enabled, all transfers are
+         *  made by the DataManager on its own I2C object, starting at the fastest
+         *  rate. The clock steps down when a window of transfers sees more than
+         *  ADAPTIVE_CLOCK_MAX_ERRORS errors, and the transfer that stepped it 
+         *  down is retried once at the slower rate. After ADAPTIVE_CLOCK_PROBE_WINDOWS
+         *  clean windows it tries one step back up. The fastest rate and each
+         *  step back up are first probed with ADAPTIVE_CLOCK_PROBE_READS reads,
+         *  so a rate the board can't sustain fails reads of its own rather than
+         *  the caller's. When disabled, transfers return to the EEPROM driver at
+         *  the frequency given to the constructor
+         *
+         * @param enabled True to enable the adaptive clock, false to disable it
+         */
+        void set_adaptive_clock(bool enabled);
+
+        /** Enable or disable pipelined writes. When enabled, all transfers are
+         *  made by the DataManager on its own I2C object and a write returns as
+         *  soon as its last page has been sent. The write cycle of that page is
+         *  waited for by the next transfer, so that work done in the meantime,
+         *  e.g. encoding, checksumming or compressing the next page, overlaps 
+         *  it rather than following it. Whilst enabled, the write cycle time 
+         *  used by estimate_cost() is only measured between the pages of a 
+         *  write that spans pages. Disabling waits for any write cycle still
+         *  in progress
+         *
+         * @param enabled True to enable pipelined writes, false to disable them
+         */
+        void set_pipelined_writes(bool enabled);
+
+        /** Get the current bus clock and the error history of the adaptive clock
+         *
+         * @param &stats Address of ClockStats_t to which the state will be written
+         */
+        void get_clock_stats(ClockStats_t &stats);
+
+        /** Set the retry policy used by every write
+         *
+         * @param &policy The new policy; attempts below one are treated as one
+         */
+        void set_retry_policy(const RetryPolicy_t &policy);
+
+        /** Get the failed write attempts and retries counted since construction
+         *  or the last reset
+         *
+         * @param &stats Address of RetryStats_t to which counters will be written
+         */
+        void get_retry_stats(RetryStats_t &stats);
+
+        /** Reset all retry counters to zero
+         */
+        void reset_retry_stats();
+
+        #if DM_LATENCY_HISTOGRAMS == true
+        /** Get the latency histogram of a public call type since construction or
+         *  the last reset
+         *
+         * @param op The call type
+         * @param &histogram Address of LatencyHistogram_t to which the histogram will be written
+         */
+        void get_latency_histogram(DataManager_FileSystem::TraceOp op, LatencyHistogram_t &histogram);
+
+        /** Reset the latency histograms of all call types
+         */
+        void reset_latency_histograms();
+        #endif /* #if DM_LATENCY_HISTOGRAMS == true */
+
+        #if DM_ENERGY_MODEL == true
+        /** Set the figures from which the energy of each call is estimated
+         *
+         * @param &model The new model
+         */
+        void set_energy_model(const EnergyModel_t &model);
+
+        /** Get the energy estimated since construction or the last reset
+         *
+         * @param &stats Address of EnergyStats_t to which counters will be written
+         */
+        void get_energy_stats(EnergyStats_t &stats);
+
+        /** Reset all energy counters to zero
+         */
+        void reset_energy_stats();
+        #endif /* #if DM_ENERGY_MODEL == true */
+
+        #if DM_SPANS == true
+        /** Copy the nodes of the span tree, in the order they were first reached.
+         *  Once all DM_SPAN_NODES nodes are in use, or DM_SPAN_DEPTH levels deep,
+         *  new frames are charged to their parent
+         *
+         * @param *nodes Array to which the nodes will be written
+         * @param max_nodes Length of the nodes array
+         * @param &count Address of integer value to which the number of nodes written will be stored
+         */
+        void get_spans(SpanNode_t *nodes, int max_nodes, int &count);
+
+        /** Discard the span tree
+         */
+        void reset_spans();
+
+        /** Print one cost of the span tree over UART as collapsed stacks, i.e. one
+         *  line of semicolon separated frames and the cost of the innermost frame
+         *  for each node with a non-zero cost, as read by flamegraph.pl
+         *
+         * @param metric The cost to print
+         */
+        void dump_spans(DataManager_FileSystem::SpanMetric metric);
+        #endif /* #if DM_SPANS == true */
+
+        #if DM_TRACE == true
+        /** Copy the recorded calls, oldest first, out of the trace ring. The ring
+         *  keeps the most recent DM_TRACE_ENTRIES calls
+         *
+         * @param *records Array to which the records will be written
+         * @param max_records Length of the records array
+         * @param &count Address of integer value to which the number of records written will be stored
+         */
+        void get_trace(DataManager_FileSystem::TraceRecord_t *records, int max_records, int &count);
+
+        /** Discard all recorded calls
+         */
+        void clear_trace();
+
+        /** Print the recorded calls, oldest first, over UART as one TRACE_LINE_PREFIX
+         *  line of hex encoded record bytes each, for the host replay tool
+         */
+        void dump_trace();
+        #endif /* #if DM_TRACE == true */
+
+        #if DM_DBG == true
+        /** Utility function to print a File_t over UART
+         *
+         * file The File_t object whose parameters we wish to print
+         */
+        void print_file(DataManager_FileSystem::File_t file);
+
+        /** Utility function to print GlobalStats_t over UART
+         *
+         * g_stats The GlobalStats_t object whose parameters we wish to print
+         */
+        void print_global_stats(DataManager_FileSystem::GlobalStats_t g_stats);
+
+        #if DM_LATENCY_HISTOGRAMS == true
+        /** Utility function to print the latency histogram of every call type
+         *  that has been made over UART
+         */
+        void print_latency_histograms();
+        #endif /* #if DM_LATENCY_HISTOGRAMS == true */
+
+        #if DM_ENERGY_MODEL == true
+        /** Utility function to print the estimated energy of every call type 
+         *  that has been made over UART
+         */
+        void print_energy_stats();
+        #endif /* #if DM_ENERGY_MODEL == true */
+        #endif // #if DM_DBG == true
+
+    private:
+
+        #if DEVICE_I2C_ASYNCH
+        /** Steps of an asynchronous append
+         */
+        enum AsyncState
+        {
+            ASYNC_IDLE,
+            ASYNC_LOOKUP,
+            ASYNC_DATA_READ,
+            ASYNC_DATA_WRITE,
+            ASYNC_DATA_POLL,
+            ASYNC_METADATA_WRITE,
+            ASYNC_METADATA_POLL
+        };
+
+        /** Handle an I2C event and start the next transfer of the asynchronous operation
+         *
+         * @param event I2C_EVENT_* flags of the completed transfer
+         */
+        void async_event(int event);
+
+        /** Start the file table lookup shared by all asynchronous operations
+         *
+         * @param filename ID of the file to be looked up
+         * @param done Called from interrupt context with the final status
+         * @return Indicates success or failure reason
+         */
+        int async_begin(uint8_t filename, Callback<void(int)> done);
+
+        /** Start a random read of the next chunk of the file table
+         *
+         * @return Indicates success or failure reason
+         */
+        int async_read_file_table();
+
+        /** Validate the request against the file found by the lookup and start 
+         *  its first data transfer
+         *
+         * @return Indicates success or failure reason
+         */
+        int async_file_found();
+
+        /** Start a write of the next chunk of data, up to the end of the current page
+         *
+         * @return Indicates success or failure reason
+         */
+        int async_write_data();
+
+        /** Start a write of the next chunk of the updated File_t to the file table
+         *
+         * @return Indicates success or failure reason
+         */
+        int async_write_metadata();
+
+        /** Start a single byte read, which is NACKed until the write cycle completes
+         */
+        void async_poll();
+
+        /** Release the write control pin, return to idle and report the final status
+         *
+         * @param status Final status of the asynchronous operation
+         */
+        void async_finish(int status);
+        #endif /* #if DEVICE_I2C_ASYNCH */
+
+        /** Buffer borrowed from the scratch arena for the lifetime of the object. 
+         *  Borrowing is strictly nested, so release is simply a matter of restoring
+         *  the arena's previous usage. data is NULL if the arena is exhausted
+         */
+        class ScratchBuffer
+        {
+            public:
+
+                ScratchBuffer(DataManager &manager, int length);
+
+                ~ScratchBuffer();
+
+                char *data;
+
+            private:
+
+                DataManager &_manager;
+                int _previous_used;
+        };
+
+        /** Scope of a frame of the span tree. Costs incurred during the lifetime
+         *  of the object are charged to the frame, below the frame of the
+         *  innermost enclosing scope. Compiles to nothing unless DM_SPANS is set
+         */
+        class Span
+        {
+            public:
+
+                #if DM_SPANS == true
+                Span(DataManager &manager, uint8_t frame);
+
+                ~Span();
+
+            private:
+
+                DataManager &_manager;
+                bool _pushed;
+                #else
+                Span(DataManager &, uint8_t) {}
+                #endif /* #if DM_SPANS == true */
+        };
+
+        /** Scope of a public call. Calls made by the DataManager to its own public
+         *  functions are nested in the caller's scope, so only the outermost call
+         *  is recorded. Every return of a public call passes its status through
+         *  done()
+         */
+        class ApiScope
+        {
+            public:
+
+                ApiScope(DataManager &manager, DataManager_FileSystem::TraceOp op, int filename, int index, int length);
+
+                ~ApiScope();
+
+                /** Record the outcome of the call if it is outermost
+                 *
+                 * @param status Status returned by the call
+                 * @return status, unchanged
+                 */
+                int done(int status);
+
+            private:
+
+                DataManager &_manager;
+                bool _outermost;
+                #if DM_SPANS == true
+                Span _span;
+                #endif /* #if DM_SPANS == true */
+                #if DM_TRACE == true || DM_LATENCY_HISTOGRAMS == true || DM_ENERGY_MODEL == true
+                uint8_t _op;
+                uint32_t _start_ticks;
+                #endif /* #if DM_TRACE == true || DM_LATENCY_HISTOGRAMS == true || DM_ENERGY_MODEL == true */
+                #if DM_ENERGY_MODEL == true
+                uint32_t _start_bus_bytes;
+                uint32_t _start_write_cycles;
+                #endif /* #if DM_ENERGY_MODEL == true */
+                #if DM_TRACE == true
+                DataManager_FileSystem::TraceRecord_t _record;
+                #endif /* #if DM_TRACE == true */
+        };
+
+        #if DM_TRACE == true
+        /** Add a completed call to the trace ring, overwriting the oldest record
+         *  once the ring is full
+         *
+         * @param record The call to add
+         */
+        void record_trace(const DataManager_FileSystem::TraceRecord_t &record);
+        #endif /* #if DM_TRACE == true */
+
+        #if DM_LATENCY_HISTOGRAMS == true
+        /** Add the latency of a completed call to the histogram of its type
+         *
+         * @param op The call type
+         * @param elapsed_us Duration of the call
+         */
+        void record_latency(uint8_t op, uint32_t elapsed_us);
+        #endif /* #if DM_LATENCY_HISTOGRAMS == true */
+
+        /** Add the cost of a file table lookup that finds the file in the given
+         *  slot, reading every slot up to it
+         *
+         * @param slot Index of the file in the file table
+         * @param &estimate Estimate to which the cost is added
+         */
+        void estimate_table_scan(int slot, CostEstimate_t &estimate);
+
+        /** Estimate the next step of the truncation in progress
+         *
+         * @param filename ID of the file given to truncate_file_step()
+         * @param entries_to_remove Number of entries given to truncate_file_step()
+         * @param &estimate Estimate to which the cost is written
+         * @return Indicates success or the failure reason that the step would return
+         */
+        int estimate_truncate_step(uint8_t filename, int entries_to_remove, CostEstimate_t &estimate);
+
+        /** Add the cost of a read made through read_storage()
+         *
+         * @param address Address from which to read
+         * @param length Number of bytes to be read
+         * @param &estimate Estimate to which the cost is added
+         */
+        void estimate_read(uint16_t address, int length, CostEstimate_t &estimate);
+
+        /** Add the cost of a write made through write_storage()
+         *
+         * @param address Address to which to write
+         * @param length Number of bytes to be written
+         * @param &estimate Estimate to which the cost is added
+         */
+        void estimate_write(uint16_t address, int length, CostEstimate_t &estimate);
+
+        /** Set the time of an estimate from its bus bytes and the write cycles
+         *  that the call waits for
+         *
+         * @param &estimate Estimate whose time is set
+         */
+        void estimate_time(CostEstimate_t &estimate);
+
+        /** Update the measured device timing from a successful transfer
+         *
+         * @param start_ticks Latency clock reading when the transfer started
+         * @param bus_bytes Bytes on the bus, including address and overhead
+         * @param write_cycles Number of write cycles the transfer made
+         */
+        void measure_transfer(uint32_t start_ticks, uint32_t bus_bytes, uint32_t write_cycles);
+
+        #if DM_ENERGY_MODEL == true
+        /** Add the estimated energy of a completed call to the counters of its type
+         *
+         * @param op The call type
+         * @param elapsed_us Duration of the call
+         * @param bus_bytes Bytes the call clocked over the bus
+         * @param write_cycles Write cycles the call started
+         */
+        void record_energy(uint8_t op, uint32_t elapsed_us, uint32_t bus_bytes, uint32_t write_cycles);
+        #endif /* #if DM_ENERGY_MODEL == true */
+
+        #if DM_SPANS == true
+        /** Charge the time since the last charge to the innermost span
+         */
+        void charge_span_time();
+
+        /** Charge a bus transfer to the innermost span
+         *
+         * @param bus_bytes Bytes on the bus, including address and overhead
+         * @param write_cycles Number of write cycles the transfer started
+         */
+        void charge_span_transfer(uint32_t bus_bytes, uint32_t write_cycles);
+        #endif /* #if DM_SPANS == true */
+
+        /** Set global next address and space remaining counters
+         *
+         * @param data Byte array containing data to write to global stats counters
+         * @return Indicates success or failure reason
+         */
+        int set_global_stats(char *data);  
+
+        /** Perform checksum on given File_t using the 'valid' parameter
+         *
+         * @param type File to be checked for validity
+         * @return True if file is valid, else false
+         */
+        bool is_valid_file(DataManager_FileSystem::File_t file); 
+
+        /** Check a record group's schema and that the file was added with it
+         *
+         * @param &schema Schema to be checked
+         * @param &file File_t of the record group, or NULL to check the schema alone
+         * @return Indicates success or failure reason
+         */
+        int check_record_schema(const DataManager_FileSystem::RecordSchema_t &schema, 
+                                const DataManager_FileSystem::File_t *file);
+
+        /** Current run and run index of an RLE file. The current run is always
+         *  stored, as the last run of the file, but with a length of stored 
+         *  rather than pending; persisted_runs and persisted_entries count the
+         *  runs before it
+         */
+        struct RleState_t
+        {
+            bool open;
+            uint8_t filename;
+            uint8_t value_length;
+            char value[RLE_MAX_VALUE_BYTES];
+            uint16_t pending;
+            uint16_t stored;
+            uint16_t run_address;
+            uint16_t persisted_runs;
+            uint32_t persisted_entries;
+            uint16_t index_stride;
+            uint8_t index_count;
+            uint32_t index[RLE_INDEX_ENTRIES];
+        };
+
+        /** Find the RAM state of an RLE file, loading it from storage if it
+         *  isn't already open
+         *
+         * @param filename ID of the RLE file
+         * @param *&state Address of pointer to which the state will be assigned
+         * @return Indicates success or failure reason
+         */
+        int get_rle_state(uint8_t filename, RleState_t *&state);
+
+        /** Rewrite the length of the current run of an RLE file if values have
+         *  been added to it since it was last written
+         *
+         * @param &state State of the RLE file
+         * @return Indicates success or failure reason
+         */
+        int persist_rle_run(RleState_t &state);
+
+        /** End the current run of an RLE file, adding it to the run index, and
+         *  write a new run of one value
+         *
+         * @param &state State of the RLE file
+         * @param *data Value of the new run
+         * @return Indicates success or failure reason
+         */
+        int start_rle_run(RleState_t &state, const char *data);
+
+        /** Record the number of values preceding a run in the run index if the run
+         *  falls on the index stride, doubling the stride when the index is full
+         *
+         * @param &state State of the RLE file
+         * @param run 0-indexed run
+         * @param entries_before Number of values preceding the run
+         */
+        void add_rle_index(RleState_t &state, uint16_t run, uint32_t entries_before);
+
+        /** Progress of a truncation made in steps: the file's metadata and
+         *  file table address and the move of its remaining entries. A 
+         *  persistent truncation also tracks the source address of its last
+         *  checkpoint, below which moves may write without another
+         */
+        struct TruncateStep_t
+        {
+            bool active;
+            bool persistent;
+            uint8_t filename;
+            int entries_to_remove;
+            int address;
+            DataManager_FileSystem::File_t file;
+            uint16_t source_address;
+            uint16_t new_address;
+            int remaining_bytes;
+            uint16_t checkpoint_address;
+        };
+
+        /** Resumable operation in progress: the call that started it, its
+         *  files, the pages cleared or blocks archived of the total, the next
+         *  address in the archive and the sequence number of its last 
+         *  checkpoint. loaded is set once the operation page has been read.
+         *  file holds the source file's metadata as it was when the operation
+         *  started, which a resumed truncation needs
+         */
+        struct LongOperation_t
+        {
+            bool loaded;
+            bool active;
+            uint8_t op;
+            uint8_t filename;
+            uint8_t archive_filename;
+            int progress;
+            int total;
+            uint16_t archive_address;
+            uint16_t sequence;
+            DataManager_FileSystem::File_t file;
+            DataManager_FileSystem::File_t archive;
+        };
+
+        /** Make one step of a truncation
+         *
+         * @param filename ID of the file on which this operation is to be performed
+         * @param entries_to_remove Number of entries to be truncated from the 
+         *                          start of the file entry table
+         * @return OPERATION_IN_PROGRESS or the outcome of the truncation
+         */
+        int truncate_step(uint8_t filename, int entries_to_remove);
+
+        /** Calculate the number of bytes moved by the next step of a truncation
+         *
+         * @param &step The truncation
+         * @return Number of bytes to move
+         */
+        static int truncate_chunk(const TruncateStep_t &step);
+
+        /** Clear one page of the file table or, after the last, the journal
+         *
+         * @param page 0-indexed page, FILE_TABLE_PAGES for the journal
+         * @return Indicates success or failure reason
+         */
+        int clear_filesystem_page(int page);
+
+        /** Compress a sealed block of a file and append it to the open archive
+         *
+         * @param &file The source file
+         * @param block 0-indexed block of the source file
+         * @param &archive The archive file
+         * @param &address Address of the next block of the archive, advanced past the block written
+         * @return ARCHIVE_INCOMPRESSIBLE if the block doesn't shrink, ARCHIVE_FULL if 
+         *         it doesn't fit, else success or failure reason
+         */
+        int archive_block(const DataManager_FileSystem::File_t &file, int block, const DataManager_FileSystem::File_t &archive,
+                          uint16_t &address);
+
+        /** Read a sealed block of a file
+         *
+         * @param &file The source file
+         * @param block 0-indexed block of the source file
+         * @param *raw Buffer of PAGE_SIZE_BYTES to which the block will be read
+         * @return Indicates success or failure reason
+         */
+        int read_sealed_block(const DataManager_FileSystem::File_t &file, int block, char *raw);
+
+        /** Encode a block as an archive block: its header followed by the 
+         *  compressed block
+         *
+         * @param *raw The block
+         * @param block_length Length of the block in bytes
+         * @param *stored Buffer of ARCHIVE_BLOCK_HEADER_BYTES + PAGE_SIZE_BYTES to which the archive block will be written
+         * @return False if the archive block wouldn't be shorter than the block, else true
+         */
+        bool compress_block(char *raw, int block_length, char *stored);
+
+        /** Append an archive block to the open archive
+         *
+         * @param *stored The archive block
+         * @param &archive The archive file
+         * @param &address Address of the next block of the archive, advanced past the block written
+         * @return ARCHIVE_FULL if the block doesn't fit, else success or failure reason
+         */
+        int write_archive_block(char *stored, const DataManager_FileSystem::File_t &archive, uint16_t &address);
+
+        /** Make steps of the resumable operation in progress until it finishes
+         *  or the next step could overrun the budget, then write a checkpoint
+         *
+         * @param &budget Work that this call may do
+         * @return OPERATION_IN_PROGRESS or the outcome of the operation
+         */
+        int run_operation(const OperationBudget_t &budget);
+
+        /** Make one step of the resumable operation in progress
+         *
+         * @return OPERATION_IN_PROGRESS or the outcome of the operation
+         */
+        int operation_step();
+
+        /** Read the operation page once and restore the operation that was in
+         *  progress, if any, from the newer of its valid copies
+         *
+         * @return Indicates success or failure reason
+         */
+        int load_operation();
+
+        /** Bring a filesystem initialised by v0.5.0 or earlier up to the current
+         *  layout, once per boot. Those versions allocated storage up to the end
+         *  of the EEPROM, so their space remaining counts the operation page and
+         *  journal and either page may hold their files' data
+         *
+         * @return LAYOUT_INCOMPATIBLE if allocated storage reaches into the 
+         *         operation page or journal, else success or failure reason
+         */
+        int check_layout();
+
+        /** Persist the progress of the resumable operation in progress, or that
+         *  none is, to the older copy in the operation page
+         *
+         * @return Indicates success or failure reason
+         */
+        int write_operation();
+
+        /** Finish the resumable operation in progress, persisting that none is
+         *
+         * @param status Outcome of the operation
+         * @return status, or the failure reason if it couldn't be persisted
+         */
+        int finish_operation(int status);
+
+        /** Block index of the open archive file
+         */
+        struct ArchiveState_t
+        {
+            bool open;
+            uint8_t filename;
+            uint32_t length;
+            uint16_t blocks;
+            uint16_t index_stride;
+            uint8_t index_count;
+            uint16_t index_address[ARCHIVE_INDEX_ENTRIES];
+            uint32_t index_offset[ARCHIVE_INDEX_ENTRIES];
+        };
+
+        /** Find the block index of an archive file, rebuilding it from the block
+         *  headers if the archive isn't already open
+         *
+         * @param filename ID of the archive file
+         * @return Indicates success or failure reason
+         */
+        int open_archive(uint8_t filename);
+
+        /** Record the address and uncompressed offset of a block in the archive's
+         *  block index, doubling the stride when the index is full
+         *
+         * @param address Address of the block's header
+         * @param offset Uncompressed offset of the block within the archive
+         */
+        void add_archive_index(uint16_t address, uint32_t offset);
+
+        /** Drop the RAM state of an RLE or archive file whose entries have been 
+         *  modified directly
+         *
+         * @param filename ID of the file
+         */
+        void close_file_state(uint8_t filename);
+
+        /** Get all File_t parameters and the file table address for a given filename
+         *
+         * @param filename ID of file to be retrieved
+         * @param &file Address of File_t object in which retrieved information
+         *              will be stored
+         * @param &address Address of integer value to which the file table address
+         *                 of the file will be stored
+         * @return Indicates success or failure reason
+         */
+        int get_file_table_entry(uint8_t filename, DataManager_FileSystem::File_t &file, int &address);
+
+        /** Find the journal record in which a file's metadata is staged
+         *
+         * @param filename ID of file to be found
+         * @return Index of the record within the journal, -1 if the file is not staged
+         */
+        int get_staged_file(uint8_t filename);
+
+        /** Write every journal record to the file table and then clear the journal
+         *
+         * @return Indicates success or failure reason
+         */
+        int apply_journal();
+
+        /** Determine the next available address to which to write file
+         *
+         * @param &next_available_address Address of integer value in which the address
+         *                                of the next available location in memory to which
+         *                                you can write a file is stored. -1 if 
+         *                                there are no available spaces
+         * @return Indicates success or failure reason
+         */
+        int get_next_available_file_table_address(int &next_available_address);
+
+        /** Modify a file's metadata
+         *
+         * @param filename ID of file to be modified
+         * @param file Updated version of file
+         * @return Indicates success or failure reason
+         */
+        int modify_file(uint8_t filename, DataManager_FileSystem::File_t file);  
+
+        /** Poll the device until it acknowledges its address, i.e. until its
+         *  internal write cycle has completed
+         *
+         * @return Indicates success or failure reason
+         */
+        int wait_for_write_cycle();
+
+        /** Wait for the write cycle left in progress by a pipelined write, if any
+         *
+         * @return Indicates success or failure reason
+         */
+        int complete_write_cycle();
+
+        /** Read from the EEPROM. When the read continues from the device's internal
+         *  address counter, e.g. whilst iterating entries or scanning the file table,
+         *  the address bytes are skipped by issuing a current address read
+         *
+         * @param address Address from which to read
+         * @param *data Pointer to an array in which the read data will be stored
+         * @param length Number of bytes to be read
+         * @return Indicates success or failure reason
+         */
+        int read_storage(uint16_t address, char *data, int length);
+
+        /** Write to the EEPROM under the retry policy, counting every retry and
+         *  its cost against the public call in progress
+         *
+         * @param address Address to which to write
+         * @param *data Data to be written
+         * @param length Number of bytes to be written
+         * @return Indicates success or failure reason
+         */
+        int write_with_retry(uint16_t address, char *data, int length);
+
+        /** Count a failed write attempt by its cause
+         *
+         * @param status Status of the failed attempt
+         */
+        void count_bus_fault(int status);
+
+        /** Write to the EEPROM and track the device's internal address counter
+         *
+         * @param address Address to which to write
+         * @param *data Data to be written
+         * @param length Number of bytes to be written
+         * @return Indicates success or failure reason
+         */
+        int write_storage(uint16_t address, char *data, int length);
+
+        /** Random read made directly on the bus, used by the adaptive clock
+         *
+         * @param address Address from which to read
+         * @param *data Pointer to an array in which the read data will be stored
+         * @param length Number of bytes to be read
+         * @return Indicates success or failure reason
+         */
+        int bus_read(uint16_t address, char *data, int length);
+
+        /** Page write made directly on the bus, used by the adaptive clock. Writes
+         *  are split at page boundaries and each write cycle is waited for
+         *
+         * @param address Address to which to write
+         * @param *data Data to be written
+         * @param length Number of bytes to be written
+         * @return Indicates success or failure reason
+         */
+        int bus_write(uint16_t address, char *data, int length);
+
+        /** Count the outcome of a transfer towards the adaptive clock's current 
+         *  window and step the clock down or up at the end of the window
+         *
+         * @param status Status of the transfer
+         * @return True if the transfer failed and stepped the clock down, so
+         *         it is worth retrying once at the slower rate
+         */
+        bool record_bus_result(int status);
+
+        /** Check that the adaptive clock's rate works before it is used by 
+         *  making ADAPTIVE_CLOCK_PROBE_READS reads, stepping down until they
+         *  all succeed or the slowest rate is reached. The device must not
+         *  be in a write cycle
+         */
+        void probe_clock_step();
+
+        /** Apply a rate from the adaptive clock's ladder
+         *
+         * @param step Index into ADAPTIVE_CLOCK_RATES_HZ
+         */
+        void set_clock_step(int step);
+
+        #if BOARD == DEVELOPMENT_BOARD_V1_1_0 || BOARD == WRIGHT_V1_0_0 || BOARD == EARHART_V1_0_0
+        STM24256 _storage;
+        #endif /* #if BOARD == ... */
+
+        /** Metadata changes staged by the open transaction
+         */
+        bool _transaction_open;
+        DataManager_FileSystem::Journal_t _journal;
+
+        /** RAM state of open RLE files
+         */
+        RleState_t _rle_files[RLE_MAX_OPEN_FILES];
+        int _rle_next_evict;
+
+        /** Open archive file and compression counters
+         */
+        ArchiveState_t _archive;
+        CompressionStats_t _compression_stats;
+
+        /** Truncation in progress through truncate_file_step() or a resumable
+         *  operation, and the resumable operation in progress
+         */
+        TruncateStep_t _truncate_step;
+        LongOperation_t _operation;
+
+        /** Whether or not the layout of the filesystem has been checked since boot
+         */
+        bool _layout_checked;
+
+        /** Bus shared with the EEPROM driver, write control pin, transmit buffer, 
+         *  the device's internal address counter if it is known and bus traffic 
+         *  counters. The counter is only tracked across transfers the DataManager
+         *  makes itself and driver reads, since a driver write may poll its write
+         *  cycles in ways that move the counter
+         */
+        I2C _i2c;
+        DigitalOut _write_control;
+        char _bus_tx[2 + PAGE_SIZE_BYTES];
+        bool _address_known;
+        uint16_t _address_pointer;
+        IoStats_t _io_stats;
+
+        /** Device timing measured from completed transfers and the address
+         *  counter followed through the call being estimated, or -1 if unknown
+         */
+        DeviceTiming_t _timing;
+        int _estimate_pointer;
+
+        /** State of the adaptive clock and the window currently being counted
+         */
+        int _frequency_hz;
+        bool _adaptive_clock;
+        bool _polling_write_cycle;
+
+        /** Pipelined writes, and whether the last of them is yet to be waited for
+         */
+        bool _pipelined_writes;
+        bool _write_cycle_pending;
+        int _clock_step;
+        int _clean_windows;
+        bool _clock_probe_pending;
+        int _history_next;
+        ClockWindow_t _window;
+        ClockStats_t _clock_stats;
+
+        /** Retry policy of writes and its counters
+         */
+        RetryPolicy_t _retry_policy;
+        RetryStats_t _retry_stats;
+
+        #if DEVICE_I2C_ASYNCH
+        /** State of the asynchronous operation in progress
+         */
+        Timeout _async_timeout;
+        volatile AsyncState _async_state;
+        Callback<void(int)> _async_done;
+        uint8_t _async_filename;
+        const char *_async_data;
+        char *_async_read_buffer;
+        int _async_entry_index;
+        int _async_length;
+        int _async_written;
+        int _async_table_offset;
+        int _async_polls;
+        uint16_t _async_file_address;
+        DataManager_FileSystem::File_t _async_file;
+        char _async_rx[PAGE_SIZE_BYTES];
+        #endif /* #if DEVICE_I2C_ASYNCH */
+
+        /** Scratch arena shared by all internal operations
+         */
+        char _scratch[DM_SCRATCH_ARENA_BYTES];
+        int _scratch_used;
+        int _scratch_peak;
+
+        /** Depth of nested public calls, the outermost call in progress and the
+         *  ring of recorded calls
+         */
+        int _api_depth;
+        uint8_t _api_op;
+        #if DM_TRACE == true
+        DataManager_FileSystem::TraceRecord_t _trace[DM_TRACE_ENTRIES];
+        int _trace_next;
+        int _trace_count;
+        #endif /* #if DM_TRACE == true */
+        #if DM_LATENCY_HISTOGRAMS == true
+        LatencyHistogram_t _latency[DataManager_FileSystem::TRACE_OPS];
+        #endif /* #if DM_LATENCY_HISTOGRAMS == true */
+        #if DM_ENERGY_MODEL == true
+        EnergyModel_t _energy_model;
+        EnergyStats_t _energy_stats;
+        #endif /* #if DM_ENERGY_MODEL == true */
+
+        /** Nodes of the span tree, the stack of nodes in progress, innermost
+         *  last, and the clock reading at which time was last charged
+         */
+        #if DM_SPANS == true
+        SpanNode_t _spans[DM_SPAN_NODES];
+        int _span_count;
+        int16_t _span_stack[DM_SPAN_DEPTH];
+        int _span_depth;
+        uint32_t _span_mark_ticks;
+        #endif /* #if DM_SPANS == true */
+
+        /** Running checksum, next page, held back page 0 and whether or not
+         *  begin_image_restore() has started an image restore
+         */
+        uint32_t _image_checksum;
+        int _image_page;
+        char _image_first_page[PAGE_SIZE_BYTES];
+        bool _image_restore_active;
 
 };
\ No newline at end of file
@@ -0,0 +1,432 @@
+/**
+  * @file    DataManager_Async.cpp
+  * @version 0.5.0
+  * @author  Adam Mitchell
+  * @brief   Asynchronous transfer layer of the DataManager. Drives multi-step
+  *          operations from I2C events so that the CPU is free during bus 
+  *          transactions and write cycles
+  */
+
+/** Includes
+ */
+#include "DataManager.h"
+
+#if DEVICE_I2C_ASYNCH
+
+/** Number of bytes of the file table read per transfer, a whole number of File_t
+ */
+#define ASYNC_FILE_TABLE_CHUNK ((PAGE_SIZE_BYTES / sizeof(DataManager_FileSystem::File_t)) * sizeof(DataManager_FileSystem::File_t))
+
+
+/** Append an entry using interrupt/DMA driven I2C transfers. The call returns
+ *  as soon as the first transfer has started; the file table lookup, data 
+ *  write, metadata write and the ACK polling after each write are then driven
+ *  by I2C events. No other DataManager call may be made, and *data must remain
+ *  valid, until done is called
+ *
+ * @param filename ID of the file to which we should append data
+ * @param *data Actual data to be written to file
+ * @param data_length Length of *data in bytes
+ * @param done Called from interrupt context with the final status
+ * @return Indicates success or failure reason of starting the operation
+ */
+int DataManager::append_file_entry_async(uint8_t filename, const char *data, int data_length, Callback<void(int)> done)
+{
+    ApiScope api(*this, DataManager_FileSystem::TRACE_APPEND_FILE_ENTRY_ASYNC, filename, 0, data_length);
+
+    if(_async_state != ASYNC_IDLE)
+    {
+        return api.done(DataManager_FileSystem::ASYNC_BUSY);
+    }
+
+    /** Staged metadata lives in RAM and can't be updated from interrupt context
+     */
+    if(_transaction_open)
+    {
+        return api.done(DataManager_FileSystem::TRANSACTION_CONFLICT);
+    }
+
+    _async_data = data;
+    _async_read_buffer = NULL;
+    _async_length = data_length;
+
+    return api.done(async_begin(filename, done));
+}
+
+/** Read consecutive entries using interrupt/DMA driven I2C transfers. The call 
+ *  returns as soon as the file table lookup has started. No other DataManager 
+ *  call may be made, and *data must remain valid, until done is called
+ *
+ * @param filename ID of the file from which we should read
+ * @param entry_index 0-indexed position of the first entry to be read
+ * @param entries Number of entries to be read
+ * @param *data Pointer to an array in which the read data will be stored
+ * @param data_length Length of *data in bytes, i.e. entries * entry length
+ * @param done Called from interrupt context with the final status
+ * @return Indicates success or failure reason of starting the operation
+ */
+int DataManager::read_file_entries_async(uint8_t filename, int entry_index, int entries, char *data, 
+                                         int data_length, Callback<void(int)> done)
+{
+    ApiScope api(*this, DataManager_FileSystem::TRACE_READ_FILE_ENTRIES_ASYNC, filename, entry_index, data_length);
+
+    if(_async_state != ASYNC_IDLE)
+    {
+        return api.done(DataManager_FileSystem::ASYNC_BUSY);
+    }
+
+    _async_data = NULL;
+    _async_read_buffer = data;
+    _async_entry_index = entry_index;
+    _async_written = entries;
+    _async_length = data_length;
+
+    return api.done(async_begin(filename, done));
+}
+
+/** Determine whether or not an asynchronous operation is in progress
+ *
+ * @return True if an asynchronous operation is in progress, else false
+ */
+bool DataManager::is_async_busy()
+{
+    return _async_state != ASYNC_IDLE;
+}
+
+/** Start the file table lookup shared by all asynchronous operations
+ *
+ * @param filename ID of the file to be looked up
+ * @param done Called from interrupt context with the final status
+ * @return Indicates success or failure reason
+ */
+int DataManager::async_begin(uint8_t filename, Callback<void(int)> done)
+{
+    /** Interrupt driven transfers don't poll for the write cycle of a pipelined write
+     */
+    int status = complete_write_cycle();
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return status;
+    }
+
+    _async_done = done;
+    _async_filename = filename;
+    _async_table_offset = 0;
+    _async_state = ASYNC_LOOKUP;
+
+    status = async_read_file_table();
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        _async_state = ASYNC_IDLE;
+        return status;
+    }
+
+    return DataManager::DATA_MANAGER_OK;
+}
+
+/** Handle an I2C event and start the next transfer of the asynchronous operation
+ *
+ * @param event I2C_EVENT_* flags of the completed transfer
+ */
+void DataManager::async_event(int event)
+{
+    bool complete = (event & I2C_EVENT_TRANSFER_COMPLETE) && !(event & (I2C_EVENT_ERROR | I2C_EVENT_ERROR_NO_SLAVE));
+    int status = DataManager::DATA_MANAGER_OK;
+
+    switch(_async_state)
+    {
+        case ASYNC_LOOKUP:
+        {
+            if(!complete)
+            {
+                async_finish(DataManager_FileSystem::ASYNC_TRANSFER_FAILED);
+                return;
+            }
+
+            int file_size = sizeof(DataManager_FileSystem::File_t);
+
+            for(int offset = 0; offset + file_size <= (int)ASYNC_FILE_TABLE_CHUNK; offset += file_size)
+            {
+                DataManager_FileSystem::File_t file;
+                memcpy(file.data, &_async_rx[offset], file_size);
+
+                if(!is_valid_file(file) || file.parameters.filename != _async_filename)
+                {
+                    continue;
+                }
+
+                _async_file = file;
+                _async_file_address = FILE_TABLE_START_ADDRESS + _async_table_offset + offset;
+
+                status = async_file_found();
+                break;
+            }
+
+            if(status == DataManager::DATA_MANAGER_OK && _async_state == ASYNC_LOOKUP)
+            {
+                _async_table_offset += ASYNC_FILE_TABLE_CHUNK;
+
+                if(_async_table_offset + file_size > FILE_TABLE_LENGTH)
+                {
+                    async_finish(DataManager_FileSystem::FILE_INVALID_NAME);
+                    return;
+                }
+
+                status = async_read_file_table();
+            }
+            break;
+        }
+
+        case ASYNC_DATA_READ:
+        {
+            async_finish(complete ? (int)DataManager::DATA_MANAGER_OK : (int)DataManager_FileSystem::ASYNC_TRANSFER_FAILED);
+            return;
+        }
+
+        case ASYNC_DATA_WRITE:
+        case ASYNC_METADATA_WRITE:
+        {
+            _write_control = 1;
+
+            if(!complete)
+            {
+                async_finish(DataManager_FileSystem::ASYNC_TRANSFER_FAILED);
+                return;
+            }
+
+            _async_state = (_async_state == ASYNC_DATA_WRITE) ? ASYNC_DATA_POLL : ASYNC_METADATA_POLL;
+            _async_polls = 0;
+
+            async_poll();
+            return;
+        }
+
+        case ASYNC_DATA_POLL:
+        case ASYNC_METADATA_POLL:
+        {
+            /** Still in its write cycle, so try again after the poll interval
+             */
+            if(!complete)
+            {
+                if(++_async_polls >= WRITE_CYCLE_POLL_ATTEMPTS)
+                {
+                    async_finish(DataManager_FileSystem::IMAGE_WRITE_CYCLE_TIMEOUT);
+                    return;
+                }
+
+                _async_timeout.attach_us(callback(this, &DataManager::async_poll), WRITE_CYCLE_POLL_INTERVAL_US);
+                return;
+            }
+
+            if(_async_state == ASYNC_METADATA_POLL)
+            {
+                if(_async_written < (int)sizeof(_async_file))
+                {
+                    _async_state = ASYNC_METADATA_WRITE;
+                    status = async_write_metadata();
+                    break;
+                }
+
+                async_finish(DataManager::DATA_MANAGER_OK);
+                return;
+            }
+
+            if(_async_written < _async_length)
+            {
+                _async_state = ASYNC_DATA_WRITE;
+                status = async_write_data();
+                break;
+            }
+
+            _async_file.parameters.next_available_address += _async_length;
+            _async_file.parameters.valid = DataManager_FileSystem::file_checksum(_async_file);
+            _async_written = 0;
+            _async_state = ASYNC_METADATA_WRITE;
+
+            status = async_write_metadata();
+            break;
+        }
+
+        default:
+            return;
+    }
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        async_finish(status);
+    }
+}
+
+/** Start a random read of the next chunk of the file table
+ *
+ * @return Indicates success or failure reason
+ */
+int DataManager::async_read_file_table()
+{
+    uint16_t address = FILE_TABLE_START_ADDRESS + _async_table_offset;
+    int length = ASYNC_FILE_TABLE_CHUNK;
+
+    if(_async_table_offset + length > FILE_TABLE_LENGTH)
+    {
+        length = FILE_TABLE_LENGTH - _async_table_offset;
+        memset(_async_rx, 0, ASYNC_FILE_TABLE_CHUNK);
+    }
+
+    _bus_tx[0] = (char)(address >> 8);
+    _bus_tx[1] = (char)(address & 0xFF);
+
+    if(_i2c.transfer(EEPROM_I2C_ADDRESS, _bus_tx, 2, _async_rx, length, 
+                     callback(this, &DataManager::async_event), I2C_EVENT_ALL) != 0)
+    {
+        return DataManager_FileSystem::ASYNC_TRANSFER_FAILED;
+    }
+
+    return DataManager::DATA_MANAGER_OK;
+}
+
+/** Validate the request against the file found by the lookup and start 
+ *  its first data transfer
+ *
+ * @return Indicates success or failure reason
+ */
+int DataManager::async_file_found()
+{
+    int entry_length = _async_file.parameters.length_bytes;
+
+    if(_async_read_buffer != NULL)
+    {
+        int written_entries = (_async_file.parameters.next_available_address - _async_file.parameters.file_start_address) / entry_length;
+
+        if(_async_entry_index < 0 || _async_written < 1 || _async_entry_index + _async_written > written_entries)
+        {
+            return DataManager_FileSystem::FILE_ENTRY_INVALID_INDEX;
+        }
+
+        if(_async_length != _async_written * entry_length)
+        {
+            return DataManager_FileSystem::FILE_ENTRY_LENGTH_MISMATCH;
+        }
+
+        uint16_t address = _async_file.parameters.file_start_address + (_async_entry_index * entry_length);
+
+        _bus_tx[0] = (char)(address >> 8);
+        _bus_tx[1] = (char)(address & 0xFF);
+        _async_state = ASYNC_DATA_READ;
+
+        if(_i2c.transfer(EEPROM_I2C_ADDRESS, _bus_tx, 2, _async_read_buffer, _async_length, 
+                         callback(this, &DataManager::async_event), I2C_EVENT_ALL) != 0)
+        {
+            return DataManager_FileSystem::ASYNC_TRANSFER_FAILED;
+        }
+
+        return DataManager::DATA_MANAGER_OK;
+    }
+
+    if(_async_length != entry_length)
+    {
+        return DataManager_FileSystem::FILE_ENTRY_LENGTH_MISMATCH;
+    }
+
+    if((_async_length - 1) + _async_file.parameters.next_available_address > _async_file.parameters.file_end_address)
+    {
+        return DataManager_FileSystem::FILE_ENTRY_FULL;
+    }
+
+    _async_written = 0;
+    _async_state = ASYNC_DATA_WRITE;
+
+    return async_write_data();
+}
+
+/** Start a write of the next chunk of data, up to the end of the current page
+ *
+ * @return Indicates success or failure reason
+ */
+int DataManager::async_write_data()
+{
+    uint16_t address = _async_file.parameters.next_available_address + _async_written;
+    int length = PAGE_SIZE_BYTES - (address % PAGE_SIZE_BYTES);
+
+    if(length > _async_length - _async_written)
+    {
+        length = _async_length - _async_written;
+    }
+
+    _bus_tx[0] = (char)(address >> 8);
+    _bus_tx[1] = (char)(address & 0xFF);
+    memcpy(&_bus_tx[2], &_async_data[_async_written], length);
+
+    _async_written += length;
+    _write_control = 0;
+
+    if(_i2c.transfer(EEPROM_I2C_ADDRESS, _bus_tx, 2 + length, NULL, 0, 
+                     callback(this, &DataManager::async_event), I2C_EVENT_ALL) != 0)
+    {
+        return DataManager_FileSystem::ASYNC_TRANSFER_FAILED;
+    }
+
+    return DataManager::DATA_MANAGER_OK;
+}
+
+/** Start a write of the next chunk of the updated File_t to the file table
+ *
+ * @return Indicates success or failure reason
+ */
+int DataManager::async_write_metadata()
+{
+    /** File_t records aren't page aligned, so one may straddle two pages
+     */
+    uint16_t address = _async_file_address + _async_written;
+    int length = PAGE_SIZE_BYTES - (address % PAGE_SIZE_BYTES);
+
+    if(length > (int)sizeof(_async_file) - _async_written)
+    {
+        length = sizeof(_async_file) - _async_written;
+    }
+
+    _bus_tx[0] = (char)(address >> 8);
+    _bus_tx[1] = (char)(address & 0xFF);
+    memcpy(&_bus_tx[2], &_async_file.data[_async_written], length);
+
+    _async_written += length;
+    _write_control = 0;
+
+    if(_i2c.transfer(EEPROM_I2C_ADDRESS, _bus_tx, 2 + length, NULL, 0, 
+                     callback(this, &DataManager::async_event), I2C_EVENT_ALL) != 0)
+    {
+        return DataManager_FileSystem::ASYNC_TRANSFER_FAILED;
+    }
+
+    return DataManager::DATA_MANAGER_OK;
+}
+
+/** Start a single byte read, which is NACKed until the write cycle completes
+ */
+void DataManager::async_poll()
+{
+    if(_i2c.transfer(EEPROM_I2C_ADDRESS, NULL, 0, _async_rx, 1, 
+                     callback(this, &DataManager::async_event), I2C_EVENT_ALL) != 0)
+    {
+        async_finish(DataManager_FileSystem::ASYNC_TRANSFER_FAILED);
+    }
+}
+
+/** Release the write control pin, return to idle and report the final status
+ *
+ * @param status Final status of the asynchronous operation
+ */
+void DataManager::async_finish(int status)
+{
+    _write_control = 1;
+    _address_known = false;
+    _async_state = ASYNC_IDLE;
+
+    if(_async_done)
+    {
+        _async_done(status);
+    }
+}
+
+#endif /* #if DEVICE_I2C_ASYNCH */
@@ -0,0 +1,426 @@
+/**
+  * @file    DataManager_Coroutine.h
+  * @version 0.5.0
+  * @author  Adam Mitchell
+  * @brief   C++20 coroutine front end of the DataManager. Awaitable storage
+  *          operations suspend across bus transfers and write cycles on top of
+  *          the asynchronous transfer layer, scheduled without heap allocation
+  */
+
+/** Define to prevent recursive inclusion
+ */
+#pragma once
+
+/** Includes
+ */
+#include "DataManager.h"
+
+#if DEVICE_I2C_ASYNCH && defined(__cpp_impl_coroutine)
+
+#include <coroutine>
+#include <stddef.h>
+
+/** Number of coroutines that may exist at once and the size of the statically
+ *  allocated frame of each; a Task whose frame doesn't fit is never started
+ */
+#ifndef DM_COROUTINE_MAX_TASKS
+    #define DM_COROUTINE_MAX_TASKS     8
+#endif /* #ifndef DM_COROUTINE_MAX_TASKS */
+
+#ifndef DM_COROUTINE_FRAME_BYTES
+    #define DM_COROUTINE_FRAME_BYTES   512
+#endif /* #ifndef DM_COROUTINE_FRAME_BYTES */
+
+namespace DataManager_Coroutine
+{
+    class Scheduler;
+
+    /** Fixed pool of coroutine frames, used in place of the heap
+     */
+    class FramePool
+    {
+        public:
+            /** Take a free frame from the pool
+             *
+             * @param size Size of the coroutine frame in bytes
+             * @return Pointer to the frame or NULL if none is free or it is too small
+             */
+            static void *allocate(size_t size)
+            {
+                if(size > DM_COROUTINE_FRAME_BYTES)
+                {
+                    return NULL;
+                }
+
+                for(int frame = 0; frame < DM_COROUTINE_MAX_TASKS; frame++)
+                {
+                    if(!_used[frame])
+                    {
+                        _used[frame] = true;
+                        return _frames[frame].data;
+                    }
+                }
+
+                return NULL;
+            }
+
+            /** Return a frame to the pool
+             *
+             * @param *frame Pointer previously returned by allocate()
+             */
+            static void release(void *frame)
+            {
+                for(int index = 0; index < DM_COROUTINE_MAX_TASKS; index++)
+                {
+                    if(_frames[index].data == frame)
+                    {
+                        _used[index] = false;
+                        return;
+                    }
+                }
+            }
+
+        private:
+            struct Frame
+            {
+                alignas(max_align_t) char data[DM_COROUTINE_FRAME_BYTES];
+            };
+
+            static inline Frame _frames[DM_COROUTINE_MAX_TASKS];
+            static inline bool _used[DM_COROUTINE_MAX_TASKS];
+    };
+
+    /** Coroutine handed to Scheduler::spawn(). It starts suspended and its frame
+     *  is returned to the pool when it runs to completion
+     */
+    class Task
+    {
+        public:
+            struct promise_type
+            {
+                static void *operator new(size_t size) noexcept
+                {
+                    return FramePool::allocate(size);
+                }
+
+                static void operator delete(void *frame) noexcept
+                {
+                    FramePool::release(frame);
+                }
+
+                static Task get_return_object_on_allocation_failure()
+                {
+                    return Task();
+                }
+
+                Task get_return_object()
+                {
+                    return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+                }
+
+                std::suspend_always initial_suspend() noexcept
+                {
+                    return {};
+                }
+
+                std::suspend_never final_suspend() noexcept
+                {
+                    return {};
+                }
+
+                void return_void() {}
+
+                void unhandled_exception() {}
+            };
+
+            Task() : handle() {}
+
+            explicit Task(std::coroutine_handle<> coroutine) : handle(coroutine) {}
+
+            /** Determine whether or not a frame was available for the coroutine
+             *
+             * @return True if the coroutine was created, else false
+             */
+            bool is_valid()
+            {
+                return (bool)handle;
+            }
+
+            std::coroutine_handle<> handle;
+    };
+
+    /** Awaitable storage operation. Operations wait in FIFO order for the bus
+     *  and resume their coroutine through the scheduler once complete
+     */
+    class Operation
+    {
+        public:
+            Operation(Scheduler &scheduler, uint8_t filename, const char *data, int data_length) :
+                      _scheduler(scheduler), _filename(filename), _data(data), _read_buffer(NULL),
+                      _entry_index(0), _entries(0), _data_length(data_length),
+                      _status(DataManager::DATA_MANAGER_OK), _next(NULL) {}
+
+            Operation(Scheduler &scheduler, uint8_t filename, int entry_index, int entries, char *data, int data_length) :
+                      _scheduler(scheduler), _filename(filename), _data(NULL), _read_buffer(data),
+                      _entry_index(entry_index), _entries(entries), _data_length(data_length),
+                      _status(DataManager::DATA_MANAGER_OK), _next(NULL) {}
+
+            bool await_ready()
+            {
+                return false;
+            }
+
+            inline bool await_suspend(std::coroutine_handle<> coroutine);
+
+            /** @return Indicates success or failure reason of the operation
+             */
+            int await_resume()
+            {
+                return _status;
+            }
+
+        private:
+            friend class Scheduler;
+
+            /** Start the asynchronous transfer of this operation
+             *
+             * @return Indicates success or failure reason of starting the operation
+             */
+            inline int start();
+
+            /** Record the final status and make the coroutine ready. Called from
+             *  interrupt context
+             *
+             * @param status Final status of the operation
+             */
+            inline void complete(int status);
+
+            Scheduler &_scheduler;
+            uint8_t _filename;
+            const char *_data;
+            char *_read_buffer;
+            int _entry_index;
+            int _entries;
+            int _data_length;
+            int _status;
+            Operation *_next;
+            std::coroutine_handle<> _coroutine;
+    };
+
+    /** Single-threaded, allocation-free scheduler for coroutines performing
+     *  storage operations on one DataManager
+     */
+    class Scheduler
+    {
+        public:
+            explicit Scheduler(DataManager &data_manager) : _data_manager(data_manager), _ready_head(0),
+                                                           _ready_count(0), _waiting_head(NULL), _waiting_tail(NULL) {}
+
+            /** Queue a coroutine to be run
+             *
+             * @param task Coroutine to be run
+             * @return False if the coroutine has no frame or the ready queue is full
+             */
+            bool spawn(Task task)
+            {
+                if(!task.is_valid())
+                {
+                    return false;
+                }
+
+                return post(task.handle);
+            }
+
+            /** Append an entry to a file, suspending until it is complete
+             *
+             * @param filename ID of the file to which we should append data
+             * @param *data Actual data to be written to file
+             * @param data_length Length of *data in bytes
+             * @return Awaitable operation yielding the status
+             */
+            Operation append(uint8_t filename, const char *data, int data_length)
+            {
+                return Operation(*this, filename, data, data_length);
+            }
+
+            /** Read consecutive entries from a file, suspending until they are read
+             *
+             * @param filename ID of the file from which we should read
+             * @param entry_index 0-indexed position of the first entry to be read
+             * @param entries Number of entries to be read
+             * @param *data Pointer to an array in which the read data will be stored
+             * @param data_length Length of *data in bytes, i.e. entries * entry length
+             * @return Awaitable operation yielding the status
+             */
+            Operation read_range(uint8_t filename, int entry_index, int entries, char *data, int data_length)
+            {
+                return Operation(*this, filename, entry_index, entries, data, data_length);
+            }
+
+            /** Resume one ready coroutine, then hand the bus to the next waiting
+             *  operation if it is free
+             *
+             * @return True if a coroutine was resumed, else false
+             */
+            bool run_once()
+            {
+                std::coroutine_handle<> coroutine;
+
+                core_util_critical_section_enter();
+
+                bool ready = _ready_count > 0;
+
+                if(ready)
+                {
+                    coroutine = _ready[_ready_head];
+                    _ready_head = (_ready_head + 1) % DM_COROUTINE_MAX_TASKS;
+                    _ready_count = _ready_count - 1;
+                }
+
+                core_util_critical_section_exit();
+
+                if(ready)
+                {
+                    coroutine.resume();
+                }
+
+                start_waiting();
+
+                return ready;
+            }
+
+            /** Run coroutines until none are ready and no operation is in progress
+             *  or waiting for the bus
+             */
+            void run()
+            {
+                while(run_once() || _ready_count > 0 || _waiting_head != NULL || _data_manager.is_async_busy())
+                {
+                }
+            }
+
+        private:
+            friend class Operation;
+
+            /** Add a coroutine to the ready queue. Safe to call from interrupt context
+             *
+             * @param coroutine Coroutine to be resumed
+             * @return False if the ready queue is full
+             */
+            bool post(std::coroutine_handle<> coroutine)
+            {
+                core_util_critical_section_enter();
+
+                bool posted = _ready_count < DM_COROUTINE_MAX_TASKS;
+
+                if(posted)
+                {
+                    _ready[(_ready_head + _ready_count) % DM_COROUTINE_MAX_TASKS] = coroutine;
+                    _ready_count = _ready_count + 1;
+                }
+
+                core_util_critical_section_exit();
+
+                return posted;
+            }
+
+            /** Start waiting operations in order while the bus is free
+             */
+            void start_waiting()
+            {
+                while(_waiting_head != NULL && !_data_manager.is_async_busy())
+                {
+                    Operation *operation = _waiting_head;
+                    _waiting_head = operation->_next;
+
+                    if(_waiting_head == NULL)
+                    {
+                        _waiting_tail = NULL;
+                    }
+
+                    int status = operation->start();
+
+                    if(status != DataManager::DATA_MANAGER_OK)
+                    {
+                        operation->_status = status;
+                        post(operation->_coroutine);
+                    }
+                }
+            }
+
+            DataManager &_data_manager;
+            std::coroutine_handle<> _ready[DM_COROUTINE_MAX_TASKS];
+            volatile int _ready_head;
+            volatile int _ready_count;
+            Operation *_waiting_head;
+            Operation *_waiting_tail;
+    };
+
+    /** Start the operation if the bus is free, otherwise join the back of the
+     *  queue of waiting operations
+     *
+     * @param coroutine Coroutine awaiting this operation
+     * @return False if the operation failed to start and the coroutine should
+     *         continue immediately
+     */
+    bool Operation::await_suspend(std::coroutine_handle<> coroutine)
+    {
+        _coroutine = coroutine;
+
+        if(_scheduler._waiting_head != NULL || _scheduler._data_manager.is_async_busy())
+        {
+            if(_scheduler._waiting_tail != NULL)
+            {
+                _scheduler._waiting_tail->_next = this;
+            }
+            else
+            {
+                _scheduler._waiting_head = this;
+            }
+
+            _scheduler._waiting_tail = this;
+            return true;
+        }
+
+        /** The transfer may complete, and set _status, before start() returns
+         */
+        int status = start();
+
+        if(status != DataManager::DATA_MANAGER_OK)
+        {
+            _status = status;
+            return false;
+        }
+
+        return true;
+    }
+
+    /** Start the asynchronous transfer of this operation
+     *
+     * @return Indicates success or failure reason of starting the operation
+     */
+    int Operation::start()
+    {
+        if(_read_buffer != NULL)
+        {
+            return _scheduler._data_manager.read_file_entries_async(_filename, _entry_index, _entries, _read_buffer,
+                                                                    _data_length, callback(this, &Operation::complete));
+        }
+
+        return _scheduler._data_manager.append_file_entry_async(_filename, _data, _data_length,
+                                                                callback(this, &Operation::complete));
+    }
+
+    /** Record the final status and make the coroutine ready. Called from
+     *  interrupt context
+     *
+     * @param status Final status of the operation
+     */
+    void Operation::complete(int status)
+    {
+        _status = status;
+        _scheduler.post(_coroutine);
+    }
+} // namespace DataManager_Coroutine
+
+#endif /* #if DEVICE_I2C_ASYNCH && defined(__cpp_impl_coroutine) */
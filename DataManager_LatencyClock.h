@@ -0,0 +1,71 @@
+/**
+  * @file    DataManager_LatencyClock.h
+  * @version 0.5.0
+  * @author  Adam Mitchell
+  * @brief   Free-running clock used to time public calls. Counts core cycles with
+  *          the DWT cycle counter on Cortex-M3 and above, nanoseconds from
+  *          std::chrono on a host and falls back to the microsecond ticker
+  *          elsewhere, e.g. on Cortex-M0+ or in the simulator, which defines
+  *          DM_LATENCY_CLOCK_US_TICKER so that calls are timed in simulated time
+  */
+
+/** Define to prevent recursive inclusion
+ */
+#pragma once
+
+/** Includes
+ */
+#include <mbed.h>
+
+#if !defined(DM_LATENCY_CLOCK_US_TICKER) && !defined(__MBED__)
+    #include <chrono>
+#endif /* #if !defined(DM_LATENCY_CLOCK_US_TICKER) && !defined(__MBED__) */
+
+namespace DataManager_LatencyClock
+{
+    /** Start the clock; harmless if it is already running
+     */
+    inline void start()
+    {
+        #if !defined(DM_LATENCY_CLOCK_US_TICKER) && defined(__CORTEX_M) && (__CORTEX_M >= 3)
+        CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+        DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+        #endif
+    }
+
+    /** Read the clock. Wraps at 32 bits, i.e. after at least 4 seconds
+     *
+     * @return Current value in ticks
+     */
+    inline uint32_t now()
+    {
+        #if defined(DM_LATENCY_CLOCK_US_TICKER)
+        return us_ticker_read();
+        #elif defined(__CORTEX_M) && (__CORTEX_M >= 3)
+        return DWT->CYCCNT;
+        #elif !defined(__MBED__)
+        return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         std::chrono::steady_clock::now().time_since_epoch()).count();
+        #else
+        return us_ticker_read();
+        #endif
+    }
+
+    /** Convert a number of ticks to microseconds
+     *
+     * @param ticks Difference of two readings of now()
+     * @return Microseconds
+     */
+    inline uint32_t to_us(uint32_t ticks)
+    {
+        #if defined(DM_LATENCY_CLOCK_US_TICKER)
+        return ticks;
+        #elif defined(__CORTEX_M) && (__CORTEX_M >= 3)
+        return ticks / (SystemCoreClock / 1000000);
+        #elif !defined(__MBED__)
+        return ticks / 1000;
+        #else
+        return ticks;
+        #endif
+    }
+}
@@ -0,0 +1,493 @@
+/**
+  * @file    DataManager_Scheduler.cpp
+  * @version 0.5.0
+  * @author  Adam Mitchell
+  * @brief   Deadline-aware request queue in front of the DataManager. Queued
+  *          requests run in priority order, earliest deadline first within a
+  *          priority, and a request that writes is deferred whenever its
+  *          estimated cost would put a write cycle inside a blackout window,
+  *          e.g. a LoRa RX1/RX2 receive window. Long requests run in steps of
+  *          at most one page, between which a higher priority request may run
+  */
+
+/** Includes
+ */
+#include "DataManager_Scheduler.h"
+
+
+/** Constructor for the DataManager_Scheduler class
+ *
+ * @param &data_manager DataManager on which requests are run
+ */
+DataManager_Scheduler::DataManager_Scheduler(DataManager &data_manager) :
+                                             _data_manager(data_manager),
+                                             _queued(0),
+                                             _last_stepped(NULL),
+                                             _window_count(0)
+{
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+/** Add a window during which no write cycle may be in progress. Times are
+ *  those of us_ticker_read(), which is simulated time in the simulator
+ *
+ * @param start_us Time at which the window opens
+ * @param length_us Length of the window
+ * @return Indicates success or failure reason
+ */
+int DataManager_Scheduler::add_blackout(uint32_t start_us, uint32_t length_us)
+{
+    prune_windows(us_ticker_read());
+
+    if(_window_count >= DM_SCHEDULER_WINDOWS)
+    {
+        return DataManager_FileSystem::SCHEDULER_TOO_MANY_WINDOWS;
+    }
+
+    _windows[_window_count].start_us = start_us;
+    _windows[_window_count].end_us = start_us + length_us;
+    _window_count++;
+
+    return DataManager::DATA_MANAGER_OK;
+}
+
+/** Remove all blackout windows
+ */
+void DataManager_Scheduler::clear_blackouts()
+{
+    _window_count = 0;
+}
+
+/** Queue a request; may be called from interrupt context, e.g. by a
+ *  radio driver, whilst run() is making a step. The cost of a step that
+ *  writes is estimated once a blackout window is pending and, if the
+ *  estimate fails, e.g. because queued appends have yet to write the
+ *  entries it truncates, again each time it is considered to run
+ *
+ * @param &request Request to be queued
+ * @return Indicates success or failure reason
+ */
+int DataManager_Scheduler::submit(DataManager_Scheduler::Request_t &request)
+{
+    switch(request.op)
+    {
+        case DataManager_FileSystem::TRACE_APPEND_FILE_ENTRY:
+        case DataManager_FileSystem::TRACE_READ_FILE_ENTRY:
+            if(request.params.count < 1)
+            {
+                return DataManager_FileSystem::FILE_ENTRY_INVALID_INDEX;
+            }
+            break;
+
+        case DataManager_FileSystem::TRACE_OVERWRITE_FILE_ENTRIES:
+        case DataManager_FileSystem::TRACE_TRUNCATE_FILE:
+        case DataManager_FileSystem::TRACE_DELETE_FILE_ENTRIES:
+            break;
+
+        default:
+            return DataManager_FileSystem::SCHEDULER_UNSUPPORTED_OP;
+    }
+
+    if(request.state == REQUEST_QUEUED || request.state == REQUEST_RUNNING)
+    {
+        return DataManager_FileSystem::SCHEDULER_REQUEST_QUEUED;
+    }
+
+    request.status = DataManager::DATA_MANAGER_OK;
+    request.progress = 0;
+    request.deferred = false;
+    request.missed_deadline = false;
+    request.submitted_us = us_ticker_read();
+    request.started_us = 0;
+    request.completed_us = 0;
+    request.estimated = false;
+
+    core_util_critical_section_enter();
+
+    if(_queued >= DM_SCHEDULER_QUEUE_LENGTH)
+    {
+        core_util_critical_section_exit();
+        return DataManager_FileSystem::SCHEDULER_QUEUE_FULL;
+    }
+
+    request.state = REQUEST_QUEUED;
+    _queue[_queued++] = &request;
+
+    core_util_critical_section_exit();
+
+    return DataManager::DATA_MANAGER_OK;
+}
+
+/** Run queued requests until none may run now. Call from the main loop,
+ *  or at wake_us, after submitting requests
+ *
+ * @param &pending Address of integer to which the number of requests still queued will be written
+ * @param &wake_us Address of integer to which the time at which a deferred request may run will be written, valid if pending is non-zero
+ * @return Indicates success or failure reason
+ */
+int DataManager_Scheduler::run(int &pending, uint32_t &wake_us)
+{
+    bool stepped = true;
+
+    while(stepped)
+    {
+        int status = run_step(stepped, pending, wake_us);
+
+        if(status != DataManager::DATA_MANAGER_OK)
+        {
+            return status;
+        }
+    }
+
+    return DataManager::DATA_MANAGER_OK;
+}
+
+/** Make one step of the highest ranked request that may run now, e.g.
+ *  to check for other work between the steps of a long request
+ *
+ * @param &stepped Address of boolean to which whether a step was made will be written
+ * @param &pending Address of integer to which the number of requests still queued will be written
+ * @param &wake_us Address of integer to which the time at which a deferred request may run will be written, valid if no step was made and pending is non-zero
+ * @return Indicates success or failure reason
+ */
+int DataManager_Scheduler::run_step(bool &stepped, int &pending, uint32_t &wake_us)
+{
+    stepped = false;
+
+    while(true)
+    {
+        uint32_t now_us = us_ticker_read();
+        prune_windows(now_us);
+
+        /** Requests submitted from interrupt context are only ever added to
+         *  the end of the queue, so the ones counted here stay put
+         */
+        int queued = _queued;
+        int next = -1;
+        bool deferred = false;
+
+        for(int index = 0; index < queued; index++)
+        {
+            Request_t &request = *_queue[index];
+
+            if((next >= 0 && !runs_before(request, *_queue[next], now_us)) || waiting(index, queued))
+            {
+                continue;
+            }
+
+            /** Reads never wait, and nothing waits while no window is pending
+             */
+            if(_window_count > 0 && request.op != DataManager_FileSystem::TRACE_READ_FILE_ENTRY &&
+               (!request.estimated || (request.estimate_status != DataManager::DATA_MANAGER_OK &&
+                                       request.estimate_status != DataManager_FileSystem::OPERATION_IN_PROGRESS)))
+            {
+                /** Only the next step is estimated: estimate_cost() prices one
+                 *  entry of an append, and a truncation is estimated afresh
+                 *  before each of its steps
+                 */
+                DataManager_FileSystem::TraceOp op = (request.op == DataManager_FileSystem::TRACE_TRUNCATE_FILE) ?
+                                                     DataManager_FileSystem::TRACE_TRUNCATE_FILE_STEP : request.op;
+
+                request.estimate_status = _data_manager.estimate_cost(op, request.filename, request.params, request.estimate);
+                request.estimated = true;
+            }
+
+            uint32_t until_us;
+
+            if(blocked(request, now_us, until_us))
+            {
+                if(!request.deferred)
+                {
+                    request.deferred = true;
+                    _stats.deferred++;
+                }
+
+                if(!deferred || (int32_t)(until_us - wake_us) < 0)
+                {
+                    wake_us = until_us;
+                    deferred = true;
+                }
+
+                continue;
+            }
+
+            next = index;
+        }
+
+        if(next < 0)
+        {
+            pending = _queued;
+
+            if(!deferred)
+            {
+                wake_us = now_us;
+            }
+
+            return DataManager::DATA_MANAGER_OK;
+        }
+
+        /** Estimating the requests considered takes time, so check the one
+         *  chosen against the clock again and choose afresh if it must wait
+         */
+        uint32_t until_us;
+
+        if(blocked(*_queue[next], us_ticker_read(), until_us))
+        {
+            continue;
+        }
+
+        Request_t &request = *_queue[next];
+
+        if(_last_stepped != NULL && _last_stepped != &request && _last_stepped->state == REQUEST_RUNNING)
+        {
+            _stats.preemptions++;
+        }
+
+        _last_stepped = &request;
+
+        DataManager::IoStats_t io_stats;
+        _data_manager.get_io_stats(io_stats);
+        uint32_t start_write_cycles = io_stats.write_cycles;
+        uint32_t start_us = us_ticker_read();
+
+        if(request.state == REQUEST_QUEUED)
+        {
+            request.started_us = start_us;
+            request.state = REQUEST_RUNNING;
+        }
+
+        int status = execute_step(request);
+        uint32_t end_us = us_ticker_read();
+
+        _data_manager.get_io_stats(io_stats);
+        _stats.steps++;
+        stepped = true;
+
+        /** Record any write cycle that did land in a window, i.e. an estimate
+         *  that fell short by more than the guard time
+         */
+        if(io_stats.write_cycles != start_write_cycles)
+        {
+            for(int window = 0; window < _window_count; window++)
+            {
+                if((int32_t)(_windows[window].start_us - end_us) < 0 &&
+                   (int32_t)(_windows[window].end_us - start_us) > 0)
+                {
+                    _stats.window_overlaps++;
+                    break;
+                }
+            }
+        }
+
+        if(status == DataManager_FileSystem::OPERATION_IN_PROGRESS)
+        {
+            pending = _queued;
+            wake_us = end_us;
+
+            return DataManager::DATA_MANAGER_OK;
+        }
+
+        /** Remove the finished request, keeping the queue in submission order
+         *  so that ties run first come, first served
+         */
+        core_util_critical_section_enter();
+
+        for(int index = next; index < _queued - 1; index++)
+        {
+            _queue[index] = _queue[index + 1];
+        }
+
+        _queued--;
+        pending = _queued;
+
+        core_util_critical_section_exit();
+
+        request.status = status;
+        request.completed_us = end_us;
+
+        if(request.has_deadline && (int32_t)(request.completed_us - request.deadline_us) > 0)
+        {
+            request.missed_deadline = true;
+            _stats.deadline_misses++;
+        }
+
+        _stats.completed++;
+        request.state = REQUEST_DONE;
+        wake_us = end_us;
+
+        return DataManager::DATA_MANAGER_OK;
+    }
+}
+
+/** Get the outcome of the requests run since the last reset_stats()
+ *
+ * @param &stats Address of SchedulerStats_t to which the stats will be written
+ */
+void DataManager_Scheduler::get_stats(DataManager_Scheduler::SchedulerStats_t &stats)
+{
+    stats = _stats;
+}
+
+/** Reset the stats
+ */
+void DataManager_Scheduler::reset_stats()
+{
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+/** Drop the windows that have closed
+ *
+ * @param now_us Current time
+ */
+void DataManager_Scheduler::prune_windows(uint32_t now_us)
+{
+    int kept = 0;
+
+    for(int window = 0; window < _window_count; window++)
+    {
+        if((int32_t)(_windows[window].end_us - now_us) > 0)
+        {
+            _windows[kept++] = _windows[window];
+        }
+    }
+
+    _window_count = kept;
+}
+
+/** Determine whether or not a request must wait for other requests: any
+ *  on the same file that is part way through, any earlier write to the
+ *  same file if it writes, so that writes to a file keep their order,
+ *  and any truncation part way through if it truncates
+ *
+ * @param index Position of the request in the queue
+ * @param queued Number of requests in the queue
+ * @return True if the request can't start yet
+ */
+bool DataManager_Scheduler::waiting(int index, int queued)
+{
+    const Request_t &request = *_queue[index];
+
+    if(request.state == REQUEST_RUNNING)
+    {
+        return false;
+    }
+
+    bool writes = request.op != DataManager_FileSystem::TRACE_READ_FILE_ENTRY;
+
+    for(int other_index = 0; other_index < queued; other_index++)
+    {
+        const Request_t &other = *_queue[other_index];
+        bool other_writes = other.op != DataManager_FileSystem::TRACE_READ_FILE_ENTRY;
+
+        if(other.state == REQUEST_RUNNING && (other.filename == request.filename || 
+           (other.op == DataManager_FileSystem::TRACE_TRUNCATE_FILE && request.op == DataManager_FileSystem::TRACE_TRUNCATE_FILE)))
+        {
+            return true;
+        }
+
+        if(other_index < index && writes && other_writes && other.filename == request.filename)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/** Determine whether or not the next step of a request must wait for a blackout window
+ *
+ * @param &request The request
+ * @param now_us Current time
+ * @param &until_us Address of integer to which the end of the window will be written
+ * @return True if the step would put a write cycle inside a window
+ */
+bool DataManager_Scheduler::blocked(const DataManager_Scheduler::Request_t &request, uint32_t now_us, uint32_t &until_us)
+{
+    /** A call that writes nothing may run at any time. One whose estimate
+     *  failed is assumed to write, so that it can't slip into a window
+     */
+    bool estimated = request.estimate_status == DataManager::DATA_MANAGER_OK ||
+                     request.estimate_status == DataManager_FileSystem::OPERATION_IN_PROGRESS;
+
+    if(request.op == DataManager_FileSystem::TRACE_READ_FILE_ENTRY || (estimated && request.estimate.write_cycles == 0))
+    {
+        return false;
+    }
+
+    int32_t duration_us = (int32_t)(request.estimate.time_us + DM_SCHEDULER_GUARD_US);
+
+    for(int window = 0; window < _window_count; window++)
+    {
+        if((int32_t)(_windows[window].start_us - now_us) < duration_us &&
+           (int32_t)(_windows[window].end_us - now_us) > 0)
+        {
+            until_us = _windows[window].end_us;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/** Determine whether or not a request should run before another
+ *
+ * @param &request The request
+ * @param &other The other request
+ * @param now_us Current time
+ * @return True if request has a higher priority or, at equal priority, an earlier deadline
+ */
+bool DataManager_Scheduler::runs_before(const DataManager_Scheduler::Request_t &request,
+                                        const DataManager_Scheduler::Request_t &other, uint32_t now_us)
+{
+    if(request.priority != other.priority)
+    {
+        return request.priority > other.priority;
+    }
+
+    if(request.has_deadline != other.has_deadline)
+    {
+        return request.has_deadline;
+    }
+
+    return request.has_deadline && (int32_t)(request.deadline_us - now_us) < (int32_t)(other.deadline_us - now_us);
+}
+
+/** Make the next step of a request
+ *
+ * @param &request The request
+ * @return OPERATION_IN_PROGRESS or the status of the request
+ */
+int DataManager_Scheduler::execute_step(DataManager_Scheduler::Request_t &request)
+{
+    int status;
+    int entry = request.progress;
+    char *data = request.data + (entry * request.params.length);
+
+    switch(request.op)
+    {
+        case DataManager_FileSystem::TRACE_APPEND_FILE_ENTRY:
+            status = _data_manager.append_file_entry(request.filename, data, request.params.length);
+            break;
+
+        case DataManager_FileSystem::TRACE_READ_FILE_ENTRY:
+            status = _data_manager.read_file_entry(request.filename, request.params.index + entry, data, request.params.length);
+            break;
+
+        case DataManager_FileSystem::TRACE_TRUNCATE_FILE:
+            request.estimated = false;
+            return _data_manager.truncate_file_step(request.filename, request.params.index);
+
+        case DataManager_FileSystem::TRACE_OVERWRITE_FILE_ENTRIES:
+            return _data_manager.overwrite_file_entries(request.filename, request.data, request.params.length);
+
+        default:
+            return _data_manager.delete_file_entries(request.filename);
+    }
+
+    if(status == DataManager::DATA_MANAGER_OK && ++request.progress < request.params.count)
+    {
+        return DataManager_FileSystem::OPERATION_IN_PROGRESS;
+    }
+
+    return status;
+}
@@ -0,0 +1,229 @@
+/**
+  * @file    DataManager_Scheduler.h
+  * @version 0.5.0
+  * @author  Adam Mitchell
+  * @brief   Deadline-aware request queue in front of the DataManager. Queued
+  *          requests run in priority order, earliest deadline first within a
+  *          priority, and a request that writes is deferred whenever its
+  *          estimated cost would put a write cycle inside a blackout window,
+  *          e.g. a LoRa RX1/RX2 receive window. Long requests run in steps of
+  *          at most one page, between which a higher priority request may run
+  */
+
+/** Define to prevent recursive inclusion
+ */
+#pragma once
+
+/** Includes
+ */
+#include "DataManager.h"
+
+/** Number of requests that may be queued at once
+ */
+#ifndef DM_SCHEDULER_QUEUE_LENGTH
+    #define DM_SCHEDULER_QUEUE_LENGTH  16
+#endif /* #ifndef DM_SCHEDULER_QUEUE_LENGTH */
+
+/** Number of blackout windows that may be pending at once
+ */
+#ifndef DM_SCHEDULER_WINDOWS
+    #define DM_SCHEDULER_WINDOWS       4
+#endif /* #ifndef DM_SCHEDULER_WINDOWS */
+
+/** Margin added to the estimated duration of a request that writes before it
+ *  is compared with the next blackout window, covering estimate error and the
+ *  time taken to schedule it
+ */
+#ifndef DM_SCHEDULER_GUARD_US
+    #define DM_SCHEDULER_GUARD_US      1000
+#endif /* #ifndef DM_SCHEDULER_GUARD_US */
+
+class DataManager_Scheduler
+{
+    public:
+        /** State of a request
+         */
+        enum RequestState
+        {
+            REQUEST_IDLE                     = 0,
+            REQUEST_QUEUED                   = 1,
+            REQUEST_RUNNING                  = 2,
+            REQUEST_DONE                     = 3
+        };
+
+        /** Priority classes of a request; any value may be used and higher
+         *  values run first
+         */
+        enum RequestPriority
+        {
+            PRIORITY_BULK                    = 0,
+            PRIORITY_NORMAL                  = 64,
+            PRIORITY_URGENT                  = 128
+        };
+
+        /** A call to be scheduled. The request is owned by the caller, must be
+         *  zeroed before it is first submitted and must remain valid, along
+         *  with *data, until its state is REQUEST_DONE
+         */
+        struct Request_t
+        {
+            /** Set by the caller; op is one of TRACE_APPEND_FILE_ENTRY, which
+             *  appends params.count entries from *data one per step,
+             *  TRACE_READ_FILE_ENTRY, which reads params.count entries from
+             *  params.index into *data one per step, TRACE_TRUNCATE_FILE, which
+             *  removes the first params.index entries one page per step,
+             *  TRACE_OVERWRITE_FILE_ENTRIES or TRACE_DELETE_FILE_ENTRIES
+             */
+            DataManager_FileSystem::TraceOp op;
+            uint8_t filename;
+            DataManager::CostParams_t params;
+            char *data;
+            uint8_t priority;
+            bool has_deadline;
+            uint32_t deadline_us;
+
+            /** Set by the scheduler
+             */
+            RequestState state;
+            int status;
+            int progress;
+            bool estimated;
+            int estimate_status;
+            bool deferred;
+            bool missed_deadline;
+            uint32_t submitted_us;
+            uint32_t started_us;
+            uint32_t completed_us;
+            DataManager::CostEstimate_t estimate;
+        };
+
+        /** Outcome of the requests run since the last reset_stats()
+         */
+        struct SchedulerStats_t
+        {
+            uint32_t completed;
+            uint32_t steps;
+            uint32_t preemptions;
+            uint32_t deferred;
+            uint32_t deadline_misses;
+            uint32_t window_overlaps;
+        };
+
+        /** Constructor for the DataManager_Scheduler class
+         *
+         * @param &data_manager DataManager on which requests are run
+         */
+        DataManager_Scheduler(DataManager &data_manager);
+
+        /** Add a window during which no write cycle may be in progress. Times are
+         *  those of us_ticker_read(), which is simulated time in the simulator
+         *
+         * @param start_us Time at which the window opens
+         * @param length_us Length of the window
+         * @return Indicates success or failure reason
+         */
+        int add_blackout(uint32_t start_us, uint32_t length_us);
+
+        /** Remove all blackout windows
+         */
+        void clear_blackouts();
+
+        /** Queue a request; may be called from interrupt context, e.g. by a
+         *  radio driver, whilst run() is making a step. The cost of a step that
+         *  writes is estimated once a blackout window is pending and, if the
+         *  estimate fails, e.g. because queued appends have yet to write the
+         *  entries it truncates, again each time it is considered to run
+         *
+         * @param &request Request to be queued
+         * @return Indicates success or failure reason
+         */
+        int submit(DataManager_Scheduler::Request_t &request);
+
+        /** Run queued requests until none may run now. Call from the main loop,
+         *  or at wake_us, after submitting requests
+         *
+         * @param &pending Address of integer to which the number of requests still queued will be written
+         * @param &wake_us Address of integer to which the time at which a deferred request may run will be written, valid if pending is non-zero
+         * @return Indicates success or failure reason
+         */
+        int run(int &pending, uint32_t &wake_us);
+
+        /** Make one step of the highest ranked request that may run now, e.g.
+         *  to check for other work between the steps of a long request
+         *
+         * @param &stepped Address of boolean to which whether a step was made will be written
+         * @param &pending Address of integer to which the number of requests still queued will be written
+         * @param &wake_us Address of integer to which the time at which a deferred request may run will be written, valid if no step was made and pending is non-zero
+         * @return Indicates success or failure reason
+         */
+        int run_step(bool &stepped, int &pending, uint32_t &wake_us);
+
+        /** Get the outcome of the requests run since the last reset_stats()
+         *
+         * @param &stats Address of SchedulerStats_t to which the stats will be written
+         */
+        void get_stats(DataManager_Scheduler::SchedulerStats_t &stats);
+
+        /** Reset the stats
+         */
+        void reset_stats();
+
+    private:
+        /** A blackout window, as absolute times
+         */
+        struct Window_t
+        {
+            uint32_t start_us;
+            uint32_t end_us;
+        };
+
+        /** Drop the windows that have closed
+         *
+         * @param now_us Current time
+         */
+        void prune_windows(uint32_t now_us);
+
+        /** Determine whether or not a request must wait for other requests: any
+         *  on the same file that is part way through, any earlier write to the
+         *  same file if it writes, so that writes to a file keep their order,
+         *  and any truncation part way through if it truncates
+         *
+         * @param index Position of the request in the queue
+         * @param queued Number of requests in the queue
+         * @return True if the request can't start yet
+         */
+        bool waiting(int index, int queued);
+
+        /** Determine whether or not the next step of a request must wait for a blackout window
+         *
+         * @param &request The request
+         * @param now_us Current time
+         * @param &until_us Address of integer to which the end of the window will be written
+         * @return True if the step would put a write cycle inside a window
+         */
+        bool blocked(const DataManager_Scheduler::Request_t &request, uint32_t now_us, uint32_t &until_us);
+
+        /** Determine whether or not a request should run before another
+         *
+         * @param &request The request
+         * @param &other The other request
+         * @param now_us Current time
+         * @return True if request has a higher priority or, at equal priority, an earlier deadline
+         */
+        static bool runs_before(const DataManager_Scheduler::Request_t &request, const DataManager_Scheduler::Request_t &other, uint32_t now_us);
+
+        /** Make the next step of a request
+         *
+         * @param &request The request
+         * @return OPERATION_IN_PROGRESS or the status of the request
+         */
+        int execute_step(DataManager_Scheduler::Request_t &request);
+
+        DataManager &_data_manager;
+        DataManager_Scheduler::Request_t *_queue[DM_SCHEDULER_QUEUE_LENGTH];
+        int _queued;
+        DataManager_Scheduler::Request_t *_last_stepped;
+        Window_t _windows[DM_SCHEDULER_WINDOWS];
+        int _window_count;
+        DataManager_Scheduler::SchedulerStats_t _stats;
+};
@@ -0,0 +1,144 @@
+/**
+  * @file    DataManager_BitPacking.h
+  * @version 0.5.0
+  * @author  Adam Mitchell
+  * @brief   Schema-driven codec that packs entries of sub-byte fields into a 
+  *          contiguous, least significant bit first, bitstream
+  */
+
+/** Define to prevent recursive inclusion
+ */
+#pragma once
+
+/** Includes 
+ */
+#include <stdint.h>
+
+namespace DataManager_FileSystem
+{
+    /** Maximum number of fields in a packed file's schema
+     */
+    static const uint8_t PACKED_MAX_FIELDS = 8;
+
+    /** Minimum number of bits in a packed entry. With at least 8 bits per entry 
+     *  the number of entries can be recovered from the number of bytes used
+     */
+    static const uint8_t PACKED_MIN_ENTRY_BITS = 8;
+
+    /** Maximum number of bytes spanned by a single packed entry
+     */
+    static const uint8_t PACKED_MAX_ENTRY_BYTES = ((PACKED_MAX_FIELDS * 32) + 7) / 8 + 1;
+
+    /** Struct used to describe the bit width, from 1 to 32, of each field
+     *  within an entry of a packed file
+     */
+    union PackedSchema_t
+    {
+        struct
+        {
+            uint8_t fields;
+            uint8_t field_bits[PACKED_MAX_FIELDS];
+        } parameters;
+
+        char data[sizeof(PackedSchema_t::parameters)];
+    };
+
+    enum
+    {
+        PACKED_INVALID_SCHEMA            = 70
+    };
+
+    /** Calculate the number of bits in a packed entry
+     *
+     * @param &schema Schema of the packed file
+     * @return Number of bits in each entry, 0 if the schema is invalid
+     */
+    static inline int packed_entry_bits(const PackedSchema_t &schema)
+    {
+        if(schema.parameters.fields == 0 || schema.parameters.fields > PACKED_MAX_FIELDS)
+        {
+            return 0;
+        }
+
+        int bits = 0;
+
+        for(uint8_t field = 0; field < schema.parameters.fields; field++)
+        {
+            if(schema.parameters.field_bits[field] == 0 || schema.parameters.field_bits[field] > 32)
+            {
+                return 0;
+            }
+
+            bits += schema.parameters.field_bits[field];
+        }
+
+        return bits;
+    }
+
+    /** Pack a single entry into a buffer, leaving the bits either side of it
+     *  untouched. Field values are truncated to their width
+     *
+     * @param &schema Schema of the packed file
+     * @param *fields Array of schema.parameters.fields values to be packed
+     * @param *buffer Buffer into which the entry is packed
+     * @param bit_offset Offset, in bits, of the entry within *buffer
+     */
+    static inline void pack_entry(const PackedSchema_t &schema, const uint32_t *fields, char *buffer, uint32_t bit_offset)
+    {
+        for(uint8_t field = 0; field < schema.parameters.fields; field++)
+        {
+            uint32_t value = fields[field];
+            int remaining = schema.parameters.field_bits[field];
+
+            while(remaining > 0)
+            {
+                int shift = bit_offset % 8;
+                int bits = (8 - shift < remaining) ? 8 - shift : remaining;
+                uint8_t mask = (uint8_t)(((1 << bits) - 1) << shift);
+
+                buffer[bit_offset / 8] = (char)(((uint8_t)buffer[bit_offset / 8] & ~mask) | ((value << shift) & mask));
+
+                value >>= bits;
+                remaining -= bits;
+                bit_offset += bits;
+            }
+        }
+    }
+
+    /** Unpack consecutive entries from a buffer using a 64-bit accumulator, so
+     *  that each byte of the bitstream is loaded once regardless of field widths
+     *
+     * @param &schema Schema of the packed file
+     * @param *buffer Buffer from which entries are unpacked
+     * @param bit_offset Offset, in bits, of the first entry within *buffer
+     * @param entries Number of entries to be unpacked
+     * @param *fields Array of entries * schema.parameters.fields values to which
+     *                the unpacked entries are written
+     */
+    static inline void unpack_entries(const PackedSchema_t &schema, const char *buffer, uint32_t bit_offset, 
+                                      int entries, uint32_t *fields)
+    {
+        const uint8_t *next = (const uint8_t *)buffer + (bit_offset / 8);
+        uint64_t accumulator = *next++ >> (bit_offset % 8);
+        int accumulated_bits = 8 - (bit_offset % 8);
+
+        for(int entry = 0; entry < entries; entry++)
+        {
+            for(uint8_t field = 0; field < schema.parameters.fields; field++)
+            {
+                int bits = schema.parameters.field_bits[field];
+
+                while(accumulated_bits < bits)
+                {
+                    accumulator |= (uint64_t)(*next++) << accumulated_bits;
+                    accumulated_bits += 8;
+                }
+
+                *fields++ = (uint32_t)(accumulator & ((1ULL << bits) - 1));
+
+                accumulator >>= bits;
+                accumulated_bits -= bits;
+            }
+        }
+    }
+}
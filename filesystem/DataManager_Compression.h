@@ -0,0 +1,172 @@
+/**
+  * @file    DataManager_Compression.h
+  * @version 0.5.0
+  * @author  Adam Mitchell
+  * @brief   Tiny LZ77-style codec for compressing sealed pages. Uses no heap and
+  *          no state beyond the caller's input and output buffers
+  */
+
+/** Define to prevent recursive inclusion
+ */
+#pragma once
+
+/** Includes 
+ */
+#include <stdint.h>
+
+/** A compressed stream is a sequence of tokens. A token below 0x80 is followed by
+ *  (token + 1) literal bytes. Any other token is a match of ((token & 0x7F) + 3) 
+ *  bytes, followed by one byte holding (distance - 1) back into the output
+ */
+namespace DataManager_FileSystem
+{
+    static const int LZ_MIN_MATCH = 3;
+    static const int LZ_MAX_MATCH = 0x7F + LZ_MIN_MATCH;
+    static const int LZ_MAX_LITERALS = 0x80;
+    static const int LZ_MAX_DISTANCE = 0x100;
+
+    /** Compress a block using greedy longest match search
+     *
+     * @param *in Block to be compressed
+     * @param in_length Length of *in in bytes
+     * @param *out Buffer to which the compressed block is written
+     * @param out_capacity Length of *out in bytes
+     * @return Length of the compressed block, 0 if it doesn't fit within out_capacity
+     */
+    static inline int lz_compress(const char *in, int in_length, char *out, int out_capacity)
+    {
+        int in_position = 0;
+        int out_position = 0;
+        int literal_start = 0;
+
+        while(in_position <= in_length)
+        {
+            int best_length = 0;
+            int best_distance = 0;
+
+            int window = (in_position > LZ_MAX_DISTANCE) ? in_position - LZ_MAX_DISTANCE : 0;
+
+            for(int candidate = window; candidate < in_position && in_position < in_length; candidate++)
+            {
+                int length = 0;
+
+                while(length < LZ_MAX_MATCH && in_position + length < in_length &&
+                      in[candidate + length] == in[in_position + length])
+                {
+                    length++;
+                }
+
+                if(length > best_length)
+                {
+                    best_length = length;
+                    best_distance = in_position - candidate;
+                }
+            }
+
+            /** Flush pending literals before a match, at the end of the block or 
+             *  when the literal run is as long as a token can describe
+             */
+            int literals = in_position - literal_start;
+
+            if(literals > 0 && (best_length >= LZ_MIN_MATCH || in_position == in_length || literals == LZ_MAX_LITERALS))
+            {
+                if(out_position + 1 + literals > out_capacity)
+                {
+                    return 0;
+                }
+
+                out[out_position++] = (char)(literals - 1);
+
+                for(int i = 0; i < literals; i++)
+                {
+                    out[out_position++] = in[literal_start + i];
+                }
+
+                literal_start = in_position;
+            }
+
+            if(in_position == in_length)
+            {
+                break;
+            }
+
+            if(best_length >= LZ_MIN_MATCH)
+            {
+                if(out_position + 2 > out_capacity)
+                {
+                    return 0;
+                }
+
+                out[out_position++] = (char)(0x80 | (best_length - LZ_MIN_MATCH));
+                out[out_position++] = (char)(best_distance - 1);
+
+                in_position += best_length;
+                literal_start = in_position;
+            }
+            else
+            {
+                in_position++;
+            }
+        }
+
+        return out_position;
+    }
+
+    /** Decompress a block produced by lz_compress()
+     *
+     * @param *in Compressed block
+     * @param in_length Length of *in in bytes
+     * @param *out Buffer to which the decompressed block is written
+     * @param out_capacity Length of *out in bytes
+     * @return Length of the decompressed block, -1 if the block is corrupt
+     */
+    static inline int lz_decompress(const char *in, int in_length, char *out, int out_capacity)
+    {
+        int in_position = 0;
+        int out_position = 0;
+
+        while(in_position < in_length)
+        {
+            uint8_t token = (uint8_t)in[in_position++];
+
+            if(token < 0x80)
+            {
+                int literals = token + 1;
+
+                if(in_position + literals > in_length || out_position + literals > out_capacity)
+                {
+                    return -1;
+                }
+
+                for(int i = 0; i < literals; i++)
+                {
+                    out[out_position++] = in[in_position++];
+                }
+            }
+            else
+            {
+                if(in_position >= in_length)
+                {
+                    return -1;
+                }
+
+                int length = (token & 0x7F) + LZ_MIN_MATCH;
+                int distance = (uint8_t)in[in_position++] + 1;
+
+                if(distance > out_position || out_position + length > out_capacity)
+                {
+                    return -1;
+                }
+
+                /** Byte by byte so that overlapping matches repeat correctly
+                 */
+                for(int i = 0; i < length; i++, out_position++)
+                {
+                    out[out_position] = out[out_position - distance];
+                }
+            }
+        }
+
+        return out_position;
+    }
+}
@@ -11,7 +11,7 @@
 
 /** Includes 
  */
-#include <mbed.h>
+#include <stdint.h>
 
 /** Collection of parameters that enable the management of a variety
  *  of persistent storage media and storage of 'files' within
@@ -19,9 +19,33 @@
 namespace DataManager_FileSystem
 {
     /** 4 byte value used to determine whether or not the filesystem
-     *  has been initialised
+     *  has been initialised with the current layout
      */
-    static const uint32_t INITIALISED = 0b01101001010110101100110001011100;
+    static const uint32_t INITIALISED = 0b01101010010111001001010111000011;
+
+    /** Initialised value written by v0.5.0 and earlier, whose storage ran to
+     *  the end of the EEPROM with no operation page or journal
+     */
+    static const uint32_t INITIALISED_V0_5 = 0b01101001010110101100110001011100;
+
+    /** 4 byte value used to determine whether or not the transaction journal
+     *  holds a committed, but not yet applied, transaction
+     */
+    static const uint32_t TRANSACTION_COMMITTED = 0b10010110101001010011001110100011;
+
+    /** Maximum number of files whose metadata can be staged in a single transaction,
+     *  limited by the number of journal records that fit within one page
+     */
+    static const uint8_t TRANSACTION_MAX_FILES = 4;
+
+    /** Maximum number of channels in a record group's schema
+     */
+    static const uint8_t RECORD_GROUP_MAX_CHANNELS = 8;
+
+    /** Initial value of the running checksum calculated over an exported
+     *  or restored EEPROM image, i.e. the CRC-32 of no data
+     */
+    static const uint32_t IMAGE_CHECKSUM_SEED = 0;
 
     /** Struct used to store useful global parameters
      */
@@ -55,6 +79,84 @@ namespace DataManager_FileSystem
         char data[sizeof(File_t::parameters)];
     };
 
+    /** Struct used to store the metadata changes of a transaction as a single
+     *  page-aligned record. Each record holds the file table address of a file
+     *  and the updated File_t to be written to it
+     */
+    union Journal_t
+    {
+        struct
+        {
+            uint32_t committed;
+            uint16_t entries;
+            uint16_t checksum;
+
+            struct
+            {
+                uint16_t address;
+                File_t file;
+            } records[TRANSACTION_MAX_FILES];
+        } parameters;
+
+        char data[sizeof(Journal_t::parameters)];
+    };
+
+    /** Struct used to persist the progress of a resumable long operation so
+     *  that it can be continued after a reset. op is the TraceOp of the call
+     *  that started it, or 0 once it has finished. Two copies are kept in the
+     *  operation page and each checkpoint overwrites the older one, so that a
+     *  checkpoint torn by a power cut leaves the previous one to resume from
+     */
+    union Operation_t
+    {
+        struct
+        {
+            uint16_t sequence;
+            uint16_t checksum;
+            uint8_t op;
+            uint8_t filename;
+            uint8_t archive_filename;
+            uint8_t truncating;
+            uint16_t progress;
+            uint16_t total;
+            uint16_t archive_address;
+            uint16_t address;
+            uint16_t source_address;
+            uint16_t new_address;
+            uint16_t remaining_bytes;
+            File_t file;
+        } parameters;
+
+        char data[sizeof(Operation_t::parameters)];
+    };
+
+    /** Struct used to describe the fixed schema of a record group, i.e. a file
+     *  in which each entry is a row holding one sample of every channel
+     */
+    union RecordSchema_t
+    {
+        struct
+        {
+            uint8_t channels;
+            uint8_t channel_length_bytes[RECORD_GROUP_MAX_CHANNELS];
+        } parameters;
+
+        char data[sizeof(RecordSchema_t::parameters)];
+    };
+
+    /** Calculate the 8-bit checksum stored in File_t::parameters.valid. The
+     *  checksum is OR'd with 1 so that it can never be 0, which is the value
+     *  of every byte in a freshly initialised file table
+     *
+     * @param &file File whose checksum is to be calculated
+     * @return Checksum of the file's parameters
+     */
+    static inline uint8_t file_checksum(const File_t &file)
+    {
+        return (uint8_t)((file.parameters.filename + file.parameters.length_bytes + file.parameters.file_start_address +
+                          file.parameters.file_end_address + file.parameters.next_available_address) | 1);
+    }
+
     enum
     {
         FILE_TABLE_FULL                  = 20,
@@ -67,4 +169,158 @@ namespace DataManager_FileSystem
         FILE_ENTRY_FULL                  = 31,
         FILE_ENTRY_INVALID_INDEX         = 32
     };
+
+    enum
+    {
+        IMAGE_INVALID_PAGE               = 40,
+        IMAGE_LENGTH_MISMATCH            = 41,
+        IMAGE_CHECKSUM_MISMATCH          = 42,
+        IMAGE_WRITE_CYCLE_TIMEOUT        = 43,
+        IMAGE_RESTORE_NOT_STARTED        = 44
+    };
+
+    enum
+    {
+        TRANSACTION_ALREADY_OPEN         = 50,
+        TRANSACTION_NOT_OPEN             = 51,
+        TRANSACTION_FULL                 = 52,
+        TRANSACTION_CONFLICT             = 53
+    };
+
+    enum
+    {
+        RECORD_INVALID_SCHEMA            = 60,
+        RECORD_INVALID_CHANNEL           = 61
+    };
+
+    enum
+    {
+        RLE_INVALID_VALUE_LENGTH         = 80
+    };
+
+    enum
+    {
+        ARCHIVE_FULL                     = 90,
+        ARCHIVE_CORRUPT                  = 91,
+        ARCHIVE_INCOMPRESSIBLE           = 92
+    };
+
+    enum
+    {
+        SCRATCH_ARENA_EXHAUSTED          = 100
+    };
+
+    enum
+    {
+        ASYNC_BUSY                       = 110,
+        ASYNC_TRANSFER_FAILED            = 111
+    };
+
+    enum
+    {
+        ESTIMATE_UNSUPPORTED_OP          = 120
+    };
+
+    enum
+    {
+        SCHEDULER_QUEUE_FULL             = 130,
+        SCHEDULER_TOO_MANY_WINDOWS       = 131,
+        SCHEDULER_REQUEST_QUEUED         = 132,
+        SCHEDULER_UNSUPPORTED_OP         = 133
+    };
+
+    enum
+    {
+        OPERATION_IN_PROGRESS            = 140,
+        OPERATION_BUSY                   = 141
+    };
+
+    enum
+    {
+        LAYOUT_INCOMPATIBLE              = 150
+    };
+
+    /** Fold length bytes of data into a running CRC-32 checksum, i.e. the 
+     *  reflected 0x04C11DB7 polynomial with its initial and final XOR, as 
+     *  zlib's crc32(). The final XOR is undone on entry, so that the checksum 
+     *  of some bytes continues into that of the bytes that follow them. The 
+     *  table-less form is used to keep flash usage down; start from 
+     *  IMAGE_CHECKSUM_SEED
+     *
+     * @param checksum Running checksum to be updated
+     * @param *data Bytes to be added to the checksum
+     * @param length Length of *data in bytes
+     * @return Updated checksum
+     */
+    static inline uint32_t image_checksum(uint32_t checksum, const char *data, int length)
+    {
+        checksum = ~checksum;
+
+        for(int i = 0; i < length; i++)
+        {
+            checksum ^= (uint8_t)data[i];
+
+            for(int bit = 0; bit < 8; bit++)
+            {
+                checksum = (checksum >> 1) ^ (0xEDB88320 & (0 - (checksum & 1)));
+            }
+        }
+
+        return ~checksum;
+    }
+
+    /** Calculate the checksum of a journal's staged records, used to detect a 
+     *  journal page that was torn by a power cut during commit
+     *
+     * @param &journal Journal whose checksum is to be calculated. The number of 
+     *                 entries must not exceed TRANSACTION_MAX_FILES
+     * @return Checksum of the journal's records
+     */
+    static inline uint16_t journal_checksum(const Journal_t &journal)
+    {
+        uint32_t checksum = image_checksum(IMAGE_CHECKSUM_SEED, (const char *)&journal.parameters.entries, 
+                                           sizeof(journal.parameters.entries));
+
+        checksum = image_checksum(checksum, (const char *)journal.parameters.records, 
+                                  journal.parameters.entries * sizeof(journal.parameters.records[0]));
+
+        return (uint16_t)checksum;
+    }
+
+    /** Calculate the checksum of a persisted operation, used to detect a copy
+     *  that was torn by a power cut or never written
+     *
+     * @param &operation Operation whose checksum is to be calculated
+     * @return Checksum of the operation's parameters other than the checksum itself
+     */
+    static inline uint16_t operation_checksum(const Operation_t &operation)
+    {
+        uint32_t checksum = image_checksum(IMAGE_CHECKSUM_SEED, (const char *)&operation.parameters.sequence, 
+                                           sizeof(operation.parameters.sequence));
+
+        const char *parameters = (const char *)&operation.parameters.op;
+
+        checksum = image_checksum(checksum, parameters, sizeof(operation) - (parameters - operation.data));
+
+        return (uint16_t)checksum;
+    }
+
+    /** Calculate the offset of a channel within a record group's row
+     *
+     * @param &schema Schema of the record group
+     * @param channel 0-indexed channel whose offset is to be calculated. Passing
+     *                the number of channels returns the length of a row
+     * @return Offset of the channel in bytes
+     */
+    static inline int record_channel_offset(const RecordSchema_t &schema, uint8_t channel)
+    {
+        int offset = 0;
+
+        for(uint8_t i = 0; i < channel && i < RECORD_GROUP_MAX_CHANNELS; i++)
+        {
+            offset += schema.parameters.channel_length_bytes[i];
+        }
+
+        return offset;
+    }
 }
\ No newline at end of file
@@ -0,0 +1,32 @@
+/**
+  * @file    DataManager_Layout.h
+  * @version 0.5.0
+  * @author  Adam Mitchell
+  * @brief   Persistent storage geometry and the location of the global stats, 
+  *          file table and storage regions within it. Free of mbed dependencies
+  *          so that host-side tools build byte-identical images
+  */
+
+/** Define to prevent recursive inclusion
+ */
+#pragma once
+
+/** Host builds have no notion of BOARD and use the layout shared by all 
+ *  supported targets
+ */
+#if !defined(__MBED__) || BOARD == DEVELOPMENT_BOARD_V1_1_0 || BOARD == WRIGHT_V1_0_0 || BOARD == EARHART_V1_0_0
+    #define PAGES                      500
+    #define PAGE_SIZE_BYTES            64
+    #define EEPROM_SIZE_BYTES          32000
+    #define GLOBAL_STATS_START_ADDRESS 0
+    #define GLOBAL_STATS_LENGTH        8
+    #define FILE_TABLE_PAGES           7
+    #define FILE_TABLE_START_ADDRESS   GLOBAL_STATS_LENGTH
+    #define FILE_TABLE_LENGTH          ((PAGE_SIZE_BYTES * FILE_TABLE_PAGES) - GLOBAL_STATS_LENGTH)
+    #define JOURNAL_PAGES              1
+    #define JOURNAL_START_ADDRESS      ((PAGES - JOURNAL_PAGES) * PAGE_SIZE_BYTES)
+    #define OPERATION_PAGES            1
+    #define OPERATION_START_ADDRESS    (JOURNAL_START_ADDRESS - (OPERATION_PAGES * PAGE_SIZE_BYTES))
+    #define STORAGE_START_ADDRESS      FILE_TABLE_LENGTH + GLOBAL_STATS_LENGTH
+    #define STORAGE_LENGTH             (OPERATION_START_ADDRESS - (STORAGE_START_ADDRESS))
+#endif /* #if !defined(__MBED__) || BOARD == ... */
@@ -0,0 +1,77 @@
+/**
+  * @file    DataManager_Span.h
+  * @version 0.5.0
+  * @author  Adam Mitchell
+  * @brief   Internal phases of the DataManager to which the span tree charges
+  *          costs, and the names under which they appear in a flame graph
+  */
+
+/** Define to prevent recursive inclusion
+ */
+#pragma once
+
+/** Includes
+ */
+#include <stdint.h>
+#include "DataManager_Trace.h"
+
+namespace DataManager_FileSystem
+{
+    /** Identifies an internal phase of a call. A frame of the span tree is
+     *  either a TraceOp, for a public call, or a SpanPhase, so phases are
+     *  numbered clear of the TraceOp values
+     */
+    enum SpanPhase
+    {
+        SPAN_TABLE_SCAN                      = 64,
+        SPAN_DATA_READ                       = 65,
+        SPAN_DATA_WRITE                      = 66,
+        SPAN_DATA_MOVE                       = 67,
+        SPAN_METADATA_WRITE                  = 68,
+        SPAN_GLOBAL_STATS_WRITE              = 69,
+        SPAN_JOURNAL_WRITE                   = 70,
+        SPAN_JOURNAL_APPLY                   = 71,
+        SPAN_WRITE_CYCLE_POLL                = 72,
+        SPAN_RETRY_BACKOFF                   = 73,
+        SPAN_CHECKPOINT_WRITE                = 74,
+        SPAN_PHASES_END
+    };
+
+    /** Cost printed by DataManager::dump_spans()
+     */
+    enum SpanMetric
+    {
+        SPAN_TIME_US                         = 0,
+        SPAN_BUS_BYTES                       = 1,
+        SPAN_TRANSFERS                       = 2,
+        SPAN_WRITE_CYCLES                    = 3
+    };
+
+    /** Name of each SpanPhase, for reports
+     */
+    static const char *const SPAN_PHASE_NAMES[SPAN_PHASES_END - SPAN_TABLE_SCAN] =
+    {
+        "table_scan", "data_read", "data_write", "data_move", "metadata_write", "global_stats_write",
+        "journal_write", "journal_apply", "write_cycle_poll", "retry_backoff", "checkpoint_write"
+    };
+
+    /** Get the name of a frame of the span tree
+     *
+     * @param frame A TraceOp or SpanPhase
+     * @return Name of the public call or phase
+     */
+    inline const char *span_frame_name(uint8_t frame)
+    {
+        if(frame > 0 && frame < TRACE_OPS)
+        {
+            return TRACE_OP_NAMES[frame];
+        }
+
+        if(frame >= SPAN_TABLE_SCAN && frame < SPAN_PHASES_END)
+        {
+            return SPAN_PHASE_NAMES[frame - SPAN_TABLE_SCAN];
+        }
+
+        return "unknown";
+    }
+}
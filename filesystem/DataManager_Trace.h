@@ -0,0 +1,114 @@
+/**
+  * @file    DataManager_Trace.h
+  * @version 0.5.0
+  * @author  Adam Mitchell
+  * @brief   Compact binary record of a public DataManager call, shared by the
+  *          on-device trace ring and host tools that replay it
+  */
+
+/** Define to prevent recursive inclusion
+ */
+#pragma once
+
+/** Includes
+ */
+#include <stdint.h>
+
+namespace DataManager_FileSystem
+{
+    /** Identifies the public call described by a trace record. Values are part
+     *  of the trace format, so new calls are only ever appended
+     */
+    enum TraceOp
+    {
+        TRACE_INIT_FILESYSTEM                = 1,
+        TRACE_INIT_GSTATS                    = 2,
+        TRACE_IS_INITIALISED                 = 3,
+        TRACE_GET_GLOBAL_STATS               = 4,
+        TRACE_ADD_FILE                       = 5,
+        TRACE_GET_FILE_BY_NAME               = 6,
+        TRACE_TOTAL_STORED_FILES             = 7,
+        TRACE_TOTAL_REMAINING_FILE_TABLE     = 8,
+        TRACE_READ_FILE_ENTRY                = 9,
+        TRACE_APPEND_FILE_ENTRY              = 10,
+        TRACE_DELETE_FILE_ENTRIES            = 11,
+        TRACE_OVERWRITE_FILE_ENTRIES         = 12,
+        TRACE_TRUNCATE_FILE                  = 13,
+        TRACE_GET_TOTAL_WRITTEN_ENTRIES      = 14,
+        TRACE_GET_REMAINING_ENTRIES          = 15,
+        TRACE_GET_REMAINING_ENTRIES_BYTES    = 16,
+        TRACE_ADD_RECORD_GROUP               = 17,
+        TRACE_READ_RECORD_CHANNEL            = 18,
+        TRACE_READ_RECORD_PROJECTION         = 19,
+        TRACE_ADD_PACKED_FILE                = 20,
+        TRACE_APPEND_PACKED_ENTRY            = 21,
+        TRACE_READ_PACKED_ENTRIES            = 22,
+        TRACE_GET_TOTAL_PACKED_ENTRIES       = 23,
+        TRACE_ADD_RLE_FILE                   = 24,
+        TRACE_APPEND_RLE_ENTRY               = 25,
+        TRACE_FLUSH_RLE_FILE                 = 26,
+        TRACE_READ_RLE_ENTRY                 = 27,
+        TRACE_GET_TOTAL_RLE_ENTRIES          = 28,
+        TRACE_ADD_ARCHIVE_FILE               = 29,
+        TRACE_COMPRESS_SEALED_PAGES          = 30,
+        TRACE_READ_ARCHIVED_ENTRY            = 31,
+        TRACE_GET_TOTAL_ARCHIVED_ENTRIES     = 32,
+        TRACE_BEGIN                          = 33,
+        TRACE_COMMIT                         = 34,
+        TRACE_ROLLBACK                       = 35,
+        TRACE_RECOVER_TRANSACTION            = 36,
+        TRACE_GET_IMAGE_PAGES                = 37,
+        TRACE_EXPORT_IMAGE_PAGE              = 38,
+        TRACE_BEGIN_IMAGE_RESTORE            = 39,
+        TRACE_RESTORE_IMAGE_PAGE             = 40,
+        TRACE_FINISH_IMAGE_RESTORE           = 41,
+        TRACE_APPEND_FILE_ENTRY_ASYNC        = 42,
+        TRACE_READ_FILE_ENTRIES_ASYNC        = 43,
+        TRACE_ESTIMATE_COST                  = 44,
+        TRACE_TRUNCATE_FILE_STEP             = 45,
+        TRACE_RESUME_OPERATION               = 46,
+        TRACE_OPS
+    };
+
+    /** One public call: the op, its filename, an index or count and a length
+     *  whose meaning depends on the op, its result and the log2 of its duration
+     *  in microseconds. Index and length saturate at 0xFFFF and the result at
+     *  the limits of int8_t
+     */
+    union TraceRecord_t
+    {
+        struct
+        {
+            uint8_t op;
+            uint8_t filename;
+            int8_t result;
+            uint8_t elapsed_log2_us;
+            uint16_t index;
+            uint16_t length;
+        } parameters;
+
+        char data[sizeof(TraceRecord_t::parameters)];
+    };
+
+    /** Name of the public call of each TraceOp, for reports
+     */
+    static const char *const TRACE_OP_NAMES[TRACE_OPS] =
+    {
+        "-", "init_filesystem", "init_gstats", "is_initialised", "get_global_stats", "add_file",
+        "get_file_by_name", "total_stored_files", "total_remaining_file_table_entries",
+        "read_file_entry", "append_file_entry", "delete_file_entries", "overwrite_file_entries",
+        "truncate_file", "get_total_written_file_entries", "get_remaining_file_entries",
+        "get_remaining_file_entries_bytes", "add_record_group", "read_record_channel",
+        "read_record_projection", "add_packed_file", "append_packed_entry", "read_packed_entries",
+        "get_total_packed_entries", "add_rle_file", "append_rle_entry", "flush_rle_file",
+        "read_rle_entry", "get_total_rle_entries", "add_archive_file", "compress_sealed_pages",
+        "read_archived_entry", "get_total_archived_entries", "begin", "commit", "rollback",
+        "recover_transaction", "get_image_pages", "export_image_page", "begin_image_restore",
+        "restore_image_page", "finish_image_restore", "append_file_entry_async",
+        "read_file_entries_async", "estimate_cost", "truncate_file_step", "resume_operation"
+    };
+
+    /** Prefix of each trace record line dumped over UART
+     */
+    static const char TRACE_LINE_PREFIX[] = "DMTRACE";
+}
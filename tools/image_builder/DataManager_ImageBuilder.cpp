@@ -0,0 +1,251 @@
+/**
+  * @file    DataManager_ImageBuilder.cpp
+  * @version 0.5.0
+  * @author  Adam Mitchell
+  * @brief   C++ file of the DataManager_ImageBuilder. Host-side builder of byte-exact 
+  *          DataManager EEPROM images
+  */
+
+/** Includes
+ */
+#include <string.h>
+#include "DataManager_ImageBuilder.h"
+
+
+DataManager_ImageBuilder::DataManager_ImageBuilder()
+{
+    memset(_image, IMAGE_ERASED_VALUE, sizeof(_image));
+}
+
+DataManager_ImageBuilder::~DataManager_ImageBuilder()
+{
+
+}
+
+/** Mirror of DataManager::init_filesystem()
+ *
+ * @return Indicates success or failure reason
+ */
+int DataManager_ImageBuilder::init_filesystem()
+{
+    for(int ft_page = 0; ft_page < FILE_TABLE_PAGES; ft_page++)
+    {
+        memset(&_image[FILE_TABLE_START_ADDRESS + (ft_page * PAGE_SIZE_BYTES)], 0, PAGE_SIZE_BYTES);
+    }
+
+    memset(&_image[JOURNAL_START_ADDRESS], 0, PAGE_SIZE_BYTES);
+    memset(&_image[OPERATION_START_ADDRESS], 0, OPERATION_PAGES * PAGE_SIZE_BYTES);
+
+    return DataManager_ImageBuilder::IMAGE_BUILDER_OK;
+}
+
+/** Mirror of DataManager::init_gstats()
+ *
+ * @return Indicates success or failure reason
+ */
+int DataManager_ImageBuilder::init_gstats()
+{
+    DataManager_FileSystem::GlobalStats_t g_stats;
+    g_stats.parameters.next_available_address = STORAGE_START_ADDRESS;
+    g_stats.parameters.space_remaining = STORAGE_LENGTH;
+    g_stats.parameters.initialised = DataManager_FileSystem::INITIALISED;
+
+    memcpy(&_image[GLOBAL_STATS_START_ADDRESS], g_stats.data, GLOBAL_STATS_LENGTH);
+
+    return DataManager_ImageBuilder::IMAGE_BUILDER_OK;
+}
+
+/** Mirror of DataManager::add_file()
+ *
+ * @param file File_t object representing the file to be stored
+ * @param entries_to_store Number of unique entries of this file type to be stored
+ * @return Indicates success or failure reason
+ */
+int DataManager_ImageBuilder::add_file(DataManager_FileSystem::File_t file, uint16_t entries_to_store)
+{
+    int requested_space = entries_to_store * file.parameters.length_bytes;
+
+    DataManager_FileSystem::GlobalStats_t g_stats;
+    memcpy(g_stats.data, &_image[GLOBAL_STATS_START_ADDRESS], GLOBAL_STATS_LENGTH);
+
+    if(requested_space > g_stats.parameters.space_remaining)
+    {
+        return DataManager_FileSystem::FILE_TABLE_FULL;
+    }
+
+    file.parameters.file_start_address = g_stats.parameters.next_available_address;
+    file.parameters.next_available_address = g_stats.parameters.next_available_address;
+    file.parameters.file_end_address = (g_stats.parameters.next_available_address + requested_space) - 1;
+
+    /** The device commits global stats before it looks for a free file table
+     *  slot, so do the same to stay byte-exact when the table is full
+     */
+    g_stats.parameters.next_available_address = file.parameters.file_end_address + 1;
+    g_stats.parameters.space_remaining = (STORAGE_START_ADDRESS + STORAGE_LENGTH) - g_stats.parameters.next_available_address;
+
+    memcpy(&_image[GLOBAL_STATS_START_ADDRESS], g_stats.data, GLOBAL_STATS_LENGTH);
+
+    file.parameters.valid = DataManager_FileSystem::file_checksum(file);
+
+    int address = -1;
+    int status = get_next_available_file_table_address(address);
+
+    if(status != DataManager_ImageBuilder::IMAGE_BUILDER_OK)
+    {
+        return status;
+    }
+
+    if(address == -1)
+    {
+        return DataManager_FileSystem::FILE_TABLE_FULL;
+    }
+
+    memcpy(&_image[address], file.data, sizeof(file));
+
+    return DataManager_ImageBuilder::IMAGE_BUILDER_OK;
+}
+
+/** Mirror of DataManager::get_image_pages()
+ *
+ * @param &pages Address of integer value to which the number of pages
+ *               in use should be stored
+ * @return Indicates success or failure reason
+ */
+int DataManager_ImageBuilder::get_image_pages(int &pages)
+{
+    DataManager_FileSystem::GlobalStats_t g_stats;
+    memcpy(g_stats.data, &_image[GLOBAL_STATS_START_ADDRESS], GLOBAL_STATS_LENGTH);
+
+    if(g_stats.parameters.initialised != DataManager_FileSystem::INITIALISED ||
+       g_stats.parameters.next_available_address > PAGES * PAGE_SIZE_BYTES)
+    {
+        pages = PAGES;
+        return DataManager_ImageBuilder::IMAGE_BUILDER_OK;
+    }
+
+    pages = (g_stats.parameters.next_available_address + PAGE_SIZE_BYTES - 1) / PAGE_SIZE_BYTES;
+
+    return DataManager_ImageBuilder::IMAGE_BUILDER_OK;
+}
+
+/** Calculate the checksum of the first pages of the image, as returned
+ *  by DataManager::export_image_page() for the last of those pages
+ *
+ * @param pages Number of pages, starting from page 0, to be checksummed
+ * @return Checksum of the image
+ */
+uint32_t DataManager_ImageBuilder::get_image_checksum(int pages)
+{
+    return DataManager_FileSystem::image_checksum(DataManager_FileSystem::IMAGE_CHECKSUM_SEED, 
+                                                  _image, pages * PAGE_SIZE_BYTES);
+}
+
+/** Check the image using the same validity rules as DataManager, i.e.
+ *  global stats are initialised, every file in the table passes its 
+ *  checksum and lies within storage without overlapping another file
+ *
+ * @return Indicates success or failure reason
+ */
+int DataManager_ImageBuilder::verify()
+{
+    DataManager_FileSystem::GlobalStats_t g_stats;
+    memcpy(g_stats.data, &_image[GLOBAL_STATS_START_ADDRESS], GLOBAL_STATS_LENGTH);
+
+    if(g_stats.parameters.initialised != DataManager_FileSystem::INITIALISED)
+    {
+        return DataManager_FileSystem::IMAGE_INVALID_PAGE;
+    }
+
+    int file_size = sizeof(DataManager_FileSystem::File_t);
+    int max_files = FILE_TABLE_LENGTH / file_size;
+
+    for(int file_index = 0; file_index < max_files; file_index++)
+    {
+        DataManager_FileSystem::File_t file;
+        memcpy(file.data, &_image[FILE_TABLE_START_ADDRESS + (file_index * file_size)], file_size);
+
+        if(!is_valid_file(file))
+        {
+            continue;
+        }
+
+        if(file.parameters.file_start_address < STORAGE_START_ADDRESS ||
+           file.parameters.file_end_address >= g_stats.parameters.next_available_address ||
+           file.parameters.next_available_address > file.parameters.file_end_address + 1)
+        {
+            return DataManager_FileSystem::FILE_INVALID_NAME;
+        }
+
+        for(int other_index = 0; other_index < file_index; other_index++)
+        {
+            DataManager_FileSystem::File_t other;
+            memcpy(other.data, &_image[FILE_TABLE_START_ADDRESS + (other_index * file_size)], file_size);
+
+            if(!is_valid_file(other))
+            {
+                continue;
+            }
+
+            if(other.parameters.filename == file.parameters.filename ||
+               (file.parameters.file_start_address <= other.parameters.file_end_address &&
+                other.parameters.file_start_address <= file.parameters.file_end_address))
+            {
+                return DataManager_FileSystem::FILE_INVALID_NAME;
+            }
+        }
+    }
+
+    return DataManager_ImageBuilder::IMAGE_BUILDER_OK;
+}
+
+/** Return the raw image
+ *
+ *  @return Pointer to EEPROM_SIZE_BYTES bytes of image data
+ */
+const char *DataManager_ImageBuilder::get_image()
+{
+    return _image;
+}
+
+/** Mirror of DataManager::get_next_available_file_table_address()
+ *
+ * @param &next_available_address Address of integer value in which the address
+ *                                of the next free file table slot is stored. -1 if 
+ *                                there are no available spaces
+ * @return Indicates success or failure reason
+ */
+int DataManager_ImageBuilder::get_next_available_file_table_address(int &next_available_address)
+{
+    DataManager_FileSystem::File_t file;
+    int file_size = sizeof(file);
+    int max_files = FILE_TABLE_LENGTH / file_size;
+
+    for(int file_index = 0; file_index < max_files; file_index++)
+    {
+        int address = FILE_TABLE_START_ADDRESS + (file_index * file_size);
+        memcpy(file.data, &_image[address], file_size);
+
+        if(!is_valid_file(file))
+        {
+            next_available_address = address;
+            break;
+        }
+    }
+
+    return DataManager_ImageBuilder::IMAGE_BUILDER_OK;
+}
+
+/** Mirror of DataManager::is_valid_file()
+ *
+ * @param file File to be checked for validity
+ * @return True if file is valid, else false
+ */
+bool DataManager_ImageBuilder::is_valid_file(DataManager_FileSystem::File_t file)
+{
+    if(file.parameters.valid == 0x00)
+    {
+        return false;
+    }
+
+    return file.parameters.valid == DataManager_FileSystem::file_checksum(file);
+}
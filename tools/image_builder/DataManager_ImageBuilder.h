@@ -0,0 +1,111 @@
+/**
+  * @file    DataManager_ImageBuilder.h
+  * @version 0.5.0
+  * @author  Adam Mitchell
+  * @brief   Host-side builder of byte-exact DataManager EEPROM images, for use
+  *          when provisioning boards on the production line
+  */
+
+/** Define to prevent recursive inclusion
+ */
+#pragma once
+
+/** Includes 
+ */
+#include <stdint.h>
+#include "DataManager_FileSystem.h"
+#include "DataManager_Layout.h"
+
+/** Value of every byte in an unprogrammed EEPROM
+ */
+#define IMAGE_ERASED_VALUE 0xFF
+
+/** Builds an EEPROM image in RAM by applying the same operations, in the 
+ *  same order, as the on-device init_filesystem(), init_gstats() and 
+ *  add_file() calls
+ */
+class DataManager_ImageBuilder
+{
+
+    public:
+
+        enum
+        {
+            IMAGE_BUILDER_OK = 0
+        };
+
+        DataManager_ImageBuilder();
+
+        ~DataManager_ImageBuilder();
+
+        /** Mirror of DataManager::init_filesystem()
+         *
+         * @return Indicates success or failure reason
+         */
+        int init_filesystem();
+
+        /** Mirror of DataManager::init_gstats()
+         *
+         * @return Indicates success or failure reason
+         */
+        int init_gstats();
+
+        /** Mirror of DataManager::add_file()
+         *
+         * @param file File_t object representing the file to be stored
+         * @param entries_to_store Number of unique entries of this file type to be stored
+         * @return Indicates success or failure reason
+         */
+        int add_file(DataManager_FileSystem::File_t file, uint16_t entries_to_store);
+
+        /** Mirror of DataManager::get_image_pages()
+         *
+         * @param &pages Address of integer value to which the number of pages
+         *               in use should be stored
+         * @return Indicates success or failure reason
+         */
+        int get_image_pages(int &pages);
+
+        /** Calculate the checksum of the first pages of the image, as returned
+         *  by DataManager::export_image_page() for the last of those pages
+         *
+         * @param pages Number of pages, starting from page 0, to be checksummed
+         * @return Checksum of the image
+         */
+        uint32_t get_image_checksum(int pages);
+
+        /** Check the image using the same validity rules as DataManager, i.e.
+         *  global stats are initialised, every file in the table passes its 
+         *  checksum and lies within storage without overlapping another file
+         *
+         * @return Indicates success or failure reason
+         */
+        int verify();
+
+        /** Return the raw image
+         *
+         *  @return Pointer to EEPROM_SIZE_BYTES bytes of image data
+         */
+        const char *get_image();
+
+    private:
+
+        /** Mirror of DataManager::get_next_available_file_table_address()
+         *
+         * @param &next_available_address Address of integer value in which the address
+         *                                of the next free file table slot is stored. -1 if 
+         *                                there are no available spaces
+         * @return Indicates success or failure reason
+         */
+        int get_next_available_file_table_address(int &next_available_address);
+
+        /** Mirror of DataManager::is_valid_file()
+         *
+         * @param file File to be checked for validity
+         * @return True if file is valid, else false
+         */
+        bool is_valid_file(DataManager_FileSystem::File_t file);
+
+        char _image[EEPROM_SIZE_BYTES];
+
+};
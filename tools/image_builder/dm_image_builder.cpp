@@ -0,0 +1,122 @@
+/**
+  * @file    dm_image_builder.cpp
+  * @version 0.5.0
+  * @author  Adam Mitchell
+  * @brief   Command line tool that builds a DataManager EEPROM image from a layout
+  *          description so that it can be burnt as one sequential page stream.
+  *
+  *          Build:  g++ -I. -I../../filesystem DataManager_ImageBuilder.cpp dm_image_builder.cpp -o dm_image_builder
+  *          Usage:  dm_image_builder <layout> <image> [--full]
+  *
+  *          The layout contains one file per line, in the order in which add_file()
+  *          would be called on the device, as: file <filename> <length_bytes> <entries_to_store>
+  *          Blank lines and lines starting with '#' are ignored
+  */
+
+/** Includes
+ */
+#include <stdio.h>
+#include <string.h>
+#include "DataManager_ImageBuilder.h"
+
+
+int main(int argc, char **argv)
+{
+    if(argc < 3)
+    {
+        fprintf(stderr, "Usage: %s <layout> <image> [--full]\n", argv[0]);
+        return 1;
+    }
+
+    bool full_image = (argc > 3 && strcmp(argv[3], "--full") == 0);
+
+    FILE *layout = fopen(argv[1], "r");
+
+    if(layout == NULL)
+    {
+        fprintf(stderr, "Unable to open layout %s\n", argv[1]);
+        return 1;
+    }
+
+    static DataManager_ImageBuilder builder;
+    builder.init_filesystem();
+    builder.init_gstats();
+
+    char line[128];
+    int line_number = 0;
+
+    while(fgets(line, sizeof(line), layout) != NULL)
+    {
+        line_number++;
+
+        char keyword[16];
+        unsigned int filename, length_bytes, entries_to_store;
+
+        if(sscanf(line, " %15s", keyword) != 1 || keyword[0] == '#')
+        {
+            continue;
+        }
+
+        if(strcmp(keyword, "file") != 0 ||
+           sscanf(line, " file %u %u %u", &filename, &length_bytes, &entries_to_store) != 3 ||
+           filename > 0xFF || length_bytes == 0 || length_bytes > 0xFFFF || entries_to_store > 0xFFFF)
+        {
+            fprintf(stderr, "%s:%d: expected 'file <filename> <length_bytes> <entries_to_store>'\n", argv[1], line_number);
+            fclose(layout);
+            return 1;
+        }
+
+        DataManager_FileSystem::File_t file;
+        memset(file.data, 0, sizeof(file));
+        file.parameters.filename = filename;
+        file.parameters.length_bytes = length_bytes;
+
+        int status = builder.add_file(file, entries_to_store);
+
+        if(status != DataManager_ImageBuilder::IMAGE_BUILDER_OK)
+        {
+            fprintf(stderr, "%s:%d: add_file failed with status %d\n", argv[1], line_number, status);
+            fclose(layout);
+            return 1;
+        }
+    }
+
+    fclose(layout);
+
+    int status = builder.verify();
+
+    if(status != DataManager_ImageBuilder::IMAGE_BUILDER_OK)
+    {
+        fprintf(stderr, "Image failed verification with status %d\n", status);
+        return 1;
+    }
+
+    int pages = PAGES;
+
+    if(!full_image)
+    {
+        builder.get_image_pages(pages);
+    }
+
+    FILE *image = fopen(argv[2], "wb");
+
+    if(image == NULL)
+    {
+        fprintf(stderr, "Unable to open image %s\n", argv[2]);
+        return 1;
+    }
+
+    size_t written = fwrite(builder.get_image(), PAGE_SIZE_BYTES, pages, image);
+    fclose(image);
+
+    if(written != (size_t)pages)
+    {
+        fprintf(stderr, "Failed to write image %s\n", argv[2]);
+        return 1;
+    }
+
+    printf("Pages: %d\r\n", pages);
+    printf("Checksum: 0x%08X\r\n", (unsigned int)builder.get_image_checksum(pages));
+
+    return 0;
+}
@@ -0,0 +1,353 @@
+/**
+  * @file    DataManager_NodeWorkload.cpp
+  * @version 0.5.0
+  * @author  Adam Mitchell
+  * @brief   C++ file of the DataManager_NodeWorkload. Scripted storage workload of
+  *          one sensor node
+  */
+
+/** Includes
+ */
+#include <string.h>
+#include "DataManager_NodeWorkload.h"
+
+
+DataManager_NodeWorkload::DataManager_NodeWorkload(const NodeWorkload_t &workload, uint32_t seed) :
+                                                   _workload(workload),
+                                                   _data_manager(NC, NC, NC, 400000),
+                                                   _random(seed | 1)
+{
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+DataManager_NodeWorkload::~DataManager_NodeWorkload()
+{
+
+}
+
+/** Initialise the filesystem and create one file per sensor
+ *
+ * @return Indicates success or failure reason
+ */
+int DataManager_NodeWorkload::setup()
+{
+    if(_workload.sensors < 1 || _workload.sensors > WORKLOAD_MAX_SENSORS)
+    {
+        return DataManager_NodeWorkload::WORKLOAD_TOO_LARGE;
+    }
+
+    for(int sensor = 0; sensor < _workload.sensors; sensor++)
+    {
+        if(_workload.entry_bytes[sensor] < 1 || _workload.entry_bytes[sensor] > PAGE_SIZE_BYTES)
+        {
+            return DataManager_NodeWorkload::WORKLOAD_TOO_LARGE;
+        }
+
+        _stats.storage_bytes += _workload.entries_per_file[sensor] * _workload.entry_bytes[sensor];
+    }
+
+    if(_stats.storage_bytes > STORAGE_LENGTH)
+    {
+        return DataManager_NodeWorkload::WORKLOAD_TOO_LARGE;
+    }
+
+    DataManager_SimulatedEeprom::select(&_eeprom);
+
+    int status = _data_manager.init_filesystem();
+
+    if(status == DataManager::DATA_MANAGER_OK)
+    {
+        status = _data_manager.init_gstats();
+    }
+
+    for(int sensor = 1; sensor <= _workload.sensors && status == DataManager::DATA_MANAGER_OK; sensor++)
+    {
+        DataManager_FileSystem::File_t file;
+        memset(file.data, 0, sizeof(file));
+        file.parameters.filename = sensor;
+        file.parameters.length_bytes = _workload.entry_bytes[sensor - 1];
+
+        status = _data_manager.add_file(file, _workload.entries_per_file[sensor - 1]);
+    }
+
+    /** Spread the nodes' wake-ups across the first period
+     */
+    _next_wake_us = _eeprom.now_us() + ((uint64_t)(next_random() % _workload.wake_period_s) * 1000000);
+    _next_uplink_us = _eeprom.now_us() + ((uint64_t)_workload.uplink_period_s * 1000000);
+
+    return status;
+}
+
+/** Run the workload until the given virtual time
+ *
+ * @param end_s Virtual time, in seconds since setup(), at which to stop
+ * @return Indicates success or failure reason
+ */
+int DataManager_NodeWorkload::run(uint64_t end_s)
+{
+    DataManager_SimulatedEeprom::select(&_eeprom);
+
+    uint64_t end_us = end_s * 1000000;
+
+    while(_next_wake_us < end_us)
+    {
+        /** Sleep until the wake-up unless the previous cycle overran it
+         */
+        if(_eeprom.now_us() < _next_wake_us)
+        {
+            _eeprom.advance_us(_next_wake_us - _eeprom.now_us());
+        }
+
+        uint64_t wake_us = _eeprom.now_us();
+        _eeprom.advance_us(_workload.wake_overhead_us);
+
+        sample();
+
+        if(_eeprom.now_us() >= _next_uplink_us)
+        {
+            uplink();
+
+            while(_next_uplink_us <= _eeprom.now_us())
+            {
+                _next_uplink_us += (uint64_t)_workload.uplink_period_s * 1000000;
+            }
+        }
+
+        uint32_t awake_us = (uint32_t)(_eeprom.now_us() - wake_us);
+
+        _stats.cycles++;
+        _stats.awake_us += awake_us;
+
+        if(awake_us > _stats.max_awake_us)
+        {
+            _stats.max_awake_us = awake_us;
+        }
+
+        _next_wake_us += (uint64_t)_workload.wake_period_s * 1000000;
+    }
+
+    return DataManager_NodeWorkload::WORKLOAD_OK;
+}
+
+/** Append a sample to the file of each sensor
+ */
+void DataManager_NodeWorkload::sample()
+{
+    _stats.samples++;
+
+    for(int sensor = 1; sensor <= _workload.sensors; sensor++)
+    {
+        int entry_bytes = _workload.entry_bytes[sensor - 1];
+
+        for(int byte = 0; byte < entry_bytes; byte++)
+        {
+            _entry[byte] = (char)next_random();
+        }
+
+        uint64_t start_us = _eeprom.now_us();
+        int status = _data_manager.append_file_entry(sensor, _entry, entry_bytes);
+
+        if(status == DataManager_FileSystem::FILE_ENTRY_FULL)
+        {
+            int entries_to_remove = (_workload.entries_per_file[sensor - 1] * _workload.truncate_percent) / 100;
+
+            status = _data_manager.truncate_file(sensor, entries_to_remove > 0 ? entries_to_remove : 1);
+            _stats.truncations++;
+
+            if(status == DataManager::DATA_MANAGER_OK)
+            {
+                status = _data_manager.append_file_entry(sensor, _entry, entry_bytes);
+            }
+        }
+
+        record_call(start_us, status);
+    }
+}
+
+/** Attempt an uplink and, if it succeeds, read out and clear the file 
+ *  of each sensor
+ */
+void DataManager_NodeWorkload::uplink()
+{
+    if((int)(next_random() % 100) >= _workload.uplink_success_percent)
+    {
+        _stats.failed_uplinks++;
+        return;
+    }
+
+    _stats.uplinks++;
+
+    for(int sensor = 1; sensor <= _workload.sensors; sensor++)
+    {
+        uint64_t start_us = _eeprom.now_us();
+        int written_entries = 0;
+
+        int status = _data_manager.get_total_written_file_entries(sensor, written_entries);
+
+        for(int entry = 0; entry < written_entries && status == DataManager::DATA_MANAGER_OK; entry++)
+        {
+            status = _data_manager.read_file_entry(sensor, entry, _entry, _workload.entry_bytes[sensor - 1]);
+        }
+
+        if(status == DataManager::DATA_MANAGER_OK)
+        {
+            status = _data_manager.delete_file_entries(sensor);
+        }
+
+        record_call(start_us, status);
+    }
+}
+
+/** Advance the generator of sample data and uplink outcomes
+ *
+ * @return Next pseudo-random value
+ */
+uint32_t DataManager_NodeWorkload::next_random()
+{
+    _random ^= _random << 13;
+    _random ^= _random >> 17;
+    _random ^= _random << 5;
+
+    return _random;
+}
+
+/** Count the latency and outcome of a DataManager call started at start_us
+ *
+ * @param start_us Simulated time at which the call started
+ * @param status Status returned by the call
+ */
+void DataManager_NodeWorkload::record_call(uint64_t start_us, int status)
+{
+    uint32_t elapsed_us = (uint32_t)(_eeprom.now_us() - start_us);
+    int bucket = 0;
+
+    while(bucket < WORKLOAD_LATENCY_BUCKETS - 1 && (1u << bucket) <= elapsed_us)
+    {
+        bucket++;
+    }
+
+    _stats.calls++;
+    _stats.busy_us += elapsed_us;
+    _stats.latency_histogram[bucket]++;
+
+    if(elapsed_us > _stats.max_call_us)
+    {
+        _stats.max_call_us = elapsed_us;
+    }
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        _stats.errors++;
+    }
+}
+
+/** Get the outcome of the workload so far, including the wear of the device
+ *
+ * @param &stats Address of NodeStats_t to which the outcome will be written
+ */
+void DataManager_NodeWorkload::get_stats(NodeStats_t &stats)
+{
+    stats = _stats;
+    stats.max_page_writes = _eeprom.get_max_page_writes();
+    stats.write_cycles = _eeprom.get_write_cycles();
+    stats.bus_bytes = _eeprom.get_bus_bytes();
+}
+
+/** Add the outcome of one node to a total
+ *
+ * @param &total Total to which the node is added
+ * @param &node Outcome of the node
+ */
+void DataManager_NodeWorkload::accumulate(NodeStats_t &total, const NodeStats_t &node)
+{
+    total.cycles += node.cycles;
+    total.awake_us += node.awake_us;
+    total.samples += node.samples;
+    total.uplinks += node.uplinks;
+    total.failed_uplinks += node.failed_uplinks;
+    total.truncations += node.truncations;
+    total.errors += node.errors;
+    total.calls += node.calls;
+    total.busy_us += node.busy_us;
+    total.write_cycles += node.write_cycles;
+    total.bus_bytes += node.bus_bytes;
+    total.storage_bytes += node.storage_bytes;
+
+    if(node.max_awake_us > total.max_awake_us)
+    {
+        total.max_awake_us = node.max_awake_us;
+    }
+
+    if(node.max_call_us > total.max_call_us)
+    {
+        total.max_call_us = node.max_call_us;
+    }
+
+    if(node.max_page_writes > total.max_page_writes)
+    {
+        total.max_page_writes = node.max_page_writes;
+    }
+
+    for(int bucket = 0; bucket < WORKLOAD_LATENCY_BUCKETS; bucket++)
+    {
+        total.latency_histogram[bucket] += node.latency_histogram[bucket];
+    }
+}
+
+/** Find the latency below which a share of all calls completed
+ *
+ * @param &stats Outcome whose latency histogram is used
+ * @param percentile Share of calls, 0 to 100
+ * @return Upper bound of the bucket in microseconds
+ */
+uint32_t DataManager_NodeWorkload::latency_percentile_us(const NodeStats_t &stats, int percentile)
+{
+    uint64_t target = (stats.calls * percentile + 99) / 100;
+    uint64_t seen = 0;
+
+    for(int bucket = 0; bucket < WORKLOAD_LATENCY_BUCKETS; bucket++)
+    {
+        seen += stats.latency_histogram[bucket];
+
+        if(seen >= target)
+        {
+            return 1u << bucket;
+        }
+    }
+
+    return 1u << (WORKLOAD_LATENCY_BUCKETS - 1);
+}
+
+/** Project the lifetime of the EEPROM from the wear of its most worn page
+ *
+ * @param max_page_writes Write cycles of the most worn page
+ * @param days Simulated days in which they were accumulated
+ * @return Years until the most worn page reaches SIM_ENDURANCE_CYCLES
+ */
+double DataManager_NodeWorkload::projected_lifetime_years(uint32_t max_page_writes, double days)
+{
+    if(max_page_writes == 0)
+    {
+        return 0.0;
+    }
+
+    return (SIM_ENDURANCE_CYCLES / (double)max_page_writes) * (days / 365.0);
+}
+
+/** Get the DataManager of the node, e.g. to read its own counters
+ *
+ * @return DataManager of the node
+ */
+DataManager &DataManager_NodeWorkload::get_data_manager()
+{
+    return _data_manager;
+}
+
+/** Get the simulated EEPROM of the node
+ *
+ * @return Simulated EEPROM of the node
+ */
+DataManager_SimulatedEeprom &DataManager_NodeWorkload::get_eeprom()
+{
+    return _eeprom;
+}
@@ -0,0 +1,170 @@
+/**
+  * @file    DataManager_NodeWorkload.h
+  * @version 0.5.0
+  * @author  Adam Mitchell
+  * @brief   Scripted storage workload of one sensor node, run through the real
+  *          DataManager against its own simulated EEPROM in virtual time
+  */
+
+/** Define to prevent recursive inclusion
+ */
+#pragma once
+
+/** Includes
+ */
+#include <stdint.h>
+#include "DataManager.h"
+#include "DataManager_SimulatedEeprom.h"
+
+/** Number of log2 buckets, in microseconds, of the call latency histogram
+ *  and the largest number of sensors, i.e. files, of a node
+ */
+#define WORKLOAD_LATENCY_BUCKETS 24
+#define WORKLOAD_MAX_SENSORS     16
+
+/** Description of a node's duty cycle: every wake period the node wakes, spends
+ *  wake_overhead_us on everything but storage, samples each sensor and appends 
+ *  the samples to the sensor's file, then sleeps. On the first wake after each
+ *  uplink period it attempts an uplink, which succeeds uplink_success_percent of
+ *  the time and then reads out and clears every file. A file that fills up 
+ *  before a successful uplink has its oldest truncate_percent entries removed
+ */
+struct NodeWorkload_t
+{
+    int sensors;
+    int entry_bytes[WORKLOAD_MAX_SENSORS];
+    int entries_per_file[WORKLOAD_MAX_SENSORS];
+    uint32_t wake_period_s;
+    uint32_t wake_overhead_us;
+    uint32_t uplink_period_s;
+    int uplink_success_percent;
+    int truncate_percent;
+};
+
+/** Outcome of running a workload
+ */
+struct NodeStats_t
+{
+    uint64_t cycles;
+    uint64_t awake_us;
+    uint32_t max_awake_us;
+    uint64_t samples;
+    uint64_t uplinks;
+    uint64_t failed_uplinks;
+    uint64_t truncations;
+    uint64_t errors;
+    uint64_t calls;
+    uint64_t busy_us;
+    uint32_t max_call_us;
+    uint32_t max_page_writes;
+    uint64_t write_cycles;
+    uint64_t bus_bytes;
+    uint32_t storage_bytes;
+    uint64_t latency_histogram[WORKLOAD_LATENCY_BUCKETS];
+};
+
+class DataManager_NodeWorkload
+{
+
+    public:
+
+        enum
+        {
+            WORKLOAD_OK         = 0,
+            WORKLOAD_TOO_LARGE  = 1
+        };
+
+        /** @param &workload Behaviour of the node
+         *  @param seed Seed of the node's sample data and start phase
+         */
+        DataManager_NodeWorkload(const NodeWorkload_t &workload, uint32_t seed);
+
+        ~DataManager_NodeWorkload();
+
+        /** Initialise the filesystem and create one file per sensor
+         *
+         * @return Indicates success or failure reason
+         */
+        int setup();
+
+        /** Run the workload until the given virtual time
+         *
+         * @param end_s Virtual time, in seconds since setup(), at which to stop
+         * @return Indicates success or failure reason
+         */
+        int run(uint64_t end_s);
+
+        /** Get the outcome of the workload so far, including the wear of the device
+         *
+         * @param &stats Address of NodeStats_t to which the outcome will be written
+         */
+        void get_stats(NodeStats_t &stats);
+
+        /** Add the outcome of one node to a total
+         *
+         * @param &total Total to which the node is added
+         * @param &node Outcome of the node
+         */
+        static void accumulate(NodeStats_t &total, const NodeStats_t &node);
+
+        /** Find the latency below which a share of all calls completed
+         *
+         * @param &stats Outcome whose latency histogram is used
+         * @param percentile Share of calls, 0 to 100
+         * @return Upper bound of the bucket in microseconds
+         */
+        static uint32_t latency_percentile_us(const NodeStats_t &stats, int percentile);
+
+        /** Project the lifetime of the EEPROM from the wear of its most worn page
+         *
+         * @param max_page_writes Write cycles of the most worn page
+         * @param days Simulated days in which they were accumulated
+         * @return Years until the most worn page reaches SIM_ENDURANCE_CYCLES
+         */
+        static double projected_lifetime_years(uint32_t max_page_writes, double days);
+
+        /** Get the DataManager of the node, e.g. to read its own counters
+         *
+         * @return DataManager of the node
+         */
+        DataManager &get_data_manager();
+
+        /** Get the simulated EEPROM of the node
+         *
+         * @return Simulated EEPROM of the node
+         */
+        DataManager_SimulatedEeprom &get_eeprom();
+
+    private:
+
+        /** Append a sample to the file of each sensor
+         */
+        void sample();
+
+        /** Attempt an uplink and, if it succeeds, read out and clear the file 
+         *  of each sensor
+         */
+        void uplink();
+
+        /** Advance the generator of sample data and uplink outcomes
+         *
+         * @return Next pseudo-random value
+         */
+        uint32_t next_random();
+
+        /** Count the latency and outcome of a DataManager call started at start_us
+         *
+         * @param start_us Simulated time at which the call started
+         * @param status Status returned by the call
+         */
+        void record_call(uint64_t start_us, int status);
+
+        NodeWorkload_t _workload;
+        DataManager_SimulatedEeprom _eeprom;
+        DataManager _data_manager;
+        NodeStats_t _stats;
+        uint32_t _random;
+        uint64_t _next_wake_us;
+        uint64_t _next_uplink_us;
+        char _entry[PAGE_SIZE_BYTES];
+};
@@ -0,0 +1,393 @@
+/**
+  * @file    DataManager_PowerCut.cpp
+  * @version 0.5.0
+  * @author  Adam Mitchell
+  * @brief   C++ file of the DataManager_PowerCut. Scripted workload that is cut off
+  *          by a power cut, remounted and checked against a reference model
+  */
+
+/** Includes
+ */
+#include <string.h>
+#include "DataManager_PowerCut.h"
+
+
+DataManager_PowerCut::DataManager_PowerCut(const PowerCutWorkload_t &workload) :
+                                           _workload(workload),
+                                           _random(1)
+{
+    memset(_image, SIM_ERASED_VALUE, sizeof(_image));
+}
+
+DataManager_PowerCut::~DataManager_PowerCut()
+{
+
+}
+
+/** Initialise the filesystem, add the files and keep the resulting image
+ *  as the starting point of every run
+ *
+ * @return Indicates success or failure reason
+ */
+int DataManager_PowerCut::format()
+{
+    if(_workload.files < 1 || _workload.files > POWER_CUT_MAX_FILES ||
+       _workload.entry_bytes < 1 || _workload.entry_bytes > PAGE_SIZE_BYTES ||
+       _workload.entries_per_file < 1 ||
+       _workload.files * _workload.entry_bytes * _workload.entries_per_file > STORAGE_LENGTH)
+    {
+        return DataManager_PowerCut::POWER_CUT_TOO_LARGE;
+    }
+
+    DataManager_SimulatedEeprom::select(&_eeprom);
+    _eeprom.erase();
+
+    DataManager *data_manager = new DataManager(NC, NC, NC, 400000);
+
+    int status = data_manager->init_filesystem();
+
+    if(status == DataManager::DATA_MANAGER_OK)
+    {
+        status = data_manager->init_gstats();
+    }
+
+    for(int file = 0; file < _workload.files && status == DataManager::DATA_MANAGER_OK; file++)
+    {
+        DataManager_FileSystem::File_t definition;
+        memset(definition.data, 0, sizeof(definition));
+        definition.parameters.filename = file + 1;
+        definition.parameters.length_bytes = _workload.entry_bytes;
+
+        status = data_manager->add_file(definition, _workload.entries_per_file);
+    }
+
+    delete data_manager;
+
+    memcpy(_image, _eeprom.get_memory(), sizeof(_image));
+
+    return status;
+}
+
+/** Run the whole workload without a cut, logging the length of every write
+ *  so that its cut points can be enumerated
+ *
+ * @param &write_lengths Log to which the length of each write is appended
+ * @return Indicates success or failure reason
+ */
+int DataManager_PowerCut::reference(std::vector<uint8_t> &write_lengths)
+{
+    DataManager_SimulatedEeprom::select(&_eeprom);
+    _eeprom.erase();
+    memcpy(_eeprom.get_memory(), _image, sizeof(_image));
+
+    PowerCutResult_t result;
+    memset(&result, 0, sizeof(result));
+
+    _eeprom.set_write_log(&write_lengths);
+    int status = run_workload(result);
+    _eeprom.set_write_log(NULL);
+
+    return status;
+}
+
+/** Run the workload from the formatted image until power is cut during a
+ *  write, then remount and check the filesystem
+ *
+ * @param write_cycle Index of the write, counted from the start of the workload, to cut
+ * @param bytes_landed Number of bytes of that write that are programmed
+ * @param &result Address of PowerCutResult_t to which the outcome will be written
+ */
+void DataManager_PowerCut::run(uint64_t write_cycle, int bytes_landed, PowerCutResult_t &result)
+{
+    DataManager_SimulatedEeprom::select(&_eeprom);
+    _eeprom.erase();
+    memcpy(_eeprom.get_memory(), _image, sizeof(_image));
+
+    memset(&result, 0, sizeof(result));
+    result.write_cycle = write_cycle;
+    result.bytes_landed = bytes_landed;
+
+    _eeprom.set_power_cut(write_cycle, bytes_landed);
+    run_workload(result);
+    _eeprom.clear_power_cut();
+
+    result.cut = !_eeprom.is_powered();
+
+    if(!result.cut)
+    {
+        _pending = _model;
+    }
+
+    _eeprom.restore_power();
+    remount(result);
+}
+
+/** Run operations of the workload until it completes or power is cut
+ *
+ * @param &result Address of PowerCutResult_t to which the operation that was cut is written
+ * @return Indicates success or failure reason
+ */
+int DataManager_PowerCut::run_workload(PowerCutResult_t &result)
+{
+    _random = _workload.seed | 1;
+    _model.assign(_workload.files, std::vector<uint32_t>());
+    memset(_next_sequence, 0, sizeof(_next_sequence));
+
+    DataManager *data_manager = new DataManager(NC, NC, NC, 400000);
+    int status = DataManager::DATA_MANAGER_OK;
+
+    for(int operation = 0; operation < _workload.operations && _eeprom.is_powered(); operation++)
+    {
+        int file = next_random() % _workload.files;
+        int second_file = (file + 1) % _workload.files;
+        int choice = next_random() % 100;
+        int kind = POWER_CUT_APPEND;
+        int entries = _model[file].size();
+
+        if(entries > 0 && (choice < _workload.truncate_percent || entries == _workload.entries_per_file))
+        {
+            kind = POWER_CUT_TRUNCATE;
+        }
+        else if(choice < _workload.truncate_percent + _workload.transaction_percent && second_file != file &&
+                (int)_model[second_file].size() < _workload.entries_per_file)
+        {
+            kind = POWER_CUT_TRANSACTION;
+        }
+
+        _pending = _model;
+        result.operation = operation;
+        result.operation_kind = kind;
+
+        if(kind == POWER_CUT_TRUNCATE)
+        {
+            int entries_to_remove = (entries / 4) + 1;
+
+            _pending[file].erase(_pending[file].begin(), _pending[file].begin() + entries_to_remove);
+
+            if(_workload.budget_write_cycles == 0)
+            {
+                status = data_manager->truncate_file(file + 1, entries_to_remove);
+            }
+            else
+            {
+                DataManager::OperationBudget_t budget = { 0, _workload.budget_write_cycles };
+
+                do
+                {
+                    status = data_manager->truncate_file(file + 1, entries_to_remove, budget);
+                }
+                while(status == DataManager_FileSystem::OPERATION_IN_PROGRESS);
+            }
+        }
+        else if(kind == POWER_CUT_TRANSACTION)
+        {
+            _pending[file].push_back(_next_sequence[file]);
+            _pending[second_file].push_back(_next_sequence[second_file]);
+
+            status = data_manager->begin();
+
+            if(status == DataManager::DATA_MANAGER_OK)
+            {
+                status = append(*data_manager, file);
+            }
+
+            if(status == DataManager::DATA_MANAGER_OK)
+            {
+                status = append(*data_manager, second_file);
+            }
+
+            if(status == DataManager::DATA_MANAGER_OK)
+            {
+                status = data_manager->commit();
+            }
+            else
+            {
+                data_manager->rollback();
+            }
+        }
+        else
+        {
+            _pending[file].push_back(_next_sequence[file]);
+            status = append(*data_manager, file);
+        }
+
+        if(!_eeprom.is_powered())
+        {
+            break;
+        }
+
+        if(status != DataManager::DATA_MANAGER_OK)
+        {
+            break;
+        }
+
+        _model = _pending;
+
+        for(int changed = 0; changed < _workload.files; changed++)
+        {
+            if(!_model[changed].empty() && _model[changed].back() >= _next_sequence[changed])
+            {
+                _next_sequence[changed] = _model[changed].back() + 1;
+            }
+        }
+    }
+
+    delete data_manager;
+
+    return status;
+}
+
+/** Append the next entry of a file
+ *
+ * @param &data_manager DataManager to call
+ * @param file Index of the file
+ * @return Status returned by the DataManager
+ */
+int DataManager_PowerCut::append(DataManager &data_manager, int file)
+{
+    fill_entry(file, _next_sequence[file]);
+
+    return data_manager.append_file_entry(file + 1, _entry, _workload.entry_bytes);
+}
+
+/** Remount the filesystem with a fresh DataManager, as after a reset, and
+ *  check it against the model
+ *
+ * @param &result Address of PowerCutResult_t to which the cost and violation will be written
+ */
+void DataManager_PowerCut::remount(PowerCutResult_t &result)
+{
+    uint64_t start_us = _eeprom.now_us();
+    uint64_t start_write_cycles = _eeprom.get_write_cycles();
+    uint64_t start_bus_bytes = _eeprom.get_bus_bytes();
+
+    DataManager *data_manager = new DataManager(NC, NC, NC, 400000);
+    bool initialised = false;
+
+    int status = data_manager->recover_transaction();
+
+    /** Finish a resumable operation that was cut
+     */
+    if(status == DataManager::DATA_MANAGER_OK)
+    {
+        DataManager::OperationBudget_t budget = { 0, 0 };
+        status = data_manager->resume_operation(budget);
+    }
+
+    if(status == DataManager::DATA_MANAGER_OK)
+    {
+        status = data_manager->is_initialised(initialised);
+    }
+
+    for(int file = 0; file < _workload.files && status == DataManager::DATA_MANAGER_OK; file++)
+    {
+        DataManager_FileSystem::File_t definition;
+
+        if(data_manager->get_file_by_name(file + 1, definition) != DataManager::DATA_MANAGER_OK &&
+           result.violation == POWER_CUT_CONSISTENT)
+        {
+            result.violation = POWER_CUT_FILE_LOST;
+            result.violation_file = file + 1;
+        }
+    }
+
+    result.mount_us = (uint32_t)(_eeprom.now_us() - start_us);
+    result.mount_write_cycles = (uint32_t)(_eeprom.get_write_cycles() - start_write_cycles);
+    result.mount_bus_bytes = (uint32_t)(_eeprom.get_bus_bytes() - start_bus_bytes);
+
+    if(status != DataManager::DATA_MANAGER_OK || !initialised)
+    {
+        result.violation = POWER_CUT_MOUNT_FAILED;
+    }
+
+    if(result.violation == POWER_CUT_CONSISTENT)
+    {
+        /** The operation that was cut must have happened completely or not at all
+         */
+        int file;
+        int violation = check(*data_manager, _model, result.violation_file);
+
+        if(violation != POWER_CUT_CONSISTENT &&
+           check(*data_manager, _pending, file) == POWER_CUT_CONSISTENT)
+        {
+            violation = POWER_CUT_CONSISTENT;
+            result.violation_file = 0;
+        }
+
+        result.violation = violation;
+    }
+
+    delete data_manager;
+}
+
+/** Compare the files with one state of the model
+ *
+ * @param &data_manager DataManager of the remounted filesystem
+ * @param &model Entries expected in each file
+ * @param &file Address of integer value to which the first inconsistent file will be stored
+ * @return POWER_CUT_CONSISTENT or the violation found
+ */
+int DataManager_PowerCut::check(DataManager &data_manager, const std::vector<std::vector<uint32_t> > &model, int &file)
+{
+    for(file = 1; file <= _workload.files; file++)
+    {
+        const std::vector<uint32_t> &entries = model[file - 1];
+        int written_entries = 0;
+
+        if(data_manager.get_total_written_file_entries(file, written_entries) != DataManager::DATA_MANAGER_OK)
+        {
+            return POWER_CUT_FILE_LOST;
+        }
+
+        if(written_entries != (int)entries.size())
+        {
+            return POWER_CUT_ENTRY_COUNT;
+        }
+
+        for(int entry = 0; entry < written_entries; entry++)
+        {
+            fill_entry(file - 1, entries[entry]);
+
+            if(data_manager.read_file_entry(file, entry, _read, _workload.entry_bytes) != DataManager::DATA_MANAGER_OK ||
+               memcmp(_read, _entry, _workload.entry_bytes) != 0)
+            {
+                return POWER_CUT_ENTRY_CONTENT;
+            }
+        }
+    }
+
+    file = 0;
+
+    return POWER_CUT_CONSISTENT;
+}
+
+/** Fill the entry buffer with the contents of an entry
+ *
+ * @param file Index of the file
+ * @param sequence Sequence number of the entry within its file
+ */
+void DataManager_PowerCut::fill_entry(int file, uint32_t sequence)
+{
+    uint32_t value = ((sequence + 1) * 0x9E3779B9u) ^ ((uint32_t)(file + 1) << 24);
+
+    for(int byte = 0; byte < _workload.entry_bytes; byte++)
+    {
+        value ^= value << 13;
+        value ^= value >> 17;
+        value ^= value << 5;
+        _entry[byte] = (char)value;
+    }
+}
+
+/** Advance the generator of the operation script
+ *
+ * @return Next pseudo-random value
+ */
+uint32_t DataManager_PowerCut::next_random()
+{
+    _random ^= _random << 13;
+    _random ^= _random >> 17;
+    _random ^= _random << 5;
+
+    return _random;
+}
@@ -0,0 +1,185 @@
+/**
+  * @file    DataManager_PowerCut.h
+  * @version 0.5.0
+  * @author  Adam Mitchell
+  * @brief   Scripted workload that is cut off by a power cut inside one of its
+  *          EEPROM writes, after which the filesystem is remounted by a fresh
+  *          DataManager and checked against a reference model of the workload
+  */
+
+/** Define to prevent recursive inclusion
+ */
+#pragma once
+
+/** Includes
+ */
+#include <stdint.h>
+#include <vector>
+#include "DataManager.h"
+#include "DataManager_SimulatedEeprom.h"
+
+/** Largest number of files of a power cut workload
+ */
+#define POWER_CUT_MAX_FILES 16
+
+/** Description of a power cut workload: files of equal entry length are added
+ *  to a fresh filesystem, after which each operation appends an entry to one
+ *  of them, truncates it or, in a transaction, appends an entry to two files
+ *  at once. A file that is full is truncated instead of appended to. Entry
+ *  contents are derived from the file and a sequence number. With a non-zero
+ *  budget_write_cycles truncations are resumable, run by repeated calls of at
+ *  most that many write cycles, and resumed by the remount
+ */
+struct PowerCutWorkload_t
+{
+    int files;
+    int entry_bytes;
+    int entries_per_file;
+    int operations;
+    int truncate_percent;
+    int transaction_percent;
+    uint32_t budget_write_cycles;
+    uint32_t seed;
+};
+
+/** Invariants checked after the remount. The files must hold exactly the
+ *  entries of the model either before or after the operation that was cut
+ */
+enum PowerCutViolation
+{
+    POWER_CUT_CONSISTENT     = 0,
+    POWER_CUT_MOUNT_FAILED   = 1,
+    POWER_CUT_FILE_LOST      = 2,
+    POWER_CUT_ENTRY_COUNT    = 3,
+    POWER_CUT_ENTRY_CONTENT  = 4,
+    POWER_CUT_VIOLATIONS
+};
+
+/** Kinds of operation of the workload
+ */
+enum PowerCutOperation
+{
+    POWER_CUT_APPEND         = 0,
+    POWER_CUT_TRUNCATE       = 1,
+    POWER_CUT_TRANSACTION    = 2
+};
+
+/** Outcome of one cut: where it happened, what it cost to remount and whether
+ *  the filesystem was consistent afterwards
+ */
+struct PowerCutResult_t
+{
+    uint64_t write_cycle;
+    int bytes_landed;
+    bool cut;
+    int operation;
+    int operation_kind;
+    uint32_t mount_us;
+    uint32_t mount_write_cycles;
+    uint32_t mount_bus_bytes;
+    int violation;
+    int violation_file;
+};
+
+class DataManager_PowerCut
+{
+
+    public:
+
+        enum
+        {
+            POWER_CUT_OK        = 0,
+            POWER_CUT_TOO_LARGE = 1
+        };
+
+        /** @param &workload Workload that is cut
+         */
+        DataManager_PowerCut(const PowerCutWorkload_t &workload);
+
+        ~DataManager_PowerCut();
+
+        /** Initialise the filesystem, add the files and keep the resulting image
+         *  as the starting point of every run
+         *
+         * @return Indicates success or failure reason
+         */
+        int format();
+
+        /** Run the whole workload without a cut, logging the length of every write
+         *  so that its cut points can be enumerated
+         *
+         * @param &write_lengths Log to which the length of each write is appended
+         * @return Indicates success or failure reason
+         */
+        int reference(std::vector<uint8_t> &write_lengths);
+
+        /** Run the workload from the formatted image until power is cut during a
+         *  write, then remount and check the filesystem
+         *
+         * @param write_cycle Index of the write, counted from the start of the workload, to cut
+         * @param bytes_landed Number of bytes of that write that are programmed
+         * @param &result Address of PowerCutResult_t to which the outcome will be written
+         */
+        void run(uint64_t write_cycle, int bytes_landed, PowerCutResult_t &result);
+
+    private:
+
+        /** Run operations of the workload until it completes or power is cut
+         *
+         * @param &result Address of PowerCutResult_t to which the operation that was cut is written
+         * @return Indicates success or failure reason
+         */
+        int run_workload(PowerCutResult_t &result);
+
+        /** Append the next entry of a file
+         *
+         * @param &data_manager DataManager to call
+         * @param file Index of the file
+         * @return Status returned by the DataManager
+         */
+        int append(DataManager &data_manager, int file);
+
+        /** Remount the filesystem with a fresh DataManager, as after a reset, and
+         *  check it against the model
+         *
+         * @param &result Address of PowerCutResult_t to which the cost and violation will be written
+         */
+        void remount(PowerCutResult_t &result);
+
+        /** Compare the files with one state of the model
+         *
+         * @param &data_manager DataManager of the remounted filesystem
+         * @param &model Entries expected in each file
+         * @param &file Address of integer value to which the first inconsistent file will be stored
+         * @return POWER_CUT_CONSISTENT or the violation found
+         */
+        int check(DataManager &data_manager, const std::vector<std::vector<uint32_t> > &model, int &file);
+
+        /** Fill the entry buffer with the contents of an entry
+         *
+         * @param file Index of the file
+         * @param sequence Sequence number of the entry within its file
+         */
+        void fill_entry(int file, uint32_t sequence);
+
+        /** Advance the generator of the operation script
+         *
+         * @return Next pseudo-random value
+         */
+        uint32_t next_random();
+
+        PowerCutWorkload_t _workload;
+        DataManager_SimulatedEeprom _eeprom;
+        uint8_t _image[SIM_EEPROM_BYTES];
+        uint32_t _random;
+
+        /** Entries of each file after the last completed operation, after the
+         *  operation in progress and the next sequence number of each file
+         */
+        std::vector<std::vector<uint32_t> > _model;
+        std::vector<std::vector<uint32_t> > _pending;
+        uint32_t _next_sequence[POWER_CUT_MAX_FILES];
+
+        char _entry[PAGE_SIZE_BYTES];
+        char _read[PAGE_SIZE_BYTES];
+};
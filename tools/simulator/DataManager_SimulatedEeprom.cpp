@@ -0,0 +1,625 @@
+/**
+  * @file    DataManager_SimulatedEeprom.cpp
+  * @version 0.5.0
+  * @author  Adam Mitchell
+  * @brief   C++ file of the DataManager_SimulatedEeprom. Host-side model of an M24256
+  *          EEPROM, together with the host STM24256 driver that uses it
+  */
+
+/** Includes
+ */
+#include <string.h>
+#include "DataManager_SimulatedEeprom.h"
+#include "STM24256.h"
+
+/** Device used by the host I2C and STM24256 stand-ins on each thread
+ */
+static thread_local DataManager_SimulatedEeprom *selected_device = NULL;
+
+
+DataManager_SimulatedEeprom::DataManager_SimulatedEeprom() :
+                                                         _write_log(NULL)
+{
+    set_bus_faults(0, 0, 0, 1);
+    set_max_frequency(0);
+
+    erase();
+}
+
+DataManager_SimulatedEeprom::~DataManager_SimulatedEeprom()
+{
+
+}
+
+/** Select the device used by the calling thread
+ *
+ * @param *device Device to be used
+ */
+void DataManager_SimulatedEeprom::select(DataManager_SimulatedEeprom *device)
+{
+    selected_device = device;
+}
+
+/** Get the device used by the calling thread
+ *
+ * @return Selected device
+ */
+DataManager_SimulatedEeprom *DataManager_SimulatedEeprom::selected()
+{
+    return selected_device;
+}
+
+/** Set every byte to the erased value and clear all counters
+ */
+void DataManager_SimulatedEeprom::erase()
+{
+    memset(_memory, SIM_ERASED_VALUE, sizeof(_memory));
+    memset(_page_writes, 0, sizeof(_page_writes));
+
+    _address = 0;
+    _now_us = 0;
+    _busy_until_us = 0;
+    _write_cycles = 0;
+    _bus_bytes = 0;
+    _bus_bits = 0;
+    _powered = true;
+    _cut_pending = false;
+    memset(_injected_faults, 0, sizeof(_injected_faults));
+
+    _interrupts.clear();
+    _interrupt_sequence = 0;
+}
+
+/** Get the simulated time
+ *
+ * @return Microseconds since construction or the last erase
+ */
+uint64_t DataManager_SimulatedEeprom::now_us()
+{
+    return _now_us;
+}
+
+/** Advance the simulated time, e.g. whilst the node sleeps
+ *
+ * @param us Number of microseconds to advance by
+ */
+void DataManager_SimulatedEeprom::advance_us(uint64_t us)
+{
+    _now_us += us;
+}
+
+/** Advance the simulated time to the end of any write cycle in progress
+ */
+void DataManager_SimulatedEeprom::wait_for_idle()
+{
+    if(_now_us < _busy_until_us)
+    {
+        _now_us = _busy_until_us;
+    }
+}
+
+/** Queue a handler to be run as an interrupt, as the I2C and Timeout 
+ *  stand-ins do for their events
+ *
+ * @param due_us Simulated time from which the handler may run
+ * @param &handler Handler to be run
+ */
+void DataManager_SimulatedEeprom::post_interrupt(uint64_t due_us, const std::function<void()> &handler)
+{
+    Interrupt_t interrupt;
+    interrupt.due_us = due_us;
+    interrupt.sequence = _interrupt_sequence++;
+    interrupt.handler = handler;
+
+    _interrupts.push_back(interrupt);
+}
+
+/** Run the queued interrupts that are due, in order of due time and then
+ *  of queueing, including those queued by the handlers run
+ *
+ * @return Number of handlers run
+ */
+int DataManager_SimulatedEeprom::run_interrupts()
+{
+    int run = 0;
+
+    while(true)
+    {
+        int next = -1;
+
+        for(int interrupt = 0; interrupt < (int)_interrupts.size(); interrupt++)
+        {
+            if(_interrupts[interrupt].due_us <= _now_us &&
+               (next < 0 || _interrupts[interrupt].due_us < _interrupts[next].due_us ||
+                (_interrupts[interrupt].due_us == _interrupts[next].due_us &&
+                 _interrupts[interrupt].sequence < _interrupts[next].sequence)))
+            {
+                next = interrupt;
+            }
+        }
+
+        if(next < 0)
+        {
+            return run;
+        }
+
+        /** The handler may queue more, so take it off the queue first
+         */
+        std::function<void()> handler = _interrupts[next].handler;
+        _interrupts.erase(_interrupts.begin() + next);
+
+        handler();
+        run++;
+    }
+}
+
+/** Get the due time of the next queued interrupt
+ *
+ * @param &due_us Address to which the due time will be written
+ * @return False if no interrupt is queued, else true
+ */
+bool DataManager_SimulatedEeprom::next_interrupt(uint64_t &due_us)
+{
+    if(_interrupts.empty())
+    {
+        return false;
+    }
+
+    due_us = _interrupts[0].due_us;
+
+    for(int interrupt = 1; interrupt < (int)_interrupts.size(); interrupt++)
+    {
+        if(_interrupts[interrupt].due_us < due_us)
+        {
+            due_us = _interrupts[interrupt].due_us;
+        }
+    }
+
+    return true;
+}
+
+/** Determine whether or not a write cycle is in progress, during which
+ *  the device NACKs its address
+ *
+ * @return True if a write cycle is in progress, else false
+ */
+bool DataManager_SimulatedEeprom::is_busy()
+{
+    return _now_us < _busy_until_us;
+}
+
+/** Random read, i.e. address bytes followed by a read
+ *
+ * @param address Address from which to read
+ * @param *data Pointer to an array in which the read data will be stored
+ * @param length Number of bytes to be read
+ * @param frequency_hz Bus clock used for the transfer
+ * @return SIM_OK, SIM_NACK or an injected fault
+ */
+int DataManager_SimulatedEeprom::random_read(int address, char *data, int length, int frequency_hz)
+{
+    int status = set_address(address, frequency_hz);
+
+    if(status != SIM_OK)
+    {
+        return status;
+    }
+
+    return current_read(data, length, frequency_hz);
+}
+
+/** Current address read, continuing from the internal address counter
+ *
+ * @param *data Pointer to an array in which the read data will be stored
+ * @param length Number of bytes to be read
+ * @param frequency_hz Bus clock used for the transfer
+ * @return SIM_OK, SIM_NACK or an injected fault
+ */
+int DataManager_SimulatedEeprom::current_read(char *data, int length, int frequency_hz)
+{
+    if(!_powered || is_busy())
+    {
+        clock_bytes(1, frequency_hz);
+        return SIM_NACK;
+    }
+
+    int status = inject_fault(1 + length, frequency_hz);
+
+    if(status != SIM_OK)
+    {
+        return status;
+    }
+
+    clock_bytes(1 + length, frequency_hz);
+
+    for(int byte = 0; byte < length; byte++)
+    {
+        data[byte] = _memory[_address];
+        _address = (_address + 1) % SIM_EEPROM_BYTES;
+    }
+
+    return SIM_OK;
+}
+
+/** Set the internal address counter without writing, i.e. the first
+ *  half of a random read
+ *
+ * @param address New value of the address counter
+ * @param frequency_hz Bus clock used for the transfer
+ * @return SIM_OK, SIM_NACK or an injected fault
+ */
+int DataManager_SimulatedEeprom::set_address(int address, int frequency_hz)
+{
+    if(!_powered || is_busy())
+    {
+        clock_bytes(1, frequency_hz);
+        return SIM_NACK;
+    }
+
+    int status = inject_fault(3, frequency_hz);
+
+    if(status != SIM_OK)
+    {
+        return status;
+    }
+
+    clock_bytes(3, frequency_hz);
+    _address = address % SIM_EEPROM_BYTES;
+
+    return SIM_OK;
+}
+
+/** Page write. The address counter rolls over within the page and a
+ *  write cycle of SIM_WRITE_CYCLE_US is started
+ *
+ * @param address Address to which to write
+ * @param *data Data to be written
+ * @param length Number of bytes to be written
+ * @param frequency_hz Bus clock used for the transfer
+ * @return SIM_OK, SIM_NACK or an injected fault
+ */
+int DataManager_SimulatedEeprom::page_write(int address, const char *data, int length, int frequency_hz)
+{
+    if(!_powered || is_busy())
+    {
+        clock_bytes(1, frequency_hz);
+        return SIM_NACK;
+    }
+
+    int status = inject_fault(3 + length, frequency_hz);
+
+    if(status != SIM_OK)
+    {
+        return status;
+    }
+
+    clock_bytes(3 + length, frequency_hz);
+
+    if(_write_log != NULL)
+    {
+        _write_log->push_back(length);
+    }
+
+    int page_start = (address % SIM_EEPROM_BYTES) & ~(SIM_EEPROM_PAGE_BYTES - 1);
+    int landed = length;
+
+    if(_cut_pending && _write_cycles == _cut_write_cycle)
+    {
+        _cut_pending = false;
+        _powered = false;
+
+        if(_cut_bytes_landed == 0)
+        {
+            return SIM_NACK;
+        }
+
+        landed = _cut_bytes_landed;
+    }
+
+    _address = address % SIM_EEPROM_BYTES;
+
+    for(int byte = 0; byte < length; byte++)
+    {
+        _memory[_address] = byte < landed ? data[byte] : SIM_ERASED_VALUE;
+        _address = page_start | ((_address + 1) & (SIM_EEPROM_PAGE_BYTES - 1));
+    }
+
+    _page_writes[page_start / SIM_EEPROM_PAGE_BYTES]++;
+    _write_cycles++;
+    _busy_until_us = _now_us + SIM_WRITE_CYCLE_US;
+
+    return SIM_OK;
+}
+
+/** Get the number of write cycles a page has been through
+ *
+ * @param page Index of the page
+ * @return Number of write cycles
+ */
+uint32_t DataManager_SimulatedEeprom::get_page_writes(int page)
+{
+    return _page_writes[page];
+}
+
+/** Get the number of write cycles of the most worn page
+ *
+ * @return Number of write cycles
+ */
+uint32_t DataManager_SimulatedEeprom::get_max_page_writes()
+{
+    uint32_t max_writes = 0;
+
+    for(int page = 0; page < SIM_EEPROM_PAGES; page++)
+    {
+        if(_page_writes[page] > max_writes)
+        {
+            max_writes = _page_writes[page];
+        }
+    }
+
+    return max_writes;
+}
+
+/** Get the total number of write cycles of all pages
+ *
+ * @return Number of write cycles
+ */
+uint64_t DataManager_SimulatedEeprom::get_write_cycles()
+{
+    return _write_cycles;
+}
+
+/** Get the total number of bytes clocked on the bus
+ *
+ * @return Number of bytes
+ */
+uint64_t DataManager_SimulatedEeprom::get_bus_bytes()
+{
+    return _bus_bytes;
+}
+
+/** Get the raw contents of the device
+ *
+ * @return Pointer to SIM_EEPROM_BYTES bytes
+ */
+uint8_t *DataManager_SimulatedEeprom::get_memory()
+{
+    return _memory;
+}
+
+/** Cut power during a write cycle. The first bytes_landed bytes of the
+ *  write are programmed and the rest of it is left erased, as the cells
+ *  of a page are erased before they are programmed. With bytes_landed 
+ *  of zero the write never starts. From then on the device NACKs every
+ *  transfer until restore_power()
+ *
+ * @param write_cycle Index, counted from zero since construction or the last erase, of the write to cut
+ * @param bytes_landed Number of bytes of that write that are programmed
+ */
+void DataManager_SimulatedEeprom::set_power_cut(uint64_t write_cycle, int bytes_landed)
+{
+    _cut_pending = true;
+    _cut_write_cycle = write_cycle;
+    _cut_bytes_landed = bytes_landed;
+}
+
+/** Cancel a power cut that is yet to happen
+ */
+void DataManager_SimulatedEeprom::clear_power_cut()
+{
+    _cut_pending = false;
+}
+
+/** Determine whether or not the device is powered
+ *
+ * @return False once a power cut has happened and until restore_power(), else true
+ */
+bool DataManager_SimulatedEeprom::is_powered()
+{
+    return _powered;
+}
+
+/** Power the device back up after a cut, leaving its contents as they were
+ */
+void DataManager_SimulatedEeprom::restore_power()
+{
+    _powered = true;
+    _busy_until_us = _now_us;
+}
+
+/** Inject bus faults into transfers made whilst the device is powered and
+ *  idle. A NACKed transfer ends after the device address, one that loses
+ *  arbitration after half of its bytes and one that times out holds the
+ *  bus for SIM_BUS_TIMEOUT_US. None of them change the memory
+ *
+ * @param nack_ppm Transfers per million that are NACKed
+ * @param arbitration_ppm Transfers per million that lose arbitration
+ * @param timeout_ppm Transfers per million that time out
+ * @param seed Seed of the fault sequence
+ */
+void DataManager_SimulatedEeprom::set_bus_faults(uint32_t nack_ppm, uint32_t arbitration_ppm, uint32_t timeout_ppm, uint32_t seed)
+{
+    _fault_ppm[SIM_OK] = 0;
+    _fault_ppm[SIM_NACK] = nack_ppm;
+    _fault_ppm[SIM_ARBITRATION_LOST] = arbitration_ppm;
+    _fault_ppm[SIM_TIMEOUT] = timeout_ppm;
+    _fault_random = seed | 1;
+}
+
+/** NACK every transfer clocked faster than the board can sustain, e.g.
+ *  because of long traces or weak pull-ups. NACKs injected this way are
+ *  counted with those of set_bus_faults()
+ *
+ * @param frequency_hz Fastest bus clock that works, or 0 for no limit
+ */
+void DataManager_SimulatedEeprom::set_max_frequency(int frequency_hz)
+{
+    _max_frequency_hz = frequency_hz;
+}
+
+/** Get the number of faults of one kind injected since construction or the last erase
+ *
+ * @param fault SIM_NACK, SIM_ARBITRATION_LOST or SIM_TIMEOUT
+ * @return Number of faults injected
+ */
+uint64_t DataManager_SimulatedEeprom::get_injected_faults(int fault)
+{
+    return _injected_faults[fault];
+}
+
+/** Append the length of every subsequent write to a log, e.g. to enumerate
+ *  the cut points of a workload
+ *
+ * @param *lengths Log to append to, or NULL to stop logging
+ */
+void DataManager_SimulatedEeprom::set_write_log(std::vector<uint8_t> *lengths)
+{
+    _write_log = lengths;
+}
+
+/** Advance the simulated time by the duration of a transfer
+ *
+ * @param bytes Number of bytes clocked on the bus
+ * @param frequency_hz Bus clock used for the transfer
+ */
+void DataManager_SimulatedEeprom::clock_bytes(int bytes, int frequency_hz)
+{
+    /** Carry the remainder so that short transfers at high rates aren't lost
+     */
+    _bus_bytes += bytes;
+    _bus_bits += (uint64_t)bytes * SIM_BITS_PER_BUS_BYTE * 1000000;
+
+    _now_us += _bus_bits / frequency_hz;
+    _bus_bits %= frequency_hz;
+}
+
+
+/** Decide whether a transfer is hit by an injected fault and charge its cost
+ *
+ * @param bytes Number of bytes the transfer would clock on the bus
+ * @param frequency_hz Bus clock used for the transfer
+ * @return SIM_OK or the fault injected
+ */
+int DataManager_SimulatedEeprom::inject_fault(int bytes, int frequency_hz)
+{
+    if(_max_frequency_hz > 0 && frequency_hz > _max_frequency_hz)
+    {
+        _injected_faults[SIM_NACK]++;
+        clock_bytes(1, frequency_hz);
+
+        return SIM_NACK;
+    }
+
+    if(_fault_ppm[SIM_NACK] == 0 && _fault_ppm[SIM_ARBITRATION_LOST] == 0 && _fault_ppm[SIM_TIMEOUT] == 0)
+    {
+        return SIM_OK;
+    }
+
+    _fault_random ^= _fault_random << 13;
+    _fault_random ^= _fault_random >> 17;
+    _fault_random ^= _fault_random << 5;
+
+    uint32_t draw = _fault_random % 1000000;
+
+    for(int fault = SIM_NACK; fault < SIM_FAULT_KINDS; fault++)
+    {
+        if(draw >= _fault_ppm[fault])
+        {
+            draw -= _fault_ppm[fault];
+            continue;
+        }
+
+        _injected_faults[fault]++;
+
+        if(fault == SIM_NACK)
+        {
+            clock_bytes(1, frequency_hz);
+        }
+        else if(fault == SIM_ARBITRATION_LOST)
+        {
+            clock_bytes((bytes + 1) / 2, frequency_hz);
+        }
+        else
+        {
+            _now_us += SIM_BUS_TIMEOUT_US;
+        }
+
+        return fault;
+    }
+
+    return SIM_OK;
+}
+
+
+STM24256::STM24256(PinName write_control, PinName sda, PinName scl, int frequency_hz) : _frequency_hz(frequency_hz)
+{
+
+}
+
+STM24256::~STM24256()
+{
+
+}
+
+/** Blocking random read, waiting for any write cycle in progress
+ *
+ * @param address Address from which to read
+ * @param *data Pointer to an array in which the read data will be stored
+ * @param length Number of bytes to be read
+ * @return 0 on success, else non-zero
+ */
+int STM24256::read_from_address(int address, char *data, int length)
+{
+    DataManager_SimulatedEeprom *device = DataManager_SimulatedEeprom::selected();
+
+    if(address < 0 || address + length > SIM_EEPROM_BYTES)
+    {
+        return DataManager_SimulatedEeprom::SIM_NACK;
+    }
+
+    device->wait_for_idle();
+
+    return device->random_read(address, data, length, _frequency_hz);
+}
+
+/** Blocking write, split at page boundaries, waiting for each write cycle
+ *
+ * @param address Address to which to write
+ * @param *data Data to be written
+ * @param length Number of bytes to be written
+ * @return 0 on success, else non-zero
+ */
+int STM24256::write_to_address(int address, char *data, int length)
+{
+    DataManager_SimulatedEeprom *device = DataManager_SimulatedEeprom::selected();
+
+    if(address < 0 || address + length > SIM_EEPROM_BYTES)
+    {
+        return DataManager_SimulatedEeprom::SIM_NACK;
+    }
+
+    for(int written = 0; written < length; )
+    {
+        int chunk = SIM_EEPROM_PAGE_BYTES - ((address + written) % SIM_EEPROM_PAGE_BYTES);
+
+        if(chunk > length - written)
+        {
+            chunk = length - written;
+        }
+
+        device->wait_for_idle();
+
+        int status = device->page_write(address + written, &data[written], chunk, _frequency_hz);
+
+        if(status != DataManager_SimulatedEeprom::SIM_OK)
+        {
+            return status;
+        }
+
+        written += chunk;
+    }
+
+    device->wait_for_idle();
+
+    return DataManager_SimulatedEeprom::SIM_OK;
+}
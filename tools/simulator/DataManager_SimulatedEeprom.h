@@ -0,0 +1,300 @@
+/**
+  * @file    DataManager_SimulatedEeprom.h
+  * @version 0.5.0
+  * @author  Adam Mitchell
+  * @brief   Host-side model of an M24256 EEPROM with a simulated clock, bus timing,
+  *          write cycles and per-page wear counters. Backs the host stand-ins for
+  *          mbed's I2C and the STM24256 driver so that the unmodified DataManager
+  *          can be run by simulation tools
+  */
+
+/** Define to prevent recursive inclusion
+ */
+#pragma once
+
+/** Includes
+ */
+#include <stdint.h>
+#include <vector>
+#include <functional>
+
+/** Geometry and timing of the simulated device
+ */
+#define SIM_EEPROM_BYTES         32768
+#define SIM_EEPROM_PAGE_BYTES    64
+#define SIM_EEPROM_PAGES         (SIM_EEPROM_BYTES / SIM_EEPROM_PAGE_BYTES)
+#define SIM_WRITE_CYCLE_US       5000
+#define SIM_ERASED_VALUE         0xFF
+
+/** Write cycles per page guaranteed by the M24256 datasheet
+ */
+#define SIM_ENDURANCE_CYCLES     4000000
+
+/** Bits clocked per byte on the bus, i.e. 8 data bits and an ACK
+ */
+#define SIM_BITS_PER_BUS_BYTE    9
+
+/** Time for which an injected bus timeout holds the bus before the transfer
+ *  is abandoned
+ */
+#define SIM_BUS_TIMEOUT_US       1000
+
+/** One simulated EEPROM. Each thread selects the device that the host I2C
+ *  and STM24256 stand-ins talk to, so independent DataManager instances can
+ *  run on many threads at once
+ */
+class DataManager_SimulatedEeprom
+{
+
+    public:
+
+        enum
+        {
+            SIM_OK               = 0,
+            SIM_NACK             = 1,
+            SIM_ARBITRATION_LOST = 2,
+            SIM_TIMEOUT          = 3,
+            SIM_FAULT_KINDS
+        };
+
+        DataManager_SimulatedEeprom();
+
+        ~DataManager_SimulatedEeprom();
+
+        /** Select the device used by the calling thread
+         *
+         * @param *device Device to be used
+         */
+        static void select(DataManager_SimulatedEeprom *device);
+
+        /** Get the device used by the calling thread
+         *
+         * @return Selected device
+         */
+        static DataManager_SimulatedEeprom *selected();
+
+        /** Set every byte to the erased value and clear all counters
+         */
+        void erase();
+
+        /** Get the simulated time
+         *
+         * @return Microseconds since construction or the last erase
+         */
+        uint64_t now_us();
+
+        /** Advance the simulated time, e.g. whilst the node sleeps
+         *
+         * @param us Number of microseconds to advance by
+         */
+        void advance_us(uint64_t us);
+
+        /** Advance the simulated time to the end of any write cycle in progress
+         */
+        void wait_for_idle();
+
+        /** Queue a handler to be run as an interrupt, as the I2C and Timeout 
+         *  stand-ins do for their events
+         *
+         * @param due_us Simulated time from which the handler may run
+         * @param &handler Handler to be run
+         */
+        void post_interrupt(uint64_t due_us, const std::function<void()> &handler);
+
+        /** Run the queued interrupts that are due, in order of due time and then
+         *  of queueing, including those queued by the handlers run
+         *
+         * @return Number of handlers run
+         */
+        int run_interrupts();
+
+        /** Get the due time of the next queued interrupt
+         *
+         * @param &due_us Address to which the due time will be written
+         * @return False if no interrupt is queued, else true
+         */
+        bool next_interrupt(uint64_t &due_us);
+
+        /** Determine whether or not a write cycle is in progress, during which
+         *  the device NACKs its address
+         *
+         * @return True if a write cycle is in progress, else false
+         */
+        bool is_busy();
+
+        /** Random read, i.e. address bytes followed by a read
+         *
+         * @param address Address from which to read
+         * @param *data Pointer to an array in which the read data will be stored
+         * @param length Number of bytes to be read
+         * @param frequency_hz Bus clock used for the transfer
+         * @return SIM_OK, SIM_NACK or an injected fault
+         */
+        int random_read(int address, char *data, int length, int frequency_hz);
+
+        /** Current address read, continuing from the internal address counter
+         *
+         * @param *data Pointer to an array in which the read data will be stored
+         * @param length Number of bytes to be read
+         * @param frequency_hz Bus clock used for the transfer
+         * @return SIM_OK, SIM_NACK or an injected fault
+         */
+        int current_read(char *data, int length, int frequency_hz);
+
+        /** Set the internal address counter without writing, i.e. the first
+         *  half of a random read
+         *
+         * @param address New value of the address counter
+         * @param frequency_hz Bus clock used for the transfer
+         * @return SIM_OK, SIM_NACK or an injected fault
+         */
+        int set_address(int address, int frequency_hz);
+
+        /** Page write. The address counter rolls over within the page and a
+         *  write cycle of SIM_WRITE_CYCLE_US is started
+         *
+         * @param address Address to which to write
+         * @param *data Data to be written
+         * @param length Number of bytes to be written
+         * @param frequency_hz Bus clock used for the transfer
+         * @return SIM_OK, SIM_NACK or an injected fault
+         */
+        int page_write(int address, const char *data, int length, int frequency_hz);
+
+        /** Get the number of write cycles a page has been through
+         *
+         * @param page Index of the page
+         * @return Number of write cycles
+         */
+        uint32_t get_page_writes(int page);
+
+        /** Get the number of write cycles of the most worn page
+         *
+         * @return Number of write cycles
+         */
+        uint32_t get_max_page_writes();
+
+        /** Get the total number of write cycles of all pages
+         *
+         * @return Number of write cycles
+         */
+        uint64_t get_write_cycles();
+
+        /** Get the total number of bytes clocked on the bus
+         *
+         * @return Number of bytes
+         */
+        uint64_t get_bus_bytes();
+
+        /** Get the raw contents of the device
+         *
+         * @return Pointer to SIM_EEPROM_BYTES bytes
+         */
+        uint8_t *get_memory();
+
+        /** Cut power during a write cycle. The first bytes_landed bytes of the
+         *  write are programmed and the rest of it is left erased, as the cells
+         *  of a page are erased before they are programmed. With bytes_landed 
+         *  of zero the write never starts. From then on the device NACKs every
+         *  transfer until restore_power()
+         *
+         * @param write_cycle Index, counted from zero since construction or the last erase, of the write to cut
+         * @param bytes_landed Number of bytes of that write that are programmed
+         */
+        void set_power_cut(uint64_t write_cycle, int bytes_landed);
+
+        /** Cancel a power cut that is yet to happen
+         */
+        void clear_power_cut();
+
+        /** Determine whether or not the device is powered
+         *
+         * @return False once a power cut has happened and until restore_power(), else true
+         */
+        bool is_powered();
+
+        /** Power the device back up after a cut, leaving its contents as they were
+         */
+        void restore_power();
+
+        /** Inject bus faults into transfers made whilst the device is powered and
+         *  idle. A NACKed transfer ends after the device address, one that loses
+         *  arbitration after half of its bytes and one that times out holds the
+         *  bus for SIM_BUS_TIMEOUT_US. None of them change the memory
+         *
+         * @param nack_ppm Transfers per million that are NACKed
+         * @param arbitration_ppm Transfers per million that lose arbitration
+         * @param timeout_ppm Transfers per million that time out
+         * @param seed Seed of the fault sequence
+         */
+        void set_bus_faults(uint32_t nack_ppm, uint32_t arbitration_ppm, uint32_t timeout_ppm, uint32_t seed);
+
+        /** NACK every transfer clocked faster than the board can sustain, e.g.
+         *  because of long traces or weak pull-ups. NACKs injected this way are
+         *  counted with those of set_bus_faults()
+         *
+         * @param frequency_hz Fastest bus clock that works, or 0 for no limit
+         */
+        void set_max_frequency(int frequency_hz);
+
+        /** Get the number of faults of one kind injected since construction or the last erase
+         *
+         * @param fault SIM_NACK, SIM_ARBITRATION_LOST or SIM_TIMEOUT
+         * @return Number of faults injected
+         */
+        uint64_t get_injected_faults(int fault);
+
+        /** Append the length of every subsequent write to a log, e.g. to enumerate
+         *  the cut points of a workload
+         *
+         * @param *lengths Log to append to, or NULL to stop logging
+         */
+        void set_write_log(std::vector<uint8_t> *lengths);
+
+    private:
+
+        /** Advance the simulated time by the duration of a transfer
+         *
+         * @param bytes Number of bytes clocked on the bus
+         * @param frequency_hz Bus clock used for the transfer
+         */
+        void clock_bytes(int bytes, int frequency_hz);
+
+        /** Decide whether a transfer is hit by an injected fault and charge its cost
+         *
+         * @param bytes Number of bytes the transfer would clock on the bus
+         * @param frequency_hz Bus clock used for the transfer
+         * @return SIM_OK or the fault injected
+         */
+        int inject_fault(int bytes, int frequency_hz);
+
+        uint8_t _memory[SIM_EEPROM_BYTES];
+        uint32_t _page_writes[SIM_EEPROM_PAGES];
+        uint16_t _address;
+        uint64_t _now_us;
+        uint64_t _busy_until_us;
+        uint64_t _write_cycles;
+        uint64_t _bus_bytes;
+        uint64_t _bus_bits;
+        bool _powered;
+        bool _cut_pending;
+        uint64_t _cut_write_cycle;
+        int _cut_bytes_landed;
+        std::vector<uint8_t> *_write_log;
+        uint32_t _fault_ppm[SIM_FAULT_KINDS];
+        uint32_t _fault_random;
+        int _max_frequency_hz;
+        uint64_t _injected_faults[SIM_FAULT_KINDS];
+
+        /** Interrupts queued and yet to run
+         */
+        struct Interrupt_t
+        {
+            uint64_t due_us;
+            uint64_t sequence;
+            std::function<void()> handler;
+        };
+
+        std::vector<Interrupt_t> _interrupts;
+        uint64_t _interrupt_sequence;
+};
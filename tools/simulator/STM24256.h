@@ -0,0 +1,47 @@
+/**
+  * @file    STM24256.h
+  * @version 0.5.0
+  * @author  Adam Mitchell
+  * @brief   Host stand-in for the STM24256 driver, backed by the simulated EEPROM
+  *          selected on the calling thread
+  */
+
+/** Define to prevent recursive inclusion
+ */
+#pragma once
+
+/** Includes
+ */
+#include "mbed.h"
+
+class STM24256
+{
+
+    public:
+
+        STM24256(PinName write_control, PinName sda, PinName scl, int frequency_hz);
+
+        ~STM24256();
+
+        /** Blocking random read, waiting for any write cycle in progress
+         *
+         * @param address Address from which to read
+         * @param *data Pointer to an array in which the read data will be stored
+         * @param length Number of bytes to be read
+         * @return 0 on success, else non-zero
+         */
+        int read_from_address(int address, char *data, int length);
+
+        /** Blocking write, split at page boundaries, waiting for each write cycle
+         *
+         * @param address Address to which to write
+         * @param *data Data to be written
+         * @param length Number of bytes to be written
+         * @return 0 on success, else non-zero
+         */
+        int write_to_address(int address, char *data, int length);
+
+    private:
+
+        int _frequency_hz;
+};
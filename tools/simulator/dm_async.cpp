@@ -0,0 +1,382 @@
+/**
+  * @file    dm_async.cpp
+  * @version 0.5.0
+  * @author  Adam Mitchell
+  * @brief   Command line tool that measures how much of the CPU work of a
+  *          logging node overlaps the EEPROM's write cycles with interrupt
+  *          driven appends. Each entry is encoded and then appended, once with
+  *          append_file_entry() and once with append_file_entry_async(), for a
+  *          sweep of CPU time per entry. With async appends the next entry is
+  *          encoded whilst the I2C events of the previous one are run as
+  *          interrupts. Every entry is read back with read_file_entries_async()
+  *          and read_file_entry(), and blocking calls made whilst an append is
+  *          in progress must return ASYNC_BUSY.
+  *
+  *          Build:  g++ -O2 -std=c++11 -I. -I../.. -I../../filesystem ../../DataManager.cpp
+  *                  ../../DataManager_Async.cpp DataManager_SimulatedEeprom.cpp
+  *                  dm_async.cpp -o dm_async
+  *          Usage:  dm_async [--entries N] [--entry-bytes E] [--cpu-us C] [--frequency HZ]
+  *
+  *          With --cpu-us only that CPU time per entry is run. Exits with 2 if
+  *          any entry reads back differently from the entry written or a call
+  *          made whilst an append is in progress isn't refused
+  */
+
+/** Includes
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "DataManager.h"
+#include "DataManager_SimulatedEeprom.h"
+
+/** Entries read back per read_file_entries_async()
+ */
+#define ASYNC_READ_ENTRIES 8
+
+/** Outcome of one run of the workload
+ */
+struct AsyncRun_t
+{
+    int status;
+    uint64_t total_us;
+    uint64_t write_cycles;
+    int mismatches;
+    int unrefused;
+};
+
+/** Final status of an asynchronous call, set from interrupt context
+ */
+struct AsyncCompletion
+{
+    bool done;
+    int status;
+
+    void complete(int final_status)
+    {
+        status = final_status;
+        done = true;
+    }
+};
+
+/** Encode an entry of samples, as a node does before storing it
+ *
+ * @param entry Index of the entry
+ * @param *data Buffer to which the entry is written
+ * @param length Length of the entry in bytes
+ */
+static void encode_entry(int entry, char *data, int length)
+{
+    for(int byte = 0; byte < length; byte++)
+    {
+        data[byte] = (char)((entry * 31) + (byte * 7) + ((entry * byte) % 5));
+    }
+}
+
+/** Charge CPU time to the simulated clock, running the interrupts that fall
+ *  due during it
+ *
+ * @param &eeprom The simulated EEPROM
+ * @param cpu_us CPU time to charge
+ */
+static void run_cpu(DataManager_SimulatedEeprom &eeprom, uint64_t cpu_us)
+{
+    uint64_t end_us = eeprom.now_us() + cpu_us;
+
+    eeprom.run_interrupts();
+
+    uint64_t due_us;
+
+    while(eeprom.next_interrupt(due_us) && due_us < end_us)
+    {
+        if(due_us > eeprom.now_us())
+        {
+            eeprom.advance_us(due_us - eeprom.now_us());
+        }
+
+        eeprom.run_interrupts();
+    }
+
+    if(end_us > eeprom.now_us())
+    {
+        eeprom.advance_us(end_us - eeprom.now_us());
+    }
+
+    eeprom.run_interrupts();
+}
+
+/** Sleep until an asynchronous call completes, running its interrupts
+ *
+ * @param &eeprom The simulated EEPROM
+ * @param &completion Completion of the call
+ * @return False if the call can never complete, as no interrupt is queued, else true
+ */
+static bool wait_for(DataManager_SimulatedEeprom &eeprom, AsyncCompletion &completion)
+{
+    eeprom.run_interrupts();
+
+    uint64_t due_us;
+
+    while(!completion.done)
+    {
+        if(!eeprom.next_interrupt(due_us))
+        {
+            return false;
+        }
+
+        if(due_us > eeprom.now_us())
+        {
+            eeprom.advance_us(due_us - eeprom.now_us());
+        }
+
+        eeprom.run_interrupts();
+    }
+
+    return true;
+}
+
+/** Log the entries of the workload and read them back
+ *
+ * @param &eeprom The simulated EEPROM
+ * @param &data_manager DataManager to call
+ * @param entries Number of entries
+ * @param entry_bytes Length of an entry in bytes
+ * @param cpu_us CPU time charged per entry
+ * @param async True to append with append_file_entry_async(), else false
+ * @param &run Address of AsyncRun_t to which the outcome will be written
+ */
+static void run_workload(DataManager_SimulatedEeprom &eeprom, DataManager &data_manager, int entries, int entry_bytes,
+                         int cpu_us, bool async, AsyncRun_t &run)
+{
+    memset(&run, 0, sizeof(run));
+
+    /** The entry being appended must remain valid whilst the next is encoded
+     */
+    std::vector<char> entry_buffers(2 * entry_bytes);
+    std::vector<char> read(ASYNC_READ_ENTRIES * entry_bytes);
+    std::vector<char> expected(entry_bytes);
+
+    AsyncCompletion append;
+    append.done = true;
+    append.status = DataManager::DATA_MANAGER_OK;
+
+    uint64_t start_us = eeprom.now_us();
+    uint64_t start_write_cycles = eeprom.get_write_cycles();
+
+    for(int entry = 0; entry < entries && run.status == DataManager::DATA_MANAGER_OK; entry++)
+    {
+        char *data = &entry_buffers[(entry % 2) * entry_bytes];
+
+        encode_entry(entry, data, entry_bytes);
+
+        if(!async)
+        {
+            eeprom.advance_us(cpu_us);
+            run.status = data_manager.append_file_entry(1, data, entry_bytes);
+            continue;
+        }
+
+        run_cpu(eeprom, cpu_us);
+
+        if(!wait_for(eeprom, append))
+        {
+            run.status = DataManager_FileSystem::ASYNC_TRANSFER_FAILED;
+            break;
+        }
+
+        if(append.status != DataManager::DATA_MANAGER_OK)
+        {
+            run.status = append.status;
+            break;
+        }
+
+        append.done = false;
+        run.status = data_manager.append_file_entry_async(1, data, entry_bytes,
+                                                          callback(&append, &AsyncCompletion::complete));
+
+        /** Whilst the first append is in progress, other calls must be refused
+         *  rather than share the bus with it
+         */
+        if(entry == 0 && run.status == DataManager::DATA_MANAGER_OK)
+        {
+            AsyncCompletion second;
+            second.done = false;
+
+            if(data_manager.read_file_entry(1, 0, &read[0], entry_bytes) != DataManager_FileSystem::ASYNC_BUSY)
+            {
+                run.unrefused++;
+            }
+
+            if(data_manager.append_file_entry_async(1, data, entry_bytes,
+                                                    callback(&second, &AsyncCompletion::complete)) != DataManager_FileSystem::ASYNC_BUSY)
+            {
+                run.unrefused++;
+            }
+        }
+    }
+
+    if(async && run.status == DataManager::DATA_MANAGER_OK)
+    {
+        if(!wait_for(eeprom, append))
+        {
+            run.status = DataManager_FileSystem::ASYNC_TRANSFER_FAILED;
+        }
+        else
+        {
+            run.status = append.status;
+        }
+    }
+
+    /** The last write cycle is part of the cost whether or not it was waited for
+     */
+    eeprom.wait_for_idle();
+
+    run.total_us = eeprom.now_us() - start_us;
+    run.write_cycles = eeprom.get_write_cycles() - start_write_cycles;
+
+    for(int first = 0; first < entries && run.status == DataManager::DATA_MANAGER_OK; first += ASYNC_READ_ENTRIES)
+    {
+        int count = (entries - first < ASYNC_READ_ENTRIES) ? entries - first : ASYNC_READ_ENTRIES;
+
+        AsyncCompletion range;
+        range.done = false;
+
+        int status = data_manager.read_file_entries_async(1, first, count, &read[0], count * entry_bytes,
+                                                          callback(&range, &AsyncCompletion::complete));
+
+        if(status == DataManager::DATA_MANAGER_OK)
+        {
+            status = wait_for(eeprom, range) ? range.status : (int)DataManager_FileSystem::ASYNC_TRANSFER_FAILED;
+        }
+
+        for(int member = 0; member < count; member++)
+        {
+            encode_entry(first + member, &expected[0], entry_bytes);
+
+            if(status != DataManager::DATA_MANAGER_OK ||
+               memcmp(&read[member * entry_bytes], &expected[0], entry_bytes) != 0)
+            {
+                run.mismatches++;
+            }
+        }
+    }
+
+    for(int entry = 0; entry < entries && run.status == DataManager::DATA_MANAGER_OK; entry++)
+    {
+        encode_entry(entry, &expected[0], entry_bytes);
+
+        if(data_manager.read_file_entry(1, entry, &read[0], entry_bytes) != DataManager::DATA_MANAGER_OK ||
+           memcmp(&read[0], &expected[0], entry_bytes) != 0)
+        {
+            run.mismatches++;
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int entries = 128;
+    int entry_bytes = 16;
+    int single_cpu_us = -1;
+    int frequency_hz = 400000;
+
+    for(int arg = 1; arg < argc; arg++)
+    {
+        if(strcmp(argv[arg], "--entries") == 0 && arg + 1 < argc)
+        {
+            entries = strtol(argv[++arg], NULL, 0);
+        }
+        else if(strcmp(argv[arg], "--entry-bytes") == 0 && arg + 1 < argc)
+        {
+            entry_bytes = strtol(argv[++arg], NULL, 0);
+        }
+        else if(strcmp(argv[arg], "--cpu-us") == 0 && arg + 1 < argc)
+        {
+            single_cpu_us = strtol(argv[++arg], NULL, 0);
+        }
+        else if(strcmp(argv[arg], "--frequency") == 0 && arg + 1 < argc)
+        {
+            frequency_hz = strtol(argv[++arg], NULL, 0);
+        }
+        else
+        {
+            fprintf(stderr, "Unknown option %s\n", argv[arg]);
+            return 1;
+        }
+    }
+
+    if(entries < 1 || entry_bytes < 1 || entry_bytes > PAGE_SIZE_BYTES)
+    {
+        fprintf(stderr, "--entries must be at least 1 and --entry-bytes from 1 to %d\n", PAGE_SIZE_BYTES);
+        return 1;
+    }
+
+    static const int CPU_US[] = { 0, 1000, 2500, 5000, 10000 };
+    int sweep = (single_cpu_us >= 0) ? 1 : sizeof(CPU_US) / sizeof(CPU_US[0]);
+
+    static DataManager_SimulatedEeprom eeprom;
+    DataManager_SimulatedEeprom::select(&eeprom);
+
+    printf("%-10s %8s %12s %12s %10s\n", "CPU us", "Cycles", "Blocking ms", "Async ms", "Async / blk");
+
+    int mismatches = 0;
+    int unrefused = 0;
+
+    for(int point = 0; point < sweep; point++)
+    {
+        int cpu_us = (single_cpu_us >= 0) ? single_cpu_us : CPU_US[point];
+        AsyncRun_t runs[2];
+
+        for(int async = 0; async < 2; async++)
+        {
+            eeprom.erase();
+
+            DataManager data_manager(NC, NC, NC, frequency_hz);
+
+            DataManager_FileSystem::File_t definition;
+            memset(definition.data, 0, sizeof(definition));
+            definition.parameters.filename = 1;
+            definition.parameters.length_bytes = entry_bytes;
+
+            int status = data_manager.init_filesystem();
+
+            if(status == DataManager::DATA_MANAGER_OK)
+            {
+                status = data_manager.init_gstats();
+            }
+
+            if(status == DataManager::DATA_MANAGER_OK)
+            {
+                status = data_manager.add_file(definition, entries);
+            }
+
+            if(status != DataManager::DATA_MANAGER_OK)
+            {
+                fprintf(stderr, "Setup failed with status %d; try fewer --entries\n", status);
+                return 1;
+            }
+
+            run_workload(eeprom, data_manager, entries, entry_bytes, cpu_us, async == 1, runs[async]);
+
+            if(runs[async].status != DataManager::DATA_MANAGER_OK)
+            {
+                fprintf(stderr, "%s workload failed with status %d at %d us of CPU per entry\n",
+                        async ? "Async" : "Blocking", runs[async].status, cpu_us);
+                return 2;
+            }
+
+            mismatches += runs[async].mismatches;
+            unrefused += runs[async].unrefused;
+        }
+
+        printf("%-10d %8llu %12.1f %12.1f %10.2f\n", cpu_us, (unsigned long long)runs[1].write_cycles,
+               runs[0].total_us / 1000.0, runs[1].total_us / 1000.0, (double)runs[1].total_us / runs[0].total_us);
+    }
+
+    printf("Workload:     %d entries of %d bytes at %d Hz\n", entries, entry_bytes, frequency_hz);
+    printf("Mismatches:   %d entries read back differently from the entry written\n", mismatches);
+    printf("Unrefused:    %d calls made whilst an append was in progress weren't refused\n", unrefused);
+
+    return (mismatches == 0 && unrefused == 0) ? 0 : 2;
+}
@@ -0,0 +1,1641 @@
+/**
+  * @file    dm_check.cpp
+  * @version 0.5.0
+  * @author  Adam Mitchell
+  * @brief   Command line tool that runs regression checks of the DataManager
+  *          against a simulated EEPROM. Each check sets up a fresh device,
+  *          drives a scenario that once went wrong and checks the outcome.
+  *
+  *          Build:  g++ -O2 -std=c++11 -I. -I../.. -I../../filesystem -I../image_builder
+  *                  ../../DataManager.cpp ../../DataManager_Async.cpp ../../DataManager_Scheduler.cpp
+  *                  DataManager_SimulatedEeprom.cpp ../image_builder/DataManager_ImageBuilder.cpp
+  *                  dm_check.cpp -o dm_check
+  *          Usage:  dm_check [--verbose]
+  *
+  *          Exits with 2 if any check fails
+  */
+
+/** Includes
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "DataManager.h"
+#include "DataManager_Scheduler.h"
+#include "DataManager_SimulatedEeprom.h"
+#include "DataManager_ImageBuilder.h"
+
+/** Print the details of failures as well as the outcome of each check
+ */
+static bool verbose = false;
+
+/** Report a failed expectation of a check
+ *
+ * @param *check Name of the check
+ * @param *what Description of the expectation
+ * @param actual Value seen
+ * @param expected Value expected
+ * @return False, so that a check can return the report
+ */
+static bool fail(const char *check, const char *what, long actual, long expected)
+{
+    if(verbose)
+    {
+        fprintf(stderr, "%s: %s was %ld, expected %ld\n", check, what, actual, expected);
+    }
+
+    return false;
+}
+
+/** Erase the device and mount an empty filesystem on it
+ *
+ * @param &eeprom The simulated EEPROM
+ * @param &data_manager DataManager to mount with
+ * @return Indicates success or failure reason
+ */
+static int format(DataManager_SimulatedEeprom &eeprom, DataManager &data_manager)
+{
+    eeprom.erase();
+
+    int status = data_manager.init_filesystem();
+
+    if(status == DataManager::DATA_MANAGER_OK)
+    {
+        status = data_manager.init_gstats();
+    }
+
+    return status;
+}
+
+/** Add a file of entries of length_bytes and append entries to it, each
+ *  entry filled with its index
+ *
+ * @param &data_manager DataManager to call
+ * @param filename ID of the file
+ * @param length_bytes Length of each entry
+ * @param entries_to_store Number of entries to be stored
+ * @param entries Number of entries to append
+ * @return Indicates success or failure reason
+ */
+static int add_filled_file(DataManager &data_manager, uint8_t filename, int length_bytes, uint16_t entries_to_store,
+                           int entries)
+{
+    DataManager_FileSystem::File_t definition;
+    memset(definition.data, 0, sizeof(definition));
+    definition.parameters.filename = filename;
+    definition.parameters.length_bytes = length_bytes;
+
+    int status = data_manager.add_file(definition, entries_to_store);
+
+    char entry[PAGE_SIZE_BYTES];
+
+    for(int index = 0; index < entries && status == DataManager::DATA_MANAGER_OK; index++)
+    {
+        memset(entry, index & 0xFF, length_bytes);
+        status = data_manager.append_file_entry(filename, entry, length_bytes);
+    }
+
+    return status;
+}
+
+/** A blocking truncation that fails part way must not leave its step open.
+ *  Power is cut during the second write cycle of the move; once it is back
+ *  a truncation of another file must be accepted and a retried truncation
+ *  must keep entries appended after the failure
+ *
+ * @param &eeprom The simulated EEPROM
+ * @return True if the check passed
+ */
+static bool check_failed_truncate(DataManager_SimulatedEeprom &eeprom)
+{
+    const char *name = "failed truncate";
+
+    DataManager data_manager(NC, NC, NC, 400000);
+
+    int status = format(eeprom, data_manager);
+
+    if(status == DataManager::DATA_MANAGER_OK)
+    {
+        status = add_filled_file(data_manager, 1, PAGE_SIZE_BYTES, 120, 100);
+    }
+
+    if(status == DataManager::DATA_MANAGER_OK)
+    {
+        status = add_filled_file(data_manager, 2, 4, 16, 4);
+    }
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return fail(name, "setup status", status, DataManager::DATA_MANAGER_OK);
+    }
+
+    eeprom.set_power_cut(eeprom.get_write_cycles() + 1, 0);
+    status = data_manager.truncate_file(1, 10);
+    eeprom.restore_power();
+
+    if(status == DataManager::DATA_MANAGER_OK)
+    {
+        return fail(name, "status of the cut truncation", status, -1);
+    }
+
+    status = data_manager.truncate_file(2, 1);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return fail(name, "status of truncating another file", status, DataManager::DATA_MANAGER_OK);
+    }
+
+    char entry[PAGE_SIZE_BYTES];
+    memset(entry, 0xA5, sizeof(entry));
+
+    for(int append = 0; append < 5 && status == DataManager::DATA_MANAGER_OK; append++)
+    {
+        status = data_manager.append_file_entry(1, entry, PAGE_SIZE_BYTES);
+    }
+
+    if(status == DataManager::DATA_MANAGER_OK)
+    {
+        status = data_manager.truncate_file(1, 10);
+    }
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return fail(name, "status of the retried truncation", status, DataManager::DATA_MANAGER_OK);
+    }
+
+    int written_entries = 0;
+    status = data_manager.get_total_written_file_entries(1, written_entries);
+
+    if(status != DataManager::DATA_MANAGER_OK || written_entries != 95)
+    {
+        return fail(name, "entries after the retried truncation", written_entries, 95);
+    }
+
+    /** The last entries are the ones appended after the failure
+     */
+    char read[PAGE_SIZE_BYTES];
+    status = data_manager.read_file_entry(1, written_entries - 1, read, PAGE_SIZE_BYTES);
+
+    if(status != DataManager::DATA_MANAGER_OK || memcmp(read, entry, PAGE_SIZE_BYTES) != 0)
+    {
+        return fail(name, "status of reading the last appended entry", status, DataManager::DATA_MANAGER_OK);
+    }
+
+    return true;
+}
+
+/** An RLE file must keep the latest value across a reset and lose at most
+ *  RLE_SYNC_INTERVAL - 1 repeats of it. One value is followed by 40 repeats
+ *  of another, the DataManager is replaced without a flush, as by a reset,
+ *  and the file is read back and continued
+ *
+ * @param &eeprom The simulated EEPROM
+ * @return True if the check passed
+ */
+static bool check_rle_reset(DataManager_SimulatedEeprom &eeprom)
+{
+    const char *name = "rle reset";
+    const int repeats = 40;
+    const int kept = 1 + ((repeats - 1) / RLE_SYNC_INTERVAL) * RLE_SYNC_INTERVAL + 1;
+
+    char first = 'A';
+    char latest = 'B';
+
+    {
+        DataManager data_manager(NC, NC, NC, 400000);
+
+        int status = format(eeprom, data_manager);
+
+        if(status == DataManager::DATA_MANAGER_OK)
+        {
+            status = data_manager.add_rle_file(1, 1, 16);
+        }
+
+        if(status == DataManager::DATA_MANAGER_OK)
+        {
+            status = data_manager.append_rle_entry(1, &first, 1);
+        }
+
+        for(int repeat = 0; repeat < repeats && status == DataManager::DATA_MANAGER_OK; repeat++)
+        {
+            status = data_manager.append_rle_entry(1, &latest, 1);
+        }
+
+        if(status != DataManager::DATA_MANAGER_OK)
+        {
+            return fail(name, "setup status", status, DataManager::DATA_MANAGER_OK);
+        }
+    }
+
+    DataManager data_manager(NC, NC, NC, 400000);
+
+    int written_entries = 0;
+    int status = data_manager.get_total_rle_entries(1, written_entries);
+
+    if(status != DataManager::DATA_MANAGER_OK || written_entries != kept)
+    {
+        return fail(name, "values after the reset", written_entries, kept);
+    }
+
+    char value = 0;
+    status = data_manager.read_rle_entry(1, written_entries - 1, &value, 1);
+
+    if(status != DataManager::DATA_MANAGER_OK || value != latest)
+    {
+        return fail(name, "latest value after the reset", value, latest);
+    }
+
+    status = data_manager.read_rle_entry(1, 0, &value, 1);
+
+    if(status != DataManager::DATA_MANAGER_OK || value != first)
+    {
+        return fail(name, "first value after the reset", value, first);
+    }
+
+    /** A repeat of the latest value continues its run rather than starting one
+     */
+    status = data_manager.append_rle_entry(1, &latest, 1);
+
+    if(status == DataManager::DATA_MANAGER_OK)
+    {
+        status = data_manager.flush_rle_file(1);
+    }
+
+    int runs = 0;
+
+    if(status == DataManager::DATA_MANAGER_OK)
+    {
+        status = data_manager.get_total_written_file_entries(1, runs);
+    }
+
+    if(status != DataManager::DATA_MANAGER_OK || runs != 2)
+    {
+        return fail(name, "runs after continuing the latest run", runs, 2);
+    }
+
+    return true;
+}
+
+/** Mount the filesystem with a fresh DataManager, as after a reset, in the
+ *  order the firmware does at start-up
+ *
+ * @param &data_manager DataManager to mount with
+ * @return Indicates success or failure reason
+ */
+static int mount(DataManager &data_manager)
+{
+    int status = data_manager.recover_transaction();
+
+    DataManager::OperationBudget_t budget = { 0, 0 };
+
+    while(status == DataManager::DATA_MANAGER_OK || status == DataManager_FileSystem::OPERATION_IN_PROGRESS)
+    {
+        status = data_manager.resume_operation(budget);
+
+        if(status == DataManager::DATA_MANAGER_OK)
+        {
+            break;
+        }
+    }
+
+    bool initialised = false;
+
+    if(status == DataManager::DATA_MANAGER_OK)
+    {
+        status = data_manager.is_initialised(initialised);
+    }
+
+    if(status == DataManager::DATA_MANAGER_OK && !initialised)
+    {
+        status = -1;
+    }
+
+    return status;
+}
+
+/** An image made by the image builder must restore through 
+ *  begin_image_restore(), restore_image_page() and finish_image_restore()
+ *  onto a device that was in use, and mount as the layout it describes.
+ *  The device holds another filesystem with a resumable truncation cut
+ *  part way, whose state lies outside the pages of the image
+ *
+ * @param &eeprom The simulated EEPROM
+ * @return True if the check passed
+ */
+static bool check_image_round_trip(DataManager_SimulatedEeprom &eeprom)
+{
+    const char *name = "image round trip";
+
+    static const int LAYOUT[][3] = { { 1, 8, 20 }, { 2, PAGE_SIZE_BYTES, 10 }, { 3, 3, 40 } };
+    static const int FILES = sizeof(LAYOUT) / sizeof(LAYOUT[0]);
+
+    {
+        DataManager data_manager(NC, NC, NC, 400000);
+
+        int status = format(eeprom, data_manager);
+
+        if(status == DataManager::DATA_MANAGER_OK)
+        {
+            status = add_filled_file(data_manager, 7, PAGE_SIZE_BYTES, 100, 90);
+        }
+
+        if(status != DataManager::DATA_MANAGER_OK)
+        {
+            return fail(name, "setup status", status, DataManager::DATA_MANAGER_OK);
+        }
+
+        DataManager::OperationBudget_t budget = { 0, 2 };
+        status = data_manager.truncate_file(7, 30, budget);
+
+        if(status != DataManager_FileSystem::OPERATION_IN_PROGRESS)
+        {
+            return fail(name, "status of the cut truncation", status, DataManager_FileSystem::OPERATION_IN_PROGRESS);
+        }
+    }
+
+    static DataManager_ImageBuilder builder;
+    builder.init_filesystem();
+    builder.init_gstats();
+
+    for(int file = 0; file < FILES; file++)
+    {
+        DataManager_FileSystem::File_t definition;
+        memset(definition.data, 0, sizeof(definition));
+        definition.parameters.filename = LAYOUT[file][0];
+        definition.parameters.length_bytes = LAYOUT[file][1];
+
+        int status = builder.add_file(definition, LAYOUT[file][2]);
+
+        if(status != DataManager_ImageBuilder::IMAGE_BUILDER_OK)
+        {
+            return fail(name, "status of building the image", status, DataManager_ImageBuilder::IMAGE_BUILDER_OK);
+        }
+    }
+
+    int pages = 0;
+    builder.get_image_pages(pages);
+
+    {
+        DataManager data_manager(NC, NC, NC, 400000);
+
+        int status = data_manager.begin_image_restore();
+
+        for(int page = 0; page < pages && status == DataManager::DATA_MANAGER_OK; page++)
+        {
+            char data[PAGE_SIZE_BYTES];
+            memcpy(data, &builder.get_image()[page * PAGE_SIZE_BYTES], PAGE_SIZE_BYTES);
+
+            status = data_manager.restore_image_page(data, PAGE_SIZE_BYTES);
+        }
+
+        if(status == DataManager::DATA_MANAGER_OK)
+        {
+            status = data_manager.finish_image_restore(builder.get_image_checksum(pages));
+        }
+
+        if(status != DataManager::DATA_MANAGER_OK)
+        {
+            return fail(name, "status of the restore", status, DataManager::DATA_MANAGER_OK);
+        }
+    }
+
+    if(memcmp(eeprom.get_memory(), builder.get_image(), pages * PAGE_SIZE_BYTES) != 0)
+    {
+        return fail(name, "restored pages matching the image", 0, 1);
+    }
+
+    DataManager data_manager(NC, NC, NC, 400000);
+
+    int status = mount(data_manager);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return fail(name, "status of mounting the restored image", status, DataManager::DATA_MANAGER_OK);
+    }
+
+    DataManager_FileSystem::File_t file;
+
+    if(data_manager.get_file_by_name(7, file) == DataManager::DATA_MANAGER_OK)
+    {
+        return fail(name, "file of the previous filesystem being found", 1, 0);
+    }
+
+    /** Every file of the layout is empty, fills to its capacity and reads back
+     */
+    for(int file_index = 0; file_index < FILES; file_index++)
+    {
+        uint8_t filename = LAYOUT[file_index][0];
+        int length_bytes = LAYOUT[file_index][1];
+        int entries_to_store = LAYOUT[file_index][2];
+        int written_entries = -1;
+
+        status = data_manager.get_total_written_file_entries(filename, written_entries);
+
+        if(status != DataManager::DATA_MANAGER_OK || written_entries != 0)
+        {
+            return fail(name, "entries of a restored file", written_entries, 0);
+        }
+
+        char entry[PAGE_SIZE_BYTES];
+
+        for(int index = 0; index < entries_to_store && status == DataManager::DATA_MANAGER_OK; index++)
+        {
+            memset(entry, (filename << 5) ^ index, length_bytes);
+            status = data_manager.append_file_entry(filename, entry, length_bytes);
+        }
+
+        if(status != DataManager::DATA_MANAGER_OK)
+        {
+            return fail(name, "status of filling a restored file", status, DataManager::DATA_MANAGER_OK);
+        }
+
+        if(data_manager.append_file_entry(filename, entry, length_bytes) == DataManager::DATA_MANAGER_OK)
+        {
+            return fail(name, "status of appending to a full restored file", 0, 1);
+        }
+    }
+
+    for(int file_index = 0; file_index < FILES; file_index++)
+    {
+        uint8_t filename = LAYOUT[file_index][0];
+        int length_bytes = LAYOUT[file_index][1];
+
+        for(int index = 0; index < LAYOUT[file_index][2]; index++)
+        {
+            char entry[PAGE_SIZE_BYTES];
+            char read[PAGE_SIZE_BYTES];
+            memset(entry, (filename << 5) ^ index, length_bytes);
+
+            status = data_manager.read_file_entry(filename, index, read, length_bytes);
+
+            if(status != DataManager::DATA_MANAGER_OK || memcmp(read, entry, length_bytes) != 0)
+            {
+                return fail(name, "status of reading back a restored file", status, DataManager::DATA_MANAGER_OK);
+            }
+        }
+    }
+
+    return true;
+}
+
+/** The image checksum must be the standard CRC-32, i.e. give its check 
+ *  value for "123456789", whether the bytes are folded in at once or in 
+ *  pieces
+ *
+ * @param &eeprom The simulated EEPROM
+ * @return True if the check passed
+ */
+static bool check_image_checksum(DataManager_SimulatedEeprom &eeprom)
+{
+    const char *name = "image checksum";
+    const char *data = "123456789";
+    const uint32_t check_value = 0xCBF43926;
+
+    uint32_t whole = DataManager_FileSystem::image_checksum(DataManager_FileSystem::IMAGE_CHECKSUM_SEED, data, 9);
+
+    if(whole != check_value)
+    {
+        return fail(name, "checksum of the check string", whole, check_value);
+    }
+
+    uint32_t pieces = DataManager_FileSystem::image_checksum(DataManager_FileSystem::IMAGE_CHECKSUM_SEED, data, 4);
+    pieces = DataManager_FileSystem::image_checksum(pieces, &data[4], 5);
+
+    if(pieces != check_value)
+    {
+        return fail(name, "checksum of the check string in pieces", pieces, check_value);
+    }
+
+    return true;
+}
+
+/** Pages of an image must only be restored between begin_image_restore()
+ *  and the finish_image_restore() that ends it, as a page written outside
+ *  of a restore would overwrite the live filesystem
+ *
+ * @param &eeprom The simulated EEPROM
+ * @return True if the check passed
+ */
+static bool check_restore_not_started(DataManager_SimulatedEeprom &eeprom)
+{
+    const char *name = "restore not started";
+
+    DataManager data_manager(NC, NC, NC, 400000);
+
+    int status = format(eeprom, data_manager);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return fail(name, "setup status", status, DataManager::DATA_MANAGER_OK);
+    }
+
+    char page[PAGE_SIZE_BYTES];
+    memset(page, 0, sizeof(page));
+
+    status = data_manager.restore_image_page(page, PAGE_SIZE_BYTES);
+
+    if(status != DataManager_FileSystem::IMAGE_RESTORE_NOT_STARTED)
+    {
+        return fail(name, "status of restoring a page", status, DataManager_FileSystem::IMAGE_RESTORE_NOT_STARTED);
+    }
+
+    status = data_manager.finish_image_restore(0);
+
+    if(status != DataManager_FileSystem::IMAGE_RESTORE_NOT_STARTED)
+    {
+        return fail(name, "status of finishing", status, DataManager_FileSystem::IMAGE_RESTORE_NOT_STARTED);
+    }
+
+    /** A checksum mismatch ends the restore it was given to
+     */
+    status = data_manager.begin_image_restore();
+
+    if(status == DataManager::DATA_MANAGER_OK)
+    {
+        status = data_manager.restore_image_page(page, PAGE_SIZE_BYTES);
+    }
+
+    if(status == DataManager::DATA_MANAGER_OK)
+    {
+        status = data_manager.finish_image_restore(0);
+    }
+
+    if(status != DataManager_FileSystem::IMAGE_CHECKSUM_MISMATCH)
+    {
+        return fail(name, "status of finishing with a wrong checksum", status, 
+                    DataManager_FileSystem::IMAGE_CHECKSUM_MISMATCH);
+    }
+
+    status = data_manager.restore_image_page(page, PAGE_SIZE_BYTES);
+
+    if(status != DataManager_FileSystem::IMAGE_RESTORE_NOT_STARTED)
+    {
+        return fail(name, "status of restoring after a mismatch", status, DataManager_FileSystem::IMAGE_RESTORE_NOT_STARTED);
+    }
+
+    return true;
+}
+
+/** Calls that write a file's metadata directly must refuse a file that the
+ *  open transaction has staged, as its commit would overwrite their changes.
+ *  Each file is staged by an append_file_entry() in the transaction and the
+ *  refused calls must leave it as it was
+ *
+ * @param &eeprom The simulated EEPROM
+ * @return True if the check passed
+ */
+static bool check_transaction_conflicts(DataManager_SimulatedEeprom &eeprom)
+{
+    const char *name = "transaction conflicts";
+
+    DataManager data_manager(NC, NC, NC, 400000);
+
+    DataManager_FileSystem::PackedSchema_t schema;
+    memset(schema.data, 0, sizeof(schema));
+    schema.parameters.fields = 2;
+    schema.parameters.field_bits[0] = 4;
+    schema.parameters.field_bits[1] = 12;
+
+    int status = format(eeprom, data_manager);
+
+    if(status == DataManager::DATA_MANAGER_OK)
+    {
+        status = data_manager.add_packed_file(1, schema, 16);
+    }
+
+    if(status == DataManager::DATA_MANAGER_OK)
+    {
+        status = data_manager.add_rle_file(2, 1, 16);
+    }
+
+    if(status == DataManager::DATA_MANAGER_OK)
+    {
+        status = add_filled_file(data_manager, 3, 8, 64, 32);
+    }
+
+    if(status == DataManager::DATA_MANAGER_OK)
+    {
+        status = data_manager.add_archive_file(4, 4 * PAGE_SIZE_BYTES);
+    }
+
+    char value = 'A';
+
+    if(status == DataManager::DATA_MANAGER_OK)
+    {
+        status = data_manager.append_rle_entry(2, &value, 1);
+    }
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return fail(name, "setup status", status, DataManager::DATA_MANAGER_OK);
+    }
+
+    /** Stage every file in one transaction
+     */
+    char entry[8] = { 0 };
+    char run[3] = { 1, 0, 'Z' };
+
+    status = data_manager.begin();
+
+    if(status == DataManager::DATA_MANAGER_OK)
+    {
+        status = data_manager.append_file_entry(1, entry, 1);
+    }
+
+    if(status == DataManager::DATA_MANAGER_OK)
+    {
+        status = data_manager.append_file_entry(2, run, sizeof(run));
+    }
+
+    if(status == DataManager::DATA_MANAGER_OK)
+    {
+        status = data_manager.append_file_entry(3, entry, sizeof(entry));
+    }
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return fail(name, "status of staging the files", status, DataManager::DATA_MANAGER_OK);
+    }
+
+    uint32_t fields[2] = { 3, 1000 };
+    status = data_manager.append_packed_entry(1, schema, fields);
+
+    if(status != DataManager_FileSystem::TRANSACTION_CONFLICT)
+    {
+        return fail(name, "status of a packed append", status, DataManager_FileSystem::TRANSACTION_CONFLICT);
+    }
+
+    value = 'B';
+    status = data_manager.append_rle_entry(2, &value, 1);
+
+    if(status != DataManager_FileSystem::TRANSACTION_CONFLICT)
+    {
+        return fail(name, "status of an RLE append", status, DataManager_FileSystem::TRANSACTION_CONFLICT);
+    }
+
+    status = data_manager.compress_sealed_pages(3, 4);
+
+    if(status != DataManager_FileSystem::TRANSACTION_CONFLICT)
+    {
+        return fail(name, "status of compressing", status, DataManager_FileSystem::TRANSACTION_CONFLICT);
+    }
+
+    DataManager::OperationBudget_t budget = { 0, 0 };
+    status = data_manager.compress_sealed_pages(3, 4, budget);
+
+    if(status != DataManager_FileSystem::TRANSACTION_CONFLICT)
+    {
+        return fail(name, "status of resumable compressing", status, DataManager_FileSystem::TRANSACTION_CONFLICT);
+    }
+
+    status = data_manager.commit();
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return fail(name, "status of the commit", status, DataManager::DATA_MANAGER_OK);
+    }
+
+    /** Each file holds what it held before the transaction plus its staged entry
+     */
+    int entries[4] = { -1, -1, -1, -1 };
+    int expected[4] = { 1, 2, 33, 0 };
+
+    for(int file = 0; file < 4; file++)
+    {
+        status = data_manager.get_total_written_file_entries(file + 1, entries[file]);
+
+        if(status != DataManager::DATA_MANAGER_OK || entries[file] != expected[file])
+        {
+            return fail(name, "entries after the commit", entries[file], expected[file]);
+        }
+    }
+
+    return true;
+}
+
+/** Rewrite the global stats of a formatted device as v0.5.0 and earlier
+ *  left them, whose storage ran to the end of the EEPROM, and fill the
+ *  operation page and journal as that storage would be
+ *
+ * @param &eeprom The simulated EEPROM
+ * @param next_available_address Next address allocated by the old layout
+ */
+static void make_legacy_layout(DataManager_SimulatedEeprom &eeprom, uint16_t next_available_address)
+{
+    DataManager_FileSystem::GlobalStats_t g_stats;
+    uint8_t *memory = eeprom.get_memory();
+
+    memcpy(g_stats.data, &memory[GLOBAL_STATS_START_ADDRESS], sizeof(g_stats));
+    g_stats.parameters.next_available_address = next_available_address;
+    g_stats.parameters.space_remaining = (PAGES * PAGE_SIZE_BYTES) - next_available_address;
+    g_stats.parameters.initialised = DataManager_FileSystem::INITIALISED_V0_5;
+    memcpy(&memory[GLOBAL_STATS_START_ADDRESS], g_stats.data, sizeof(g_stats));
+
+    memset(&memory[OPERATION_START_ADDRESS], 0xA5, (PAGES * PAGE_SIZE_BYTES) - OPERATION_START_ADDRESS);
+}
+
+/** A filesystem from v0.5.0 or earlier counts the operation page and 
+ *  journal as free storage and may hold data in them. Mounting it must
+ *  clear both pages and stop add_file() allocating them, or refuse with
+ *  LAYOUT_INCOMPATIBLE if its files reach into them, after which
+ *  init_filesystem() must still format the device
+ *
+ * @param &eeprom The simulated EEPROM
+ * @return True if the check passed
+ */
+static bool check_legacy_layout(DataManager_SimulatedEeprom &eeprom)
+{
+    const char *name = "legacy layout";
+
+    DataManager setup(NC, NC, NC, 400000);
+
+    int status = format(eeprom, setup);
+
+    if(status == DataManager::DATA_MANAGER_OK)
+    {
+        status = add_filled_file(setup, 1, 8, 32, 20);
+    }
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return fail(name, "setup status", status, DataManager::DATA_MANAGER_OK);
+    }
+
+    DataManager_FileSystem::GlobalStats_t g_stats;
+
+    status = setup.get_global_stats(g_stats.data);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return fail(name, "global stats status", status, DataManager::DATA_MANAGER_OK);
+    }
+
+    uint16_t next_available_address = g_stats.parameters.next_available_address;
+    make_legacy_layout(eeprom, next_available_address);
+
+    DataManager migrated(NC, NC, NC, 400000);
+
+    status = mount(migrated);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return fail(name, "status of mounting the old layout", status, DataManager::DATA_MANAGER_OK);
+    }
+
+    status = migrated.get_global_stats(g_stats.data);
+
+    int expected_space = (STORAGE_START_ADDRESS + STORAGE_LENGTH) - next_available_address;
+
+    if(status != DataManager::DATA_MANAGER_OK || g_stats.parameters.space_remaining != expected_space)
+    {
+        return fail(name, "space remaining after migration", g_stats.parameters.space_remaining, expected_space);
+    }
+
+    uint8_t *memory = eeprom.get_memory();
+
+    for(int address = OPERATION_START_ADDRESS; address < PAGES * PAGE_SIZE_BYTES; address++)
+    {
+        if(memory[address] != 0)
+        {
+            return fail(name, "byte of the operation page or journal", memory[address], 0);
+        }
+    }
+
+    int entries = 0;
+
+    status = migrated.get_total_written_file_entries(1, entries);
+
+    if(status != DataManager::DATA_MANAGER_OK || entries != 20)
+    {
+        return fail(name, "entries after migration", entries, 20);
+    }
+
+    status = add_filled_file(migrated, 2, PAGE_SIZE_BYTES, (expected_space / PAGE_SIZE_BYTES) + 1, 0);
+
+    if(status == DataManager::DATA_MANAGER_OK)
+    {
+        return fail(name, "status of a file reaching into the journal", status, -1);
+    }
+
+    status = add_filled_file(migrated, 2, PAGE_SIZE_BYTES, expected_space / PAGE_SIZE_BYTES, 0);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return fail(name, "status of a file filling the storage", status, DataManager::DATA_MANAGER_OK);
+    }
+
+    /** An old filesystem whose files reach into the reserved pages
+     */
+    make_legacy_layout(eeprom, OPERATION_START_ADDRESS + PAGE_SIZE_BYTES);
+
+    DataManager refused(NC, NC, NC, 400000);
+
+    status = refused.recover_transaction();
+
+    if(status != DataManager_FileSystem::LAYOUT_INCOMPATIBLE)
+    {
+        return fail(name, "status of mounting an incompatible layout", status,
+                    DataManager_FileSystem::LAYOUT_INCOMPATIBLE);
+    }
+
+    status = refused.init_filesystem();
+
+    if(status == DataManager::DATA_MANAGER_OK)
+    {
+        status = refused.init_gstats();
+    }
+
+    if(status == DataManager::DATA_MANAGER_OK)
+    {
+        status = add_filled_file(refused, 1, 8, 32, 4);
+    }
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return fail(name, "status of formatting an incompatible layout", status, DataManager::DATA_MANAGER_OK);
+    }
+
+    DataManager remounted(NC, NC, NC, 400000);
+
+    status = mount(remounted);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return fail(name, "status of mounting after formatting", status, DataManager::DATA_MANAGER_OK);
+    }
+
+    return true;
+}
+
+/** The adaptive clock must not fail calls at a rate the board can't 
+ *  sustain. On a board that only works up to 400 kHz, neither the start
+ *  at 1 MHz nor the probe back up after clean windows may fail a read or
+ *  write, and once the board degrades further a write must succeed within
+ *  the retry policy, the last attempt being retried at the slower rate
+ *
+ * @param &eeprom The simulated EEPROM
+ * @return True if the check passed
+ */
+static bool check_adaptive_clock(DataManager_SimulatedEeprom &eeprom)
+{
+    const char *name = "adaptive clock";
+
+    eeprom.set_max_frequency(400000);
+
+    DataManager data_manager(NC, NC, NC, 400000);
+    data_manager.set_adaptive_clock(true);
+
+    int status = format(eeprom, data_manager);
+
+    if(status == DataManager::DATA_MANAGER_OK)
+    {
+        status = add_filled_file(data_manager, 1, 8, 80, 64);
+    }
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        eeprom.set_max_frequency(0);
+        return fail(name, "status of writes from the start", status, DataManager::DATA_MANAGER_OK);
+    }
+
+    /** Enough reads for the clock to try stepping back up
+     */
+    char entry[8];
+    DataManager::ClockStats_t stats;
+
+    for(int read = 0; read < 2 * ADAPTIVE_CLOCK_WINDOW * ADAPTIVE_CLOCK_PROBE_WINDOWS; read++)
+    {
+        status = data_manager.read_file_entry(1, read % 64, entry, sizeof(entry));
+
+        if(status != DataManager::DATA_MANAGER_OK || entry[0] != (char)(read % 64))
+        {
+            eeprom.set_max_frequency(0);
+            return fail(name, "read whilst the clock adapts", read, -1);
+        }
+    }
+
+    data_manager.get_clock_stats(stats);
+
+    if(stats.step_ups == 0 || stats.failed_probes < 2 || stats.frequency_hz != 400000)
+    {
+        eeprom.set_max_frequency(0);
+        return fail(name, "probes of a rate the board can't sustain", stats.failed_probes, 2);
+    }
+
+    /** The board degrades once the clock has settled
+     */
+    eeprom.set_max_frequency(100000);
+
+    memset(entry, 0x5A, sizeof(entry));
+    status = data_manager.append_file_entry(1, entry, sizeof(entry));
+
+    data_manager.get_clock_stats(stats);
+    eeprom.set_max_frequency(0);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return fail(name, "status of a write as the board degrades", status, DataManager::DATA_MANAGER_OK);
+    }
+
+    if(stats.frequency_hz != 100000)
+    {
+        return fail(name, "clock after the board degrades", stats.frequency_hz, 100000);
+    }
+
+    /** With pipelined writes, the step back up once the board recovers is
+     *  probed after the write cycle left in progress has completed, rather
+     *  than by its polls, which the device NACKs. Whether the step up falls
+     *  on a write depends on the transfers before it, so a few reads shift it
+     */
+    for(int reads = 0; reads < 4; reads++)
+    {
+        eeprom.set_max_frequency(400000);
+
+        DataManager pipelined(NC, NC, NC, 400000);
+        pipelined.set_adaptive_clock(true);
+        pipelined.set_pipelined_writes(true);
+
+        status = format(eeprom, pipelined);
+
+        if(status == DataManager::DATA_MANAGER_OK)
+        {
+            status = add_filled_file(pipelined, 1, 8, 300, 20);
+        }
+
+        for(int read = 0; read < reads && status == DataManager::DATA_MANAGER_OK; read++)
+        {
+            status = pipelined.read_file_entry(1, read, entry, sizeof(entry));
+        }
+
+        DataManager::ClockStats_t degraded;
+        pipelined.get_clock_stats(degraded);
+
+        eeprom.set_max_frequency(1000000);
+
+        for(int append = 0; append < 280 && status == DataManager::DATA_MANAGER_OK; append++)
+        {
+            status = pipelined.append_file_entry(1, entry, sizeof(entry));
+        }
+
+        pipelined.get_clock_stats(stats);
+        eeprom.set_max_frequency(0);
+
+        if(status != DataManager::DATA_MANAGER_OK)
+        {
+            return fail(name, "status of pipelined writes", status, DataManager::DATA_MANAGER_OK);
+        }
+
+        if(degraded.frequency_hz != 400000 || stats.frequency_hz != 1000000)
+        {
+            return fail(name, "clock after the board recovers with pipelined writes", stats.frequency_hz, 1000000);
+        }
+
+        if(stats.failed_probes != degraded.failed_probes || stats.step_downs != degraded.step_downs)
+        {
+            return fail(name, "failed probes after the board recovers", stats.failed_probes - degraded.failed_probes, 0);
+        }
+    }
+
+    /** Polls of a write cycle are retried by their own loop, so an append
+     *  under the adaptive clock clocks as many bus bytes as with pipelined
+     *  writes alone rather than a burst of reads per poll interval
+     */
+    uint64_t append_bus_bytes[2];
+
+    for(int adaptive = 0; adaptive < 2; adaptive++)
+    {
+        DataManager polling(NC, NC, NC, 400000);
+        polling.set_adaptive_clock(adaptive == 1);
+        polling.set_pipelined_writes(adaptive == 0);
+
+        status = format(eeprom, polling);
+
+        if(status == DataManager::DATA_MANAGER_OK)
+        {
+            status = add_filled_file(polling, 1, 8, 16, 1);
+        }
+
+        eeprom.wait_for_idle();
+        uint64_t start_bus_bytes = eeprom.get_bus_bytes();
+
+        if(status == DataManager::DATA_MANAGER_OK)
+        {
+            status = polling.append_file_entry(1, entry, sizeof(entry));
+        }
+
+        if(status == DataManager::DATA_MANAGER_OK)
+        {
+            status = polling.read_file_entry(1, 0, entry, sizeof(entry));
+        }
+
+        if(status != DataManager::DATA_MANAGER_OK)
+        {
+            return fail(name, "status of an append whilst polling", status, DataManager::DATA_MANAGER_OK);
+        }
+
+        append_bus_bytes[adaptive] = eeprom.get_bus_bytes() - start_bus_bytes;
+    }
+
+    if(append_bus_bytes[1] > append_bus_bytes[0])
+    {
+        return fail(name, "bus bytes of an append under the adaptive clock", append_bus_bytes[1], append_bus_bytes[0]);
+    }
+
+    return true;
+}
+
+/** A blocking compression that fails part way must not leave the blocks
+ *  it wrote in the archive's block index, as the archive's metadata never
+ *  covered them. Power is cut as the second block is written; once it is
+ *  back the archive must still be empty and a retried compression must
+ *  archive every entry as it was written
+ *
+ * @param &eeprom The simulated EEPROM
+ * @return True if the check passed
+ */
+static bool check_failed_compress(DataManager_SimulatedEeprom &eeprom)
+{
+    const char *name = "failed compress";
+
+    DataManager data_manager(NC, NC, NC, 400000);
+
+    int status = format(eeprom, data_manager);
+
+    if(status == DataManager::DATA_MANAGER_OK)
+    {
+        status = add_filled_file(data_manager, 1, 8, 128, 128);
+    }
+
+    if(status == DataManager::DATA_MANAGER_OK)
+    {
+        status = data_manager.add_archive_file(2, 16 * (PAGE_SIZE_BYTES + ARCHIVE_BLOCK_HEADER_BYTES));
+    }
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return fail(name, "status of setup", status, DataManager::DATA_MANAGER_OK);
+    }
+
+    eeprom.set_power_cut(eeprom.get_write_cycles() + 1, 0);
+    status = data_manager.compress_sealed_pages(1, 2);
+    eeprom.restore_power();
+
+    if(status == DataManager::DATA_MANAGER_OK)
+    {
+        return fail(name, "status of compressing through the cut", status, -1);
+    }
+
+    int archived_entries = -1;
+    status = data_manager.get_total_archived_entries(2, 8, archived_entries);
+
+    if(status != DataManager::DATA_MANAGER_OK || archived_entries != 0)
+    {
+        return fail(name, "archived entries after the failure", archived_entries, 0);
+    }
+
+    status = data_manager.compress_sealed_pages(1, 2);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return fail(name, "status of the retried compression", status, DataManager::DATA_MANAGER_OK);
+    }
+
+    status = data_manager.get_total_archived_entries(2, 8, archived_entries);
+
+    if(status != DataManager::DATA_MANAGER_OK || archived_entries != 128)
+    {
+        return fail(name, "archived entries after the retry", archived_entries, 128);
+    }
+
+    char entry[8];
+
+    for(int index = 0; index < 128; index++)
+    {
+        status = data_manager.read_archived_entry(2, index, entry, sizeof(entry));
+
+        if(status != DataManager::DATA_MANAGER_OK || entry[0] != (char)index || entry[7] != (char)index)
+        {
+            return fail(name, "archived entry read back", index, -1);
+        }
+    }
+
+    return true;
+}
+
+/** Fill an entry with bytes that don't compress, distinct for every index
+ *
+ * @param index Index of the entry
+ * @param *entry Buffer of 8 bytes to which the entry is written
+ */
+static void fill_noisy_entry(int index, char *entry)
+{
+    uint32_t random = (index * 2654435761u) | 1;
+
+    for(int byte = 0; byte < 8; byte++)
+    {
+        random ^= random << 13;
+        random ^= random >> 17;
+        random ^= random << 5;
+        entry[byte] = (char)random;
+    }
+}
+
+/** Blocks that don't shrink must be left in the source file rather than 
+ *  archived. Two pages that compress are followed by six that don't; the
+ *  first compression must archive only the two pages and leave the rest in
+ *  place, after which both forms must return ARCHIVE_INCOMPRESSIBLE without
+ *  spending a write cycle
+ *
+ * @param &eeprom The simulated EEPROM
+ * @return True if the check passed
+ */
+static bool check_incompressible(DataManager_SimulatedEeprom &eeprom)
+{
+    const char *name = "incompressible";
+
+    DataManager data_manager(NC, NC, NC, 400000);
+
+    int status = format(eeprom, data_manager);
+
+    if(status == DataManager::DATA_MANAGER_OK)
+    {
+        status = add_filled_file(data_manager, 1, 8, 64, 16);
+    }
+
+    char entry[8];
+
+    for(int index = 16; index < 64 && status == DataManager::DATA_MANAGER_OK; index++)
+    {
+        fill_noisy_entry(index, entry);
+        status = data_manager.append_file_entry(1, entry, sizeof(entry));
+    }
+
+    if(status == DataManager::DATA_MANAGER_OK)
+    {
+        status = data_manager.add_archive_file(2, 8 * (PAGE_SIZE_BYTES + ARCHIVE_BLOCK_HEADER_BYTES));
+    }
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return fail(name, "status of setup", status, DataManager::DATA_MANAGER_OK);
+    }
+
+    status = data_manager.compress_sealed_pages(1, 2);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return fail(name, "status of compressing the pages that shrink", status, DataManager::DATA_MANAGER_OK);
+    }
+
+    int archived_entries = -1;
+    status = data_manager.get_total_archived_entries(2, 8, archived_entries);
+
+    if(status != DataManager::DATA_MANAGER_OK || archived_entries != 16)
+    {
+        return fail(name, "archived entries", archived_entries, 16);
+    }
+
+    for(int attempt = 0; attempt < 2; attempt++)
+    {
+        DataManager::OperationBudget_t budget = { 0, 1 };
+        uint64_t start_write_cycles = eeprom.get_write_cycles();
+
+        status = (attempt == 0) ? data_manager.compress_sealed_pages(1, 2) : data_manager.compress_sealed_pages(1, 2, budget);
+
+        if(status != DataManager_FileSystem::ARCHIVE_INCOMPRESSIBLE)
+        {
+            return fail(name, "status of compressing the pages that don't shrink", status,
+                        DataManager_FileSystem::ARCHIVE_INCOMPRESSIBLE);
+        }
+
+        if(eeprom.get_write_cycles() != start_write_cycles)
+        {
+            return fail(name, "write cycles spent on the pages that don't shrink",
+                        (int)(eeprom.get_write_cycles() - start_write_cycles), 0);
+        }
+    }
+
+    char expected[8];
+
+    for(int index = 0; index < 64; index++)
+    {
+        if(index < 16)
+        {
+            memset(expected, index, sizeof(expected));
+            status = data_manager.read_archived_entry(2, index, entry, sizeof(entry));
+        }
+        else
+        {
+            fill_noisy_entry(index, expected);
+            status = data_manager.read_file_entry(1, index - 16, entry, sizeof(entry));
+        }
+
+        if(status != DataManager::DATA_MANAGER_OK || memcmp(entry, expected, sizeof(entry)) != 0)
+        {
+            return fail(name, "entry read back", index, -1);
+        }
+    }
+
+    return true;
+}
+
+/** Format the device with six empty files of 8-byte entries
+ *
+ * @param &eeprom The simulated EEPROM
+ * @param &data_manager DataManager to mount with
+ * @return Indicates success or failure reason
+ */
+static int format_scheduled(DataManager_SimulatedEeprom &eeprom, DataManager &data_manager)
+{
+    int status = format(eeprom, data_manager);
+
+    for(int file = 1; file <= 6 && status == DataManager::DATA_MANAGER_OK; file++)
+    {
+        status = add_filled_file(data_manager, file, 8, 16, 0);
+    }
+
+    return status;
+}
+
+/** Zero a request and make it an append of one entry of 8 bytes
+ *
+ * @param &request Request to be set up
+ * @param filename ID of the file appended to
+ * @param *data Entry to be appended
+ * @param priority Priority of the request
+ */
+static void make_append(DataManager_Scheduler::Request_t &request, uint8_t filename, char *data, uint8_t priority)
+{
+    memset(&request, 0, sizeof(request));
+    request.op = DataManager_FileSystem::TRACE_APPEND_FILE_ENTRY;
+    request.filename = filename;
+    request.params.count = 1;
+    request.params.length = 8;
+    request.data = data;
+    request.priority = priority;
+}
+
+/** Requests run in priority order and, within a priority, earliest deadline
+ *  first with requests without a deadline last, whatever order they were
+ *  submitted in
+ *
+ * @param &eeprom The simulated EEPROM
+ * @return True if the check passed
+ */
+static bool check_scheduler_order(DataManager_SimulatedEeprom &eeprom)
+{
+    const char *name = "scheduler order";
+
+    DataManager data_manager(NC, NC, NC, 400000);
+
+    int status = format_scheduled(eeprom, data_manager);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return fail(name, "setup status", status, DataManager::DATA_MANAGER_OK);
+    }
+
+    /** Submitted in this order, expected to run in the order of expected[]
+     */
+    static const int DEADLINES_MS[] = { -1, 40, 10, 30, 20, 50 };
+    static const uint8_t PRIORITIES[] = { DataManager_Scheduler::PRIORITY_NORMAL, DataManager_Scheduler::PRIORITY_NORMAL,
+                                          DataManager_Scheduler::PRIORITY_NORMAL, DataManager_Scheduler::PRIORITY_NORMAL,
+                                          DataManager_Scheduler::PRIORITY_NORMAL, DataManager_Scheduler::PRIORITY_URGENT };
+    static const int expected[] = { 5, 2, 4, 3, 1, 0 };
+    static const int REQUESTS = sizeof(expected) / sizeof(expected[0]);
+
+    DataManager_Scheduler scheduler(data_manager);
+    DataManager_Scheduler::Request_t requests[REQUESTS];
+    char data[8];
+    memset(data, 0, sizeof(data));
+
+    uint32_t now_us = (uint32_t)eeprom.now_us();
+
+    for(int request = 0; request < REQUESTS; request++)
+    {
+        /** Each on its own file, as writes to one file keep their order
+         */
+        make_append(requests[request], request + 1, data, PRIORITIES[request]);
+        requests[request].has_deadline = DEADLINES_MS[request] >= 0;
+        requests[request].deadline_us = now_us + (DEADLINES_MS[request] * 1000);
+
+        status = scheduler.submit(requests[request]);
+
+        if(status != DataManager::DATA_MANAGER_OK)
+        {
+            return fail(name, "submit status", status, DataManager::DATA_MANAGER_OK);
+        }
+    }
+
+    for(int step = 0; step < REQUESTS; step++)
+    {
+        bool stepped = false;
+        int pending = 0;
+        uint32_t wake_us = 0;
+
+        status = scheduler.run_step(stepped, pending, wake_us);
+
+        if(status != DataManager::DATA_MANAGER_OK || !stepped)
+        {
+            return fail(name, "step status", status, DataManager::DATA_MANAGER_OK);
+        }
+
+        int done = -1;
+
+        for(int request = 0; request < REQUESTS; request++)
+        {
+            if(requests[request].state == DataManager_Scheduler::REQUEST_DONE && requests[request].progress >= 0)
+            {
+                done = request;
+                requests[request].progress = -1;
+            }
+        }
+
+        if(done != expected[step])
+        {
+            return fail(name, "request run at this step", done, expected[step]);
+        }
+
+        if(requests[done].status != DataManager::DATA_MANAGER_OK)
+        {
+            return fail(name, "request status", requests[done].status, DataManager::DATA_MANAGER_OK);
+        }
+    }
+
+    return true;
+}
+
+/** A write due to run into a blackout window waits until the window has
+ *  closed, a read runs during it and a write that finishes well before a
+ *  later window runs at once. No write cycle may land in a window
+ *
+ * @param &eeprom The simulated EEPROM
+ * @return True if the check passed
+ */
+static bool check_scheduler_blackout(DataManager_SimulatedEeprom &eeprom)
+{
+    const char *name = "scheduler blackout";
+
+    DataManager data_manager(NC, NC, NC, 400000);
+
+    int status = format_scheduled(eeprom, data_manager);
+
+    if(status == DataManager::DATA_MANAGER_OK)
+    {
+        status = add_filled_file(data_manager, 7, 8, 16, 4);
+    }
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return fail(name, "setup status", status, DataManager::DATA_MANAGER_OK);
+    }
+
+    DataManager_Scheduler scheduler(data_manager);
+    DataManager_Scheduler::Request_t append;
+    DataManager_Scheduler::Request_t read;
+    char data[8];
+    char read_data[8];
+    memset(data, 0x3C, sizeof(data));
+
+    /** A window opening 2 ms from now, sooner than an append can complete
+     */
+    uint32_t window_start_us = (uint32_t)eeprom.now_us() + 2000;
+    uint32_t window_end_us = window_start_us + 50000;
+
+    status = scheduler.add_blackout(window_start_us, window_end_us - window_start_us);
+
+    make_append(append, 1, data, DataManager_Scheduler::PRIORITY_URGENT);
+
+    memset(&read, 0, sizeof(read));
+    read.op = DataManager_FileSystem::TRACE_READ_FILE_ENTRY;
+    read.filename = 7;
+    read.params.index = 3;
+    read.params.count = 1;
+    read.params.length = 8;
+    read.data = read_data;
+    read.priority = DataManager_Scheduler::PRIORITY_BULK;
+
+    if(status == DataManager::DATA_MANAGER_OK)
+    {
+        status = scheduler.submit(append);
+    }
+
+    if(status == DataManager::DATA_MANAGER_OK)
+    {
+        status = scheduler.submit(read);
+    }
+
+    int pending = 0;
+    uint32_t wake_us = 0;
+
+    if(status == DataManager::DATA_MANAGER_OK)
+    {
+        status = scheduler.run(pending, wake_us);
+    }
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return fail(name, "status before the window", status, DataManager::DATA_MANAGER_OK);
+    }
+
+    if(append.state != DataManager_Scheduler::REQUEST_QUEUED || !append.deferred || pending != 1)
+    {
+        return fail(name, "state of the append before the window", append.state, DataManager_Scheduler::REQUEST_QUEUED);
+    }
+
+    if(read.state != DataManager_Scheduler::REQUEST_DONE || read.status != DataManager::DATA_MANAGER_OK || read_data[0] != 3)
+    {
+        return fail(name, "state of the read before the window", read.state, DataManager_Scheduler::REQUEST_DONE);
+    }
+
+    if(wake_us != window_end_us)
+    {
+        return fail(name, "wake time", wake_us, window_end_us);
+    }
+
+    /** Run again from the end of the window, with another window a second later
+     */
+    eeprom.advance_us(wake_us - (uint32_t)eeprom.now_us());
+
+    status = scheduler.add_blackout(wake_us + 1000000, 50000);
+
+    if(status == DataManager::DATA_MANAGER_OK)
+    {
+        status = scheduler.run(pending, wake_us);
+    }
+
+    if(status != DataManager::DATA_MANAGER_OK || append.state != DataManager_Scheduler::REQUEST_DONE ||
+       append.status != DataManager::DATA_MANAGER_OK || pending != 0)
+    {
+        return fail(name, "state of the append after the window", append.state, DataManager_Scheduler::REQUEST_DONE);
+    }
+
+    if((int32_t)(append.started_us - window_end_us) < 0)
+    {
+        return fail(name, "start of the append", append.started_us, window_end_us);
+    }
+
+    /** Far enough from the next window to run at once
+     */
+    make_append(append, 2, data, DataManager_Scheduler::PRIORITY_BULK);
+
+    status = scheduler.submit(append);
+
+    if(status == DataManager::DATA_MANAGER_OK)
+    {
+        status = scheduler.run(pending, wake_us);
+    }
+
+    if(status != DataManager::DATA_MANAGER_OK || append.state != DataManager_Scheduler::REQUEST_DONE || append.deferred)
+    {
+        return fail(name, "deferral of an append clear of the window", append.deferred, 0);
+    }
+
+    DataManager_Scheduler::SchedulerStats_t stats;
+    scheduler.get_stats(stats);
+
+    if(stats.window_overlaps != 0)
+    {
+        return fail(name, "write cycles in a window", stats.window_overlaps, 0);
+    }
+
+    return true;
+}
+
+/** A request whose estimate fails is assumed to write, so it waits for a
+ *  blackout window like any other write and then runs to its own failure
+ *
+ * @param &eeprom The simulated EEPROM
+ * @return True if the check passed
+ */
+static bool check_scheduler_failed_estimate(DataManager_SimulatedEeprom &eeprom)
+{
+    const char *name = "scheduler failed estimate";
+
+    DataManager data_manager(NC, NC, NC, 400000);
+
+    int status = format_scheduled(eeprom, data_manager);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return fail(name, "setup status", status, DataManager::DATA_MANAGER_OK);
+    }
+
+    DataManager_Scheduler scheduler(data_manager);
+    DataManager_Scheduler::Request_t append;
+    char data[8];
+    memset(data, 0, sizeof(data));
+
+    uint32_t window_start_us = (uint32_t)eeprom.now_us() + 2000;
+    uint32_t window_end_us = window_start_us + 50000;
+
+    /** No such file, so its cost can't be estimated
+     */
+    make_append(append, 9, data, DataManager_Scheduler::PRIORITY_URGENT);
+
+    DataManager::CostEstimate_t estimate;
+    int estimate_status = data_manager.estimate_cost(append.op, append.filename, append.params, estimate);
+
+    if(estimate_status == DataManager::DATA_MANAGER_OK)
+    {
+        return fail(name, "estimate status", estimate_status, -1);
+    }
+
+    status = scheduler.add_blackout(window_start_us, window_end_us - window_start_us);
+
+    if(status == DataManager::DATA_MANAGER_OK)
+    {
+        status = scheduler.submit(append);
+    }
+
+    int pending = 0;
+    uint32_t wake_us = 0;
+
+    if(status == DataManager::DATA_MANAGER_OK)
+    {
+        status = scheduler.run(pending, wake_us);
+    }
+
+    if(status != DataManager::DATA_MANAGER_OK || append.state != DataManager_Scheduler::REQUEST_QUEUED || !append.deferred)
+    {
+        return fail(name, "state before the window", append.state, DataManager_Scheduler::REQUEST_QUEUED);
+    }
+
+    eeprom.advance_us(wake_us - (uint32_t)eeprom.now_us());
+
+    status = scheduler.run(pending, wake_us);
+
+    if(status != DataManager::DATA_MANAGER_OK || append.state != DataManager_Scheduler::REQUEST_DONE)
+    {
+        return fail(name, "state after the window", append.state, DataManager_Scheduler::REQUEST_DONE);
+    }
+
+    if(append.status != estimate_status)
+    {
+        return fail(name, "request status", append.status, estimate_status);
+    }
+
+    return true;
+}
+
+/** A regression check
+ */
+struct Check_t
+{
+    const char *name;
+    bool (*run)(DataManager_SimulatedEeprom &eeprom);
+};
+
+static const Check_t CHECKS[] =
+{
+    { "failed truncate", check_failed_truncate },
+    { "rle reset", check_rle_reset },
+    { "image round trip", check_image_round_trip },
+    { "image checksum", check_image_checksum },
+    { "restore not started", check_restore_not_started },
+    { "transaction conflicts", check_transaction_conflicts },
+    { "legacy layout", check_legacy_layout },
+    { "failed compress", check_failed_compress },
+    { "incompressible", check_incompressible },
+    { "adaptive clock", check_adaptive_clock },
+    { "scheduler order", check_scheduler_order },
+    { "scheduler blackout", check_scheduler_blackout },
+    { "scheduler failed estimate", check_scheduler_failed_estimate }
+};
+
+int main(int argc, char **argv)
+{
+    for(int arg = 1; arg < argc; arg++)
+    {
+        if(strcmp(argv[arg], "--verbose") == 0)
+        {
+            verbose = true;
+        }
+        else
+        {
+            fprintf(stderr, "Unknown option %s\n", argv[arg]);
+            return 1;
+        }
+    }
+
+    static DataManager_SimulatedEeprom eeprom;
+    DataManager_SimulatedEeprom::select(&eeprom);
+
+    int failures = 0;
+
+    for(unsigned int check = 0; check < sizeof(CHECKS) / sizeof(CHECKS[0]); check++)
+    {
+        bool passed = CHECKS[check].run(eeprom);
+
+        printf("%-30s %s\n", CHECKS[check].name, passed ? "pass" : "FAIL");
+
+        if(!passed)
+        {
+            failures++;
+        }
+    }
+
+    printf("Failures:     %d of %d checks\n", failures, (int)(sizeof(CHECKS) / sizeof(CHECKS[0])));
+
+    return failures == 0 ? 0 : 2;
+}
@@ -0,0 +1,396 @@
+/**
+  * @file    dm_compress.cpp
+  * @version 0.5.0
+  * @author  Adam Mitchell
+  * @brief   Command line tool that measures compress_sealed_pages() on a
+  *          simulated EEPROM for a range of sensor signals. For each signal a
+  *          file is filled with sealed pages, which are then archived, and the
+  *          compression ratio, the host time taken to encode and decode a page
+  *          and the write cycles spent against the bytes reclaimed are reported.
+  *          The simulator has no model of the MCU, so encoding and decoding are
+  *          timed on the host, as a relative measure between signals.
+  *
+  *          Build:  g++ -O2 -std=c++11 -I. -I../.. -I../../filesystem ../../DataManager.cpp
+  *                  ../../DataManager_Async.cpp DataManager_SimulatedEeprom.cpp
+  *                  dm_compress.cpp -o dm_compress
+  *          Usage:  dm_compress [--pages N] [--entry-bytes B] [--frequency HZ]
+  *                              [--budget-cycles C]
+  *
+  *          With --budget-cycles the resumable form is called with a budget of
+  *          C write cycles until it completes. Pages from the first that
+  *          doesn't shrink are left in the source file. Exits with 2 if any
+  *          entry, archived or left in place, reads back differently from the
+  *          entry written, or if the write cycles counted by
+  *          get_compression_stats() differ from those the simulator saw
+  */
+
+/** Includes
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include "DataManager.h"
+#include "DataManager_SimulatedEeprom.h"
+
+/** Number of times each page is encoded and decoded when timing it
+ */
+#define COMPRESS_TIMING_REPEATS 200
+
+/** Signals whose samples are stored, as 16-bit readings
+ */
+enum CompressSignal
+{
+    SIGNAL_CONSTANT,
+    SIGNAL_RAMP,
+    SIGNAL_NOISY,
+    SIGNAL_COUNTER,
+    SIGNAL_RANDOM,
+    SIGNAL_COUNT
+};
+
+static const char *SIGNAL_NAMES[SIGNAL_COUNT] =
+{
+    "constant", "slow ramp", "noisy sensor", "counter", "random"
+};
+
+/** Outcome of archiving one signal
+ */
+struct CompressRun_t
+{
+    int status;
+    DataManager::CompressionStats_t stats;
+    uint64_t write_cycles;
+    uint64_t bus_us;
+    double encode_ns;
+    double decode_ns;
+    int mismatches;
+};
+
+/** Fill an entry with samples of a signal
+ *
+ * @param signal One of CompressSignal
+ * @param index Index of the entry
+ * @param *entry Buffer to which the entry is written
+ * @param entry_bytes Length of the entry in bytes
+ */
+static void fill_entry(int signal, int index, char *entry, int entry_bytes)
+{
+    uint32_t random = (index * 2654435761u) | 1;
+
+    for(int byte = 0; byte + 1 < entry_bytes; byte += 2)
+    {
+        int sample = (index * entry_bytes + byte) / 2;
+        int reading;
+
+        switch(signal)
+        {
+            case SIGNAL_CONSTANT:
+                reading = 2048;
+                break;
+
+            case SIGNAL_RAMP:
+                reading = 2048 + (sample / 16);
+                break;
+
+            case SIGNAL_NOISY:
+                reading = 2048 + ((sample * 7) % 64) + (((sample * 31) % 5) - 2);
+                break;
+
+            case SIGNAL_COUNTER:
+                reading = (byte == 0) ? (index & 0xFFFF) : (index >> 16);
+                break;
+
+            default:
+                random ^= random << 13;
+                random ^= random >> 17;
+                random ^= random << 5;
+                reading = random & 0xFFFF;
+                break;
+        }
+
+        entry[byte] = (char)(reading & 0xFF);
+        entry[byte + 1] = (char)(reading >> 8);
+    }
+
+    if(entry_bytes % 2 != 0)
+    {
+        entry[entry_bytes - 1] = (char)index;
+    }
+}
+
+/** Time encoding and decoding the pages of a signal on the host
+ *
+ * @param signal One of CompressSignal
+ * @param pages Number of pages
+ * @param entry_bytes Length of each entry in bytes
+ * @param &run Address of CompressRun_t to which the times will be written
+ */
+static void time_codec(int signal, int pages, int entry_bytes, CompressRun_t &run)
+{
+    int entries_per_page = PAGE_SIZE_BYTES / entry_bytes;
+    int block_length = entries_per_page * entry_bytes;
+
+    char raw[PAGE_SIZE_BYTES];
+    char compressed[PAGE_SIZE_BYTES];
+    char decoded[PAGE_SIZE_BYTES];
+    volatile int sink = 0;
+
+    double encode_ns = 0;
+    double decode_ns = 0;
+
+    for(int page = 0; page < pages; page++)
+    {
+        for(int entry = 0; entry < entries_per_page; entry++)
+        {
+            fill_entry(signal, (page * entries_per_page) + entry, &raw[entry * entry_bytes], entry_bytes);
+        }
+
+        int compressed_length = 0;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        for(int repeat = 0; repeat < COMPRESS_TIMING_REPEATS; repeat++)
+        {
+            compressed_length = DataManager_FileSystem::lz_compress(raw, block_length, compressed,
+                                                                    block_length - ARCHIVE_BLOCK_HEADER_BYTES - 1);
+            sink += compressed_length;
+        }
+
+        encode_ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+        /** Blocks that don't shrink are left in the source file and cost 
+         *  nothing to decode
+         */
+        if(compressed_length == 0)
+        {
+            continue;
+        }
+
+        start = std::chrono::steady_clock::now();
+
+        for(int repeat = 0; repeat < COMPRESS_TIMING_REPEATS; repeat++)
+        {
+            sink += DataManager_FileSystem::lz_decompress(compressed, compressed_length, decoded, sizeof(decoded));
+        }
+
+        decode_ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    (void)sink;
+
+    run.encode_ns = encode_ns / ((double)pages * COMPRESS_TIMING_REPEATS);
+    run.decode_ns = decode_ns / ((double)pages * COMPRESS_TIMING_REPEATS);
+}
+
+/** Fill a file with sealed pages of a signal, archive them and read them back
+ *
+ * @param &eeprom The simulated EEPROM
+ * @param &data_manager DataManager to call
+ * @param signal One of CompressSignal
+ * @param pages Number of sealed pages
+ * @param entry_bytes Length of each entry in bytes
+ * @param budget_cycles Write cycles per call of the resumable form, or 0 for the blocking form
+ * @param &run Address of CompressRun_t to which the outcome will be written
+ */
+static void run_signal(DataManager_SimulatedEeprom &eeprom, DataManager &data_manager, int signal, int pages,
+                       int entry_bytes, int budget_cycles, CompressRun_t &run)
+{
+    int entries = pages * (PAGE_SIZE_BYTES / entry_bytes);
+
+    DataManager_FileSystem::File_t definition;
+    memset(definition.data, 0, sizeof(definition));
+    definition.parameters.filename = 1;
+    definition.parameters.length_bytes = entry_bytes;
+
+    run.status = data_manager.init_filesystem();
+
+    if(run.status == DataManager::DATA_MANAGER_OK)
+    {
+        run.status = data_manager.init_gstats();
+    }
+
+    if(run.status == DataManager::DATA_MANAGER_OK)
+    {
+        run.status = data_manager.add_file(definition, entries);
+    }
+
+    /** Room for every page behind its block header
+     */
+    if(run.status == DataManager::DATA_MANAGER_OK)
+    {
+        run.status = data_manager.add_archive_file(2, pages * (PAGE_SIZE_BYTES + ARCHIVE_BLOCK_HEADER_BYTES));
+    }
+
+    char entry[PAGE_SIZE_BYTES];
+
+    for(int index = 0; index < entries && run.status == DataManager::DATA_MANAGER_OK; index++)
+    {
+        fill_entry(signal, index, entry, entry_bytes);
+        run.status = data_manager.append_file_entry(1, entry, entry_bytes);
+    }
+
+    if(run.status != DataManager::DATA_MANAGER_OK)
+    {
+        return;
+    }
+
+    data_manager.reset_compression_stats();
+
+    uint64_t start_us = eeprom.now_us();
+    uint64_t start_write_cycles = eeprom.get_write_cycles();
+
+    if(budget_cycles > 0)
+    {
+        DataManager::OperationBudget_t budget = { 0, (uint32_t)budget_cycles };
+
+        do
+        {
+            run.status = data_manager.compress_sealed_pages(1, 2, budget);
+        }
+        while(run.status == DataManager_FileSystem::OPERATION_IN_PROGRESS);
+    }
+    else
+    {
+        run.status = data_manager.compress_sealed_pages(1, 2);
+    }
+
+    /** A signal whose first page doesn't shrink is left in place
+     */
+    if(run.status == DataManager_FileSystem::ARCHIVE_INCOMPRESSIBLE)
+    {
+        run.status = DataManager::DATA_MANAGER_OK;
+    }
+
+    eeprom.wait_for_idle();
+
+    run.bus_us = eeprom.now_us() - start_us;
+    run.write_cycles = eeprom.get_write_cycles() - start_write_cycles;
+
+    data_manager.get_compression_stats(run.stats);
+
+    /** Entries that weren't archived remain at the start of the source file
+     */
+    int archived = 0;
+
+    if(run.status == DataManager::DATA_MANAGER_OK)
+    {
+        run.status = data_manager.get_total_archived_entries(2, entry_bytes, archived);
+    }
+
+    char read[PAGE_SIZE_BYTES];
+
+    for(int index = 0; index < entries && run.status == DataManager::DATA_MANAGER_OK; index++)
+    {
+        fill_entry(signal, index, entry, entry_bytes);
+
+        int status = (index < archived) ? data_manager.read_archived_entry(2, index, read, entry_bytes) :
+                                          data_manager.read_file_entry(1, index - archived, read, entry_bytes);
+
+        if(status != DataManager::DATA_MANAGER_OK || memcmp(read, entry, entry_bytes) != 0)
+        {
+            run.mismatches++;
+        }
+    }
+
+    time_codec(signal, pages, entry_bytes, run);
+}
+
+int main(int argc, char **argv)
+{
+    int pages = 64;
+    int entry_bytes = 16;
+    int frequency_hz = 400000;
+    int budget_cycles = 0;
+
+    for(int arg = 1; arg < argc; arg++)
+    {
+        if(strcmp(argv[arg], "--pages") == 0 && arg + 1 < argc)
+        {
+            pages = strtol(argv[++arg], NULL, 0);
+        }
+        else if(strcmp(argv[arg], "--entry-bytes") == 0 && arg + 1 < argc)
+        {
+            entry_bytes = strtol(argv[++arg], NULL, 0);
+        }
+        else if(strcmp(argv[arg], "--frequency") == 0 && arg + 1 < argc)
+        {
+            frequency_hz = strtol(argv[++arg], NULL, 0);
+        }
+        else if(strcmp(argv[arg], "--budget-cycles") == 0 && arg + 1 < argc)
+        {
+            budget_cycles = strtol(argv[++arg], NULL, 0);
+        }
+        else
+        {
+            fprintf(stderr, "Unknown option %s\n", argv[arg]);
+            return 1;
+        }
+    }
+
+    if(pages < 1 || entry_bytes < 1 || entry_bytes > PAGE_SIZE_BYTES)
+    {
+        fprintf(stderr, "--pages must be at least 1 and --entry-bytes between 1 and %d\n", PAGE_SIZE_BYTES);
+        return 1;
+    }
+
+    static DataManager_SimulatedEeprom eeprom;
+    DataManager_SimulatedEeprom::select(&eeprom);
+
+    printf("%-14s %8s %8s %7s %10s %10s %8s %8s %10s %12s %9s\n", "Signal", "Raw B", "Stored B", "Ratio",
+           "Encode ns", "Decode ns", "Cycles", "Counted", "Reclaimed", "Cycles / KiB", "Bus ms");
+
+    int mismatches = 0;
+    int miscounts = 0;
+
+    for(int signal = 0; signal < SIGNAL_COUNT; signal++)
+    {
+        eeprom.erase();
+
+        DataManager data_manager(NC, NC, NC, frequency_hz);
+
+        CompressRun_t run;
+        memset(&run, 0, sizeof(run));
+
+        run_signal(eeprom, data_manager, signal, pages, entry_bytes, budget_cycles, run);
+
+        if(run.status != DataManager::DATA_MANAGER_OK)
+        {
+            fprintf(stderr, "%s failed with status %d; try fewer --pages\n", SIGNAL_NAMES[signal], run.status);
+            return 1;
+        }
+
+        mismatches += run.mismatches;
+
+        if(run.write_cycles != run.stats.write_cycles)
+        {
+            miscounts++;
+        }
+
+        /** Write cycles spent per KiB of storage given back, or none if the
+         *  signal didn't compress
+         */
+        double ratio = (run.stats.stored_bytes > 0) ? (double)run.stats.raw_bytes / run.stats.stored_bytes : 0;
+        double cycles_per_kib = (run.stats.bytes_reclaimed > 0) ? (run.write_cycles * 1024.0) / run.stats.bytes_reclaimed : 0;
+
+        printf("%-14s %8lu %8lu %7.2f %10.0f %10.0f %8llu %8lu %10ld %12.1f %9.1f\n", SIGNAL_NAMES[signal],
+               (unsigned long)run.stats.raw_bytes, (unsigned long)run.stats.stored_bytes, ratio, run.encode_ns,
+               run.decode_ns, (unsigned long long)run.write_cycles, (unsigned long)run.stats.write_cycles,
+               (long)run.stats.bytes_reclaimed, cycles_per_kib, run.bus_us / 1000.0);
+    }
+
+    printf("Workload:     %d sealed pages of %d-byte entries at %d Hz", pages, entry_bytes, frequency_hz);
+
+    if(budget_cycles > 0)
+    {
+        printf(", resumable with %d write cycles per call", budget_cycles);
+    }
+
+    printf("\n");
+    printf("Columns:      encode and decode are host ns per page; cycles are those the simulator saw, counted\n");
+    printf("              those of get_compression_stats(); reclaimed bytes are net of block headers\n");
+    printf("Mismatches:   %d entries read back differently from the entry written\n", mismatches);
+    printf("Miscounts:    %d signals whose counted write cycles differ from those seen\n", miscounts);
+
+    return (mismatches == 0 && miscounts == 0) ? 0 : 2;
+}
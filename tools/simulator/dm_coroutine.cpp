@@ -0,0 +1,329 @@
+/**
+  * @file    dm_coroutine.cpp
+  * @version 0.5.0
+  * @author  Adam Mitchell
+  * @brief   Command line tool that runs many concurrent coroutines of
+  *          DataManager_Coroutine.h on the simulated EEPROM. Each coroutine
+  *          logs entries to its own file with append() and reads every batch
+  *          back with read_range(), whilst the I2C events of whichever operation
+  *          holds the bus are run as interrupts. Every status and every entry
+  *          read back is checked, a coroutine spawned whilst the frame pool is
+  *          full must be refused and the frames must be reused by a second round.
+  *
+  *          Build:  g++ -O2 -std=c++20 -DDM_COROUTINE_MAX_TASKS=16 -I. -I../.. -I../../filesystem
+  *                  ../../DataManager.cpp ../../DataManager_Async.cpp DataManager_SimulatedEeprom.cpp
+  *                  dm_coroutine.cpp -o dm_coroutine
+  *          Usage:  dm_coroutine [--tasks N] [--entries E] [--entry-bytes B] [--batch K]
+  *
+  *          --tasks defaults to DM_COROUTINE_MAX_TASKS. Exits with 2 if any
+  *          operation fails, any entry reads back differently from the entry
+  *          written, the frame pool isn't respected or the coroutines stall
+  */
+
+/** Includes
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include "DataManager.h"
+#include "DataManager_Coroutine.h"
+#include "DataManager_SimulatedEeprom.h"
+
+#if !DEVICE_I2C_ASYNCH || !defined(__cpp_impl_coroutine)
+    #error dm_coroutine needs DEVICE_I2C_ASYNCH and a C++20 compiler
+#endif /* #if !DEVICE_I2C_ASYNCH || !defined(__cpp_impl_coroutine) */
+
+/** Largest number of entries read back per read_range()
+ */
+#define COROUTINE_MAX_BATCH 16
+
+/** State of one logging coroutine, kept outside its frame so that the frame
+ *  fits DM_COROUTINE_FRAME_BYTES
+ */
+struct Logger_t
+{
+    uint8_t filename;
+    int entries;
+    int entry_bytes;
+    int batch;
+    int round;
+    int appended;
+    int failures;
+    int mismatches;
+    bool finished;
+    char entry[PAGE_SIZE_BYTES];
+    char read[COROUTINE_MAX_BATCH * PAGE_SIZE_BYTES];
+    char expected[PAGE_SIZE_BYTES];
+};
+
+/** Encode an entry, distinct for every file, round and index
+ *
+ * @param &logger Logger whose entry is encoded
+ * @param index Index of the entry in the round
+ * @param *data Buffer to which the entry is written
+ */
+static void encode_entry(Logger_t &logger, int index, char *data)
+{
+    for(int byte = 0; byte < logger.entry_bytes; byte++)
+    {
+        data[byte] = (char)((logger.filename * 53) + (logger.round * 17) + (index * 31) + (byte * 7));
+    }
+}
+
+/** Append the entries of a round in batches and read each batch back
+ *
+ * @param &scheduler Scheduler on which the coroutine runs
+ * @param *logger State of the coroutine
+ * @return Coroutine to be spawned
+ */
+static DataManager_Coroutine::Task log_entries(DataManager_Coroutine::Scheduler &scheduler, Logger_t *logger)
+{
+    int first_entry = logger->round * logger->entries;
+
+    for(int first = 0; first < logger->entries; first += logger->batch)
+    {
+        int count = (logger->entries - first < logger->batch) ? logger->entries - first : logger->batch;
+
+        for(int member = 0; member < count; member++)
+        {
+            encode_entry(*logger, first + member, logger->entry);
+
+            int status = co_await scheduler.append(logger->filename, logger->entry, logger->entry_bytes);
+
+            if(status != DataManager::DATA_MANAGER_OK)
+            {
+                logger->failures++;
+            }
+            else
+            {
+                logger->appended++;
+            }
+        }
+
+        int status = co_await scheduler.read_range(logger->filename, first_entry + first, count, logger->read,
+                                                   count * logger->entry_bytes);
+
+        for(int member = 0; member < count; member++)
+        {
+            encode_entry(*logger, first + member, logger->expected);
+
+            if(status != DataManager::DATA_MANAGER_OK ||
+               memcmp(&logger->read[member * logger->entry_bytes], logger->expected, logger->entry_bytes) != 0)
+            {
+                logger->mismatches++;
+            }
+        }
+    }
+
+    logger->finished = true;
+}
+
+/** Run the scheduler until every logger has finished, running the interrupts
+ *  of the simulated EEPROM whenever no coroutine is ready
+ *
+ * @param &eeprom The simulated EEPROM
+ * @param &scheduler Scheduler to run
+ * @param *loggers Loggers spawned on the scheduler
+ * @param tasks Number of loggers
+ * @return False if the loggers stall, as none is ready and no interrupt is queued, else true
+ */
+static bool run_loggers(DataManager_SimulatedEeprom &eeprom, DataManager_Coroutine::Scheduler &scheduler,
+                        Logger_t *loggers, int tasks)
+{
+    while(true)
+    {
+        while(scheduler.run_once())
+        {
+        }
+
+        bool finished = true;
+
+        for(int task = 0; task < tasks; task++)
+        {
+            finished = finished && loggers[task].finished;
+        }
+
+        if(finished)
+        {
+            return true;
+        }
+
+        uint64_t due_us;
+
+        if(!eeprom.next_interrupt(due_us))
+        {
+            return false;
+        }
+
+        if(due_us > eeprom.now_us())
+        {
+            eeprom.advance_us(due_us - eeprom.now_us());
+        }
+
+        eeprom.run_interrupts();
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int tasks = DM_COROUTINE_MAX_TASKS;
+    int entries = 32;
+    int entry_bytes = 16;
+    int batch = 8;
+
+    for(int arg = 1; arg < argc; arg++)
+    {
+        if(strcmp(argv[arg], "--tasks") == 0 && arg + 1 < argc)
+        {
+            tasks = strtol(argv[++arg], NULL, 0);
+        }
+        else if(strcmp(argv[arg], "--entries") == 0 && arg + 1 < argc)
+        {
+            entries = strtol(argv[++arg], NULL, 0);
+        }
+        else if(strcmp(argv[arg], "--entry-bytes") == 0 && arg + 1 < argc)
+        {
+            entry_bytes = strtol(argv[++arg], NULL, 0);
+        }
+        else if(strcmp(argv[arg], "--batch") == 0 && arg + 1 < argc)
+        {
+            batch = strtol(argv[++arg], NULL, 0);
+        }
+        else
+        {
+            fprintf(stderr, "Unknown option %s\n", argv[arg]);
+            return 1;
+        }
+    }
+
+    if(tasks < 1 || tasks > DM_COROUTINE_MAX_TASKS || entries < 1 || entry_bytes < 1 || entry_bytes > PAGE_SIZE_BYTES ||
+       batch < 1 || batch > COROUTINE_MAX_BATCH)
+    {
+        fprintf(stderr, "--tasks must be from 1 to %d, --entries at least 1, --entry-bytes from 1 to %d and "
+                "--batch from 1 to %d\n", DM_COROUTINE_MAX_TASKS, PAGE_SIZE_BYTES, COROUTINE_MAX_BATCH);
+        return 1;
+    }
+
+    static DataManager_SimulatedEeprom eeprom;
+    DataManager_SimulatedEeprom::select(&eeprom);
+
+    DataManager data_manager(NC, NC, NC, 400000);
+
+    int status = data_manager.init_filesystem();
+
+    if(status == DataManager::DATA_MANAGER_OK)
+    {
+        status = data_manager.init_gstats();
+    }
+
+    /** Each logger owns a file with room for two rounds
+     */
+    for(int task = 0; task < tasks && status == DataManager::DATA_MANAGER_OK; task++)
+    {
+        DataManager_FileSystem::File_t definition;
+        memset(definition.data, 0, sizeof(definition));
+        definition.parameters.filename = task + 1;
+        definition.parameters.length_bytes = entry_bytes;
+
+        status = data_manager.add_file(definition, 2 * entries);
+    }
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        fprintf(stderr, "Setup failed with status %d; try fewer --tasks or --entries\n", status);
+        return 1;
+    }
+
+    std::vector<Logger_t> loggers(tasks);
+    DataManager_Coroutine::Scheduler scheduler(data_manager);
+
+    int failures = 0;
+    int mismatches = 0;
+    int overcommits = 0;
+    bool stalled = false;
+
+    printf("%-6s %8s %12s %12s %12s\n", "Round", "Tasks", "Operations", "Sim ms", "Cycles");
+
+    for(int round = 0; round < 2 && !stalled; round++)
+    {
+        uint64_t start_us = eeprom.now_us();
+        uint64_t start_write_cycles = eeprom.get_write_cycles();
+
+        for(int task = 0; task < tasks; task++)
+        {
+            Logger_t &logger = loggers[task];
+            memset(&logger, 0, sizeof(logger));
+            logger.filename = task + 1;
+            logger.entries = entries;
+            logger.entry_bytes = entry_bytes;
+            logger.batch = batch;
+            logger.round = round;
+
+            if(!scheduler.spawn(log_entries(scheduler, &logger)))
+            {
+                fprintf(stderr, "Round %d: coroutine %d was refused a frame\n", round, task);
+                logger.failures++;
+                logger.finished = true;
+            }
+        }
+
+        /** With every frame in use, another coroutine must not start
+         */
+        if(tasks == DM_COROUTINE_MAX_TASKS)
+        {
+            Logger_t extra;
+            memset(&extra, 0, sizeof(extra));
+            extra.finished = true;
+
+            if(scheduler.spawn(log_entries(scheduler, &extra)))
+            {
+                overcommits++;
+            }
+        }
+
+        stalled = !run_loggers(eeprom, scheduler, &loggers[0], tasks);
+
+        int operations = 0;
+
+        for(int task = 0; task < tasks; task++)
+        {
+            failures += loggers[task].failures;
+            mismatches += loggers[task].mismatches;
+            operations += loggers[task].appended + ((entries + batch - 1) / batch);
+        }
+
+        eeprom.wait_for_idle();
+
+        printf("%-6d %8d %12d %12.1f %12llu\n", round, tasks, operations, (eeprom.now_us() - start_us) / 1000.0,
+               (unsigned long long)(eeprom.get_write_cycles() - start_write_cycles));
+    }
+
+    /** Entries are checked once more with blocking reads, now that no
+     *  operation is in progress
+     */
+    for(int task = 0; task < tasks && !stalled; task++)
+    {
+        Logger_t &logger = loggers[task];
+
+        for(int index = 0; index < 2 * entries; index++)
+        {
+            logger.round = index / entries;
+            encode_entry(logger, index % entries, logger.expected);
+
+            if(data_manager.read_file_entry(logger.filename, index, logger.read, entry_bytes) != DataManager::DATA_MANAGER_OK ||
+               memcmp(logger.read, logger.expected, entry_bytes) != 0)
+            {
+                mismatches++;
+            }
+        }
+    }
+
+    printf("Workload:     %d coroutines of %d appends of %d bytes, read back %d at a time, twice\n", tasks, entries,
+           entry_bytes, batch);
+    printf("Failures:     %d operations failed%s\n", failures, stalled ? ", and the coroutines stalled" : "");
+    printf("Mismatches:   %d entries read back differently from the entry written\n", mismatches);
+    printf("Frame pool:   %d coroutines started with every frame in use\n", overcommits);
+
+    return (failures == 0 && mismatches == 0 && overcommits == 0 && !stalled) ? 0 : 2;
+}
@@ -0,0 +1,315 @@
+/**
+  * @file    dm_estimate.cpp
+  * @version 0.5.0
+  * @author  Adam Mitchell
+  * @brief   Command line tool that validates DataManager::estimate_cost() on a
+  *          simulated EEPROM. Sweeps the position of a file in the file table,
+  *          its entry length and how full it is, estimates each supported call,
+  *          makes the call and compares the estimate with the transfers, bus
+  *          bytes, write cycles and time actually spent. With the adaptive
+  *          clock or pipelined writes the DataManager polls write cycles itself,
+  *          and those polls, which the estimates exclude, are taken out of the
+  *          transfers and bus bytes spent.
+  *
+  *          Build:  g++ -O2 -std=c++11 -I. -I../.. -I../../filesystem ../../DataManager.cpp
+  *                  ../../DataManager_Async.cpp DataManager_SimulatedEeprom.cpp
+  *                  dm_estimate.cpp -o dm_estimate
+  *          Usage:  dm_estimate [--frequency HZ] [--entries E] [--pipelined] [--adaptive-clock]
+  *                              [--verbose]
+  *
+  *          Exits with 2 if any estimate of transfers, bus bytes, write cycles
+  *          or status differs from the call
+  */
+
+/** Includes
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "DataManager.h"
+#include "DataManager_SimulatedEeprom.h"
+
+/** Calls of the sweep
+ */
+enum EstimateCall
+{
+    ESTIMATE_FIND,
+    ESTIMATE_APPEND,
+    ESTIMATE_OVERWRITE,
+    ESTIMATE_READ_HEAD,
+    ESTIMATE_READ_TAIL,
+    ESTIMATE_TRUNCATE_ONE,
+    ESTIMATE_TRUNCATE_THIRD,
+    ESTIMATE_TRUNCATE_ALL,
+    ESTIMATE_DELETE,
+    ESTIMATE_CALLS
+};
+
+static const char *CALL_NAMES[ESTIMATE_CALLS] =
+{
+    "get_file_by_name", "append_file_entry", "overwrite_file_entries", "read 5 from start",
+    "read 3 from end", "truncate 1", "truncate 1/3", "truncate all", "delete_file_entries"
+};
+
+/** Agreement of the estimates of one call with the calls made
+ */
+struct CallStats_t
+{
+    uint32_t cases;
+    uint32_t count_mismatches;
+    uint32_t status_mismatches;
+    double abs_error_percent;
+    double max_error_percent;
+    uint64_t estimated_us;
+    uint64_t actual_us;
+};
+
+static char entry[PAGE_SIZE_BYTES];
+
+/** Make a call of the sweep
+ *
+ * @param &data_manager DataManager to call
+ * @param call The call
+ * @param filename ID of the file
+ * @param &params Arguments of the call, as given to estimate_cost()
+ * @return Status of the call
+ */
+static int make_call(DataManager &data_manager, int call, uint8_t filename, const DataManager::CostParams_t &params)
+{
+    DataManager_FileSystem::File_t file;
+
+    switch(call)
+    {
+        case ESTIMATE_FIND:           return data_manager.get_file_by_name(filename, file);
+        case ESTIMATE_APPEND:         return data_manager.append_file_entry(filename, entry, params.length);
+        case ESTIMATE_OVERWRITE:      return data_manager.overwrite_file_entries(filename, entry, params.length);
+        case ESTIMATE_DELETE:         return data_manager.delete_file_entries(filename);
+
+        case ESTIMATE_READ_HEAD:
+        case ESTIMATE_READ_TAIL:
+            for(int index = params.index; index < params.index + params.count; index++)
+            {
+                int status = data_manager.read_file_entry(filename, index, entry, params.length);
+
+                if(status != DataManager::DATA_MANAGER_OK)
+                {
+                    return status;
+                }
+            }
+            return DataManager::DATA_MANAGER_OK;
+
+        default:
+            return data_manager.truncate_file(filename, params.index);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int frequency_hz = 400000;
+    int entries = 24;
+    bool verbose = false;
+    bool pipelined = false;
+    bool adaptive_clock = false;
+
+    for(int arg = 1; arg < argc; arg++)
+    {
+        if(strcmp(argv[arg], "--verbose") == 0)
+        {
+            verbose = true;
+        }
+        else if(strcmp(argv[arg], "--pipelined") == 0)
+        {
+            pipelined = true;
+        }
+        else if(strcmp(argv[arg], "--adaptive-clock") == 0)
+        {
+            adaptive_clock = true;
+        }
+        else if(strcmp(argv[arg], "--frequency") == 0 && arg + 1 < argc)
+        {
+            frequency_hz = strtol(argv[++arg], NULL, 0);
+        }
+        else if(strcmp(argv[arg], "--entries") == 0 && arg + 1 < argc)
+        {
+            entries = strtol(argv[++arg], NULL, 0);
+        }
+        else
+        {
+            fprintf(stderr, "Unknown option %s\n", argv[arg]);
+            return 1;
+        }
+    }
+
+    static const int SLOTS[] = { 0, 3, 11 };
+    static const int ENTRY_BYTES[] = { 4, 10, 13, 64 };
+
+    static DataManager_SimulatedEeprom eeprom;
+    static uint8_t image[SIM_EEPROM_BYTES];
+    static CallStats_t stats[ESTIMATE_CALLS];
+    memset(stats, 0, sizeof(stats));
+    memset(entry, 0x5A, sizeof(entry));
+
+    DataManager_SimulatedEeprom::select(&eeprom);
+    DataManager data_manager(NC, NC, NC, frequency_hz);
+    data_manager.set_adaptive_clock(adaptive_clock);
+    data_manager.set_pipelined_writes(pipelined);
+
+    for(size_t slot = 0; slot < sizeof(SLOTS) / sizeof(SLOTS[0]); slot++)
+    {
+        for(size_t bytes = 0; bytes < sizeof(ENTRY_BYTES) / sizeof(ENTRY_BYTES[0]); bytes++)
+        {
+            int entry_bytes = ENTRY_BYTES[bytes];
+            int fills[] = { 0, 1, entries / 2, entries - 1, entries };
+
+            for(size_t fill = 0; fill < sizeof(fills) / sizeof(fills[0]); fill++)
+            {
+                /** The file under test is preceded by SLOTS[slot] small files
+                 */
+                eeprom.erase();
+
+                int status = data_manager.init_filesystem();
+
+                if(status == DataManager::DATA_MANAGER_OK)
+                {
+                    status = data_manager.init_gstats();
+                }
+
+                for(int file_index = 0; file_index <= SLOTS[slot] && status == DataManager::DATA_MANAGER_OK; file_index++)
+                {
+                    DataManager_FileSystem::File_t definition;
+                    memset(definition.data, 0, sizeof(definition));
+                    definition.parameters.filename = file_index + 1;
+                    definition.parameters.length_bytes = (file_index == SLOTS[slot]) ? entry_bytes : 1;
+
+                    status = data_manager.add_file(definition, (file_index == SLOTS[slot]) ? entries : 1);
+                }
+
+                uint8_t filename = SLOTS[slot] + 1;
+
+                for(int written = 0; written < fills[fill] && status == DataManager::DATA_MANAGER_OK; written++)
+                {
+                    status = data_manager.append_file_entry(filename, entry, entry_bytes);
+                }
+
+                if(status != DataManager::DATA_MANAGER_OK)
+                {
+                    fprintf(stderr, "Setup failed with status %d; try fewer --entries\n", status);
+                    return 1;
+                }
+
+                memcpy(image, eeprom.get_memory(), sizeof(image));
+
+                for(int call = 0; call < ESTIMATE_CALLS; call++)
+                {
+                    memcpy(eeprom.get_memory(), image, sizeof(image));
+
+                    DataManager::CostParams_t params = { 0, 1, entry_bytes };
+                    DataManager_FileSystem::TraceOp op = DataManager_FileSystem::TRACE_TRUNCATE_FILE;
+
+                    switch(call)
+                    {
+                        case ESTIMATE_FIND:           op = DataManager_FileSystem::TRACE_GET_FILE_BY_NAME; break;
+                        case ESTIMATE_APPEND:         op = DataManager_FileSystem::TRACE_APPEND_FILE_ENTRY; break;
+                        case ESTIMATE_OVERWRITE:      op = DataManager_FileSystem::TRACE_OVERWRITE_FILE_ENTRIES; break;
+                        case ESTIMATE_DELETE:         op = DataManager_FileSystem::TRACE_DELETE_FILE_ENTRIES; break;
+                        case ESTIMATE_READ_HEAD:      op = DataManager_FileSystem::TRACE_READ_FILE_ENTRY;
+                                                      params.count = fills[fill] < 5 ? fills[fill] : 5; break;
+                        case ESTIMATE_READ_TAIL:      op = DataManager_FileSystem::TRACE_READ_FILE_ENTRY;
+                                                      params.count = fills[fill] < 3 ? fills[fill] : 3;
+                                                      params.index = fills[fill] - params.count; break;
+                        case ESTIMATE_TRUNCATE_ONE:   params.index = 1; break;
+                        case ESTIMATE_TRUNCATE_THIRD: params.index = fills[fill] / 3; break;
+                        case ESTIMATE_TRUNCATE_ALL:   params.index = fills[fill]; break;
+                    }
+
+                    /** Reading nothing is not a call
+                     */
+                    if(op == DataManager_FileSystem::TRACE_READ_FILE_ENTRY && params.count == 0)
+                    {
+                        continue;
+                    }
+
+                    DataManager::CostEstimate_t estimate;
+                    int estimated_status = data_manager.estimate_cost(op, filename, params, estimate);
+
+                    DataManager::IoStats_t io_stats;
+                    data_manager.reset_io_stats();
+                    uint64_t start_us = eeprom.now_us();
+
+                    int actual_status = make_call(data_manager, call, filename, params);
+
+                    uint32_t actual_us = (uint32_t)(eeprom.now_us() - start_us);
+                    data_manager.get_io_stats(io_stats);
+
+                    CallStats_t &call_stats = stats[call];
+                    call_stats.cases++;
+                    call_stats.estimated_us += estimate.time_us;
+                    call_stats.actual_us += actual_us;
+
+                    uint32_t actual_transfers = io_stats.reads + io_stats.writes - io_stats.write_cycle_polls;
+                    uint32_t actual_bus_bytes = io_stats.bus_bytes - io_stats.write_cycle_poll_bytes;
+
+                    bool counts_match = estimate.transfers == actual_transfers &&
+                                        estimate.bus_bytes == actual_bus_bytes &&
+                                        estimate.write_cycles == io_stats.write_cycles;
+
+                    if(!counts_match)
+                    {
+                        call_stats.count_mismatches++;
+                    }
+
+                    if(estimated_status != actual_status)
+                    {
+                        call_stats.status_mismatches++;
+                    }
+
+                    double error_percent = actual_us ? (100.0 * ((double)estimate.time_us - actual_us)) / actual_us : 0.0;
+                    double abs_error_percent = error_percent < 0 ? -error_percent : error_percent;
+
+                    call_stats.abs_error_percent += abs_error_percent;
+
+                    if(abs_error_percent > call_stats.max_error_percent)
+                    {
+                        call_stats.max_error_percent = abs_error_percent;
+                    }
+
+                    if(verbose || !counts_match || estimated_status != actual_status)
+                    {
+                        printf("slot %2d, %2d byte entries, %2d written, %-24s estimated %4u transfers %6u bytes %3u cycles %7u us "
+                               "status %d; actual %4u %6u %3u %7u us status %d\n", SLOTS[slot], entry_bytes, fills[fill],
+                               CALL_NAMES[call], estimate.transfers, estimate.bus_bytes, estimate.write_cycles,
+                               estimate.time_us, estimated_status, actual_transfers, actual_bus_bytes,
+                               io_stats.write_cycles, actual_us, actual_status);
+                    }
+                }
+            }
+        }
+    }
+
+    DataManager::DeviceTiming_t timing;
+    data_manager.get_device_timing(timing);
+
+    printf("%-24s %6s %10s %10s %12s %12s %12s %12s\n", "Call", "Cases", "Counts", "Status",
+           "Estimate ms", "Actual ms", "Mean err %", "Max err %");
+
+    uint32_t mismatches = 0;
+
+    for(int call = 0; call < ESTIMATE_CALLS; call++)
+    {
+        const CallStats_t &call_stats = stats[call];
+
+        printf("%-24s %6u %10u %10u %12.1f %12.1f %12.2f %12.2f\n", CALL_NAMES[call], call_stats.cases,
+               call_stats.cases - call_stats.count_mismatches, call_stats.cases - call_stats.status_mismatches,
+               call_stats.estimated_us / 1000.0, call_stats.actual_us / 1000.0,
+               call_stats.cases ? call_stats.abs_error_percent / call_stats.cases : 0.0, call_stats.max_error_percent);
+
+        mismatches += call_stats.count_mismatches + call_stats.status_mismatches;
+    }
+
+    printf("Timing:       %u ns per bus byte, %u us per write cycle measured at %d Hz%s%s\n", timing.bus_byte_ns,
+           timing.write_cycle_us, frequency_hz, pipelined ? " with pipelined writes" : "",
+           adaptive_clock ? " with the adaptive clock" : "");
+    printf("Mismatches:   %u estimates differ from the call in transfers, bus bytes, write cycles or status\n", mismatches);
+
+    return mismatches == 0 ? 0 : 2;
+}
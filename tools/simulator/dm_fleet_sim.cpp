@@ -0,0 +1,220 @@
+/**
+  * @file    dm_fleet_sim.cpp
+  * @version 0.5.0
+  * @author  Adam Mitchell
+  * @brief   Command line tool that runs a node workload on a fleet of simulated
+  *          nodes, each an independent DataManager on its own simulated EEPROM,
+  *          spread across all cores by a work-stealing pool. Reports the wear,
+  *          capacity and latency of the fleet.
+  *
+  *          Build:  g++ -O2 -std=c++11 -pthread -I. -I../.. -I../../filesystem ../../DataManager.cpp
+  *                  ../../DataManager_Async.cpp DataManager_SimulatedEeprom.cpp
+  *                  DataManager_NodeWorkload.cpp dm_fleet_sim.cpp -o dm_fleet_sim
+  *          Usage:  dm_fleet_sim [--nodes N] [--days D] [--sensors S] [--entry-bytes B]
+  *                               [--entries E] [--wake-s T] [--uplink-s U]
+  *                               [--uplink-success-percent P] [--truncate-percent P]
+  *                               [--threads N]
+  */
+
+/** Includes
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "DataManager_NodeWorkload.h"
+
+/** Queue of node indices owned by one worker. The owner takes from the back,
+ *  idle workers steal from the front
+ */
+struct WorkQueue_t
+{
+    std::mutex lock;
+    std::deque<int> nodes;
+};
+
+/** Take the next node for a worker, stealing from the others when its own
+ *  queue is empty
+ *
+ * @param &queues Queues of all workers
+ * @param worker Index of the worker
+ * @param &node Address of integer value to which the node index should be stored
+ * @return True if a node was taken, false if all queues are empty
+ */
+static bool take_node(std::vector<WorkQueue_t> &queues, int worker, int &node)
+{
+    {
+        std::lock_guard<std::mutex> guard(queues[worker].lock);
+
+        if(!queues[worker].nodes.empty())
+        {
+            node = queues[worker].nodes.back();
+            queues[worker].nodes.pop_back();
+            return true;
+        }
+    }
+
+    for(size_t offset = 1; offset < queues.size(); offset++)
+    {
+        WorkQueue_t &victim = queues[(worker + offset) % queues.size()];
+        std::lock_guard<std::mutex> guard(victim.lock);
+
+        if(!victim.nodes.empty())
+        {
+            node = victim.nodes.front();
+            victim.nodes.pop_front();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+int main(int argc, char **argv)
+{
+    NodeWorkload_t workload;
+    workload.sensors = 4;
+    workload.wake_period_s = 900;
+    workload.wake_overhead_us = 0;
+    workload.uplink_period_s = 6 * 3600;
+    workload.uplink_success_percent = 100;
+    workload.truncate_percent = 25;
+
+    int entry_bytes = 8;
+    int entries_per_file = 700;
+
+    int nodes = 1000;
+    int days = 365;
+    int threads = std::thread::hardware_concurrency();
+
+    for(int arg = 1; arg + 1 < argc; arg += 2)
+    {
+        long value = strtol(argv[arg + 1], NULL, 0);
+
+        if(strcmp(argv[arg], "--nodes") == 0)                 nodes = value;
+        else if(strcmp(argv[arg], "--days") == 0)             days = value;
+        else if(strcmp(argv[arg], "--sensors") == 0)          workload.sensors = value;
+        else if(strcmp(argv[arg], "--entry-bytes") == 0)      entry_bytes = value;
+        else if(strcmp(argv[arg], "--entries") == 0)          entries_per_file = value;
+        else if(strcmp(argv[arg], "--wake-s") == 0)           workload.wake_period_s = value;
+        else if(strcmp(argv[arg], "--uplink-s") == 0)         workload.uplink_period_s = value;
+        else if(strcmp(argv[arg], "--uplink-success-percent") == 0) workload.uplink_success_percent = value;
+        else if(strcmp(argv[arg], "--truncate-percent") == 0) workload.truncate_percent = value;
+        else if(strcmp(argv[arg], "--threads") == 0)          threads = value;
+        else
+        {
+            fprintf(stderr, "Unknown option %s\n", argv[arg]);
+            return 1;
+        }
+    }
+
+    if(threads < 1)
+    {
+        threads = 1;
+    }
+
+    if(nodes < 1 || days < 1 || workload.wake_period_s == 0 || workload.uplink_period_s == 0)
+    {
+        fprintf(stderr, "--nodes, --days, --wake-s and --uplink-s must be positive\n");
+        return 1;
+    }
+
+    for(int sensor = 0; sensor < WORKLOAD_MAX_SENSORS; sensor++)
+    {
+        workload.entry_bytes[sensor] = entry_bytes;
+        workload.entries_per_file[sensor] = entries_per_file;
+    }
+
+    /** Deal the nodes out round-robin, then let idle workers steal
+     */
+    std::vector<WorkQueue_t> queues(threads);
+
+    for(int node = 0; node < nodes; node++)
+    {
+        queues[node % threads].nodes.push_back(node);
+    }
+
+    std::vector<NodeStats_t> totals(threads);
+    std::vector<int> failed_setups(threads, 0);
+    std::vector<std::thread> workers;
+
+    auto started = std::chrono::steady_clock::now();
+
+    for(int worker = 0; worker < threads; worker++)
+    {
+        memset(&totals[worker], 0, sizeof(NodeStats_t));
+
+        workers.push_back(std::thread([&, worker]()
+        {
+            int node;
+
+            while(take_node(queues, worker, node))
+            {
+                DataManager_NodeWorkload *simulated = new DataManager_NodeWorkload(workload, 0x9E3779B9u * (node + 1));
+
+                if(simulated->setup() != DataManager::DATA_MANAGER_OK)
+                {
+                    failed_setups[worker]++;
+                }
+                else
+                {
+                    simulated->run((uint64_t)days * 24 * 3600);
+
+                    NodeStats_t stats;
+                    simulated->get_stats(stats);
+                    DataManager_NodeWorkload::accumulate(totals[worker], stats);
+                }
+
+                delete simulated;
+            }
+        }));
+    }
+
+    for(size_t worker = 0; worker < workers.size(); worker++)
+    {
+        workers[worker].join();
+    }
+
+    double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    NodeStats_t fleet;
+    memset(&fleet, 0, sizeof(fleet));
+    int failed = 0;
+
+    for(int worker = 0; worker < threads; worker++)
+    {
+        DataManager_NodeWorkload::accumulate(fleet, totals[worker]);
+        failed += failed_setups[worker];
+    }
+
+    if(failed > 0)
+    {
+        fprintf(stderr, "%d nodes failed setup; the workload doesn't fit the EEPROM\n", failed);
+        return 1;
+    }
+
+    double years = days / 365.0;
+    double max_wear_per_year = fleet.max_page_writes / years;
+    double lifetime_years = DataManager_NodeWorkload::projected_lifetime_years(fleet.max_page_writes, days);
+
+    printf("Fleet:        %d nodes x %d days on %d threads in %.1f s (%.1f node-years/min)\n",
+           nodes, days, threads, wall_s, (nodes * years * 60.0) / wall_s);
+    printf("Activity:     %llu samples, %llu uplinks, %llu failed uplinks, %llu truncations, %llu errors\n",
+           (unsigned long long)fleet.samples, (unsigned long long)fleet.uplinks, (unsigned long long)fleet.failed_uplinks,
+           (unsigned long long)fleet.truncations, (unsigned long long)fleet.errors);
+    printf("Capacity:     %u of %d bytes of storage allocated per node\n", fleet.storage_bytes / nodes, STORAGE_LENGTH);
+    printf("Wear:         %.0f write cycles per node per day, worst page %u cycles (%.0f per year)\n",
+           fleet.write_cycles / (double)nodes / days, fleet.max_page_writes, max_wear_per_year);
+    printf("Lifetime:     %.1f years until the worst page reaches %d cycles\n", lifetime_years, SIM_ENDURANCE_CYCLES);
+    printf("Bus:          %.0f bytes per node per day\n", fleet.bus_bytes / (double)nodes / days);
+    printf("Latency:      mean %.0f us, p50 < %u us, p99 < %u us, max %u us\n",
+           fleet.calls ? fleet.busy_us / (double)fleet.calls : 0.0,
+           DataManager_NodeWorkload::latency_percentile_us(fleet, 50),
+           DataManager_NodeWorkload::latency_percentile_us(fleet, 99), fleet.max_call_us);
+
+    return 0;
+}
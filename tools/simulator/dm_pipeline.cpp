@@ -0,0 +1,250 @@
+/**
+  * @file    dm_pipeline.cpp
+  * @version 0.5.0
+  * @author  Adam Mitchell
+  * @brief   Command line tool that measures how much of the CPU work of a
+  *          logging node overlaps the EEPROM's write cycles. Each page of
+  *          samples is encoded, checksummed and compressed and then appended,
+  *          in batches of pages made by a transaction, once with blocking writes
+  *          and once with pipelined writes, for a sweep of CPU time per page.
+  *          The simulator has no model of the MCU, so the CPU time of a page is
+  *          charged to the simulated clock while the host does the work.
+  *
+  *          Build:  g++ -O2 -std=c++11 -I. -I../.. -I../../filesystem ../../DataManager.cpp
+  *                  ../../DataManager_Async.cpp DataManager_SimulatedEeprom.cpp
+  *                  dm_pipeline.cpp -o dm_pipeline
+  *          Usage:  dm_pipeline [--pages N] [--batch B] [--cpu-us C] [--frequency HZ]
+  *                              [--adaptive-clock]
+  *
+  *          With --cpu-us only that CPU time per page is run. Exits with 2 if
+  *          any page reads back differently from the page written
+  */
+
+/** Includes
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "DataManager.h"
+#include "DataManager_SimulatedEeprom.h"
+
+/** Bytes of a page given to the samples; the rest holds their checksum
+ */
+#define PIPELINE_SAMPLE_BYTES (PAGE_SIZE_BYTES - 4)
+
+/** Outcome of one run of the workload
+ */
+struct PipelineRun_t
+{
+    int status;
+    uint64_t total_us;
+    uint64_t write_cycles;
+    int mismatches;
+};
+
+/** Encode, checksum and compress a page of samples, as a node does before
+ *  storing them. The compressed length is only used to keep the work live
+ *
+ * @param page Index of the page
+ * @param *entry Buffer of PAGE_SIZE_BYTES to which the page is written
+ * @return Compressed length of the samples
+ */
+static int encode_page(int page, char *entry)
+{
+    /** A slowly varying 16-bit reading with some noise
+     */
+    for(int sample = 0; sample < PIPELINE_SAMPLE_BYTES / 2; sample++)
+    {
+        int reading = 2048 + ((page * 7 + sample) % 64) + (((page * 31 + sample * 17) % 5) - 2);
+        entry[2 * sample] = (char)(reading >> 8);
+        entry[(2 * sample) + 1] = (char)(reading & 0xFF);
+    }
+
+    uint32_t checksum = DataManager_FileSystem::image_checksum(DataManager_FileSystem::IMAGE_CHECKSUM_SEED, entry,
+                                                               PIPELINE_SAMPLE_BYTES);
+    memcpy(&entry[PIPELINE_SAMPLE_BYTES], &checksum, sizeof(checksum));
+
+    char compressed[PAGE_SIZE_BYTES];
+
+    return DataManager_FileSystem::lz_compress(entry, PIPELINE_SAMPLE_BYTES, compressed, sizeof(compressed));
+}
+
+/** Log the pages of the workload, a batch per transaction, and read them back
+ *
+ * @param &eeprom The simulated EEPROM
+ * @param &data_manager DataManager to call
+ * @param pages Number of pages
+ * @param batch Number of pages per transaction
+ * @param cpu_us CPU time charged per page
+ * @param &run Address of PipelineRun_t to which the outcome will be written
+ */
+static void run_workload(DataManager_SimulatedEeprom &eeprom, DataManager &data_manager, int pages, int batch,
+                         int cpu_us, PipelineRun_t &run)
+{
+    memset(&run, 0, sizeof(run));
+
+    char entry[PAGE_SIZE_BYTES];
+    char read[PAGE_SIZE_BYTES];
+
+    uint64_t start_us = eeprom.now_us();
+    uint64_t start_write_cycles = eeprom.get_write_cycles();
+
+    for(int page = 0; page < pages && run.status == DataManager::DATA_MANAGER_OK; page += batch)
+    {
+        run.status = data_manager.begin();
+
+        for(int member = 0; member < batch && page + member < pages && run.status == DataManager::DATA_MANAGER_OK; member++)
+        {
+            volatile int compressed_length = encode_page(page + member, entry);
+            (void)compressed_length;
+            eeprom.advance_us(cpu_us);
+
+            run.status = data_manager.append_file_entry(1, entry, PAGE_SIZE_BYTES);
+        }
+
+        if(run.status == DataManager::DATA_MANAGER_OK)
+        {
+            run.status = data_manager.commit();
+        }
+    }
+
+    /** The last write cycle is part of the cost whether or not it was waited for
+     */
+    eeprom.wait_for_idle();
+
+    run.total_us = eeprom.now_us() - start_us;
+    run.write_cycles = eeprom.get_write_cycles() - start_write_cycles;
+
+    for(int page = 0; page < pages && run.status == DataManager::DATA_MANAGER_OK; page++)
+    {
+        encode_page(page, entry);
+
+        if(data_manager.read_file_entry(1, page, read, PAGE_SIZE_BYTES) != DataManager::DATA_MANAGER_OK ||
+           memcmp(read, entry, PAGE_SIZE_BYTES) != 0)
+        {
+            run.mismatches++;
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int pages = 64;
+    int batch = 8;
+    int single_cpu_us = -1;
+    int frequency_hz = 400000;
+    bool adaptive_clock = false;
+
+    for(int arg = 1; arg < argc; arg++)
+    {
+        if(strcmp(argv[arg], "--adaptive-clock") == 0)
+        {
+            adaptive_clock = true;
+        }
+        else if(strcmp(argv[arg], "--pages") == 0 && arg + 1 < argc)
+        {
+            pages = strtol(argv[++arg], NULL, 0);
+        }
+        else if(strcmp(argv[arg], "--batch") == 0 && arg + 1 < argc)
+        {
+            batch = strtol(argv[++arg], NULL, 0);
+        }
+        else if(strcmp(argv[arg], "--cpu-us") == 0 && arg + 1 < argc)
+        {
+            single_cpu_us = strtol(argv[++arg], NULL, 0);
+        }
+        else if(strcmp(argv[arg], "--frequency") == 0 && arg + 1 < argc)
+        {
+            frequency_hz = strtol(argv[++arg], NULL, 0);
+        }
+        else
+        {
+            fprintf(stderr, "Unknown option %s\n", argv[arg]);
+            return 1;
+        }
+    }
+
+    if(pages < 1 || batch < 1)
+    {
+        fprintf(stderr, "--pages and --batch must be at least 1\n");
+        return 1;
+    }
+
+    static const int CPU_US[] = { 0, 1000, 2500, 4000, 5000, 7500, 10000 };
+    int sweep = (single_cpu_us >= 0) ? 1 : sizeof(CPU_US) / sizeof(CPU_US[0]);
+
+    static DataManager_SimulatedEeprom eeprom;
+    DataManager_SimulatedEeprom::select(&eeprom);
+
+    printf("%-10s %8s %10s %12s %12s %12s %12s\n", "CPU us", "Cycles", "Bus ms", "Blocking ms", "Pipelined ms",
+           "Floor ms", "Pipe / floor");
+
+    int mismatches = 0;
+
+    for(int point = 0; point < sweep; point++)
+    {
+        int cpu_us = (single_cpu_us >= 0) ? single_cpu_us : CPU_US[point];
+        PipelineRun_t runs[2];
+
+        for(int pipelined = 0; pipelined < 2; pipelined++)
+        {
+            eeprom.erase();
+
+            DataManager data_manager(NC, NC, NC, frequency_hz);
+            data_manager.set_adaptive_clock(adaptive_clock);
+            data_manager.set_pipelined_writes(pipelined == 1);
+
+            DataManager_FileSystem::File_t definition;
+            memset(definition.data, 0, sizeof(definition));
+            definition.parameters.filename = 1;
+            definition.parameters.length_bytes = PAGE_SIZE_BYTES;
+
+            int status = data_manager.init_filesystem();
+
+            if(status == DataManager::DATA_MANAGER_OK)
+            {
+                status = data_manager.init_gstats();
+            }
+
+            if(status == DataManager::DATA_MANAGER_OK)
+            {
+                status = data_manager.add_file(definition, pages);
+            }
+
+            if(status != DataManager::DATA_MANAGER_OK)
+            {
+                fprintf(stderr, "Setup failed with status %d; try fewer --pages\n", status);
+                return 1;
+            }
+
+            run_workload(eeprom, data_manager, pages, batch, cpu_us, runs[pipelined]);
+
+            if(runs[pipelined].status != DataManager::DATA_MANAGER_OK)
+            {
+                fprintf(stderr, "Workload failed with status %d at %d us of CPU per page\n", runs[pipelined].status, cpu_us);
+                return 1;
+            }
+
+            mismatches += runs[pipelined].mismatches;
+        }
+
+        /** Blocking writes take the sum of the CPU time, the write cycles and
+         *  the rest, i.e. bus transfers. Only the CPU time and write cycles can
+         *  overlap, so no schedule can beat the larger of them plus the rest
+         */
+        int64_t cpu_total_us = (int64_t)cpu_us * pages;
+        int64_t cycle_total_us = runs[0].write_cycles * SIM_WRITE_CYCLE_US;
+        int64_t bus_us = (int64_t)runs[0].total_us - cpu_total_us - cycle_total_us;
+        int64_t floor_us = bus_us + ((cpu_total_us > cycle_total_us) ? cpu_total_us : cycle_total_us);
+
+        printf("%-10d %8llu %10.1f %12.1f %12.1f %12.1f %12.2f\n", cpu_us, (unsigned long long)runs[0].write_cycles,
+               bus_us / 1000.0, runs[0].total_us / 1000.0, runs[1].total_us / 1000.0, floor_us / 1000.0,
+               (double)runs[1].total_us / floor_us);
+    }
+
+    printf("Workload:     %d pages of %d bytes in transactions of %d pages at %d Hz%s\n", pages, PAGE_SIZE_BYTES, batch,
+           frequency_hz, adaptive_clock ? " with the adaptive clock" : "");
+    printf("Mismatches:   %d pages read back differently from the page written\n", mismatches);
+
+    return mismatches == 0 ? 0 : 2;
+}
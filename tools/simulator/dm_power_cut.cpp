@@ -0,0 +1,272 @@
+/**
+  * @file    dm_power_cut.cpp
+  * @version 0.5.0
+  * @author  Adam Mitchell
+  * @brief   Command line tool that cuts power at every write cycle, or every byte
+  *          of every write cycle, of a scripted workload, remounts the filesystem
+  *          after each cut and checks it against a reference model. Cuts are run
+  *          in parallel across all cores. Reports the violations found and the
+  *          time and write cycles spent remounting.
+  *
+  *          Build:  g++ -O2 -std=c++11 -pthread -I. -I../.. -I../../filesystem ../../DataManager.cpp
+  *                  ../../DataManager_Async.cpp DataManager_SimulatedEeprom.cpp
+  *                  DataManager_PowerCut.cpp dm_power_cut.cpp -o dm_power_cut
+  *          Usage:  dm_power_cut [--files F] [--entry-bytes B] [--entries E] [--operations N]
+  *                               [--truncate-percent P] [--transaction-percent P] [--seed S]
+  *                               [--granularity page|byte] [--threads N] [--cut CYCLE BYTES]
+  *                               [--budget-cycles C]
+  *
+  *          With --cut only the given cut is run, e.g. to debug a violation. With
+  *          --budget-cycles truncations are resumable, run C write cycles per call
+  *          and resumed by the remount
+  */
+
+/** Includes
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "DataManager_PowerCut.h"
+
+/** Number of violations listed individually
+ */
+#define LISTED_VIOLATIONS 10
+
+static const char *VIOLATION_NAMES[POWER_CUT_VIOLATIONS] =
+{
+    "consistent", "mount failed", "file lost", "entry count", "entry content"
+};
+
+static const char *OPERATION_NAMES[] =
+{
+    "append", "truncate", "transaction"
+};
+
+/** Cut point of the sweep
+ */
+struct CutPoint_t
+{
+    uint64_t write_cycle;
+    int bytes_landed;
+};
+
+/** Outcome of the cuts run by one worker
+ */
+struct SweepStats_t
+{
+    uint64_t runs;
+    uint64_t violations[POWER_CUT_VIOLATIONS];
+    uint64_t repairs;
+    uint64_t mount_us;
+    uint32_t max_mount_us;
+    uint32_t max_mount_write_cycles;
+    std::vector<PowerCutResult_t> listed;
+};
+
+static bool earlier_cut(const PowerCutResult_t &a, const PowerCutResult_t &b)
+{
+    return a.write_cycle < b.write_cycle || (a.write_cycle == b.write_cycle && a.bytes_landed < b.bytes_landed);
+}
+
+int main(int argc, char **argv)
+{
+    PowerCutWorkload_t workload;
+    workload.files = 4;
+    workload.entry_bytes = 10;
+    workload.entries_per_file = 40;
+    workload.operations = 100;
+    workload.truncate_percent = 10;
+    workload.transaction_percent = 20;
+    workload.budget_write_cycles = 0;
+    workload.seed = 1;
+
+    bool byte_granularity = false;
+    int threads = std::thread::hardware_concurrency();
+    bool single_cut = false;
+    CutPoint_t cut = { 0, 0 };
+
+    for(int arg = 1; arg + 1 < argc; arg += 2)
+    {
+        const char *value = argv[arg + 1];
+
+        if(strcmp(argv[arg], "--files") == 0)                    workload.files = strtol(value, NULL, 0);
+        else if(strcmp(argv[arg], "--entry-bytes") == 0)         workload.entry_bytes = strtol(value, NULL, 0);
+        else if(strcmp(argv[arg], "--entries") == 0)             workload.entries_per_file = strtol(value, NULL, 0);
+        else if(strcmp(argv[arg], "--operations") == 0)          workload.operations = strtol(value, NULL, 0);
+        else if(strcmp(argv[arg], "--truncate-percent") == 0)    workload.truncate_percent = strtol(value, NULL, 0);
+        else if(strcmp(argv[arg], "--transaction-percent") == 0) workload.transaction_percent = strtol(value, NULL, 0);
+        else if(strcmp(argv[arg], "--seed") == 0)                workload.seed = strtoul(value, NULL, 0);
+        else if(strcmp(argv[arg], "--budget-cycles") == 0)       workload.budget_write_cycles = strtoul(value, NULL, 0);
+        else if(strcmp(argv[arg], "--threads") == 0)             threads = strtol(value, NULL, 0);
+        else if(strcmp(argv[arg], "--granularity") == 0)         byte_granularity = strcmp(value, "byte") == 0;
+        else if(strcmp(argv[arg], "--cut") == 0 && arg + 2 < argc)
+        {
+            single_cut = true;
+            cut.write_cycle = strtoull(value, NULL, 0);
+            cut.bytes_landed = strtol(argv[arg + 2], NULL, 0);
+            arg++;
+        }
+        else
+        {
+            fprintf(stderr, "Unknown option %s\n", argv[arg]);
+            return 1;
+        }
+    }
+
+    if(threads < 1)
+    {
+        threads = 1;
+    }
+
+    /** Enumerate the cut points from an uncut run of the workload
+     */
+    DataManager_PowerCut reference(workload);
+    std::vector<uint8_t> write_lengths;
+
+    if(reference.format() != DataManager::DATA_MANAGER_OK)
+    {
+        fprintf(stderr, "Formatting failed; check the files fit the EEPROM\n");
+        return 1;
+    }
+
+    int status = reference.reference(write_lengths);
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        fprintf(stderr, "The workload fails with status %d without a power cut\n", status);
+        return 1;
+    }
+
+    std::vector<CutPoint_t> cuts;
+
+    if(single_cut)
+    {
+        cuts.push_back(cut);
+    }
+    else
+    {
+        for(size_t write_cycle = 0; write_cycle < write_lengths.size(); write_cycle++)
+        {
+            int points = byte_granularity ? write_lengths[write_cycle] : 1;
+
+            for(int bytes_landed = 0; bytes_landed < points; bytes_landed++)
+            {
+                CutPoint_t point = { write_cycle, bytes_landed };
+                cuts.push_back(point);
+            }
+        }
+    }
+
+    std::atomic<size_t> next_cut(0);
+    std::vector<SweepStats_t> totals(threads);
+    std::vector<std::thread> workers;
+
+    auto started = std::chrono::steady_clock::now();
+
+    for(int worker = 0; worker < threads; worker++)
+    {
+        workers.push_back(std::thread([&, worker]()
+        {
+            SweepStats_t &stats = totals[worker];
+            stats.runs = 0;
+            stats.repairs = 0;
+            stats.mount_us = 0;
+            stats.max_mount_us = 0;
+            stats.max_mount_write_cycles = 0;
+            memset(stats.violations, 0, sizeof(stats.violations));
+
+            DataManager_PowerCut *harness = new DataManager_PowerCut(workload);
+            harness->format();
+
+            for(size_t index = next_cut++; index < cuts.size(); index = next_cut++)
+            {
+                PowerCutResult_t result;
+                harness->run(cuts[index].write_cycle, cuts[index].bytes_landed, result);
+
+                stats.runs++;
+                stats.violations[result.violation]++;
+                stats.mount_us += result.mount_us;
+                stats.max_mount_us = std::max(stats.max_mount_us, result.mount_us);
+                stats.max_mount_write_cycles = std::max(stats.max_mount_write_cycles, result.mount_write_cycles);
+
+                if(result.mount_write_cycles > 0)
+                {
+                    stats.repairs++;
+                }
+
+                if(result.violation != POWER_CUT_CONSISTENT && stats.listed.size() < LISTED_VIOLATIONS)
+                {
+                    stats.listed.push_back(result);
+                }
+            }
+
+            delete harness;
+        }));
+    }
+
+    for(size_t worker = 0; worker < workers.size(); worker++)
+    {
+        workers[worker].join();
+    }
+
+    double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    SweepStats_t sweep;
+    sweep.runs = 0;
+    sweep.repairs = 0;
+    sweep.mount_us = 0;
+    sweep.max_mount_us = 0;
+    sweep.max_mount_write_cycles = 0;
+    memset(sweep.violations, 0, sizeof(sweep.violations));
+
+    for(int worker = 0; worker < threads; worker++)
+    {
+        sweep.runs += totals[worker].runs;
+        sweep.repairs += totals[worker].repairs;
+        sweep.mount_us += totals[worker].mount_us;
+        sweep.max_mount_us = std::max(sweep.max_mount_us, totals[worker].max_mount_us);
+        sweep.max_mount_write_cycles = std::max(sweep.max_mount_write_cycles, totals[worker].max_mount_write_cycles);
+        sweep.listed.insert(sweep.listed.end(), totals[worker].listed.begin(), totals[worker].listed.end());
+
+        for(int violation = 0; violation < POWER_CUT_VIOLATIONS; violation++)
+        {
+            sweep.violations[violation] += totals[worker].violations[violation];
+        }
+    }
+
+    std::sort(sweep.listed.begin(), sweep.listed.end(), earlier_cut);
+
+    uint64_t violations = sweep.runs - sweep.violations[POWER_CUT_CONSISTENT];
+
+    printf("Workload:     %d files of %d x %d bytes, %d operations, %zu write cycles\n", workload.files,
+           workload.entries_per_file, workload.entry_bytes, workload.operations, write_lengths.size());
+    printf("Sweep:        %llu cuts at %s granularity on %d threads in %.1f s\n", (unsigned long long)sweep.runs,
+           byte_granularity ? "byte" : "page", threads, wall_s);
+    printf("Mount:        mean %.0f us, max %u us; %llu cuts needed repair writes, at most %u write cycles\n",
+           sweep.runs ? sweep.mount_us / (double)sweep.runs : 0.0, sweep.max_mount_us,
+           (unsigned long long)sweep.repairs, sweep.max_mount_write_cycles);
+    printf("Violations:   %llu", (unsigned long long)violations);
+
+    for(int violation = 1; violation < POWER_CUT_VIOLATIONS; violation++)
+    {
+        printf(", %llu %s", (unsigned long long)sweep.violations[violation], VIOLATION_NAMES[violation]);
+    }
+
+    printf("\n");
+
+    for(size_t listed = 0; listed < sweep.listed.size() && listed < LISTED_VIOLATIONS; listed++)
+    {
+        const PowerCutResult_t &result = sweep.listed[listed];
+
+        printf("  --cut %llu %d: %s of file %d after cutting operation %d (%s)\n",
+               (unsigned long long)result.write_cycle, result.bytes_landed, VIOLATION_NAMES[result.violation],
+               result.violation_file, result.operation, OPERATION_NAMES[result.operation_kind]);
+    }
+
+    return violations == 0 ? 0 : 2;
+}
@@ -0,0 +1,317 @@
+/**
+  * @file    dm_replay.cpp
+  * @version 0.5.0
+  * @author  Adam Mitchell
+  * @brief   Command line tool that replays a trace of DataManager calls, as printed
+  *          over UART by DataManager::dump_trace(), through the real DataManager on
+  *          a simulated EEPROM and reports the simulated time of each call type
+  *          next to the time measured in the field.
+  *
+  *          Build:  g++ -O2 -std=c++11 -I. -I../.. -I../../filesystem ../../DataManager.cpp
+  *                  ../../DataManager_Async.cpp DataManager_SimulatedEeprom.cpp
+  *                  dm_replay.cpp -o dm_replay
+  *          Usage:  dm_replay <log> [--image FILE] [--frequency HZ] [--adaptive-clock]
+  *
+  *          The log may contain any other output; only lines containing a
+  *          TRACE_LINE_PREFIX record are used. The EEPROM starts erased unless an
+  *          image of its contents when the trace began is given, e.g. one made by
+  *          dm_image_builder. Entry contents aren't traced, so replayed writes use
+  *          pseudo-random data. Calls whose arguments can't be rebuilt from a
+  *          record, i.e. those taking a record or packed schema and image transfers,
+  *          are counted but skipped
+  */
+
+/** Includes
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "DataManager.h"
+#include "DataManager_SimulatedEeprom.h"
+
+/** Longest entry or buffer length a trace record can describe
+ */
+#define REPLAY_MAX_LENGTH 0x10000
+
+/** Per call type outcome of the replay
+ */
+struct OpStats_t
+{
+    uint32_t calls;
+    uint32_t replayed;
+    uint32_t mismatches;
+    uint64_t total_us;
+    uint32_t max_us;
+    uint8_t field_max_log2_us;
+};
+
+static char buffer[REPLAY_MAX_LENGTH];
+static uint32_t random_state = 1;
+
+/** Fill the buffer with the pseudo-random contents of a replayed write
+ *
+ * @param length Number of bytes to fill
+ */
+static void fill_buffer(int length)
+{
+    for(int byte = 0; byte < length; byte++)
+    {
+        random_state ^= random_state << 13;
+        random_state ^= random_state >> 17;
+        random_state ^= random_state << 5;
+        buffer[byte] = (char)random_state;
+    }
+}
+
+/** Parse a trace record from a line of the log
+ *
+ * @param *line Line of the log
+ * @param &record Address of TraceRecord_t to which the record will be written
+ * @return True if the line holds a record
+ */
+static bool parse_record(const char *line, DataManager_FileSystem::TraceRecord_t &record)
+{
+    const char *hex = strstr(line, DataManager_FileSystem::TRACE_LINE_PREFIX);
+
+    if(hex == NULL)
+    {
+        return false;
+    }
+
+    hex += strlen(DataManager_FileSystem::TRACE_LINE_PREFIX);
+
+    for(size_t byte = 0; byte < sizeof(record); byte++)
+    {
+        unsigned int value;
+
+        if(sscanf(hex + 1 + (2 * byte), "%2x", &value) != 1)
+        {
+            return false;
+        }
+
+        record.data[byte] = (char)value;
+    }
+
+    return record.parameters.op > 0 && record.parameters.op < DataManager_FileSystem::TRACE_OPS;
+}
+
+/** Make the call described by a trace record
+ *
+ * @param &data_manager DataManager to call
+ * @param &record The call to make
+ * @param &replayed Address of boolean to which whether the call could be made will be written
+ * @return Status returned by the call
+ */
+static int replay(DataManager &data_manager, const DataManager_FileSystem::TraceRecord_t &record, bool &replayed)
+{
+    uint8_t filename = record.parameters.filename;
+    int index = record.parameters.index;
+    int length = record.parameters.length;
+    int value = 0;
+    bool flag = false;
+    DataManager_FileSystem::File_t file;
+
+    replayed = true;
+
+    switch(record.parameters.op)
+    {
+        case DataManager_FileSystem::TRACE_INIT_FILESYSTEM:            return data_manager.init_filesystem();
+        case DataManager_FileSystem::TRACE_INIT_GSTATS:                return data_manager.init_gstats();
+        case DataManager_FileSystem::TRACE_IS_INITIALISED:             return data_manager.is_initialised(flag);
+        case DataManager_FileSystem::TRACE_GET_GLOBAL_STATS:           return data_manager.get_global_stats(buffer);
+        case DataManager_FileSystem::TRACE_GET_FILE_BY_NAME:           return data_manager.get_file_by_name(filename, file);
+        case DataManager_FileSystem::TRACE_TOTAL_STORED_FILES:         return data_manager.total_stored_files(value);
+        case DataManager_FileSystem::TRACE_TOTAL_REMAINING_FILE_TABLE: return data_manager.total_remaining_file_table_entries(value);
+        case DataManager_FileSystem::TRACE_READ_FILE_ENTRY:            return data_manager.read_file_entry(filename, index, buffer, length);
+        case DataManager_FileSystem::TRACE_DELETE_FILE_ENTRIES:        return data_manager.delete_file_entries(filename);
+        case DataManager_FileSystem::TRACE_TRUNCATE_FILE:              return data_manager.truncate_file(filename, index);
+        case DataManager_FileSystem::TRACE_GET_TOTAL_WRITTEN_ENTRIES:  return data_manager.get_total_written_file_entries(filename, value);
+        case DataManager_FileSystem::TRACE_GET_REMAINING_ENTRIES:      return data_manager.get_remaining_file_entries(filename, value);
+        case DataManager_FileSystem::TRACE_GET_REMAINING_ENTRIES_BYTES: return data_manager.get_remaining_file_entries_bytes(filename, value);
+        case DataManager_FileSystem::TRACE_ADD_RLE_FILE:               return data_manager.add_rle_file(filename, length, index);
+        case DataManager_FileSystem::TRACE_FLUSH_RLE_FILE:             return data_manager.flush_rle_file(filename);
+        case DataManager_FileSystem::TRACE_READ_RLE_ENTRY:             return data_manager.read_rle_entry(filename, index, buffer, length);
+        case DataManager_FileSystem::TRACE_GET_TOTAL_RLE_ENTRIES:      return data_manager.get_total_rle_entries(filename, value);
+        case DataManager_FileSystem::TRACE_ADD_ARCHIVE_FILE:           return data_manager.add_archive_file(filename, length);
+        case DataManager_FileSystem::TRACE_COMPRESS_SEALED_PAGES:      return data_manager.compress_sealed_pages(filename, index);
+        case DataManager_FileSystem::TRACE_READ_ARCHIVED_ENTRY:        return data_manager.read_archived_entry(filename, index, buffer, length);
+        case DataManager_FileSystem::TRACE_GET_TOTAL_ARCHIVED_ENTRIES: return data_manager.get_total_archived_entries(filename, length, value);
+        case DataManager_FileSystem::TRACE_BEGIN:                      return data_manager.begin();
+        case DataManager_FileSystem::TRACE_COMMIT:                     return data_manager.commit();
+        case DataManager_FileSystem::TRACE_ROLLBACK:                   return data_manager.rollback();
+        case DataManager_FileSystem::TRACE_RECOVER_TRANSACTION:        return data_manager.recover_transaction();
+        case DataManager_FileSystem::TRACE_GET_IMAGE_PAGES:            return data_manager.get_image_pages(value);
+
+        case DataManager_FileSystem::TRACE_RESUME_OPERATION:
+            {
+                DataManager::OperationBudget_t budget = { 0, 0 };
+                return data_manager.resume_operation(budget);
+            }
+
+        case DataManager_FileSystem::TRACE_ADD_FILE:
+            memset(file.data, 0, sizeof(file));
+            file.parameters.filename = filename;
+            file.parameters.length_bytes = length;
+            return data_manager.add_file(file, index);
+
+        case DataManager_FileSystem::TRACE_APPEND_FILE_ENTRY:
+            fill_buffer(length);
+            return data_manager.append_file_entry(filename, buffer, length);
+
+        case DataManager_FileSystem::TRACE_OVERWRITE_FILE_ENTRIES:
+            fill_buffer(length);
+            return data_manager.overwrite_file_entries(filename, buffer, length);
+
+        case DataManager_FileSystem::TRACE_APPEND_RLE_ENTRY:
+            fill_buffer(length);
+            return data_manager.append_rle_entry(filename, buffer, length);
+
+        default:
+            replayed = false;
+            return DataManager::DATA_MANAGER_OK;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if(argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <log> [--image FILE] [--frequency HZ] [--adaptive-clock]\n", argv[0]);
+        return 1;
+    }
+
+    const char *image = NULL;
+    int frequency_hz = 400000;
+    bool adaptive_clock = false;
+
+    for(int arg = 2; arg < argc; arg++)
+    {
+        if(strcmp(argv[arg], "--adaptive-clock") == 0)
+        {
+            adaptive_clock = true;
+        }
+        else if(strcmp(argv[arg], "--image") == 0 && arg + 1 < argc)
+        {
+            image = argv[++arg];
+        }
+        else if(strcmp(argv[arg], "--frequency") == 0 && arg + 1 < argc)
+        {
+            frequency_hz = strtol(argv[++arg], NULL, 0);
+        }
+        else
+        {
+            fprintf(stderr, "Unknown option %s\n", argv[arg]);
+            return 1;
+        }
+    }
+
+    FILE *log = fopen(argv[1], "r");
+
+    if(log == NULL)
+    {
+        fprintf(stderr, "Unable to open log %s\n", argv[1]);
+        return 1;
+    }
+
+    static DataManager_SimulatedEeprom eeprom;
+    DataManager_SimulatedEeprom::select(&eeprom);
+
+    if(image != NULL)
+    {
+        FILE *contents = fopen(image, "rb");
+
+        if(contents == NULL || fread(eeprom.get_memory(), 1, SIM_EEPROM_BYTES, contents) != SIM_EEPROM_BYTES)
+        {
+            fprintf(stderr, "Unable to read a %d byte image from %s\n", SIM_EEPROM_BYTES, image);
+            fclose(log);
+            return 1;
+        }
+
+        fclose(contents);
+    }
+
+    static DataManager data_manager(NC, NC, NC, frequency_hz);
+    data_manager.set_adaptive_clock(adaptive_clock);
+
+    static OpStats_t stats[DataManager_FileSystem::TRACE_OPS];
+    memset(stats, 0, sizeof(stats));
+
+    char line[256];
+    uint32_t calls = 0;
+    uint32_t mismatches = 0;
+    uint64_t total_us = 0;
+
+    while(fgets(line, sizeof(line), log) != NULL)
+    {
+        DataManager_FileSystem::TraceRecord_t record;
+
+        if(!parse_record(line, record))
+        {
+            continue;
+        }
+
+        OpStats_t &op = stats[record.parameters.op];
+        op.calls++;
+        calls++;
+
+        if(record.parameters.elapsed_log2_us > op.field_max_log2_us)
+        {
+            op.field_max_log2_us = record.parameters.elapsed_log2_us;
+        }
+
+        bool replayed;
+        uint64_t start_us = eeprom.now_us();
+        int status = replay(data_manager, record, replayed);
+        uint32_t elapsed_us = (uint32_t)(eeprom.now_us() - start_us);
+
+        if(!replayed)
+        {
+            continue;
+        }
+
+        int result = status < -128 ? -128 : (status > 127 ? 127 : status);
+
+        op.replayed++;
+        op.total_us += elapsed_us;
+        total_us += elapsed_us;
+
+        if(elapsed_us > op.max_us)
+        {
+            op.max_us = elapsed_us;
+        }
+
+        if(result != record.parameters.result)
+        {
+            op.mismatches++;
+            mismatches++;
+        }
+    }
+
+    fclose(log);
+
+    if(calls == 0)
+    {
+        fprintf(stderr, "No %s records found in %s\n", DataManager_FileSystem::TRACE_LINE_PREFIX, argv[1]);
+        return 1;
+    }
+
+    printf("%-36s %8s %8s %10s %10s %10s %12s %10s\n", "Call", "Traced", "Replayed", "Total ms",
+           "Mean us", "Max us", "Field < us", "Mismatches");
+
+    for(int op = 1; op < DataManager_FileSystem::TRACE_OPS; op++)
+    {
+        if(stats[op].calls == 0)
+        {
+            continue;
+        }
+
+        printf("%-36s %8u %8u %10.1f %10.0f %10u %12u %10u\n", DataManager_FileSystem::TRACE_OP_NAMES[op], stats[op].calls, stats[op].replayed,
+               stats[op].total_us / 1000.0, stats[op].replayed ? stats[op].total_us / (double)stats[op].replayed : 0.0,
+               stats[op].max_us, (uint32_t)1 << stats[op].field_max_log2_us, stats[op].mismatches);
+    }
+
+    printf("Total:        %u calls, %.1f ms simulated at %d Hz%s, %u results differ from the trace\n",
+           calls, total_us / 1000.0, frequency_hz, adaptive_clock ? " (adaptive)" : "", mismatches);
+
+    return 0;
+}
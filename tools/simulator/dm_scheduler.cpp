@@ -0,0 +1,751 @@
+/**
+  * @file    dm_scheduler.cpp
+  * @version 0.5.0
+  * @author  Adam Mitchell
+  * @brief   Command line tool that benchmarks DataManager_Scheduler on a simulated
+  *          EEPROM in simulated time. A LoRa node samples its sensors, reads the
+  *          latest samples ahead of each uplink and clears its files after it,
+  *          opening RX1 and RX2 receive windows during which no write cycle may
+  *          be in progress. In the background it appends batches to a log file,
+  *          truncating the log when it fills, whilst urgent reads of the latest
+  *          samples arrive at random. The same workload is run with each call
+  *          made as it arrives and through the scheduler, one step at a time,
+  *          and the latency of each kind of request, deadline misses and calls
+  *          that wrote during a window are reported for both.
+  *
+  *          Build:  g++ -O2 -std=c++11 -I. -I../.. -I../../filesystem ../../DataManager.cpp
+  *                  ../../DataManager_Async.cpp ../../DataManager_Scheduler.cpp
+  *                  DataManager_SimulatedEeprom.cpp dm_scheduler.cpp -o dm_scheduler
+  *          Usage:  dm_scheduler [--duration S] [--sensors N] [--sample-ms MS]
+  *                  [--uplink-s S] [--rx-ms MS] [--bulk-s S] [--urgent-ms MS]
+  *                  [--frequency HZ] [--seed N]
+  *
+  *          Exits with 2 if any call made through the scheduler wrote during a
+  *          window
+  */
+
+/** Includes
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "DataManager.h"
+#include "DataManager_Scheduler.h"
+#include "DataManager_SimulatedEeprom.h"
+
+/** Node behaviour that isn't configurable: bytes per sample, entries per file,
+ *  samples read ahead of an uplink, how long before the uplink they are read
+ *  and the delays of the receive windows after it
+ */
+#define BENCH_ENTRY_BYTES      16
+#define BENCH_FILE_ENTRIES     128
+#define BENCH_UPLINK_ENTRIES   8
+#define BENCH_PREPARE_US       100000
+#define BENCH_RX1_DELAY_US     1000000
+#define BENCH_RX2_DELAY_US     2000000
+#define BENCH_MAX_SENSORS      8
+#define BENCH_POOL             64
+
+/** Background work: entries of the log file, entries appended per batch and
+ *  removed when the log fills, and the deadline of an urgent read
+ */
+#define BENCH_LOG_ENTRIES      384
+#define BENCH_BULK_ENTRIES     32
+#define BENCH_LOG_TRUNCATE     256
+#define BENCH_URGENT_US        25000
+
+/** Kinds of request of the workload. Clearing a file has a deadline like a
+ *  sample so that the two run in order of arrival
+ */
+enum BenchClass
+{
+    CLASS_LOG_TRUNCATE,
+    CLASS_LOG_APPEND,
+    CLASS_CLEAR,
+    CLASS_SAMPLE,
+    CLASS_UPLINK_READ,
+    CLASS_URGENT_READ,
+    CLASS_COUNT
+};
+
+static const char *CLASS_NAMES[CLASS_COUNT] =
+{
+    "log truncate", "log batch append", "clear after uplink", "sample append", "uplink read", "urgent read"
+};
+
+static const uint8_t CLASS_PRIORITIES[CLASS_COUNT] =
+{
+    DataManager_Scheduler::PRIORITY_BULK, DataManager_Scheduler::PRIORITY_BULK, DataManager_Scheduler::PRIORITY_NORMAL,
+    DataManager_Scheduler::PRIORITY_NORMAL, DataManager_Scheduler::PRIORITY_URGENT, DataManager_Scheduler::PRIORITY_URGENT
+};
+
+/** A request of the workload and the time at which it arose
+ */
+struct BenchRequest_t
+{
+    bool used;
+    int bench_class;
+    uint32_t arrival_us;
+    DataManager_Scheduler::Request_t request;
+    char data[BENCH_ENTRY_BYTES * BENCH_BULK_ENTRIES];
+};
+
+/** Outcome of one run of the workload
+ */
+struct BenchStats_t
+{
+    std::vector<uint32_t> latency_us[CLASS_COUNT];
+    uint32_t deadline_misses[CLASS_COUNT];
+    uint32_t window_writes;
+    uint32_t deferred;
+    uint32_t preemptions;
+    uint32_t errors;
+    uint32_t dropped;
+};
+
+/** Receive window opened by an uplink
+ */
+struct BenchWindow_t
+{
+    uint32_t start_us;
+    uint32_t end_us;
+};
+
+static BenchRequest_t pool[BENCH_POOL];
+static uint32_t stored[BENCH_MAX_SENSORS + 1];
+static uint32_t random_state;
+
+/** Get a pseudo-random number
+ *
+ * @return Next number of the sequence
+ */
+static uint32_t next_random()
+{
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+}
+
+/** Take a free request from the pool
+ *
+ * @param bench_class Kind of request
+ * @param op Call to make
+ * @param filename ID of the file
+ * @param now_us Time at which the request arose
+ * @return Pointer to the request or NULL if the pool is exhausted
+ */
+static BenchRequest_t *new_request(int bench_class, DataManager_FileSystem::TraceOp op, uint8_t filename, uint32_t now_us)
+{
+    for(int slot = 0; slot < BENCH_POOL; slot++)
+    {
+        if(!pool[slot].used)
+        {
+            BenchRequest_t &bench = pool[slot];
+            memset(&bench, 0, sizeof(bench));
+            bench.used = true;
+            bench.bench_class = bench_class;
+            bench.arrival_us = now_us;
+            bench.request.op = op;
+            bench.request.filename = filename;
+            bench.request.params.count = 1;
+            bench.request.params.length = BENCH_ENTRY_BYTES;
+            bench.request.data = bench.data;
+            bench.request.priority = CLASS_PRIORITIES[bench_class];
+            return &bench;
+        }
+    }
+
+    return NULL;
+}
+
+/** Make the whole call of a request as soon as it arises
+ *
+ * @param &data_manager DataManager to call
+ * @param &request The request
+ * @return Status of the call
+ */
+static int make_call(DataManager &data_manager, DataManager_Scheduler::Request_t &request)
+{
+    switch(request.op)
+    {
+        case DataManager_FileSystem::TRACE_DELETE_FILE_ENTRIES:
+            return data_manager.delete_file_entries(request.filename);
+
+        case DataManager_FileSystem::TRACE_TRUNCATE_FILE:
+            return data_manager.truncate_file(request.filename, request.params.index);
+
+        default:
+            for(int entry = 0; entry < request.params.count; entry++)
+            {
+                char *data = request.data + (entry * request.params.length);
+                int status = (request.op == DataManager_FileSystem::TRACE_APPEND_FILE_ENTRY) ?
+                             data_manager.append_file_entry(request.filename, data, request.params.length) :
+                             data_manager.read_file_entry(request.filename, request.params.index + entry, data,
+                                                          request.params.length);
+
+                if(status != DataManager::DATA_MANAGER_OK)
+                {
+                    return status;
+                }
+            }
+
+            return DataManager::DATA_MANAGER_OK;
+    }
+}
+
+/** Account for a request that has completed and return it to the pool
+ *
+ * @param &bench The request
+ * @param wrote Whether or not the call wrote to the EEPROM
+ * @param &windows Receive windows opened so far
+ * @param &stats Outcome of the run
+ */
+static void complete(BenchRequest_t &bench, bool wrote, const std::vector<BenchWindow_t> &windows, BenchStats_t &stats)
+{
+    const DataManager_Scheduler::Request_t &request = bench.request;
+    uint32_t &entries = stored[request.filename - 1];
+
+    stats.latency_us[bench.bench_class].push_back(request.completed_us - bench.arrival_us);
+
+    if(request.has_deadline && (int32_t)(request.completed_us - request.deadline_us) > 0)
+    {
+        stats.deadline_misses[bench.bench_class]++;
+    }
+
+    if(request.status != DataManager::DATA_MANAGER_OK)
+    {
+        stats.errors++;
+    }
+    else if(request.op == DataManager_FileSystem::TRACE_APPEND_FILE_ENTRY)
+    {
+        entries += request.params.count;
+    }
+    else if(request.op == DataManager_FileSystem::TRACE_DELETE_FILE_ENTRIES)
+    {
+        entries = 0;
+    }
+    else if(request.op == DataManager_FileSystem::TRACE_TRUNCATE_FILE)
+    {
+        entries = (entries > (uint32_t)request.params.index) ? entries - request.params.index : 0;
+    }
+
+    if(wrote)
+    {
+        for(size_t window = 0; window < windows.size(); window++)
+        {
+            if(windows[window].start_us < request.completed_us && windows[window].end_us > request.started_us)
+            {
+                stats.window_writes++;
+                break;
+            }
+        }
+    }
+
+    bench.used = false;
+}
+
+/** Run the workload
+ *
+ * @param &data_manager DataManager to call
+ * @param &eeprom Simulated EEPROM of the DataManager
+ * @param scheduled Whether calls are made through the scheduler or as they arise
+ * @param duration_s, sensors, sample_ms, uplink_s, rx_ms, bulk_s, urgent_ms Behaviour of the node
+ * @param seed Seed of the sample timing
+ * @param &stats Outcome of the run
+ * @return Indicates success or failure reason
+ */
+static int run_workload(DataManager &data_manager, DataManager_SimulatedEeprom &eeprom, bool scheduled, int duration_s,
+                        int sensors, int sample_ms, int uplink_s, int rx_ms, int bulk_s, int urgent_ms, uint32_t seed,
+                        BenchStats_t &stats)
+{
+    eeprom.erase();
+    memset(pool, 0, sizeof(pool));
+    memset(stored, 0, sizeof(stored));
+    random_state = seed;
+
+    int status = data_manager.init_filesystem();
+
+    if(status == DataManager::DATA_MANAGER_OK)
+    {
+        status = data_manager.init_gstats();
+    }
+
+    /** One file per sensor and the log file after them
+     */
+    uint8_t log_filename = sensors + 1;
+
+    for(int filename = 1; filename <= log_filename && status == DataManager::DATA_MANAGER_OK; filename++)
+    {
+        DataManager_FileSystem::File_t definition;
+        memset(definition.data, 0, sizeof(definition));
+        definition.parameters.filename = filename;
+        definition.parameters.length_bytes = BENCH_ENTRY_BYTES;
+
+        status = data_manager.add_file(definition, (filename == log_filename) ? BENCH_LOG_ENTRIES : BENCH_FILE_ENTRIES);
+    }
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        return status;
+    }
+
+    DataManager_Scheduler scheduler(data_manager);
+    std::vector<BenchWindow_t> windows;
+    uint32_t written[BENCH_MAX_SENSORS];
+    uint32_t next_sample_us[BENCH_MAX_SENSORS];
+
+    uint32_t sample_us = sample_ms * 1000;
+    uint32_t uplink_us = uplink_s * 1000000;
+    uint32_t bulk_us = bulk_s * 1000000;
+    uint32_t urgent_us = urgent_ms * 1000;
+    uint32_t start_us = us_ticker_read();
+    uint32_t end_us = start_us + (duration_s * 1000000);
+    uint32_t next_uplink_us = start_us + uplink_us;
+    uint32_t next_bulk_us = start_us + (next_random() % bulk_us);
+    uint32_t next_urgent_us = start_us + (next_random() % urgent_us);
+    uint32_t log_written = 0;
+    bool prepared = false;
+
+    for(int sensor = 0; sensor < sensors; sensor++)
+    {
+        written[sensor] = 0;
+        next_sample_us[sensor] = start_us + (next_random() % sample_us);
+    }
+
+    while(true)
+    {
+        uint32_t now_us = us_ticker_read();
+
+        if((int32_t)(now_us - end_us) >= 0)
+        {
+            break;
+        }
+
+        std::vector<BenchRequest_t *> arrived;
+
+        for(int sensor = 0; sensor < sensors; sensor++)
+        {
+            if((int32_t)(now_us - next_sample_us[sensor]) < 0)
+            {
+                continue;
+            }
+
+            BenchRequest_t *bench = new_request(CLASS_SAMPLE, DataManager_FileSystem::TRACE_APPEND_FILE_ENTRY,
+                                                sensor + 1, next_sample_us[sensor]);
+
+            next_sample_us[sensor] += (sample_us / 2) + (next_random() % sample_us);
+
+            if(bench == NULL || written[sensor] >= BENCH_FILE_ENTRIES)
+            {
+                if(bench != NULL)
+                {
+                    bench->used = false;
+                }
+
+                stats.dropped++;
+                continue;
+            }
+
+            memset(bench->data, (char)next_random(), BENCH_ENTRY_BYTES);
+            bench->request.has_deadline = true;
+            bench->request.deadline_us = bench->arrival_us + sample_us;
+            written[sensor]++;
+            arrived.push_back(bench);
+        }
+
+        /** Read the latest sample of a sensor at once, ahead of any clearing of
+         *  its file that arises at the same time
+         */
+        if((int32_t)(now_us - next_urgent_us) >= 0)
+        {
+            int sensor = next_random() % sensors;
+
+            if(stored[sensor] > 0)
+            {
+                BenchRequest_t *bench = new_request(CLASS_URGENT_READ, DataManager_FileSystem::TRACE_READ_FILE_ENTRY,
+                                                    sensor + 1, next_urgent_us);
+
+                if(bench != NULL)
+                {
+                    bench->request.params.index = stored[sensor] - 1;
+                    bench->request.has_deadline = true;
+                    bench->request.deadline_us = bench->arrival_us + BENCH_URGENT_US;
+                    arrived.push_back(bench);
+                }
+                else
+                {
+                    stats.dropped++;
+                }
+            }
+
+            next_urgent_us += (urgent_us / 2) + (next_random() % urgent_us);
+        }
+
+        /** Read the latest samples of each file shortly before the uplink...
+         */
+        if(!prepared && (int32_t)(now_us - (next_uplink_us - BENCH_PREPARE_US)) >= 0)
+        {
+            prepared = true;
+
+            for(int sensor = 0; sensor < sensors; sensor++)
+            {
+                int count = stored[sensor] < BENCH_UPLINK_ENTRIES ? stored[sensor] : BENCH_UPLINK_ENTRIES;
+
+                if(count == 0)
+                {
+                    continue;
+                }
+
+                BenchRequest_t *bench = new_request(CLASS_UPLINK_READ, DataManager_FileSystem::TRACE_READ_FILE_ENTRY,
+                                                    sensor + 1, next_uplink_us - BENCH_PREPARE_US);
+
+                if(bench == NULL)
+                {
+                    stats.dropped++;
+                    continue;
+                }
+
+                bench->request.params.index = stored[sensor] - count;
+                bench->request.params.count = count;
+                bench->request.has_deadline = true;
+                bench->request.deadline_us = next_uplink_us;
+                arrived.push_back(bench);
+            }
+        }
+
+        /** ...then transmit, opening the receive windows, and clear the files
+         */
+        if((int32_t)(now_us - next_uplink_us) >= 0)
+        {
+            BenchWindow_t rx1 = { next_uplink_us + BENCH_RX1_DELAY_US, next_uplink_us + BENCH_RX1_DELAY_US + (rx_ms * 1000) };
+            BenchWindow_t rx2 = { next_uplink_us + BENCH_RX2_DELAY_US, next_uplink_us + BENCH_RX2_DELAY_US + (rx_ms * 1000) };
+            windows.push_back(rx1);
+            windows.push_back(rx2);
+
+            if(scheduled)
+            {
+                scheduler.add_blackout(rx1.start_us, rx1.end_us - rx1.start_us);
+                scheduler.add_blackout(rx2.start_us, rx2.end_us - rx2.start_us);
+            }
+
+            for(int sensor = 0; sensor < sensors; sensor++)
+            {
+                BenchRequest_t *bench = new_request(CLASS_CLEAR, DataManager_FileSystem::TRACE_DELETE_FILE_ENTRIES,
+                                                    sensor + 1, next_uplink_us);
+
+                if(bench == NULL)
+                {
+                    stats.dropped++;
+                    continue;
+                }
+
+                bench->request.has_deadline = true;
+                bench->request.deadline_us = bench->arrival_us + sample_us;
+                written[sensor] = 0;
+                arrived.push_back(bench);
+            }
+
+            next_uplink_us += uplink_us;
+            prepared = false;
+        }
+
+        /** Append a batch to the log, truncating it first if it is full
+         */
+        if((int32_t)(now_us - next_bulk_us) >= 0)
+        {
+            if(log_written + BENCH_BULK_ENTRIES > BENCH_LOG_ENTRIES)
+            {
+                BenchRequest_t *bench = new_request(CLASS_LOG_TRUNCATE, DataManager_FileSystem::TRACE_TRUNCATE_FILE,
+                                                    log_filename, next_bulk_us);
+
+                if(bench != NULL)
+                {
+                    bench->request.params.index = BENCH_LOG_TRUNCATE;
+                    log_written -= BENCH_LOG_TRUNCATE;
+                    arrived.push_back(bench);
+                }
+                else
+                {
+                    stats.dropped++;
+                }
+            }
+
+            BenchRequest_t *bench = new_request(CLASS_LOG_APPEND, DataManager_FileSystem::TRACE_APPEND_FILE_ENTRY,
+                                                log_filename, next_bulk_us);
+
+            if(bench != NULL && log_written + BENCH_BULK_ENTRIES <= BENCH_LOG_ENTRIES)
+            {
+                memset(bench->data, (char)next_random(), sizeof(bench->data));
+                bench->request.params.count = BENCH_BULK_ENTRIES;
+                log_written += BENCH_BULK_ENTRIES;
+                arrived.push_back(bench);
+            }
+            else
+            {
+                if(bench != NULL)
+                {
+                    bench->used = false;
+                }
+
+                stats.dropped++;
+            }
+
+            next_bulk_us += bulk_us;
+        }
+
+        uint32_t wake_us = now_us;
+        int pending = 0;
+        bool stepped = false;
+
+        for(size_t request = 0; request < arrived.size(); request++)
+        {
+            BenchRequest_t &bench = *arrived[request];
+
+            if(scheduled)
+            {
+                if(scheduler.submit(bench.request) != DataManager::DATA_MANAGER_OK)
+                {
+                    bench.used = false;
+                    stats.dropped++;
+                }
+
+                continue;
+            }
+
+            DataManager::IoStats_t io_stats;
+            data_manager.get_io_stats(io_stats);
+            uint32_t start_write_cycles = io_stats.write_cycles;
+
+            bench.request.started_us = us_ticker_read();
+            bench.request.status = make_call(data_manager, bench.request);
+            bench.request.completed_us = us_ticker_read();
+
+            data_manager.get_io_stats(io_stats);
+            complete(bench, io_stats.write_cycles != start_write_cycles, windows, stats);
+        }
+
+        /** Make one step at a time, so that requests arising during a long
+         *  request are submitted between its steps
+         */
+        if(scheduled)
+        {
+            status = scheduler.run_step(stepped, pending, wake_us);
+
+            if(status != DataManager::DATA_MANAGER_OK)
+            {
+                return status;
+            }
+
+            for(int slot = 0; slot < BENCH_POOL; slot++)
+            {
+                BenchRequest_t &bench = pool[slot];
+
+                /** A long request may be deferred part way through until a
+                 *  window has closed, so whether its steps wrote during a
+                 *  window is taken from the scheduler
+                 */
+                if(bench.used && bench.request.state == DataManager_Scheduler::REQUEST_DONE)
+                {
+                    complete(bench, false, windows, stats);
+                }
+            }
+
+            if(stepped)
+            {
+                continue;
+            }
+        }
+
+        /** Sleep until the next sample, uplink, batch, urgent read or deferred request
+         */
+        uint32_t next_us = next_uplink_us - (prepared ? 0 : BENCH_PREPARE_US);
+        uint32_t events[] = { next_bulk_us, next_urgent_us };
+
+        for(size_t event = 0; event < sizeof(events) / sizeof(events[0]); event++)
+        {
+            if((int32_t)(events[event] - next_us) < 0)
+            {
+                next_us = events[event];
+            }
+        }
+
+        for(int sensor = 0; sensor < sensors; sensor++)
+        {
+            if((int32_t)(next_sample_us[sensor] - next_us) < 0)
+            {
+                next_us = next_sample_us[sensor];
+            }
+        }
+
+        if(pending > 0 && (int32_t)(wake_us - next_us) < 0)
+        {
+            next_us = wake_us;
+        }
+
+        now_us = us_ticker_read();
+
+        if((int32_t)(next_us - now_us) > 0)
+        {
+            eeprom.advance_us(next_us - now_us);
+        }
+    }
+
+    DataManager_Scheduler::SchedulerStats_t scheduler_stats;
+    scheduler.get_stats(scheduler_stats);
+    stats.deferred = scheduler_stats.deferred;
+    stats.preemptions = scheduler_stats.preemptions;
+
+    if(scheduled)
+    {
+        stats.window_writes = scheduler_stats.window_overlaps;
+    }
+
+    return DataManager::DATA_MANAGER_OK;
+}
+
+/** Print the outcome of a run
+ *
+ * @param *mode Name of the run
+ * @param &stats Outcome of the run
+ */
+static void print_stats(const char *mode, BenchStats_t &stats)
+{
+    for(int bench_class = CLASS_COUNT - 1; bench_class >= 0; bench_class--)
+    {
+        std::vector<uint32_t> &latency = stats.latency_us[bench_class];
+
+        if(latency.empty())
+        {
+            continue;
+        }
+
+        std::sort(latency.begin(), latency.end());
+
+        uint64_t total_us = 0;
+
+        for(size_t request = 0; request < latency.size(); request++)
+        {
+            total_us += latency[request];
+        }
+
+        printf("%-10s %-20s %8u %10.2f %10.2f %10.2f %10.2f %8u\n", mode, CLASS_NAMES[bench_class], (uint32_t)latency.size(),
+               (total_us / (double)latency.size()) / 1000.0, latency[latency.size() / 2] / 1000.0,
+               latency[((latency.size() - 1) * 99) / 100] / 1000.0, latency.back() / 1000.0, stats.deadline_misses[bench_class]);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int duration_s = 600;
+    int sensors = 4;
+    int sample_ms = 250;
+    int uplink_s = 10;
+    int rx_ms = 200;
+    int bulk_s = 5;
+    int urgent_ms = 500;
+    int frequency_hz = 400000;
+    uint32_t seed = 1;
+
+    for(int arg = 1; arg < argc; arg++)
+    {
+        if(arg + 1 >= argc)
+        {
+            fprintf(stderr, "Unknown option %s\n", argv[arg]);
+            return 1;
+        }
+
+        if(strcmp(argv[arg], "--duration") == 0)
+        {
+            duration_s = strtol(argv[++arg], NULL, 0);
+        }
+        else if(strcmp(argv[arg], "--sensors") == 0)
+        {
+            sensors = strtol(argv[++arg], NULL, 0);
+        }
+        else if(strcmp(argv[arg], "--sample-ms") == 0)
+        {
+            sample_ms = strtol(argv[++arg], NULL, 0);
+        }
+        else if(strcmp(argv[arg], "--uplink-s") == 0)
+        {
+            uplink_s = strtol(argv[++arg], NULL, 0);
+        }
+        else if(strcmp(argv[arg], "--rx-ms") == 0)
+        {
+            rx_ms = strtol(argv[++arg], NULL, 0);
+        }
+        else if(strcmp(argv[arg], "--bulk-s") == 0)
+        {
+            bulk_s = strtol(argv[++arg], NULL, 0);
+        }
+        else if(strcmp(argv[arg], "--urgent-ms") == 0)
+        {
+            urgent_ms = strtol(argv[++arg], NULL, 0);
+        }
+        else if(strcmp(argv[arg], "--frequency") == 0)
+        {
+            frequency_hz = strtol(argv[++arg], NULL, 0);
+        }
+        else if(strcmp(argv[arg], "--seed") == 0)
+        {
+            seed = strtoul(argv[++arg], NULL, 0);
+        }
+        else
+        {
+            fprintf(stderr, "Unknown option %s\n", argv[arg]);
+            return 1;
+        }
+    }
+
+    if(sensors < 1 || sensors > BENCH_MAX_SENSORS || sample_ms < 1 || uplink_s < 3 || rx_ms < 1 || bulk_s < 1 ||
+       urgent_ms < 1 || duration_s < uplink_s || duration_s > 4000 || seed == 0)
+    {
+        fprintf(stderr, "Need 1 to %d sensors, --uplink-s of at least 3, a --duration of --uplink-s to 4000 and a non-zero --seed\n",
+                BENCH_MAX_SENSORS);
+        return 1;
+    }
+
+    static DataManager_SimulatedEeprom eeprom;
+    DataManager_SimulatedEeprom::select(&eeprom);
+    static DataManager data_manager(NC, NC, NC, frequency_hz);
+
+    static BenchStats_t direct;
+    static BenchStats_t scheduled;
+    memset(direct.deadline_misses, 0, sizeof(direct.deadline_misses));
+    memset(scheduled.deadline_misses, 0, sizeof(scheduled.deadline_misses));
+
+    int status = run_workload(data_manager, eeprom, false, duration_s, sensors, sample_ms, uplink_s, rx_ms, bulk_s,
+                              urgent_ms, seed, direct);
+
+    if(status == DataManager::DATA_MANAGER_OK)
+    {
+        status = run_workload(data_manager, eeprom, true, duration_s, sensors, sample_ms, uplink_s, rx_ms, bulk_s,
+                              urgent_ms, seed, scheduled);
+    }
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        fprintf(stderr, "Workload failed with status %d\n", status);
+        return 1;
+    }
+
+    DataManager::DeviceTiming_t timing;
+    data_manager.get_device_timing(timing);
+
+    printf("%-10s %-20s %8s %10s %10s %10s %10s %8s\n", "Mode", "Request", "Count", "Mean ms", "p50 ms", "p99 ms", "Max ms", "Late");
+    print_stats("direct", direct);
+    print_stats("scheduled", scheduled);
+
+    printf("Windows:      %u calls made as they arose and %u made through the scheduler wrote during an RX window\n",
+           direct.window_writes, scheduled.window_writes);
+    printf("Scheduler:    %u requests waited for an RX window to close, %u steps of a long request were preempted\n",
+           scheduled.deferred, scheduled.preemptions);
+    printf("Write cycle:  %.2f ms measured\n", timing.write_cycle_us / 1000.0);
+    printf("Errors:       %u direct, %u scheduled; %u and %u requests dropped\n", direct.errors, scheduled.errors,
+           direct.dropped, scheduled.dropped);
+
+    return scheduled.window_writes == 0 ? 0 : 2;
+}
@@ -0,0 +1,320 @@
+/**
+  * @file    dm_workload.cpp
+  * @version 0.5.0
+  * @author  Adam Mitchell
+  * @brief   Command line tool that runs a duty-cycle workload through the real
+  *          DataManager on a simulated EEPROM and reports the energy-relevant
+  *          figures of the storage layer: awake time per cycle, write cycles per
+  *          day and projected EEPROM lifetime.
+  *
+  *          Build:  g++ -O2 -std=c++11 -I. -I../.. -I../../filesystem ../../DataManager.cpp
+  *                  ../../DataManager_Async.cpp DataManager_SimulatedEeprom.cpp
+  *                  DataManager_NodeWorkload.cpp dm_workload.cpp -o dm_workload
+  *          Usage:  dm_workload <workload> [--days D] [--seed S] [--nack-ppm N]
+  *                                 [--arbitration-ppm N] [--timeout-ppm N] [--retry-attempts N]
+  *                                 [--retry-backoff-us T] [--retry-backoff-max-us T]
+  *                                 [--flame-graph time|bus-bytes|transfers|write-cycles]
+  *                                 [--supply-mv V] [--mcu-active-ua I] [--eeprom-active-ua I]
+  *                                 [--eeprom-write-ua I]
+  *
+  *          The workload contains one setting per line:
+  *              wake_s <seconds between wake-ups>
+  *              wake_overhead_us <time awake per cycle spent on everything but storage>
+  *              sensor <entry_bytes> <entries_to_store>    (one line per sensor file)
+  *              uplink_s <seconds between uplink attempts>
+  *              uplink_success_percent <share of uplink attempts that succeed>
+  *              truncate_percent <share of a full file removed to make room>
+  *          Blank lines and lines starting with '#' are ignored
+  *
+  *          The --*-ppm options inject bus faults into that many transfers per
+  *          million and the --retry-* options set the DataManager's retry policy,
+  *          to measure the cost of bus errors and tune the policy
+  *
+  *          With --flame-graph, which needs -DDM_SPANS=true on the build line,
+  *          the report is replaced by the span tree of the DataManager as
+  *          collapsed stacks of the given cost, e.g.
+  *              dm_workload node.txt --flame-graph time | flamegraph.pl > time.svg
+  *
+  *          Built with -DDM_RETRY_STATS=true, the report breaks retries down
+  *          by public call.
+  *
+  *          Built with -DDM_ENERGY_MODEL=true, the report includes the energy
+  *          estimated for the storage calls, for the datasheet figures given by
+  *          the --supply-mv and --*-ua options
+  */
+
+/** Includes
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "DataManager_NodeWorkload.h"
+
+
+int main(int argc, char **argv)
+{
+    if(argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <workload> [--days D] [--seed S] [--nack-ppm N] [--arbitration-ppm N]\n"
+                        "       [--timeout-ppm N] [--retry-attempts N] [--retry-backoff-us T] [--retry-backoff-max-us T]\n"
+                        "       [--flame-graph time|bus-bytes|transfers|write-cycles] [--supply-mv V] [--mcu-active-ua I]\n"
+                        "       [--eeprom-active-ua I] [--eeprom-write-ua I]\n", argv[0]);
+        return 1;
+    }
+
+    int days = 30;
+    uint32_t seed = 1;
+    uint32_t fault_ppm[DataManager_SimulatedEeprom::SIM_FAULT_KINDS] = { 0 };
+    DataManager::RetryPolicy_t policy = { NUM_OF_WRITE_RETRIES, RETRY_BACKOFF_US, RETRY_BACKOFF_MAX_US };
+    static const char *METRIC_NAMES[] = { "time", "bus-bytes", "transfers", "write-cycles" };
+    int flame_metric = -1;
+    static const char *ENERGY_OPTIONS[] = { "--supply-mv", "--mcu-active-ua", "--eeprom-active-ua", "--eeprom-write-ua" };
+    #if DM_ENERGY_MODEL == true
+    uint32_t energy_model[] = { ENERGY_SUPPLY_MV, ENERGY_MCU_ACTIVE_UA, ENERGY_EEPROM_ACTIVE_UA,
+                                ENERGY_EEPROM_WRITE_UA, ENERGY_WRITE_CYCLE_US };
+    #endif /* #if DM_ENERGY_MODEL == true */
+
+    for(int arg = 2; arg + 1 < argc; arg += 2)
+    {
+        if(strcmp(argv[arg], "--days") == 0)
+        {
+            days = strtol(argv[arg + 1], NULL, 0);
+        }
+        else if(strcmp(argv[arg], "--seed") == 0)
+        {
+            seed = strtoul(argv[arg + 1], NULL, 0);
+        }
+        else if(strcmp(argv[arg], "--nack-ppm") == 0)             fault_ppm[DataManager_SimulatedEeprom::SIM_NACK] = strtoul(argv[arg + 1], NULL, 0);
+        else if(strcmp(argv[arg], "--arbitration-ppm") == 0)      fault_ppm[DataManager_SimulatedEeprom::SIM_ARBITRATION_LOST] = strtoul(argv[arg + 1], NULL, 0);
+        else if(strcmp(argv[arg], "--timeout-ppm") == 0)          fault_ppm[DataManager_SimulatedEeprom::SIM_TIMEOUT] = strtoul(argv[arg + 1], NULL, 0);
+        else if(strcmp(argv[arg], "--retry-attempts") == 0)       policy.attempts = strtol(argv[arg + 1], NULL, 0);
+        else if(strcmp(argv[arg], "--retry-backoff-us") == 0)     policy.backoff_us = strtoul(argv[arg + 1], NULL, 0);
+        else if(strcmp(argv[arg], "--retry-backoff-max-us") == 0) policy.backoff_max_us = strtoul(argv[arg + 1], NULL, 0);
+        else if(strcmp(argv[arg], "--flame-graph") == 0)
+        {
+            for(int metric = 0; metric < 4; metric++)
+            {
+                if(strcmp(argv[arg + 1], METRIC_NAMES[metric]) == 0)
+                {
+                    flame_metric = metric;
+                }
+            }
+
+            if(flame_metric < 0)
+            {
+                fprintf(stderr, "Unknown cost %s\n", argv[arg + 1]);
+                return 1;
+            }
+
+            #if DM_SPANS != true
+            fprintf(stderr, "--flame-graph needs a build with -DDM_SPANS=true\n");
+            return 1;
+            #endif /* #if DM_SPANS != true */
+        }
+        else
+        {
+            int field = 0;
+
+            while(field < 4 && strcmp(argv[arg], ENERGY_OPTIONS[field]) != 0)
+            {
+                field++;
+            }
+
+            if(field == 4)
+            {
+                fprintf(stderr, "Unknown option %s\n", argv[arg]);
+                return 1;
+            }
+
+            #if DM_ENERGY_MODEL == true
+            energy_model[field] = strtoul(argv[arg + 1], NULL, 0);
+            #else
+            fprintf(stderr, "%s needs a build with -DDM_ENERGY_MODEL=true\n", argv[arg]);
+            return 1;
+            #endif /* #if DM_ENERGY_MODEL == true */
+        }
+    }
+
+    FILE *description = fopen(argv[1], "r");
+
+    if(description == NULL)
+    {
+        fprintf(stderr, "Unable to open workload %s\n", argv[1]);
+        return 1;
+    }
+
+    NodeWorkload_t workload;
+    memset(&workload, 0, sizeof(workload));
+    workload.wake_period_s = 900;
+    workload.uplink_period_s = 6 * 3600;
+    workload.uplink_success_percent = 100;
+    workload.truncate_percent = 25;
+
+    char line[128];
+    int line_number = 0;
+
+    while(fgets(line, sizeof(line), description) != NULL)
+    {
+        line_number++;
+
+        char keyword[32];
+        unsigned int first, second;
+
+        if(sscanf(line, " %31s", keyword) != 1 || keyword[0] == '#')
+        {
+            continue;
+        }
+
+        int values = sscanf(line, " %*s %u %u", &first, &second);
+        bool valid = values >= 1;
+
+        if(valid && strcmp(keyword, "sensor") == 0)
+        {
+            valid = values == 2 && workload.sensors < WORKLOAD_MAX_SENSORS;
+
+            if(valid)
+            {
+                workload.entry_bytes[workload.sensors] = first;
+                workload.entries_per_file[workload.sensors] = second;
+                workload.sensors++;
+            }
+        }
+        else if(valid && strcmp(keyword, "wake_s") == 0)                 workload.wake_period_s = first;
+        else if(valid && strcmp(keyword, "wake_overhead_us") == 0)       workload.wake_overhead_us = first;
+        else if(valid && strcmp(keyword, "uplink_s") == 0)               workload.uplink_period_s = first;
+        else if(valid && strcmp(keyword, "uplink_success_percent") == 0) workload.uplink_success_percent = first;
+        else if(valid && strcmp(keyword, "truncate_percent") == 0)       workload.truncate_percent = first;
+        else
+        {
+            valid = false;
+        }
+
+        if(!valid)
+        {
+            fprintf(stderr, "%s:%d: unknown or malformed setting\n", argv[1], line_number);
+            fclose(description);
+            return 1;
+        }
+    }
+
+    fclose(description);
+
+    if(days < 1 || workload.wake_period_s == 0 || workload.uplink_period_s == 0)
+    {
+        fprintf(stderr, "--days, wake_s and uplink_s must be positive\n");
+        return 1;
+    }
+
+    static DataManager_NodeWorkload node(workload, seed);
+
+    node.get_eeprom().set_bus_faults(fault_ppm[DataManager_SimulatedEeprom::SIM_NACK],
+                                     fault_ppm[DataManager_SimulatedEeprom::SIM_ARBITRATION_LOST],
+                                     fault_ppm[DataManager_SimulatedEeprom::SIM_TIMEOUT], seed);
+    node.get_data_manager().set_retry_policy(policy);
+
+    #if DM_ENERGY_MODEL == true
+    DataManager::EnergyModel_t model = { energy_model[0], energy_model[1], energy_model[2], energy_model[3], energy_model[4] };
+    node.get_data_manager().set_energy_model(model);
+    #endif /* #if DM_ENERGY_MODEL == true */
+
+    int status = node.setup();
+
+    if(status != DataManager::DATA_MANAGER_OK)
+    {
+        fprintf(stderr, "Setup failed with status %d; check the sensors fit the EEPROM\n", status);
+        return 1;
+    }
+
+    #if DM_SPANS == true
+    /** Leave the setup out of the flame graph
+     */
+    node.get_data_manager().reset_spans();
+    #endif /* #if DM_SPANS == true */
+
+    #if DM_ENERGY_MODEL == true
+    node.get_data_manager().reset_energy_stats();
+    #endif /* #if DM_ENERGY_MODEL == true */
+
+    node.run((uint64_t)days * 24 * 3600);
+
+    #if DM_SPANS == true
+    if(flame_metric >= 0)
+    {
+        node.get_data_manager().dump_spans((DataManager_FileSystem::SpanMetric)flame_metric);
+        return 0;
+    }
+    #endif /* #if DM_SPANS == true */
+
+    NodeStats_t stats;
+    node.get_stats(stats);
+
+    DataManager::IoStats_t io_stats;
+    node.get_data_manager().get_io_stats(io_stats);
+
+    static DataManager::RetryStats_t retry_stats;
+    node.get_data_manager().get_retry_stats(retry_stats);
+
+    double cycles = stats.cycles ? (double)stats.cycles : 1.0;
+    double storage_us = stats.awake_us - (stats.cycles * (double)workload.wake_overhead_us);
+
+    printf("Workload:     %d sensors, wake every %u s, uplink every %u s (%d%% succeed), %d days\n",
+           workload.sensors, workload.wake_period_s, workload.uplink_period_s, workload.uplink_success_percent, days);
+    printf("Activity:     %llu cycles, %llu uplinks, %llu failed uplinks, %llu truncations, %llu errors\n",
+           (unsigned long long)stats.cycles, (unsigned long long)stats.uplinks, (unsigned long long)stats.failed_uplinks,
+           (unsigned long long)stats.truncations, (unsigned long long)stats.errors);
+    printf("Awake:        mean %.2f ms per cycle, of which storage %.2f ms; max %.2f ms\n",
+           stats.awake_us / cycles / 1000.0, storage_us / cycles / 1000.0, stats.max_awake_us / 1000.0);
+    printf("Duty cycle:   %.4f%% awake\n", (100.0 * stats.awake_us) / ((double)days * 24 * 3600 * 1000000));
+    printf("Writes:       %.0f write cycles per day, worst page %.1f per day\n",
+           stats.write_cycles / (double)days, stats.max_page_writes / (double)days);
+    printf("Bus:          %.0f bytes per day, %.0f saved by current address reads\n",
+           stats.bus_bytes / (double)days, io_stats.bus_bytes_saved / (double)days);
+    printf("Bus faults:   %llu NACKs, %llu arbitration losses, %llu timeouts injected\n",
+           (unsigned long long)node.get_eeprom().get_injected_faults(DataManager_SimulatedEeprom::SIM_NACK),
+           (unsigned long long)node.get_eeprom().get_injected_faults(DataManager_SimulatedEeprom::SIM_ARBITRATION_LOST),
+           (unsigned long long)node.get_eeprom().get_injected_faults(DataManager_SimulatedEeprom::SIM_TIMEOUT));
+    printf("Retries:      %u retries costing %.1f ms (%.3f%% of storage time), %u writes failed after %d attempts\n",
+           retry_stats.total.retries, retry_stats.total.retry_us / 1000.0,
+           storage_us > 0 ? (100.0 * retry_stats.total.retry_us) / storage_us : 0.0,
+           retry_stats.total.failures, policy.attempts);
+
+    #if DM_RETRY_STATS == true
+    for(int op = 0; op < DataManager_FileSystem::TRACE_OPS; op++)
+    {
+        if(retry_stats.api[op].retries > 0 || retry_stats.api[op].failures > 0)
+        {
+            printf("              %-32s %u retries, %.1f ms, %u failed\n", DataManager_FileSystem::TRACE_OP_NAMES[op],
+                   retry_stats.api[op].retries, retry_stats.api[op].retry_us / 1000.0, retry_stats.api[op].failures);
+        }
+    }
+    #endif /* #if DM_RETRY_STATS == true */
+
+    #if DM_ENERGY_MODEL == true
+    static DataManager::EnergyStats_t energy_stats;
+    node.get_data_manager().get_energy_stats(energy_stats);
+
+    double total_nj = (double)energy_stats.total.mcu_nj + energy_stats.total.bus_nj + energy_stats.total.write_nj;
+
+    printf("Energy:       %.2f mJ per day in storage calls, %.1f uJ per cycle at %u mV (MCU %.0f%%, bus %.0f%%, write cycles %.0f%%)\n",
+           total_nj / 1000000.0 / days, total_nj / 1000.0 / cycles, model.supply_mv,
+           total_nj > 0 ? (100.0 * energy_stats.total.mcu_nj) / total_nj : 0.0,
+           total_nj > 0 ? (100.0 * energy_stats.total.bus_nj) / total_nj : 0.0,
+           total_nj > 0 ? (100.0 * energy_stats.total.write_nj) / total_nj : 0.0);
+
+    for(int op = 1; op < DataManager_FileSystem::TRACE_OPS; op++)
+    {
+        const DataManager::EnergyCounts_t &counts = energy_stats.api[op];
+
+        if(counts.calls > 0)
+        {
+            printf("              %-32s %u calls, %.2f uJ each\n", DataManager_FileSystem::TRACE_OP_NAMES[op], counts.calls,
+                   ((double)counts.mcu_nj + counts.bus_nj + counts.write_nj) / 1000.0 / counts.calls);
+        }
+    }
+    #endif /* #if DM_ENERGY_MODEL == true */
+
+    printf("Lifetime:     %.1f years until the worst page reaches %d cycles\n",
+           DataManager_NodeWorkload::projected_lifetime_years(stats.max_page_writes, days), SIM_ENDURANCE_CYCLES);
+
+    return 0;
+}
@@ -0,0 +1,256 @@
+/**
+  * @file    mbed.h
+  * @version 0.5.0
+  * @author  Adam Mitchell
+  * @brief   Host stand-in for the subset of mbed OS used by the DataManager. Time
+  *          and bus transfers are served by the simulated EEPROM selected on the
+  *          calling thread, see DataManager_SimulatedEeprom.h
+  */
+
+/** Define to prevent recursive inclusion
+ */
+#pragma once
+
+/** Includes
+ */
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <functional>
+#include "DataManager_SimulatedEeprom.h"
+
+/** Targets known to the DataManager; the simulator models the development board
+ */
+#define DEVELOPMENT_BOARD_V1_1_0 1
+#define WRIGHT_V1_0_0            2
+#define EARHART_V1_0_0           3
+
+#ifndef BOARD
+    #define BOARD DEVELOPMENT_BOARD_V1_1_0
+#endif /* #ifndef BOARD */
+
+/** The I2C stand-in offers interrupt driven transfers, whose events are run
+ *  by DataManager_SimulatedEeprom::run_interrupts(). Define as 0 to build the
+ *  DataManager without them
+ */
+#ifndef DEVICE_I2C_ASYNCH
+    #define DEVICE_I2C_ASYNCH 1
+#endif /* #ifndef DEVICE_I2C_ASYNCH */
+
+/** Time public calls in simulated rather than host time
+ */
+#define DM_LATENCY_CLOCK_US_TICKER 1
+
+typedef int PinName;
+
+#define NC ((PinName)-1)
+
+inline uint32_t us_ticker_read()
+{
+    return (uint32_t)DataManager_SimulatedEeprom::selected()->now_us();
+}
+
+inline void wait_us(int us)
+{
+    DataManager_SimulatedEeprom::selected()->advance_us(us);
+}
+
+inline void debug(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+}
+
+inline void core_util_critical_section_enter() {}
+
+inline void core_util_critical_section_exit() {}
+
+/** Callable bound to a function or to a method of an object, as mbed's
+ *  Callback. An empty Callback tests false
+ */
+template <typename F>
+class Callback;
+
+template <typename R, typename... Args>
+class Callback<R(Args...)>
+{
+
+    public:
+
+        Callback() {}
+
+        Callback(R (*function)(Args...)) : _function(function) {}
+
+        template <typename T>
+        Callback(T *object, R (T::*method)(Args...)) : 
+                 _function([object, method](Args... args) { return (object->*method)(args...); }) {}
+
+        R operator()(Args... args) const
+        {
+            return _function(args...);
+        }
+
+        explicit operator bool() const
+        {
+            return (bool)_function;
+        }
+
+    private:
+
+        std::function<R(Args...)> _function;
+};
+
+template <typename T, typename R, typename... Args>
+Callback<R(Args...)> callback(T *object, R (T::*method)(Args...))
+{
+    return Callback<R(Args...)>(object, method);
+}
+
+/** Events of an interrupt driven I2C transfer
+ */
+#define I2C_EVENT_ERROR               (1 << 1)
+#define I2C_EVENT_ERROR_NO_SLAVE      (1 << 2)
+#define I2C_EVENT_TRANSFER_COMPLETE   (1 << 3)
+#define I2C_EVENT_TRANSFER_EARLY_NACK (1 << 4)
+#define I2C_EVENT_ALL                 (I2C_EVENT_ERROR | I2C_EVENT_TRANSFER_COMPLETE | I2C_EVENT_ERROR_NO_SLAVE | \
+                                       I2C_EVENT_TRANSFER_EARLY_NACK)
+
+typedef Callback<void(int)> event_callback_t;
+
+/** One-shot timer whose callback runs as an interrupt of the selected device
+ *  once the simulated clock has advanced past its delay. Unlike mbed's, 
+ *  attaching again doesn't cancel the callback already attached
+ */
+class Timeout
+{
+
+    public:
+
+        void attach_us(const Callback<void()> &function, int us)
+        {
+            DataManager_SimulatedEeprom *device = DataManager_SimulatedEeprom::selected();
+            device->post_interrupt(device->now_us() + us, [function]() { function(); });
+        }
+};
+
+class DigitalOut
+{
+
+    public:
+
+        DigitalOut(PinName pin, int value = 0) : _value(value) {}
+
+        DigitalOut &operator=(int value)
+        {
+            _value = value;
+            return *this;
+        }
+
+        operator int()
+        {
+            return _value;
+        }
+
+    private:
+
+        int _value;
+};
+
+/** Bus transfers as seen by the EEPROM: a write of two bytes only sets the
+ *  address counter, a longer write is a page write and a read continues from
+ *  the address counter.
+ *
+ *  An interrupt driven transfer is made on the device when it is started, so
+ *  its bus time is charged to the caller, and its event is run as an interrupt
+ *  by the next DataManager_SimulatedEeprom::run_interrupts(). The write cycle
+ *  it starts runs on the simulated clock as usual, which is what a caller 
+ *  overlaps with its own work
+ */
+class I2C
+{
+
+    public:
+
+        I2C(PinName sda, PinName scl) : _frequency_hz(100000), _transfer_pending(false) {}
+
+        void frequency(int hz)
+        {
+            _frequency_hz = hz;
+        }
+
+        int read(int address, char *data, int length, bool repeated = false)
+        {
+            return DataManager_SimulatedEeprom::selected()->current_read(data, length, _frequency_hz);
+        }
+
+        int write(int address, const char *data, int length, bool repeated = false)
+        {
+            DataManager_SimulatedEeprom *device = DataManager_SimulatedEeprom::selected();
+            int memory_address = ((uint8_t)data[0] << 8) | (uint8_t)data[1];
+
+            if(length <= 2)
+            {
+                return device->set_address(memory_address, _frequency_hz);
+            }
+
+            return device->page_write(memory_address, &data[2], length - 2, _frequency_hz);
+        }
+
+        int transfer(int address, const char *tx_buffer, int tx_length, char *rx_buffer, int rx_length,
+                     const event_callback_t &handler, int event = I2C_EVENT_TRANSFER_COMPLETE, bool repeated = false)
+        {
+            if(_transfer_pending)
+            {
+                return -1;
+            }
+
+            int status = DataManager_SimulatedEeprom::SIM_OK;
+
+            if(tx_length > 0)
+            {
+                status = write(address, tx_buffer, tx_length, rx_length > 0);
+            }
+
+            if(status == DataManager_SimulatedEeprom::SIM_OK && rx_length > 0)
+            {
+                status = read(address, rx_buffer, rx_length);
+            }
+
+            int events = I2C_EVENT_TRANSFER_COMPLETE;
+
+            if(status == DataManager_SimulatedEeprom::SIM_NACK)
+            {
+                events = I2C_EVENT_ERROR_NO_SLAVE;
+            }
+            else if(status != DataManager_SimulatedEeprom::SIM_OK)
+            {
+                events = I2C_EVENT_ERROR;
+            }
+
+            _transfer_pending = true;
+
+            DataManager_SimulatedEeprom *device = DataManager_SimulatedEeprom::selected();
+            device->post_interrupt(device->now_us(), [this, handler, events, event]()
+            {
+                _transfer_pending = false;
+
+                if(handler && (events & event))
+                {
+                    handler(events & event);
+                }
+            });
+
+            return 0;
+        }
+
+        void stop() {}
+
+    private:
+
+        int _frequency_hz;
+        bool _transfer_pending;
+};